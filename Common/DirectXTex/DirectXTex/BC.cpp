@@ -717,6 +717,366 @@ namespace
         pBC->bitmap = 0x00000000;
     }
 #endif // COLOR_WEIGHTS
+
+    //-------------------------------------------------------------------------------------
+    // Integer fast path for 8-bit RGBA blocks (TEX_COMPRESS_BC_FAST)
+    //
+    // The endpoints come from the bounding box of the block, with its diagonal picked by the
+    // sign of the covariance of red and blue with green, inset by 1/16th of the range and then
+    // refined once by least squares. Colors are indexed by their projection on the endpoint
+    // axis, so there is no float expansion and no per-palette-entry distance search.
+    //-------------------------------------------------------------------------------------
+    inline uint16_t Quantize565(int32_t r, int32_t g, int32_t b)
+    {
+        r = (r < 0) ? 0 : (r > 255) ? 255 : r;
+        g = (g < 0) ? 0 : (g > 255) ? 255 : g;
+        b = (b < 0) ? 0 : (b > 255) ? 255 : b;
+
+        return static_cast<uint16_t>(
+            (((r * 31 + 127) / 255) << 11)
+            | (((g * 63 + 127) / 255) << 5)
+            | ((b * 31 + 127) / 255));
+    }
+
+    inline void Expand565(uint16_t w565, _Out_writes_(3) int32_t *pColor)
+    {
+        int32_t r = (w565 >> 11) & 31;
+        int32_t g = (w565 >> 5) & 63;
+        int32_t b = w565 & 31;
+
+        pColor[0] = (r << 3) | (r >> 2);
+        pColor[1] = (g << 2) | (g >> 4);
+        pColor[2] = (b << 3) | (b >> 2);
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Per channel minimum and maximum of a block, as packed RGBA
+    void BoundsRGBA(
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const uint32_t *pRGBA,
+        _Out_ uint32_t *pMin,
+        _Out_ uint32_t *pMax)
+    {
+#if defined(_XM_SSE_INTRINSICS_)
+        __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRGBA));
+        __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRGBA + 4));
+        __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRGBA + 8));
+        __m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRGBA + 12));
+
+        __m128i vMin = _mm_min_epu8(_mm_min_epu8(p0, p1), _mm_min_epu8(p2, p3));
+        __m128i vMax = _mm_max_epu8(_mm_max_epu8(p0, p1), _mm_max_epu8(p2, p3));
+
+        vMin = _mm_min_epu8(vMin, _mm_shuffle_epi32(vMin, _MM_SHUFFLE(1, 0, 3, 2)));
+        vMin = _mm_min_epu8(vMin, _mm_shuffle_epi32(vMin, _MM_SHUFFLE(2, 3, 0, 1)));
+        vMax = _mm_max_epu8(vMax, _mm_shuffle_epi32(vMax, _MM_SHUFFLE(1, 0, 3, 2)));
+        vMax = _mm_max_epu8(vMax, _mm_shuffle_epi32(vMax, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        *pMin = static_cast<uint32_t>(_mm_cvtsi128_si32(vMin));
+        *pMax = static_cast<uint32_t>(_mm_cvtsi128_si32(vMax));
+#else
+        uint32_t minC[4] = { 255, 255, 255, 255 };
+        uint32_t maxC[4] = {};
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            for (size_t c = 0; c < 4; ++c)
+            {
+                uint32_t v = (pRGBA[i] >> (c * 8)) & 0xff;
+                minC[c] = std::min(minC[c], v);
+                maxC[c] = std::max(maxC[c], v);
+            }
+        }
+
+        *pMin = minC[0] | (minC[1] << 8) | (minC[2] << 16) | (minC[3] << 24);
+        *pMax = maxC[0] | (maxC[1] << 8) | (maxC[2] << 16) | (maxC[3] << 24);
+#endif
+    }
+
+    //-------------------------------------------------------------------------------------
+    // 2 bit BC1 indices of a block for the 4 color palette of the endpoints wColorA and wColorB
+    uint32_t IndexRGBA(
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const uint32_t *pRGBA,
+        uint16_t wColorA,
+        uint16_t wColorB)
+    {
+        int32_t palette[4][3];
+        Expand565(wColorA, palette[0]);
+        Expand565(wColorB, palette[1]);
+        for (size_t c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (palette[0][c] * 2 + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + palette[1][c] * 2) / 3;
+        }
+
+        // Project on the axis from B to A, the palette runs 1, 3, 2, 0 along it
+        const int32_t dir[3] = { palette[0][0] - palette[1][0], palette[0][1] - palette[1][1], palette[0][2] - palette[1][2] };
+
+        int32_t stops[4];
+        for (size_t i = 0; i < 4; ++i)
+            stops[i] = palette[i][0] * dir[0] + palette[i][1] * dir[1] + palette[i][2] * dir[2];
+
+        // Decision points between neighbouring entries, doubled to stay in integers
+        const int32_t c3Point = stops[1] + stops[3];
+        const int32_t halfPoint = stops[3] + stops[2];
+        const int32_t c0Point = stops[2] + stops[0];
+
+        uint32_t dw = 0;
+
+#if defined(_XM_SSE_INTRINSICS_)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i vDir = _mm_setr_epi16(
+            static_cast<short>(dir[0]), static_cast<short>(dir[1]), static_cast<short>(dir[2]), 0,
+            static_cast<short>(dir[0]), static_cast<short>(dir[1]), static_cast<short>(dir[2]), 0);
+        const __m128i vC3 = _mm_set1_epi32(c3Point - 1);
+        const __m128i vHalf = _mm_set1_epi32(halfPoint - 1);
+        const __m128i vC0 = _mm_set1_epi32(c0Point - 1);
+        const __m128i one = _mm_set1_epi32(1);
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; i += 4)
+        {
+            __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRGBA + i));
+
+            // r*dr + g*dg and b*db of each pixel, then their sums
+            __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(p, zero), vDir);
+            __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(p, zero), vDir);
+            __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+            __m128i dot = _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+            dot = _mm_add_epi32(dot, dot);
+
+            // Index bit 0 is set below the half point, bit 1 between the c3 and c0 points
+            __m128i bit0 = _mm_andnot_si128(_mm_cmpgt_epi32(dot, vHalf), one);
+            __m128i bit1 = _mm_and_si128(_mm_xor_si128(_mm_cmpgt_epi32(dot, vC3), _mm_cmpgt_epi32(dot, vC0)), one);
+            __m128i index = _mm_or_si128(bit0, _mm_add_epi32(bit1, bit1));
+
+            // Gather the four 2 bit indices in one byte
+            index = _mm_or_si128(index, _mm_srli_epi64(index, 30));
+            uint32_t bits = (static_cast<uint32_t>(_mm_cvtsi128_si32(index)) & 0xf)
+                | ((static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(index, 8))) & 0xf) << 4);
+
+            dw |= bits << (i * 2);
+        }
+#else
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            int32_t r = pRGBA[i] & 0xff;
+            int32_t g = (pRGBA[i] >> 8) & 0xff;
+            int32_t b = (pRGBA[i] >> 16) & 0xff;
+            int32_t dot = (r * dir[0] + g * dir[1] + b * dir[2]) * 2;
+
+            uint32_t index;
+            if (dot < halfPoint)
+                index = (dot < c3Point) ? 1u : 3u;
+            else
+                index = (dot < c0Point) ? 2u : 0u;
+
+            dw |= index << (i * 2);
+        }
+#endif
+
+        return dw;
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Least squares endpoints for the given indices, false if the indices do not span two colors
+    bool RefineRGBA(
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const uint32_t *pRGBA,
+        uint32_t dw,
+        _Out_ uint16_t *pColorA,
+        _Out_ uint16_t *pColorB)
+    {
+        // Weight of endpoint A (in thirds) for each index
+        static const int32_t pWeights[] = { 3, 0, 2, 1 };
+
+        int32_t aa = 0, bb = 0, ab = 0;
+        int32_t sumA[3] = {};
+        int32_t sum[3] = {};
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 2)
+        {
+            int32_t wa = pWeights[dw & 3];
+            int32_t wb = 3 - wa;
+
+            aa += wa * wa;
+            bb += wb * wb;
+            ab += wa * wb;
+
+            for (size_t c = 0; c < 3; ++c)
+            {
+                int32_t v = (pRGBA[i] >> (c * 8)) & 0xff;
+                sumA[c] += wa * v;
+                sum[c] += v;
+            }
+        }
+
+        int32_t det = aa * bb - ab * ab;
+        if (!det)
+            return false;
+
+        // Solve [aa ab; ab bb] [A; B] = 3 * [sumA; sumB], the weights are in thirds
+        const float fScale = 3.0f / static_cast<float>(det);
+
+        int32_t colorA[3], colorB[3];
+        for (size_t c = 0; c < 3; ++c)
+        {
+            int32_t sumB = sum[c] * 3 - sumA[c];
+            colorA[c] = static_cast<int32_t>(static_cast<float>(sumA[c] * bb - sumB * ab) * fScale + 0.5f);
+            colorB[c] = static_cast<int32_t>(static_cast<float>(sumB * aa - sumA[c] * ab) * fScale + 0.5f);
+        }
+
+        *pColorA = Quantize565(colorA[0], colorA[1], colorA[2]);
+        *pColorB = Quantize565(colorB[0], colorB[1], colorB[2]);
+        return true;
+    }
+
+    //-------------------------------------------------------------------------------------
+    void EncodeBC1Fast(
+        _Out_ D3DX_BC1 *pBC,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const uint32_t *pRGBA)
+    {
+        uint32_t minColor, maxColor;
+        BoundsRGBA(pRGBA, &minColor, &maxColor);
+
+        int32_t lo[3], hi[3];
+        for (size_t c = 0; c < 3; ++c)
+        {
+            lo[c] = (minColor >> (c * 8)) & 0xff;
+            hi[c] = (maxColor >> (c * 8)) & 0xff;
+        }
+
+        if (lo[0] == hi[0] && lo[1] == hi[1] && lo[2] == hi[2])
+        {
+            // Solid block
+            uint16_t wColor = Quantize565(lo[0], lo[1], lo[2]);
+            pBC->rgb[0] = wColor;
+            pBC->rgb[1] = wColor;
+            pBC->bitmap = 0x00000000;
+            return;
+        }
+
+        // Pick the diagonal of the box the colors run along
+        int32_t covRG = 0, covBG = 0;
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            int32_t r = static_cast<int32_t>(pRGBA[i] & 0xff) * 2 - (lo[0] + hi[0]);
+            int32_t g = static_cast<int32_t>((pRGBA[i] >> 8) & 0xff) * 2 - (lo[1] + hi[1]);
+            int32_t b = static_cast<int32_t>((pRGBA[i] >> 16) & 0xff) * 2 - (lo[2] + hi[2]);
+            covRG += r * g;
+            covBG += b * g;
+        }
+
+        if (covRG < 0)
+            std::swap(lo[0], hi[0]);
+        if (covBG < 0)
+            std::swap(lo[2], hi[2]);
+
+        // Inset the box, the extremes are rarely worth an endpoint
+        int32_t colorA[3], colorB[3];
+        for (size_t c = 0; c < 3; ++c)
+        {
+            int32_t inset = (hi[c] - lo[c]) / 16;
+            colorA[c] = hi[c] - inset;
+            colorB[c] = lo[c] + inset;
+        }
+
+        uint16_t wColorA = Quantize565(colorA[0], colorA[1], colorA[2]);
+        uint16_t wColorB = Quantize565(colorB[0], colorB[1], colorB[2]);
+        uint32_t dw = IndexRGBA(pRGBA, wColorA, wColorB);
+
+        uint16_t wRefinedA, wRefinedB;
+        if (RefineRGBA(pRGBA, dw, &wRefinedA, &wRefinedB)
+            && (wRefinedA != wColorA || wRefinedB != wColorB))
+        {
+            wColorA = wRefinedA;
+            wColorB = wRefinedB;
+            dw = IndexRGBA(pRGBA, wColorA, wColorB);
+        }
+
+        // Four color mode needs A > B, swapping the endpoints swaps indices 0/1 and 2/3
+        if (wColorA < wColorB)
+        {
+            std::swap(wColorA, wColorB);
+            dw ^= 0x55555555;
+        }
+        else if (wColorA == wColorB)
+        {
+            dw = 0;
+        }
+
+        pBC->rgb[0] = wColorA;
+        pBC->rgb[1] = wColorB;
+        pBC->bitmap = dw;
+    }
+
+    //-------------------------------------------------------------------------------------
+    void EncodeBC3AlphaFast(
+        _Out_ D3DX_BC3 *pBC,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const uint32_t *pRGBA)
+    {
+        uint32_t minColor, maxColor;
+        BoundsRGBA(pRGBA, &minColor, &maxColor);
+
+        const int32_t minAlpha = static_cast<int32_t>(minColor >> 24);
+        const int32_t maxAlpha = static_cast<int32_t>(maxColor >> 24);
+
+        // Eight step mode, alpha[0] is the maximum and alpha[1] the minimum
+        pBC->alpha[0] = static_cast<uint8_t>(maxAlpha);
+        pBC->alpha[1] = static_cast<uint8_t>(minAlpha);
+
+        if (minAlpha == maxAlpha)
+        {
+            memset(pBC->bitmap, 0x00, 6);
+            return;
+        }
+
+        // Step of each alpha from the minimum (0) to the maximum (7), rounded to nearest
+        const int32_t range = maxAlpha - minAlpha;
+        uint8_t steps[NUM_PIXELS_PER_BLOCK];
+
+#if defined(_XM_SSE_INTRINSICS_)
+        const __m128i vMin = _mm_set1_epi16(static_cast<short>(minAlpha));
+        const __m128i v14 = _mm_set1_epi16(14);
+
+        __m128i a01 = _mm_packs_epi32(
+            _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRGBA)), 24),
+            _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRGBA + 4)), 24));
+        __m128i a23 = _mm_packs_epi32(
+            _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRGBA + 8)), 24),
+            _mm_srli_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRGBA + 12)), 24));
+
+        a01 = _mm_mullo_epi16(_mm_sub_epi16(a01, vMin), v14);
+        a23 = _mm_mullo_epi16(_mm_sub_epi16(a23, vMin), v14);
+
+        // Count the rounding thresholds (2 * step - 1) * range / 14 each alpha reaches
+        __m128i t01 = _mm_setzero_si128();
+        __m128i t23 = _mm_setzero_si128();
+        for (int32_t step = 1; step < 8; ++step)
+        {
+            __m128i threshold = _mm_set1_epi16(static_cast<short>((2 * step - 1) * range - 1));
+            t01 = _mm_sub_epi16(t01, _mm_cmpgt_epi16(a01, threshold));
+            t23 = _mm_sub_epi16(t23, _mm_cmpgt_epi16(a23, threshold));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(steps), _mm_packus_epi16(t01, t23));
+#else
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            int32_t a = static_cast<int32_t>(pRGBA[i] >> 24) - minAlpha;
+            steps[i] = static_cast<uint8_t>((a * 14 + range) / (range * 2));
+        }
+#endif
+
+        // Step 7 is index 0, step 0 index 1, steps 1 to 6 are indices 7 to 2
+        uint64_t bits = 0;
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            uint32_t index = (8u - steps[i]) & 7u;
+            if (index < 2)
+                index ^= 1;
+            bits |= static_cast<uint64_t>(index) << (i * 3);
+        }
+
+        for (size_t i = 0; i < 6; ++i)
+            pBC->bitmap[i] = static_cast<uint8_t>(bits >> (i * 8));
+    }
 }
 
 
@@ -1139,3 +1499,43 @@ void DirectX::D3DXEncodeBC3(uint8_t *pBC, const XMVECTOR *pColor, DWORD flags)
         pBC3->bitmap[2 + iSet * 3] = reinterpret_cast<uint8_t *>(&dw)[2];
     }
 }
+
+
+//-------------------------------------------------------------------------------------
+// BC1/BC3 fast compression of 8-bit RGBA blocks
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC1Fast(uint8_t *pBC, const uint32_t *pRGBA, float threshold, DWORD flags)
+{
+    assert(pBC && pRGBA);
+
+    // Pixels under the alpha threshold need the 3 color mode of the full encoder
+    const float fThreshold = threshold * 255.0f;
+    for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        if (static_cast<float>(pRGBA[i] >> 24) < fThreshold)
+        {
+            XMVECTOR temp[NUM_PIXELS_PER_BLOCK];
+            for (size_t j = 0; j < NUM_PIXELS_PER_BLOCK; ++j)
+            {
+                temp[j] = XMLoadUByteN4(reinterpret_cast<const XMUBYTEN4*>(&pRGBA[j]));
+            }
+
+            D3DXEncodeBC1(pBC, temp, threshold, flags & ~BC_FLAGS_FAST);
+            return;
+        }
+    }
+
+    auto pBC1 = reinterpret_cast<D3DX_BC1 *>(pBC);
+    EncodeBC1Fast(pBC1, pRGBA);
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC3Fast(uint8_t *pBC, const uint32_t *pRGBA)
+{
+    assert(pBC && pRGBA);
+
+    auto pBC3 = reinterpret_cast<D3DX_BC3 *>(pBC);
+    EncodeBC1Fast(&pBC3->bc1, pRGBA);
+    EncodeBC3AlphaFast(pBC3, pRGBA);
+}
@@ -36,6 +36,11 @@ enum BC_FLAGS
     BC_FLAGS_UNIFORM            = 0x40000,  // By default, uses perceptual weighting for BC1-3; this flag makes it a uniform weighting
     BC_FLAGS_USE_3SUBSETS       = 0x80000,  // By default, BC7 skips mode 0 & 2; this flag adds those modes back
     BC_FLAGS_FORCE_BC7_MODE6    = 0x100000, // BC7 should only use mode 6; skip other modes
+    BC_FLAGS_FAST               = 0x200000, // BC1 and BC3 of 8-bit RGBA sources use the integer fast encoder
+    BC_FLAGS_BC7_ULTRAFAST      = 0x400000, // BC7 mode 6 only, without endpoint refinement
+    BC_FLAGS_BC7_FAST           = 0x800000, // BC7 modes 1, 5 and 6, few partitions, one refinement pass
+    BC_FLAGS_BC7_SLOW           = 0xC00000, // BC7 all modes, more partitions, two refinement passes
+    BC_FLAGS_BC7_QUALITY_MASK   = 0xC00000,
 };
 
 //-------------------------------------------------------------------------------------
@@ -322,4 +327,9 @@ void D3DXEncodeBC6HU(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BL
 void D3DXEncodeBC6HS(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ DWORD flags);
 void D3DXEncodeBC7(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ DWORD flags);
 
+// Fast integer encoders for blocks of packed 8-bit RGBA (red in the low byte), see TEX_COMPRESS_BC_FAST,
+// BC1 blocks that need the 3 color mode go through D3DXEncodeBC1 with flags
+void D3DXEncodeBC1Fast(_Out_writes_(8) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const uint32_t *pRGBA, _In_ float threshold, _In_ DWORD flags);
+void D3DXEncodeBC3Fast(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const uint32_t *pRGBA);
+
 } // namespace
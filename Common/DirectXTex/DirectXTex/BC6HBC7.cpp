@@ -782,14 +782,28 @@ namespace
         struct EncodeParams
         {
             uint8_t uMode;
+            uint8_t uRefinePasses;
+            bool bExhaustive;
+            bool bPaletteError;
             LDREndPntPair aEndPts[BC7_MAX_SHAPES][BC7_MAX_REGIONS];
             LDRColorA aLDRPixels[NUM_PIXELS_PER_BLOCK];
             const HDRColorA* const aHDRPixels;
 
-            EncodeParams(const HDRColorA* const aOriginal) : uMode(0), aEndPts{}, aLDRPixels{}, aHDRPixels(aOriginal) {}
+            EncodeParams(const HDRColorA* const aOriginal) : uMode(0), uRefinePasses(1), bExhaustive(true), bPaletteError(false), aEndPts{}, aLDRPixels{}, aHDRPixels(aOriginal) {}
         };
 #pragma warning(pop)
 
+        // How far the encoder searches, picked by the BC_FLAGS_BC7_* quality flags
+        struct Preset
+        {
+            uint8_t uModeMask;          // bit per mode tried, modes 0 and 2 are also tried with BC_FLAGS_USE_3SUBSETS
+            uint8_t uShapeShift;        // the best (partitions >> uShapeShift) rough partitions are refined, at least one
+            uint8_t uRefinePasses;      // rounds of endpoint optimization, 0 keeps the rough endpoints
+            bool bExhaustive;           // small exhaustive search around the optimized endpoints
+            bool bRotations;            // channel rotations of modes 4 and 5
+            bool bPaletteError;         // MapColors takes the true minimum of ComputePaletteError instead of ComputeError
+        };
+
         static uint8_t Quantize(_In_ uint8_t comp, _In_ uint8_t uPrec)
         {
             assert(0 < uPrec && uPrec <= 8);
@@ -857,6 +871,7 @@ namespace
 
     private:
         static const ModeInfo ms_aInfo[];
+        static const Preset ms_aPresets[];
     };
 }
 
@@ -1108,6 +1123,15 @@ const D3DX_BC7::ModeInfo D3DX_BC7::ms_aInfo[] =
         // Mode 7: Color+Alpha, 2 Subsets, RGBAP 55551 (unique P-bit), 2-bit indices, 64 partitions
 };
 
+// Indexed by (flags & BC_FLAGS_BC7_QUALITY_MASK) >> 22: normal, ultrafast, fast, slow
+const D3DX_BC7::Preset D3DX_BC7::ms_aPresets[] =
+{
+    { 0xFA, 2, 1, true,  true,  false },    // modes 1, 3-7 (the original search, with the original errors)
+    { 0x40, 0, 0, false, false, true  },    // mode 6
+    { 0x62, 4, 1, false, false, true  },    // modes 1, 5, 6
+    { 0xFF, 1, 2, true,  true,  true  },    // all modes
+};
+
 
 namespace
 {
@@ -1624,6 +1648,68 @@ namespace
     }
 
 
+    //-------------------------------------------------------------------------------------
+    // Smallest squared error of the channels in uMask (a byte mask of packed RGBA) between pixel and
+    // uNumIndices palette entries, 4 entries at a time. Unlike ComputeError it does not stop at the
+    // first entry whose error grows, so it can only find a smaller error. uNumIndices is a multiple of 4.
+    inline float ComputePaletteError(
+        const LDRColorA& pixel,
+        _In_reads_(uNumIndices) const LDRColorA aPalette[],
+        size_t uNumIndices,
+        uint32_t uMask)
+    {
+        assert((uNumIndices & 3) == 0);
+        static_assert(sizeof(LDRColorA) == 4, "LDRColorA should be 4 bytes");
+
+#if defined(_XM_SSE_INTRINSICS_)
+        uint32_t uPixel;
+        memcpy(&uPixel, &pixel, sizeof(uPixel));
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i vMask = _mm_set1_epi32(static_cast<int>(uMask));
+        const __m128i vPixel = _mm_unpacklo_epi8(_mm_and_si128(_mm_set1_epi32(static_cast<int>(uPixel)), vMask), zero);
+
+        __m128 vBest = _mm_set1_ps(FLT_MAX);
+        for (size_t i = 0; i < uNumIndices; i += 4)
+        {
+            __m128i entries = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&aPalette[i])), vMask);
+
+            // Squared differences summed in pairs of channels, then the pairs of each entry
+            __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(entries, zero), vPixel);
+            __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(entries, zero), vPixel);
+            lo = _mm_madd_epi16(lo, lo);
+            hi = _mm_madd_epi16(hi, hi);
+            __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+            __m128i err = _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+
+            // At most 4 * 255^2, exact as float
+            vBest = _mm_min_ps(vBest, _mm_cvtepi32_ps(err));
+        }
+
+        vBest = _mm_min_ps(vBest, _mm_shuffle_ps(vBest, vBest, _MM_SHUFFLE(1, 0, 3, 2)));
+        vBest = _mm_min_ps(vBest, _mm_shuffle_ps(vBest, vBest, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(vBest);
+#else
+        float fBestErr = FLT_MAX;
+        for (size_t i = 0; i < uNumIndices; ++i)
+        {
+            float fErr = 0.0f;
+            for (size_t ch = 0; ch < BC7_NUM_CHANNELS; ++ch)
+            {
+                if (uMask & (0xffu << (ch * 8)))
+                {
+                    float e = float(pixel[ch]) - float(aPalette[i][ch]);
+                    fErr += e * e;
+                }
+            }
+            fBestErr = std::min(fBestErr, fErr);
+        }
+        return fBestErr;
+#endif
+    }
+
+
     void FillWithErrorColors(_Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA* pOut)
     {
         for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
@@ -2735,6 +2821,13 @@ void D3DX_BC7::Encode(DWORD flags, const HDRColorA* const pIn)
     float fMSEBest = FLT_MAX;
     uint32_t alphaMask = 0xFF;
 
+    static_assert(BC_FLAGS_BC7_ULTRAFAST == (1 << 22), "BC7 presets are indexed by the quality bits");
+    const Preset& preset = ms_aPresets[(flags & BC_FLAGS_BC7_QUALITY_MASK) >> 22];
+    const uint32_t uModeMask = preset.uModeMask | ((flags & BC_FLAGS_USE_3SUBSETS) ? 0x05u : 0u);
+    EP.uRefinePasses = preset.uRefinePasses;
+    EP.bExhaustive = preset.bExhaustive;
+    EP.bPaletteError = preset.bPaletteError;
+
     for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
     {
         EP.aLDRPixels[i].r = uint8_t(std::max<float>(0.0f, std::min<float>(255.0f, pIn[i].r * 255.0f + 0.01f)));
@@ -2748,9 +2841,9 @@ void D3DX_BC7::Encode(DWORD flags, const HDRColorA* const pIn)
 
     for (EP.uMode = 0; EP.uMode < 8 && fMSEBest > 0; ++EP.uMode)
     {
-        if (!(flags & BC_FLAGS_USE_3SUBSETS) && (EP.uMode == 0 || EP.uMode == 2))
+        if (!(uModeMask & (1u << EP.uMode)))
         {
-            // 3 subset modes tend to be used rarely and add significant compression time
+            // Not searched by this preset; 3 subset modes tend to be used rarely and add significant compression time
             continue;
         }
 
@@ -2770,11 +2863,11 @@ void D3DX_BC7::Encode(DWORD flags, const HDRColorA* const pIn)
         assert(uShapes <= BC7_MAX_SHAPES);
         _Analysis_assume_(uShapes <= BC7_MAX_SHAPES);
 
-        const size_t uNumRots = size_t(1) << ms_aInfo[EP.uMode].uRotationBits;
+        const size_t uNumRots = preset.bRotations ? (size_t(1) << ms_aInfo[EP.uMode].uRotationBits) : 1;
         const size_t uNumIdxMode = size_t(1) << ms_aInfo[EP.uMode].uIndexModeBits;
         // Number of rough cases to look at. reasonable values of this are 1, uShapes/4, and uShapes
         // uShapes/4 gets nearly all the cases; you can increase that a bit (say by 3 or 4) if you really want to squeeze the last bit out
-        const size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        const size_t uItems = std::max<size_t>(1, uShapes >> preset.uShapeShift);
         float afRoughMSE[BC7_MAX_SHAPES];
         size_t auShape[BC7_MAX_SHAPES];
 
@@ -3038,8 +3131,11 @@ void D3DX_BC7::OptimizeOne(const EncodeParams* pEP, const LDRColorA aColors[], s
     }
 
     // finally, do a small exhaustive search around what we think is the global minima to be sure
-    for (size_t ch = 0; ch < BC7_NUM_CHANNELS; ch++)
-        Exhaustive(pEP, aColors, np, uIndexMode, ch, fOptErr, opt);
+    if (pEP->bExhaustive)
+    {
+        for (size_t ch = 0; ch < BC7_NUM_CHANNELS; ch++)
+            Exhaustive(pEP, aColors, np, uIndexMode, ch, fOptErr, opt);
+    }
 }
 
 _Use_decl_annotations_
@@ -3347,29 +3443,36 @@ float D3DX_BC7::Refine(const EncodeParams* pEP, size_t uShape, size_t uRotation,
 
     AssignIndices(pEP, uShape, uIndexMode, newEndPts1, aOrgIdx, aOrgIdx2, aOrgErr);
 
-    OptimizeEndPoints(pEP, uShape, uIndexMode, aOrgErr, newEndPts1, aOptEndPts);
-
-    LDREndPntPair newEndPts2[BC7_MAX_REGIONS];
-    FixEndpointPBits(pEP, aOptEndPts, newEndPts2);
-
-    AssignIndices(pEP, uShape, uIndexMode, newEndPts2, aOptIdx, aOptIdx2, aOptErr);
-
-    float fOrgTotErr = 0, fOptTotErr = 0;
+    float fOrgTotErr = 0;
     for (size_t p = 0; p <= uPartitions; p++)
-    {
         fOrgTotErr += aOrgErr[p];
-        fOptTotErr += aOptErr[p];
-    }
-    if (fOptTotErr < fOrgTotErr)
-    {
-        EmitBlock(pEP, uShape, uRotation, uIndexMode, newEndPts2, aOptIdx, aOptIdx2);
-        return fOptTotErr;
-    }
-    else
+
+    // Each pass optimizes the best endpoints so far, until one does not improve them
+    for (size_t uPass = 0; uPass < pEP->uRefinePasses && fOrgTotErr > 0; ++uPass)
     {
-        EmitBlock(pEP, uShape, uRotation, uIndexMode, newEndPts1, aOrgIdx, aOrgIdx2);
-        return fOrgTotErr;
+        OptimizeEndPoints(pEP, uShape, uIndexMode, aOrgErr, newEndPts1, aOptEndPts);
+
+        LDREndPntPair newEndPts2[BC7_MAX_REGIONS];
+        FixEndpointPBits(pEP, aOptEndPts, newEndPts2);
+
+        AssignIndices(pEP, uShape, uIndexMode, newEndPts2, aOptIdx, aOptIdx2, aOptErr);
+
+        float fOptTotErr = 0;
+        for (size_t p = 0; p <= uPartitions; p++)
+            fOptTotErr += aOptErr[p];
+
+        if (fOptTotErr >= fOrgTotErr)
+            break;
+
+        memcpy(newEndPts1, newEndPts2, sizeof(newEndPts1));
+        memcpy(aOrgIdx, aOptIdx, sizeof(aOrgIdx));
+        memcpy(aOrgIdx2, aOptIdx2, sizeof(aOrgIdx2));
+        memcpy(aOrgErr, aOptErr, sizeof(aOrgErr));
+        fOrgTotErr = fOptTotErr;
     }
+
+    EmitBlock(pEP, uShape, uRotation, uIndexMode, newEndPts1, aOrgIdx, aOrgIdx2);
+    return fOrgTotErr;
 }
 
 _Use_decl_annotations_
@@ -3381,10 +3484,24 @@ float D3DX_BC7::MapColors(const EncodeParams* pEP, const LDRColorA aColors[], si
     LDRColorA aPalette[BC7_MAX_INDICES];
     float fTotalErr = 0;
 
+    // This is the inner loop of the endpoint search, every candidate endpoint pair maps all colors of its region.
+    // The default search keeps ComputeError so its blocks stay the same, the presets take the SIMD minimum
     GeneratePaletteQuantized(pEP, uIndexMode, endPts, aPalette);
     for (size_t i = 0; i < np; ++i)
     {
-        fTotalErr += ComputeError(aColors[i], aPalette, uIndexPrec, uIndexPrec2);
+        if (!pEP->bPaletteError)
+        {
+            fTotalErr += ComputeError(aColors[i], aPalette, uIndexPrec, uIndexPrec2);
+        }
+        else if (uIndexPrec2 == 0)
+        {
+            fTotalErr += ComputePaletteError(aColors[i], aPalette, size_t(1) << uIndexPrec, 0xFFFFFFFF);
+        }
+        else
+        {
+            fTotalErr += ComputePaletteError(aColors[i], aPalette, size_t(1) << uIndexPrec, 0x00FFFFFF);
+            fTotalErr += ComputePaletteError(aColors[i], aPalette, size_t(1) << uIndexPrec2, 0xFF000000);
+        }
         if (fTotalErr > fMinErr)   // check for early exit
         {
             fTotalErr = FLT_MAX;
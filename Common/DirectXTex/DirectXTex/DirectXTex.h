@@ -583,6 +583,18 @@ namespace DirectX
         TEX_COMPRESS_BC7_QUICK          = 0x100000,
             // Minimal modes (usually mode 6) for BC7 compression
 
+        TEX_COMPRESS_BC_FAST            = 0x200000,
+            // Integer SIMD encoder for BC1 and BC3 from 8-bit RGBA/BGRA sources; much faster, somewhat lower quality, no dithering
+
+        TEX_COMPRESS_BC7_ULTRAFAST      = 0x400000,
+        TEX_COMPRESS_BC7_FAST           = 0x800000,
+        TEX_COMPRESS_BC7_SLOW           = 0xC00000,
+        TEX_COMPRESS_BC7_QUALITY_MASK   = 0xC00000,
+            // BC7 quality presets, limiting the search over modes, partitions and endpoint refinement; the default is in between fast and slow
+            // ultrafast: mode 6 only, rough endpoints without refinement
+            // fast: modes 1, 5 and 6, the 4 best partitions, one refinement pass without the exhaustive search
+            // slow: all modes, the 32 best partitions, a second refinement pass
+
         TEX_COMPRESS_SRGB_IN            = 0x1000000,
         TEX_COMPRESS_SRGB_OUT           = 0x2000000,
         TEX_COMPRESS_SRGB               = (TEX_COMPRESS_SRGB_IN | TEX_COMPRESS_SRGB_OUT),
@@ -593,13 +605,26 @@ namespace DirectX
             // Compress is free to use multithreading to improve performance (by default it does not use multithreading)
     };
 
+    class IParallelExecutor
+    {
+    public:
+        virtual ~IParallelExecutor() = default;
+
+        virtual void __cdecl ParallelFor(_In_ size_t count, _In_ const std::function<void __cdecl(size_t first, size_t last)>& work) = 0;
+            // Calls work for ranges covering the tasks [0, count) exactly once, on any threads and in any order,
+            // and returns when all of them are done. Lets Compress share the threads of an application's job system
+    };
+
     HRESULT __cdecl Compress(
         _In_ const Image& srcImage, _In_ DXGI_FORMAT format, _In_ DWORD compress, _In_ float threshold,
-        _Out_ ScratchImage& cImage);
+        _Out_ ScratchImage& cImage, _In_opt_ IParallelExecutor* executor = nullptr);
     HRESULT __cdecl Compress(
         _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
-        _In_ DXGI_FORMAT format, _In_ DWORD compress, _In_ float threshold, _Out_ ScratchImage& cImages);
+        _In_ DXGI_FORMAT format, _In_ DWORD compress, _In_ float threshold, _Out_ ScratchImage& cImages,
+        _In_opt_ IParallelExecutor* executor = nullptr);
         // Note that threshold is only used by BC1. TEX_THRESHOLD_DEFAULT is a typical value to use
+        // Blocks are compressed in parallel with TEX_COMPRESS_PARALLEL or an executor; without an executor
+        // threads are started for the call. The result is the same however the blocks are scheduled
 
 #if defined(__d3d11_h__) || defined(__d3d11_x_h__)
     HRESULT __cdecl Compress(
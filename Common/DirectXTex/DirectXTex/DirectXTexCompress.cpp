@@ -11,10 +11,8 @@
 
 #include "DirectXTexP.h"
 
-#ifdef _OPENMP
-#include <omp.h>
-#pragma warning(disable : 4616 6993)
-#endif
+#include <atomic>
+#include <thread>
 
 #include "BC.h"
 
@@ -30,7 +28,11 @@ namespace
         static_assert(static_cast<int>(TEX_COMPRESS_UNIFORM) == static_cast<int>(BC_FLAGS_UNIFORM), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
         static_assert(static_cast<int>(TEX_COMPRESS_BC7_USE_3SUBSETS) == static_cast<int>(BC_FLAGS_USE_3SUBSETS), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
         static_assert(static_cast<int>(TEX_COMPRESS_BC7_QUICK) == static_cast<int>(BC_FLAGS_FORCE_BC7_MODE6), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
-        return (compress & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A | BC_FLAGS_UNIFORM | BC_FLAGS_USE_3SUBSETS | BC_FLAGS_FORCE_BC7_MODE6));
+        static_assert(static_cast<int>(TEX_COMPRESS_BC_FAST) == static_cast<int>(BC_FLAGS_FAST), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        static_assert(static_cast<int>(TEX_COMPRESS_BC7_ULTRAFAST) == static_cast<int>(BC_FLAGS_BC7_ULTRAFAST), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        static_assert(static_cast<int>(TEX_COMPRESS_BC7_FAST) == static_cast<int>(BC_FLAGS_BC7_FAST), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        static_assert(static_cast<int>(TEX_COMPRESS_BC7_SLOW) == static_cast<int>(BC_FLAGS_BC7_SLOW), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        return (compress & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A | BC_FLAGS_UNIFORM | BC_FLAGS_USE_3SUBSETS | BC_FLAGS_FORCE_BC7_MODE6 | BC_FLAGS_FAST | BC_FLAGS_BC7_QUALITY_MASK));
     }
 
     inline DWORD GetSRGBFlags(_In_ DWORD compress)
@@ -66,13 +68,121 @@ namespace
     }
 
 
+    //-------------------------------------------------------------------------------------
+    // The integer fast path takes BC1/BC3 from 8-bit RGBA/BGRA when no sRGB conversion is needed
+    //-------------------------------------------------------------------------------------
+    bool UseFastEncoder(_In_ const Image& image, _In_ const Image& result, DWORD bcflags, DWORD srgb)
+    {
+        if (!(bcflags & BC_FLAGS_FAST))
+            return false;
+
+        switch (result.format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            break;
+
+        default:
+            return false;
+        }
+
+        switch (image.format)
+        {
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            break;
+
+        default:
+            return false;
+        }
+
+        // _ConvertScanline converts between sRGB and linear when only one side is sRGB
+        bool srgbIn = (srgb & TEX_FILTER_SRGB_IN) || IsSRGB(image.format);
+        bool srgbOut = (srgb & TEX_FILTER_SRGB_OUT) || IsSRGB(result.format);
+        return srgbIn == srgbOut;
+    }
+
+    void EncodeBlockFast(
+        _In_ const Image& image,
+        _In_ const Image& result,
+        size_t x,
+        size_t y,
+        uint8_t* pDest,
+        DWORD bcflags,
+        float threshold)
+    {
+        size_t pw = std::min<size_t>(4, image.width - x);
+        size_t ph = std::min<size_t>(4, image.height - y);
+        assert(pw > 0 && ph > 0);
+
+        // Replicate pixels for partial block, as the float path does
+        static const size_t uSrc[] = { 0, 0, 0, 1 };
+
+        const bool bgra = (image.format == DXGI_FORMAT_B8G8R8A8_UNORM || image.format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB);
+
+        __declspec(align(16)) uint32_t block[NUM_PIXELS_PER_BLOCK];
+        for (size_t t = 0; t < 4; ++t)
+        {
+            size_t row = (t < ph) ? t : std::min<size_t>(uSrc[t], ph - 1);
+            auto sptr = reinterpret_cast<const uint32_t*>(image.pixels + (y + row) * image.rowPitch) + x;
+
+            for (size_t s = 0; s < 4; ++s)
+            {
+                uint32_t v = sptr[(s < pw) ? s : std::min<size_t>(uSrc[s], pw - 1)];
+                if (bgra)
+                    v = (v & 0xff00ff00) | ((v >> 16) & 0xff) | ((v & 0xff) << 16);
+                block[(t << 2) | s] = v;
+            }
+        }
+
+        if (result.format == DXGI_FORMAT_BC1_UNORM || result.format == DXGI_FORMAT_BC1_UNORM_SRGB)
+            D3DXEncodeBC1Fast(pDest, block, threshold, bcflags);
+        else
+            D3DXEncodeBC3Fast(pDest, block);
+    }
+
+    HRESULT CompressBC_Fast(
+        const Image& image,
+        const Image& result,
+        DWORD bcflags,
+        float threshold,
+        size_t firstRow,
+        size_t lastRow)
+    {
+        const size_t blocksize = (result.format == DXGI_FORMAT_BC1_UNORM || result.format == DXGI_FORMAT_BC1_UNORM_SRGB) ? 8 : 16;
+
+        uint8_t *pDest = result.pixels + result.rowPitch * firstRow;
+        for (size_t h = firstRow * 4; h < lastRow * 4; h += 4)
+        {
+            uint8_t *dptr = pDest;
+            for (size_t w = 0; w < image.width; w += 4)
+            {
+                EncodeBlockFast(image, result, w, h, dptr, bcflags, threshold);
+                dptr += blocksize;
+            }
+
+            pDest += result.rowPitch;
+        }
+
+        return S_OK;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // Compresses the block rows [firstRow, lastRow) of image, rows past the bottom of the image are ignored
     //-------------------------------------------------------------------------------------
     HRESULT CompressBC(
         const Image& image,
         const Image& result,
         DWORD bcflags,
         DWORD srgb,
-        float threshold)
+        float threshold,
+        size_t firstRow = 0,
+        size_t lastRow = SIZE_MAX)
     {
         if (!image.pixels || !result.pixels)
             return E_POINTER;
@@ -80,6 +190,8 @@ namespace
         assert(image.width == result.width);
         assert(image.height == result.height);
 
+        lastRow = std::min<size_t>(lastRow, (image.height + 3) / 4);
+
         const DXGI_FORMAT format = image.format;
         size_t sbpp = BitsPerPixel(format);
         if (!sbpp)
@@ -103,11 +215,15 @@ namespace
         if (!DetermineEncoderSettings(result.format, pfEncode, blocksize, cflags))
             return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
 
+        if (UseFastEncoder(image, result, bcflags, srgb))
+            return CompressBC_Fast(image, result, bcflags, threshold, firstRow, lastRow);
+
         __declspec(align(16)) XMVECTOR temp[16];
-        const uint8_t *pSrc = image.pixels;
-        const uint8_t *pEnd = image.pixels + image.slicePitch;
         const size_t rowPitch = image.rowPitch;
-        for (size_t h = 0; h < image.height; h += 4)
+        const uint8_t *pSrc = image.pixels + rowPitch * 4 * firstRow;
+        const uint8_t *pEnd = image.pixels + image.slicePitch;
+        pDest += result.rowPitch * firstRow;
+        for (size_t h = firstRow * 4; h < lastRow * 4; h += 4)
         {
             const uint8_t *sptr = pSrc;
             uint8_t* dptr = pDest;
@@ -195,13 +311,54 @@ namespace
 
 
     //-------------------------------------------------------------------------------------
-#ifdef _OPENMP
+    // Parallel compression runs chunks of whole block rows, of about this many blocks, as the executor's tasks
+    //-------------------------------------------------------------------------------------
+    const size_t BC_BLOCKS_PER_CHUNK = 1024;
+
+    // Executor used without one from the caller: threads started for the call take chunks in turn with the calling thread
+    class ThreadExecutor : public IParallelExecutor
+    {
+    public:
+        void __cdecl ParallelFor(size_t count, const std::function<void __cdecl(size_t first, size_t last)>& work) override
+        {
+            std::atomic<size_t> next(0);
+            auto run = [&]()
+            {
+                for (size_t chunk = next++; chunk < count; chunk = next++)
+                    work(chunk, chunk + 1);
+            };
+
+            size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count);
+
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (size_t i = 1; i < threads; ++i)
+            {
+                try
+                {
+                    workers.emplace_back(run);
+                }
+                catch (...)
+                {
+                    // Fewer threads only make it slower
+                    break;
+                }
+            }
+
+            run();
+
+            for (auto& worker : workers)
+                worker.join();
+        }
+    };
+
     HRESULT CompressBC_Parallel(
         const Image& image,
         const Image& result,
         DWORD bcflags,
         DWORD srgb,
-        float threshold)
+        float threshold,
+        IParallelExecutor& executor)
     {
         if (!image.pixels || !result.pixels)
             return E_POINTER;
@@ -209,123 +366,33 @@ namespace
         assert(image.width == result.width);
         assert(image.height == result.height);
 
-        const DXGI_FORMAT format = image.format;
-        size_t sbpp = BitsPerPixel(format);
-        if (!sbpp)
-            return E_FAIL;
+        const size_t blockRows = std::max<size_t>(1, (image.height + 3) / 4);
+        const size_t blocksPerRow = std::max<size_t>(1, (image.width + 3) / 4);
+        const size_t rowsPerChunk = std::max<size_t>(1, BC_BLOCKS_PER_CHUNK / blocksPerRow);
+        const size_t chunks = (blockRows + rowsPerChunk - 1) / rowsPerChunk;
 
-        if (sbpp < 8)
-        {
-            // We don't support compressing from monochrome (DXGI_FORMAT_R1_UNORM)
-            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
-        }
+        if (chunks == 1)
+            return CompressBC(image, result, bcflags, srgb, threshold);
 
-        // Round to bytes
-        sbpp = (sbpp + 7) / 8;
-
-        const uint8_t *pEnd = image.pixels + image.slicePitch;
-
-        // Determine BC format encoder
-        BC_ENCODE pfEncode;
-        size_t blocksize;
-        DWORD cflags;
-        if (!DetermineEncoderSettings(result.format, pfEncode, blocksize, cflags))
-            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
-
-        // Refactored version of loop to support parallel independance
-        const size_t nBlocks = std::max<size_t>(1, (image.width + 3) / 4) * std::max<size_t>(1, (image.height + 3) / 4);
-
-        bool fail = false;
-
-#pragma omp parallel for
-        for (int nb = 0; nb < static_cast<int>(nBlocks); ++nb)
+        // Every chunk writes its own rows, so the result does not depend on the order they run in.
+        // The first failure is kept and the chunks not started yet are skipped.
+        std::atomic<HRESULT> hrResult(S_OK);
+        executor.ParallelFor(chunks, [&](size_t first, size_t last)
         {
-            int nbWidth = std::max<int>(1, int((image.width + 3) / 4));
-
-            int y = nb / nbWidth;
-            int x = (nb - (y*nbWidth)) * 4;
-            y *= 4;
-
-            assert((x >= 0) && (x < int(image.width)));
-            assert((y >= 0) && (y < int(image.height)));
-
-            size_t rowPitch = image.rowPitch;
-            const uint8_t *pSrc = image.pixels + (y*rowPitch) + (x*sbpp);
-
-            uint8_t *pDest = result.pixels + (nb*blocksize);
-
-            size_t ph = std::min<size_t>(4, image.height - y);
-            size_t pw = std::min<size_t>(4, image.width - x);
-            assert(pw > 0 && ph > 0);
-
-            ptrdiff_t bytesLeft = pEnd - pSrc;
-            assert(bytesLeft > 0);
-            size_t bytesToRead = std::min<size_t>(rowPitch, size_t(bytesLeft));
-
-            __declspec(align(16)) XMVECTOR temp[16];
-            if (!_LoadScanline(&temp[0], pw, pSrc, bytesToRead, format))
-                fail = true;
-
-            if (ph > 1)
-            {
-                bytesToRead = std::min<size_t>(rowPitch, size_t(bytesLeft - rowPitch));
-                if (!_LoadScanline(&temp[4], pw, pSrc + rowPitch, bytesToRead, format))
-                    fail = true;
-
-                if (ph > 2)
-                {
-                    bytesToRead = std::min<size_t>(rowPitch, size_t(bytesLeft - rowPitch * 2));
-                    if (!_LoadScanline(&temp[8], pw, pSrc + rowPitch * 2, bytesToRead, format))
-                        fail = true;
-
-                    if (ph > 3)
-                    {
-                        bytesToRead = std::min<size_t>(rowPitch, size_t(bytesLeft - rowPitch * 3));
-                        if (!_LoadScanline(&temp[12], pw, pSrc + rowPitch * 3, bytesToRead, format))
-                            fail = true;
-                    }
-                }
-            }
-
-            if (pw != 4 || ph != 4)
+            for (size_t chunk = first; chunk < last && SUCCEEDED(hrResult.load()); ++chunk)
             {
-                // Replicate pixels for partial block
-                static const size_t uSrc[] = { 0, 0, 0, 1 };
-
-                if (pw < 4)
-                {
-                    for (size_t t = 0; t < ph && t < 4; ++t)
-                    {
-                        for (size_t s = pw; s < 4; ++s)
-                        {
-                            temp[(t << 2) | s] = temp[(t << 2) | uSrc[s]];
-                        }
-                    }
-                }
-
-                if (ph < 4)
+                HRESULT hr = CompressBC(image, result, bcflags, srgb, threshold,
+                    chunk * rowsPerChunk, std::min(blockRows, (chunk + 1) * rowsPerChunk));
+                if (FAILED(hr))
                 {
-                    for (size_t t = ph; t < 4; ++t)
-                    {
-                        for (size_t s = 0; s < 4; ++s)
-                        {
-                            temp[(t << 2) | s] = temp[(uSrc[t] << 2) | s];
-                        }
-                    }
+                    HRESULT expected = S_OK;
+                    hrResult.compare_exchange_strong(expected, hr);
                 }
             }
+        });
 
-            _ConvertScanline(temp, 16, result.format, format, cflags | srgb);
-
-            if (pfEncode)
-                pfEncode(pDest, temp, bcflags);
-            else
-                D3DXEncodeBC1(pDest, temp, threshold, bcflags);
-        }
-
-        return (fail) ? E_FAIL : S_OK;
+        return hrResult.load();
     }
-#endif // _OPENMP
 
 
     //-------------------------------------------------------------------------------------
@@ -595,7 +662,8 @@ HRESULT DirectX::Compress(
     DXGI_FORMAT format,
     DWORD compress,
     float threshold,
-    ScratchImage& image)
+    ScratchImage& image,
+    IParallelExecutor* executor)
 {
     if (IsCompressed(srcImage.format) || !IsCompressed(format))
         return E_INVALIDARG;
@@ -617,13 +685,10 @@ HRESULT DirectX::Compress(
     }
 
     // Compress single image
-    if (compress & TEX_COMPRESS_PARALLEL)
+    if ((compress & TEX_COMPRESS_PARALLEL) || executor)
     {
-#ifndef _OPENMP
-        return E_NOTIMPL;
-#else
-        hr = CompressBC_Parallel(srcImage, *img, GetBCFlags(compress), GetSRGBFlags(compress), threshold);
-#endif // _OPENMP
+        ThreadExecutor threads;
+        hr = CompressBC_Parallel(srcImage, *img, GetBCFlags(compress), GetSRGBFlags(compress), threshold, executor ? *executor : threads);
     }
     else
     {
@@ -644,7 +709,8 @@ HRESULT DirectX::Compress(
     DXGI_FORMAT format,
     DWORD compress,
     float threshold,
-    ScratchImage& cImages)
+    ScratchImage& cImages,
+    IParallelExecutor* executor)
 {
     if (!srcImages || !nimages)
         return E_INVALIDARG;
@@ -689,21 +755,15 @@ HRESULT DirectX::Compress(
             return E_FAIL;
         }
 
-        if ((compress & TEX_COMPRESS_PARALLEL))
+        if ((compress & TEX_COMPRESS_PARALLEL) || executor)
         {
-#ifndef _OPENMP
-            return E_NOTIMPL;
-#else
-            if (compress & TEX_COMPRESS_PARALLEL)
+            ThreadExecutor threads;
+            hr = CompressBC_Parallel(src, dest[index], GetBCFlags(compress), GetSRGBFlags(compress), threshold, executor ? *executor : threads);
+            if (FAILED(hr))
             {
-                hr = CompressBC_Parallel(src, dest[index], GetBCFlags(compress), GetSRGBFlags(compress), threshold);
-                if (FAILED(hr))
-                {
-                    cImages.Release();
-                    return  hr;
-                }
+                cImages.Release();
+                return  hr;
             }
-#endif // _OPENMP
         }
         else
         {
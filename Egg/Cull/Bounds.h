@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../Math/Float3.h"
+#include "../Math/Float4x4.h"
+#include <cmath>
+
+/*
+Bounding volumes, in whatever space the points they were built from are in
+*/
+namespace Egg {
+	namespace Cull {
+
+		struct Aabb
+		{
+			Egg::Math::Float3 min;
+			Egg::Math::Float3 max;
+
+			Egg::Math::Float3 GetCenter() const { return Egg::Math::Float3{ (min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f }; }
+			Egg::Math::Float3 GetHalfExtent() const { return Egg::Math::Float3{ (max.x - min.x) * 0.5f, (max.y - min.y) * 0.5f, (max.z - min.z) * 0.5f }; }
+		};
+
+		struct Sphere
+		{
+			Egg::Math::Float3 center;
+			float radius;
+		};
+
+		/*
+		Box around the box transformed by an affine row-vector matrix (v * m), the center is transformed
+		and the half extent grows by the absolute values of the matrix elements
+		*/
+		inline Aabb Transform(const Aabb& box, const Egg::Math::Float4x4& m)
+		{
+			const Egg::Math::Float3 c = box.GetCenter();
+			const Egg::Math::Float3 e = box.GetHalfExtent();
+
+			float center[3], extent[3];
+			for(int j = 0; j < 3; j++)
+			{
+				center[j] = c.x * m.m[0][j] + c.y * m.m[1][j] + c.z * m.m[2][j] + m.m[3][j];
+				extent[j] = e.x * std::fabs(m.m[0][j]) + e.y * std::fabs(m.m[1][j]) + e.z * std::fabs(m.m[2][j]);
+			}
+
+			return Aabb{
+				Egg::Math::Float3{ center[0] - extent[0], center[1] - extent[1], center[2] - extent[2] },
+				Egg::Math::Float3{ center[0] + extent[0], center[1] + extent[1], center[2] + extent[2] } };
+		}
+
+	}
+}
@@ -0,0 +1,129 @@
+#include "Frustum.h"
+#include "../Math/Simd.h"
+
+#include <cmath>
+
+namespace Egg {
+	namespace Cull {
+
+		namespace {
+
+			// the clip space coordinate c of v * m is dot(v, column c of m)
+			Egg::Math::Float4 Column(const Egg::Math::Float4x4& m, int c)
+			{
+				return Egg::Math::Float4{ m.m[0][c], m.m[1][c], m.m[2][c], m.m[3][c] };
+			}
+
+			Egg::Math::Float4 Normalize(const Egg::Math::Float4& p)
+			{
+				const float invLength = 1.0f / std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+				return Egg::Math::Float4{ p.x * invLength, p.y * invLength, p.z * invLength, p.w * invLength };
+			}
+
+			Egg::Math::Float4 Plane(const Egg::Math::Float4& a, const Egg::Math::Float4& b, float sign)
+			{
+				return Normalize(Egg::Math::Float4{ a.x + sign * b.x, a.y + sign * b.y, a.z + sign * b.z, a.w + sign * b.w });
+			}
+
+			float Distance(const Egg::Math::Float4& plane, const Egg::Math::Float3& p)
+			{
+				return plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w;
+			}
+
+		}
+
+		Frustum Frustum::FromViewProj(const Egg::Math::Float4x4& viewProj) noexcept
+		{
+			const Egg::Math::Float4 c0 = Column(viewProj, 0);
+			const Egg::Math::Float4 c1 = Column(viewProj, 1);
+			const Egg::Math::Float4 c2 = Column(viewProj, 2);
+			const Egg::Math::Float4 c3 = Column(viewProj, 3);
+
+			Frustum f;
+			f.planes[0] = Plane(c3, c0,  1.0f);  // -w <= x
+			f.planes[1] = Plane(c3, c0, -1.0f);  //  x <= w
+			f.planes[2] = Plane(c3, c1,  1.0f);  // -w <= y
+			f.planes[3] = Plane(c3, c1, -1.0f);  //  y <= w
+			f.planes[4] = Normalize(c2);         //  0 <= z
+			f.planes[5] = Plane(c3, c2, -1.0f);  //  z <= w
+			return f;
+		}
+
+		bool Frustum::Intersects(const Sphere& sphere) const noexcept
+		{
+			for(const Egg::Math::Float4& plane : planes)
+				if(Distance(plane, sphere.center) < -sphere.radius)
+					return false;
+			return true;
+		}
+
+		bool Frustum::Intersects(const Aabb& aabb) const noexcept
+		{
+			// the box is outside if its corner furthest along the plane normal is outside
+			for(const Egg::Math::Float4& plane : planes)
+			{
+				const Egg::Math::Float3 p{
+					plane.x >= 0.0f ? aabb.max.x : aabb.min.x,
+					plane.y >= 0.0f ? aabb.max.y : aabb.min.y,
+					plane.z >= 0.0f ? aabb.max.z : aabb.min.z };
+				if(Distance(plane, p) < 0.0f)
+					return false;
+			}
+			return true;
+		}
+
+		size_t CullSpheres(
+			const Frustum& frustum,
+			const float* x, const float* y, const float* z, const float* radius,
+			size_t count,
+			uint32_t* visible, uint32_t firstIndex) noexcept
+		{
+			size_t visibleCount = 0;
+			size_t i = 0;
+#if EGG_MATH_SIMD
+			__m128 px[6], py[6], pz[6], pw[6];
+			for(int p = 0; p < 6; p++)
+			{
+				const Egg::Math::Float4& plane = frustum.GetPlane(p);
+				px[p] = _mm_set1_ps(plane.x);
+				py[p] = _mm_set1_ps(plane.y);
+				pz[p] = _mm_set1_ps(plane.z);
+				pw[p] = _mm_set1_ps(plane.w);
+			}
+
+			const __m128 zero = _mm_setzero_ps();
+			for(; i + 4 <= count; i += 4)
+			{
+				const __m128 vx = _mm_loadu_ps(x + i);
+				const __m128 vy = _mm_loadu_ps(y + i);
+				const __m128 vz = _mm_loadu_ps(z + i);
+				const __m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(radius + i));
+
+				// a lane is culled as soon as one plane has the whole sphere behind it
+				__m128 outside = zero;
+				for(int p = 0; p < 6; p++)
+				{
+					__m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, px[p]), _mm_mul_ps(vy, py[p])), _mm_mul_ps(vz, pz[p])), pw[p]);
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negRadius));
+				}
+
+				int mask = ~_mm_movemask_ps(outside) & 0xf;
+				const uint32_t base = firstIndex + (uint32_t)i;
+				// branchless compaction, every lane is written and the count only advances for visible ones
+				for(uint32_t lane = 0; lane < 4; lane++)
+				{
+					visible[visibleCount] = base + lane;
+					visibleCount += (mask >> lane) & 1;
+				}
+			}
+#endif
+			for(; i < count; i++)
+			{
+				if(frustum.Intersects(Sphere{ Egg::Math::Float3{ x[i], y[i], z[i] }, radius[i] }))
+					visible[visibleCount++] = firstIndex + (uint32_t)i;
+			}
+			return visibleCount;
+		}
+
+	}
+}
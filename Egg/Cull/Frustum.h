@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Bounds.h"
+#include "../Math/Float4.h"
+#include "../Math/Float4x4.h"
+#include <cstddef>
+#include <cstdint>
+
+/*
+View frustum culling. Volumes touching the frustum count as visible, the tests are conservative:
+a volume close to a frustum corner may be reported visible while it is just outside.
+*/
+namespace Egg {
+	namespace Cull {
+
+		class Frustum
+		{
+			/*
+			left, right, bottom, top, near, far, with normals pointing inwards and unit length:
+			a point p is inside a plane if dot(plane.xyz, p) + plane.w >= 0
+			*/
+			Egg::Math::Float4 planes[6];
+
+		public:
+
+			/*
+			Planes of the clip volume of a row-vector view-projection matrix (v * viewProj) with d3d depth, 0 <= z <= w
+			*/
+			static Frustum FromViewProj(const Egg::Math::Float4x4& viewProj) noexcept;
+
+			bool Intersects(const Sphere& sphere) const noexcept;
+			bool Intersects(const Aabb& aabb) const noexcept;
+
+			const Egg::Math::Float4& GetPlane(uint32_t index) const { return planes[index]; }
+		};
+
+		/*
+		Tests count spheres given as separate coordinate and radius arrays against the frustum, four at a time.
+		The indices (firstIndex + i) of the visible ones are written to visible in increasing order, which must have room for count.
+		Returns the number of visible spheres.
+		*/
+		size_t CullSpheres(
+			const Frustum& frustum,
+			const float* x, const float* y, const float* z, const float* radius,
+			size_t count,
+			uint32_t* visible, uint32_t firstIndex = 0) noexcept;
+
+	}
+}
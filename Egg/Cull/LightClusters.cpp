@@ -0,0 +1,180 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Egg {
+	namespace Cull {
+
+		namespace {
+
+			bool Touches(const Sphere& sphere, const Aabb& box)
+			{
+				const float dx = std::max(std::max(box.min.x - sphere.center.x, sphere.center.x - box.max.x), 0.0f);
+				const float dy = std::max(std::max(box.min.y - sphere.center.y, sphere.center.y - box.max.y), 0.0f);
+				const float dz = std::max(std::max(box.min.z - sphere.center.z, sphere.center.z - box.max.z), 0.0f);
+				return dx * dx + dy * dy + dz * dz <= sphere.radius * sphere.radius;
+			}
+
+			// the tiles [first, last] of count tiles covering t = 0 .. count, false if none
+			bool TileRange(float tMin, float tMax, uint32_t count, uint32_t& first, uint32_t& last)
+			{
+				if (tMax < 0.0f || tMin >= (float)count)
+					return false;
+				first = (uint32_t)std::max(tMin, 0.0f);
+				last = (uint32_t)std::min(tMax, (float)(count - 1));
+				return true;
+			}
+
+		}
+
+		LightClusters::LightClusters(uint32_t countX, uint32_t countY, uint32_t countZ, uint32_t maxLightsPerCluster) :
+			countX{ countX }, countY{ countY }, countZ{ countZ }, maxLightsPerCluster{ maxLightsPerCluster },
+			sliceDepths(countZ + 1), boxes(countX * countY * countZ),
+			slots(countX * countY * countZ * maxLightsPerCluster), counts(countX * countY * countZ),
+			ranges(countX * countY * countZ)
+		{
+		}
+
+		void LightClusters::SetProjection(const Egg::Math::Float4x4& proj)
+		{
+			// Proj has z' = z * a + b, w' = z, so near = -b / a and far = b / (1 - a)
+			const float a = proj.m[2][2];
+			const float b = proj.m[3][2];
+			const float zn = -b / a;
+			const float zf = b / (1.0f - a);
+			if (proj.m[0][0] == xScale && proj.m[1][1] == yScale && zn == nearPlane && zf == farPlane)
+				return;
+
+			xScale = proj.m[0][0];
+			yScale = proj.m[1][1];
+			nearPlane = zn;
+			farPlane = zf;
+
+			const float logRatio = std::log2(farPlane / nearPlane);
+			depthScale = (float)countZ / logRatio;
+			depthBias = -(float)countZ * std::log2(nearPlane) / logRatio;
+			for (uint32_t z = 0; z <= countZ; z++)
+				sliceDepths[z] = nearPlane * std::pow(farPlane / nearPlane, (float)z / (float)countZ);
+
+			// a tile is a pyramid, its x and y at a given depth are the device coordinates times depth / scale
+			for (uint32_t z = 0; z < countZ; z++)
+			{
+				const float d0 = sliceDepths[z];
+				const float d1 = sliceDepths[z + 1];
+				for (uint32_t y = 0; y < countY; y++)
+				{
+					const float top = 1.0f - 2.0f * (float)y / (float)countY;
+					const float bottom = 1.0f - 2.0f * (float)(y + 1) / (float)countY;
+					for (uint32_t x = 0; x < countX; x++)
+					{
+						const float left = -1.0f + 2.0f * (float)x / (float)countX;
+						const float right = -1.0f + 2.0f * (float)(x + 1) / (float)countX;
+
+						Aabb& box = boxes[GetClusterIndex(x, y, z)];
+						box.min.x = std::min(left * d0, left * d1) / xScale;
+						box.max.x = std::max(right * d0, right * d1) / xScale;
+						box.min.y = std::min(bottom * d0, bottom * d1) / yScale;
+						box.max.y = std::max(top * d0, top * d1) / yScale;
+						box.min.z = d0;
+						box.max.z = d1;
+					}
+				}
+			}
+		}
+
+		void LightClusters::BeginFrame(
+			const Egg::Math::Float4x4& view, const Egg::Math::Float4x4& proj,
+			const Sphere* lights, uint32_t lightCount)
+		{
+			SetProjection(proj);
+
+			viewLights.resize(lightCount);
+			for (uint32_t i = 0; i < lightCount; i++)
+			{
+				const Egg::Math::Float3& c = lights[i].center;
+				Sphere& s = viewLights[i];
+				s.center.x = c.x * view.m[0][0] + c.y * view.m[1][0] + c.z * view.m[2][0] + view.m[3][0];
+				s.center.y = c.x * view.m[0][1] + c.y * view.m[1][1] + c.z * view.m[2][1] + view.m[3][1];
+				s.center.z = c.x * view.m[0][2] + c.y * view.m[1][2] + c.z * view.m[2][2] + view.m[3][2];
+				s.radius = lights[i].radius;
+			}
+
+			std::fill(counts.begin(), counts.end(), 0u);
+		}
+
+		void LightClusters::BinSlice(uint32_t z) noexcept
+		{
+			const float d0 = sliceDepths[z];
+			const float d1 = sliceDepths[z + 1];
+			const float halfX = 0.5f * (float)countX;
+			const float halfY = 0.5f * (float)countY;
+
+			for (uint32_t light = 0; light < (uint32_t)viewLights.size(); light++)
+			{
+				const Sphere& s = viewLights[light];
+				if (s.center.z + s.radius < d0 || s.center.z - s.radius > d1)
+					continue;
+
+				// the box around the sphere cut to the slice, its x / depth is smallest for the smallest x at one of the two depths
+				const float nearDepth = std::max(d0, s.center.z - s.radius);
+				const float farDepth = std::min(d1, s.center.z + s.radius);
+				const float minX = xScale * (s.center.x - s.radius);
+				const float maxX = xScale * (s.center.x + s.radius);
+				const float minY = yScale * (s.center.y - s.radius);
+				const float maxY = yScale * (s.center.y + s.radius);
+				const float left = std::min(minX / nearDepth, minX / farDepth);
+				const float right = std::max(maxX / nearDepth, maxX / farDepth);
+				const float bottom = std::min(minY / nearDepth, minY / farDepth);
+				const float top = std::max(maxY / nearDepth, maxY / farDepth);
+
+				uint32_t x0, x1, y0, y1;
+				if (!TileRange((left + 1.0f) * halfX, (right + 1.0f) * halfX, countX, x0, x1) ||
+					!TileRange((1.0f - top) * halfY, (1.0f - bottom) * halfY, countY, y0, y1))
+					continue;
+
+				// the screen rectangle is conservative, the sphere may still miss the corner clusters
+				for (uint32_t y = y0; y <= y1; y++)
+					for (uint32_t x = x0; x <= x1; x++)
+					{
+						const uint32_t cluster = GetClusterIndex(x, y, z);
+						if (!Touches(s, boxes[cluster]))
+							continue;
+						uint32_t& count = counts[cluster];
+						if (count < maxLightsPerCluster)
+							slots[cluster * maxLightsPerCluster + count] = light;
+						count++;
+					}
+			}
+		}
+
+		void LightClusters::Finish()
+		{
+			stats = Stats{};
+			stats.lights = (uint32_t)viewLights.size();
+			stats.clusters = GetClusterCount();
+
+			uint32_t offset = 0;
+			for (uint32_t cluster = 0; cluster < stats.clusters; cluster++)
+			{
+				const uint32_t touching = counts[cluster];
+				const uint32_t count = std::min(touching, maxLightsPerCluster);
+				ranges[cluster] = Range{ offset, count };
+				offset += count;
+
+				stats.occupiedClusters += touching > 0 ? 1 : 0;
+				stats.overflowedClusters += touching > maxLightsPerCluster ? 1 : 0;
+				stats.maxLightsPerCluster = std::max(stats.maxLightsPerCluster, count);
+			}
+
+			indices.resize(offset);
+			for (uint32_t cluster = 0; cluster < stats.clusters; cluster++)
+				std::copy_n(&slots[cluster * maxLightsPerCluster], ranges[cluster].count, indices.data() + ranges[cluster].offset);
+
+			stats.indices = offset;
+			stats.averageLightsPerCluster = (float)offset / (float)stats.clusters;
+			stats.averageLightsPerOccupiedCluster = stats.occupiedClusters > 0 ? (float)offset / (float)stats.occupiedClusters : 0.0f;
+		}
+
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Bounds.h"
+#include "../Math/Float4x4.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Clustered light culling. The view frustum is cut into a grid of clusters (froxels): countX * countY tiles
+on the screen, and countZ depth slices whose thickness grows exponentially from the near to the far plane.
+Every cluster gets the list of the lights whose sphere of influence touches it, so a pixel only shades the lights of its cluster.
+
+A frame goes like this:
+	BeginFrame(view, proj, lights)
+	BinSlice(z) for every depth slice, slices are independent and can be binned in parallel
+	Finish(), packs the lists into GetRanges() and GetIndices()
+
+The grid follows the projection matrix, which must be a symmetric perspective projection with d3d depth (Float4x4::Proj).
+A pixel at view depth d with normalized device coordinates (x, y) is in the cluster
+	tile x = floor((x + 1) / 2 * countX), tile y = floor((1 - y) / 2 * countY) (rows from the top of the screen),
+	slice = floor(log2(d) * GetDepthScale() + GetDepthBias())
+each clamped to the grid, and the index of the cluster is (slice * countY + tile y) * countX + tile x.
+*/
+namespace Egg {
+	namespace Cull {
+
+		class LightClusters
+		{
+		public:
+
+			// the lights of a cluster are GetIndices()[offset] .. GetIndices()[offset + count - 1]
+			struct Range
+			{
+				uint32_t offset;
+				uint32_t count;
+			};
+
+			struct Stats
+			{
+				uint32_t lights = 0;
+				uint32_t clusters = 0;
+				// clusters with at least one light
+				uint32_t occupiedClusters = 0;
+				// total length of the light lists
+				uint32_t indices = 0;
+				uint32_t maxLightsPerCluster = 0;
+				// clusters touched by more than the maximum number of lights, the ones above it were dropped
+				uint32_t overflowedClusters = 0;
+				float averageLightsPerCluster = 0.0f;
+				float averageLightsPerOccupiedCluster = 0.0f;
+			};
+
+		private:
+
+			uint32_t countX;
+			uint32_t countY;
+			uint32_t countZ;
+			uint32_t maxLightsPerCluster;
+
+			// projection the cluster boxes were computed for
+			float xScale = 0.0f;
+			float yScale = 0.0f;
+			float nearPlane = 0.0f;
+			float farPlane = 0.0f;
+			float depthScale = 0.0f;
+			float depthBias = 0.0f;
+
+			// view depth of the slice boundaries, countZ + 1 of them
+			std::vector<float> sliceDepths;
+			// view space boxes of the clusters
+			std::vector<Aabb> boxes;
+
+			// view space spheres of the lights this frame
+			std::vector<Sphere> viewLights;
+
+			// maxLightsPerCluster slots for every cluster, filled by BinSlice
+			std::vector<uint32_t> slots;
+			std::vector<uint32_t> counts;
+
+			std::vector<Range> ranges;
+			std::vector<uint32_t> indices;
+
+			Stats stats;
+
+			void SetProjection(const Egg::Math::Float4x4& proj);
+
+		public:
+
+			LightClusters(uint32_t countX = 16, uint32_t countY = 9, uint32_t countZ = 24, uint32_t maxLightsPerCluster = 64);
+
+			/*
+			Takes the world space spheres of influence of the lights, view and proj are the row-vector matrices of the camera.
+			The cluster boxes are only recomputed when the projection changes.
+			*/
+			void BeginFrame(
+				const Egg::Math::Float4x4& view, const Egg::Math::Float4x4& proj,
+				const Sphere* lights, uint32_t lightCount);
+
+			/*
+			Finds the lights of the clusters of depth slice z, different slices may be binned at the same time
+			*/
+			void BinSlice(uint32_t z) noexcept;
+
+			/*
+			Packs the light lists of all clusters after every slice is binned, and updates the stats
+			*/
+			void Finish();
+
+			uint32_t GetCountX() const { return countX; }
+			uint32_t GetCountY() const { return countY; }
+			uint32_t GetCountZ() const { return countZ; }
+			uint32_t GetClusterCount() const { return countX * countY * countZ; }
+			uint32_t GetClusterIndex(uint32_t x, uint32_t y, uint32_t z) const { return (z * countY + y) * countX + x; }
+
+			float GetDepthScale() const { return depthScale; }
+			float GetDepthBias() const { return depthBias; }
+
+			const Aabb& GetClusterBox(uint32_t cluster) const { return boxes[cluster]; }
+
+			/*
+			One range per cluster, into the indices of the lights (in the order they were given to BeginFrame)
+			*/
+			const std::vector<Range>& GetRanges() const { return ranges; }
+			const std::vector<uint32_t>& GetIndices() const { return indices; }
+
+			const Stats& GetStats() const { return stats; }
+		};
+
+	}
+}
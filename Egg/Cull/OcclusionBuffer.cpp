@@ -0,0 +1,381 @@
+#include "OcclusionBuffer.h"
+#include "../Math/Float4.h"
+#include "../Math/Simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Egg {
+	namespace Cull {
+
+		namespace {
+
+			// vertices with a smaller w are behind or on the camera plane, their triangles are not rasterized
+			constexpr float MinW = 1e-5f;
+
+		}
+
+		OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height)
+		{
+			tilesX = std::max(1u, (width + TileWidth - 1) / TileWidth);
+			tilesY = std::max(1u, (height + TileHeight - 1) / TileHeight);
+			this->width = tilesX * TileWidth;
+			this->height = tilesY * TileHeight;
+			bins.resize(tilesX * tilesY);
+
+			uint32_t w = this->width, h = this->height;
+			for(;;)
+			{
+				levels.emplace_back(w * h, 1.0f);
+				levelWidths.push_back(w);
+				levelHeights.push_back(h);
+				if(w == 1 && h == 1)
+					break;
+				w = (w + 1) / 2;
+				h = (h + 1) / 2;
+			}
+		}
+
+		void OcclusionBuffer::BeginFrame(const Egg::Math::Float4x4& viewProj)
+		{
+			this->viewProj = viewProj;
+			std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+			triangles.clear();
+			for(std::vector<uint32_t>& bin : bins)
+				bin.clear();
+			stats = Stats{};
+		}
+
+		void OcclusionBuffer::AddOccluder(
+			const Egg::Math::Float4x4& model,
+			const Egg::Math::Float3* positions, size_t vertexCount,
+			const uint32_t* indices, size_t indexCount)
+		{
+			const Egg::Math::Float4x4 modelViewProj = model * viewProj;
+
+			screenX.resize(vertexCount);
+			screenY.resize(vertexCount);
+			screenZ.resize(vertexCount);
+			screenInvW.resize(vertexCount);
+
+			const float halfWidth = 0.5f * (float)width;
+			const float halfHeight = 0.5f * (float)height;
+			for(size_t i = 0; i < vertexCount; i++)
+			{
+				const Egg::Math::Float4 clip = modelViewProj.Transform(Egg::Math::Float4{ positions[i], 1.0f });
+				if(clip.w < MinW)
+				{
+					screenX[i] = screenY[i] = screenZ[i] = screenInvW[i] = 0.0f;
+					continue;
+				}
+				const float invW = 1.0f / clip.w;
+				screenX[i] = (clip.x * invW + 1.0f) * halfWidth;
+				screenY[i] = (1.0f - clip.y * invW) * halfHeight;
+				screenZ[i] = clip.z * invW;
+				screenInvW[i] = invW;
+			}
+
+			stats.occluders++;
+			SetupTriangles(indices, indexCount / 3);
+		}
+
+		void OcclusionBuffer::SetupTriangles(const uint32_t* indices, size_t triangleCount)
+		{
+			stats.triangles += (uint32_t)triangleCount;
+
+			// four triangles per iteration, lanes past the end repeat the last triangle and are dropped at the end
+			for(size_t first = 0; first < triangleCount; first += 4)
+			{
+				const size_t laneCount = std::min<size_t>(4, triangleCount - first);
+
+				float x[3][4], y[3][4], z[3][4], invW[3][4];
+				for(size_t lane = 0; lane < 4; lane++)
+				{
+					const uint32_t* triangle = indices + 3 * (first + std::min(lane, laneCount - 1));
+					for(int v = 0; v < 3; v++)
+					{
+						x[v][lane] = screenX[triangle[v]];
+						y[v][lane] = screenY[triangle[v]];
+						z[v][lane] = screenZ[triangle[v]];
+						invW[v][lane] = screenInvW[triangle[v]];
+					}
+				}
+
+				// edge k is opposite to vertex k: from vertex k + 1 to vertex k + 2
+				Triangle setup[4];
+				bool valid[4];
+#if EGG_MATH_SIMD
+				{
+					__m128 vx[3], vy[3], vz[3];
+					__m128 zero = _mm_setzero_ps();
+					__m128 inFront = _mm_castsi128_ps(_mm_set1_epi32(-1));
+					for(int v = 0; v < 3; v++)
+					{
+						vx[v] = _mm_loadu_ps(x[v]);
+						vy[v] = _mm_loadu_ps(y[v]);
+						vz[v] = _mm_loadu_ps(z[v]);
+						inFront = _mm_and_ps(inFront, _mm_cmpgt_ps(_mm_loadu_ps(invW[v]), zero));
+					}
+
+					__m128 a[3], b[3], c[3];
+					for(int k = 0; k < 3; k++)
+					{
+						const int i = (k + 1) % 3, j = (k + 2) % 3;
+						a[k] = _mm_sub_ps(vy[i], vy[j]);
+						b[k] = _mm_sub_ps(vx[j], vx[i]);
+						c[k] = _mm_sub_ps(_mm_mul_ps(vx[i], vy[j]), _mm_mul_ps(vy[i], vx[j]));
+					}
+
+					// twice the signed area, the edges of clockwise triangles are flipped so the inside is positive for both windings
+					__m128 doubleArea = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], vx[0]), _mm_mul_ps(b[0], vy[0])), c[0]);
+					const __m128 flip = _mm_and_ps(_mm_cmplt_ps(doubleArea, zero), _mm_set1_ps(-0.0f));
+					doubleArea = _mm_xor_ps(doubleArea, flip);
+					for(int k = 0; k < 3; k++)
+					{
+						a[k] = _mm_xor_ps(a[k], flip);
+						b[k] = _mm_xor_ps(b[k], flip);
+						c[k] = _mm_xor_ps(c[k], flip);
+					}
+
+					// depth is linear in screen space, barycentric k is edge k over the area
+					const __m128 nonDegenerate = _mm_cmpgt_ps(doubleArea, zero);
+					const __m128 invArea = _mm_div_ps(_mm_set1_ps(1.0f), _mm_or_ps(_mm_and_ps(nonDegenerate, doubleArea), _mm_andnot_ps(nonDegenerate, _mm_set1_ps(1.0f))));
+					__m128 za = zero, zb = zero, zc = zero;
+					for(int k = 0; k < 3; k++)
+					{
+						za = _mm_add_ps(za, _mm_mul_ps(a[k], vz[k]));
+						zb = _mm_add_ps(zb, _mm_mul_ps(b[k], vz[k]));
+						zc = _mm_add_ps(zc, _mm_mul_ps(c[k], vz[k]));
+					}
+					za = _mm_mul_ps(za, invArea);
+					zb = _mm_mul_ps(zb, invArea);
+					zc = _mm_mul_ps(zc, invArea);
+
+					const int validMask = _mm_movemask_ps(_mm_and_ps(inFront, nonDegenerate));
+
+					float out[4];
+					for(int k = 0; k < 3; k++)
+					{
+						_mm_storeu_ps(out, a[k]); for(int lane = 0; lane < 4; lane++) setup[lane].edgeA[k] = out[lane];
+						_mm_storeu_ps(out, b[k]); for(int lane = 0; lane < 4; lane++) setup[lane].edgeB[k] = out[lane];
+						_mm_storeu_ps(out, c[k]); for(int lane = 0; lane < 4; lane++) setup[lane].edgeC[k] = out[lane];
+					}
+					_mm_storeu_ps(out, za); for(int lane = 0; lane < 4; lane++) setup[lane].depthA = out[lane];
+					_mm_storeu_ps(out, zb); for(int lane = 0; lane < 4; lane++) setup[lane].depthB = out[lane];
+					_mm_storeu_ps(out, zc); for(int lane = 0; lane < 4; lane++) setup[lane].depthC = out[lane];
+					for(int lane = 0; lane < 4; lane++)
+						valid[lane] = ((validMask >> lane) & 1) != 0;
+				}
+#else
+				for(int lane = 0; lane < 4; lane++)
+				{
+					Triangle& t = setup[lane];
+					for(int k = 0; k < 3; k++)
+					{
+						const int i = (k + 1) % 3, j = (k + 2) % 3;
+						t.edgeA[k] = y[i][lane] - y[j][lane];
+						t.edgeB[k] = x[j][lane] - x[i][lane];
+						t.edgeC[k] = x[i][lane] * y[j][lane] - y[i][lane] * x[j][lane];
+					}
+					float doubleArea = t.edgeA[0] * x[0][lane] + t.edgeB[0] * y[0][lane] + t.edgeC[0];
+					if(doubleArea < 0.0f)
+					{
+						doubleArea = -doubleArea;
+						for(int k = 0; k < 3; k++)
+						{
+							t.edgeA[k] = -t.edgeA[k];
+							t.edgeB[k] = -t.edgeB[k];
+							t.edgeC[k] = -t.edgeC[k];
+						}
+					}
+					valid[lane] = doubleArea > 0.0f && invW[0][lane] > 0.0f && invW[1][lane] > 0.0f && invW[2][lane] > 0.0f;
+
+					const float invArea = valid[lane] ? 1.0f / doubleArea : 1.0f;
+					t.depthA = (t.edgeA[0] * z[0][lane] + t.edgeA[1] * z[1][lane] + t.edgeA[2] * z[2][lane]) * invArea;
+					t.depthB = (t.edgeB[0] * z[0][lane] + t.edgeB[1] * z[1][lane] + t.edgeB[2] * z[2][lane]) * invArea;
+					t.depthC = (t.edgeC[0] * z[0][lane] + t.edgeC[1] * z[1][lane] + t.edgeC[2] * z[2][lane]) * invArea;
+				}
+#endif
+				for(size_t lane = 0; lane < laneCount; lane++)
+				{
+					if(!valid[lane])
+					{
+						stats.rejectedTriangles++;
+						continue;
+					}
+
+					// pixels whose center is inside the bounds of the vertices, clamped to the screen
+					const float minX = std::min(std::min(x[0][lane], x[1][lane]), x[2][lane]);
+					const float maxX = std::max(std::max(x[0][lane], x[1][lane]), x[2][lane]);
+					const float minY = std::min(std::min(y[0][lane], y[1][lane]), y[2][lane]);
+					const float maxY = std::max(std::max(y[0][lane], y[1][lane]), y[2][lane]);
+
+					Triangle& t = setup[lane];
+					t.minX = (int32_t)std::ceil(std::max(minX - 0.5f, 0.0f));
+					t.minY = (int32_t)std::ceil(std::max(minY - 0.5f, 0.0f));
+					t.maxX = (int32_t)std::floor(std::min(maxX - 0.5f, (float)width - 1.0f));
+					t.maxY = (int32_t)std::floor(std::min(maxY - 0.5f, (float)height - 1.0f));
+					if(t.minX > t.maxX || t.minY > t.maxY)
+					{
+						stats.rejectedTriangles++;
+						continue;
+					}
+
+					AddTriangle(t);
+				}
+			}
+		}
+
+		void OcclusionBuffer::AddTriangle(const Triangle& triangle)
+		{
+			const uint32_t index = (uint32_t)triangles.size();
+			triangles.push_back(triangle);
+
+			const uint32_t tileMinX = triangle.minX / TileWidth, tileMaxX = triangle.maxX / TileWidth;
+			const uint32_t tileMinY = triangle.minY / TileHeight, tileMaxY = triangle.maxY / TileHeight;
+			for(uint32_t ty = tileMinY; ty <= tileMaxY; ty++)
+				for(uint32_t tx = tileMinX; tx <= tileMaxX; tx++)
+					bins[ty * tilesX + tx].push_back(index);
+			stats.binnedTriangles += (tileMaxX - tileMinX + 1) * (tileMaxY - tileMinY + 1);
+		}
+
+		void OcclusionBuffer::RasterizeTile(uint32_t tile) noexcept
+		{
+			const int32_t tileX = (int32_t)((tile % tilesX) * TileWidth);
+			const int32_t tileY = (int32_t)((tile / tilesX) * TileHeight);
+			float* depth = levels[0].data();
+
+			for(uint32_t index : bins[tile])
+			{
+				const Triangle& t = triangles[index];
+				// the tile starts at a multiple of 4, so aligning down stays inside it
+				const int32_t minX = std::max(t.minX, tileX) & ~3;
+				const int32_t maxX = std::min(t.maxX, tileX + (int32_t)TileWidth - 1);
+				const int32_t minY = std::max(t.minY, tileY);
+				const int32_t maxY = std::min(t.maxY, tileY + (int32_t)TileHeight - 1);
+
+#if EGG_MATH_SIMD
+				const __m128 a0 = _mm_set1_ps(t.edgeA[0]), a1 = _mm_set1_ps(t.edgeA[1]), a2 = _mm_set1_ps(t.edgeA[2]);
+				const __m128 za = _mm_set1_ps(t.depthA);
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+				for(int32_t y = minY; y <= maxY; y++)
+				{
+					const float py = (float)y + 0.5f;
+					const __m128 row0 = _mm_set1_ps(t.edgeB[0] * py + t.edgeC[0]);
+					const __m128 row1 = _mm_set1_ps(t.edgeB[1] * py + t.edgeC[1]);
+					const __m128 row2 = _mm_set1_ps(t.edgeB[2] * py + t.edgeC[2]);
+					const __m128 rowZ = _mm_set1_ps(t.depthB * py + t.depthC);
+					float* line = depth + (size_t)y * width;
+
+					for(int32_t x = minX; x <= maxX; x += 4)
+					{
+						const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+						const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+						const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+						const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+						const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+						if(_mm_movemask_ps(inside) == 0)
+							continue;
+
+						const __m128 z = _mm_max_ps(_mm_add_ps(_mm_mul_ps(za, px), rowZ), zero);
+						const __m128 old = _mm_loadu_ps(line + x);
+						const __m128 nearer = _mm_min_ps(old, z);
+						_mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+					}
+				}
+#else
+				for(int32_t y = minY; y <= maxY; y++)
+				{
+					const float py = (float)y + 0.5f;
+					float* line = depth + (size_t)y * width;
+					for(int32_t x = minX; x <= maxX; x++)
+					{
+						const float px = (float)x + 0.5f;
+						if(t.edgeA[0] * px + t.edgeB[0] * py + t.edgeC[0] < 0.0f ||
+						   t.edgeA[1] * px + t.edgeB[1] * py + t.edgeC[1] < 0.0f ||
+						   t.edgeA[2] * px + t.edgeB[2] * py + t.edgeC[2] < 0.0f)
+							continue;
+						const float z = std::max(t.depthA * px + t.depthB * py + t.depthC, 0.0f);
+						line[x] = std::min(line[x], z);
+					}
+				}
+#endif
+			}
+		}
+
+		void OcclusionBuffer::BuildHierarchy()
+		{
+			for(size_t level = 1; level < levels.size(); level++)
+			{
+				const std::vector<float>& src = levels[level - 1];
+				std::vector<float>& dst = levels[level];
+				const uint32_t srcWidth = levelWidths[level - 1], srcHeight = levelHeights[level - 1];
+				const uint32_t dstWidth = levelWidths[level], dstHeight = levelHeights[level];
+
+				for(uint32_t y = 0; y < dstHeight; y++)
+				{
+					const uint32_t y0 = 2 * y, y1 = std::min(2 * y + 1, srcHeight - 1);
+					for(uint32_t x = 0; x < dstWidth; x++)
+					{
+						const uint32_t x0 = 2 * x, x1 = std::min(2 * x + 1, srcWidth - 1);
+						dst[y * dstWidth + x] = std::max(
+							std::max(src[y0 * srcWidth + x0], src[y0 * srcWidth + x1]),
+							std::max(src[y1 * srcWidth + x0], src[y1 * srcWidth + x1]));
+					}
+				}
+			}
+		}
+
+		bool OcclusionBuffer::IsOccluded(const Aabb& box) const noexcept
+		{
+			float minX = (float)width, maxX = 0.0f;
+			float minY = (float)height, maxY = 0.0f;
+			float minZ = 1.0f;
+
+			for(int corner = 0; corner < 8; corner++)
+			{
+				const Egg::Math::Float4 p{
+					(corner & 1) ? box.max.x : box.min.x,
+					(corner & 2) ? box.max.y : box.min.y,
+					(corner & 4) ? box.max.z : box.min.z,
+					1.0f };
+				const Egg::Math::Float4 clip = viewProj.Transform(p);
+				if(clip.w < MinW)
+					return false;
+
+				const float invW = 1.0f / clip.w;
+				const float x = (clip.x * invW + 1.0f) * 0.5f * (float)width;
+				const float y = (1.0f - clip.y * invW) * 0.5f * (float)height;
+				minX = std::min(minX, x);
+				maxX = std::max(maxX, x);
+				minY = std::min(minY, y);
+				maxY = std::max(maxY, y);
+				minZ = std::min(minZ, clip.z * invW);
+			}
+
+			if(maxX < 0.0f || maxY < 0.0f || minX >= (float)width || minY >= (float)height)
+				return false;
+
+			const uint32_t x0 = (uint32_t)std::max(minX, 0.0f);
+			const uint32_t y0 = (uint32_t)std::max(minY, 0.0f);
+			const uint32_t x1 = (uint32_t)std::min(maxX, (float)width - 1.0f);
+			const uint32_t y1 = (uint32_t)std::min(maxY, (float)height - 1.0f);
+
+			// the finest level where the box covers at most 2x2 texels
+			size_t level = 0;
+			while(level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+				level++;
+
+			const std::vector<float>& texels = levels[level];
+			const uint32_t levelWidth = levelWidths[level];
+			for(uint32_t y = y0 >> level; y <= (y1 >> level); y++)
+				for(uint32_t x = x0 >> level; x <= (x1 >> level); x++)
+					if(texels[y * levelWidth + x] >= minZ)
+						return false;
+			return true;
+		}
+
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Bounds.h"
+#include "../Math/Float3.h"
+#include "../Math/Float4x4.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Software occlusion culling. A few big occluder meshes are rasterized into a small depth buffer on the CPU,
+then bounding boxes are tested against a max-depth pyramid (hierarchical z) of it.
+
+A frame goes like this:
+	BeginFrame(viewProj)
+	AddOccluder(...) for every occluder, sets up the triangles four at a time and bins them into screen tiles
+	RasterizeTile(t) for every tile, tiles are independent and can be rasterized in parallel
+	BuildHierarchy()
+	IsOccluded(box) for every object, const and safe to call from any number of threads
+
+Depth is d3d depth (z / w, 0 at the near plane). The test is conservative: pixels are only covered where
+their center is inside an occluder triangle, triangles crossing the camera plane are dropped,
+and a box is only reported occluded if every texel it touches holds occluders in front of the whole box.
+*/
+namespace Egg {
+	namespace Cull {
+
+		class OcclusionBuffer
+		{
+		public:
+
+			static constexpr uint32_t TileWidth = 32;
+			static constexpr uint32_t TileHeight = 16;
+
+			struct Stats
+			{
+				uint32_t occluders = 0;
+				uint32_t triangles = 0;
+				// triangles crossing the camera plane, degenerate or off screen
+				uint32_t rejectedTriangles = 0;
+				// sum over tiles of the triangles binned to them
+				uint32_t binnedTriangles = 0;
+			};
+
+		private:
+
+			// screen space edge functions a * x + b * y + c, positive inside, and the depth plane of a triangle
+			struct Triangle
+			{
+				float edgeA[3], edgeB[3], edgeC[3];
+				float depthA, depthB, depthC;
+				int32_t minX, minY, maxX, maxY;
+			};
+
+			uint32_t width;
+			uint32_t height;
+			uint32_t tilesX;
+			uint32_t tilesY;
+
+			Egg::Math::Float4x4 viewProj;
+
+			std::vector<Triangle> triangles;
+			std::vector<std::vector<uint32_t>> bins;
+
+			// screen space vertices of the occluder being added: x, y in pixels, z / w, and 1 / w (0 if behind the camera)
+			std::vector<float> screenX, screenY, screenZ, screenInvW;
+
+			// levels[0] is the rasterized depth, every further level holds the max of 2x2 texels of the one before
+			std::vector<std::vector<float>> levels;
+			std::vector<uint32_t> levelWidths;
+			std::vector<uint32_t> levelHeights;
+
+			Stats stats;
+
+			void SetupTriangles(const uint32_t* indices, size_t triangleCount);
+			void AddTriangle(const Triangle& triangle);
+
+		public:
+
+			/*
+			width is rounded up to a multiple of TileWidth, height to a multiple of TileHeight
+			*/
+			OcclusionBuffer(uint32_t width = 256, uint32_t height = 128);
+
+			/*
+			Clears the depth and the bins, viewProj is the row-vector view-projection matrix used by all further calls
+			*/
+			void BeginFrame(const Egg::Math::Float4x4& viewProj);
+
+			/*
+			Triangle list given by indices into positions, in model space, drawn with model * viewProj
+			*/
+			void AddOccluder(
+				const Egg::Math::Float4x4& model,
+				const Egg::Math::Float3* positions, size_t vertexCount,
+				const uint32_t* indices, size_t indexCount);
+
+			uint32_t GetTileCount() const { return tilesX * tilesY; }
+
+			/*
+			Rasterizes the triangles binned to the tile, different tiles may be rasterized at the same time
+			*/
+			void RasterizeTile(uint32_t tile) noexcept;
+
+			/*
+			Builds the max-depth pyramid, after all tiles are rasterized
+			*/
+			void BuildHierarchy();
+
+			/*
+			True if the world space box is certainly hidden behind the occluders.
+			Boxes crossing the camera plane are never occluded, boxes off screen are not either: frustum culling deals with those.
+			*/
+			bool IsOccluded(const Aabb& box) const noexcept;
+
+			uint32_t GetWidth() const { return width; }
+			uint32_t GetHeight() const { return height; }
+
+			/*
+			Rasterized depth, width * height floats, rows from the top of the screen
+			*/
+			const float* GetDepth() const { return levels[0].data(); }
+
+			const Stats& GetStats() const { return stats; }
+		};
+
+	}
+}
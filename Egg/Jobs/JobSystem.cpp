@@ -0,0 +1,320 @@
+#include "JobSystem.h"
+
+#include <chrono>
+
+namespace Egg {
+	namespace Jobs {
+
+		struct Task
+		{
+			JobSystem::Job job;
+			Counter::P counter;
+		};
+
+		namespace {
+			thread_local const JobSystem* currentSystem = nullptr;
+			thread_local int currentWorker = -1;
+		}
+
+		WorkDeque::WorkDeque(int64_t capacity)
+		{
+			rings.push_back(std::make_unique<Ring>(capacity));
+			ring.store(rings.back().get(), std::memory_order_relaxed);
+		}
+
+		void WorkDeque::Push(Task* task)
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed);
+			const int64_t t = top.load(std::memory_order_acquire);
+			Ring* r = ring.load(std::memory_order_relaxed);
+
+			if(b - t > r->capacity - 1)
+			{
+				rings.push_back(std::make_unique<Ring>(r->capacity * 2));
+				Ring* grown = rings.back().get();
+				for(int64_t i = t; i < b; i++)
+					grown->Put(i, r->Get(i));
+				ring.store(grown, std::memory_order_release);
+				r = grown;
+			}
+
+			r->Put(b, task);
+			// publishes the task to thieves
+			bottom.store(b + 1, std::memory_order_release);
+		}
+
+		Task* WorkDeque::Pop()
+		{
+			const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			Ring* r = ring.load(std::memory_order_relaxed);
+			// the reservation of the bottom element has to be visible before top is read
+			bottom.store(b, std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_seq_cst);
+
+			if(t > b)
+			{
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			Task* task = r->Get(b);
+			if(t == b)
+			{
+				// last element, race the thieves for it
+				if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					task = nullptr;
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+			return task;
+		}
+
+		Task* WorkDeque::Steal()
+		{
+			int64_t t = top.load(std::memory_order_seq_cst);
+			const int64_t b = bottom.load(std::memory_order_seq_cst);
+			if(t >= b)
+				return nullptr;
+
+			Ring* r = ring.load(std::memory_order_acquire);
+			Task* task = r->Get(t);
+			if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return nullptr;
+			return task;
+		}
+
+		JobSystem::JobSystem(uint32_t workerCount)
+		{
+			if(workerCount == 0)
+				workerCount = DefaultWorkerCount();
+
+			workers.reserve(workerCount);
+			for(uint32_t i = 0; i < workerCount; i++)
+				workers.push_back(std::make_unique<Worker>());
+
+			// every deque exists before any worker may try to steal from it
+			for(uint32_t i = 0; i < workerCount; i++)
+				workers[i]->thread = std::thread{ &JobSystem::Run, this, i };
+		}
+
+		JobSystem::~JobSystem()
+		{
+			{
+				std::lock_guard<std::mutex> lock{ sleepMutex };
+				stopping = true;
+			}
+			wake.notify_all();
+
+			for(auto& worker : workers)
+				worker->thread.join();
+		}
+
+		void JobSystem::Submit(Job job, const Counter::P& counter)
+		{
+			if(counter)
+				counter->pending.fetch_add(1, std::memory_order_relaxed);
+			Enqueue(new Task{ std::move(job), counter });
+		}
+
+		void JobSystem::SubmitAfter(Counter& dependency, Job job, const Counter::P& counter)
+		{
+			if(counter)
+				counter->pending.fetch_add(1, std::memory_order_relaxed);
+			Task* task = new Task{ std::move(job), counter };
+
+			{
+				std::lock_guard<std::mutex> lock{ dependency.mutex };
+				if(!dependency.IsDone())
+				{
+					dependency.continuations.push_back(task);
+					return;
+				}
+			}
+			Enqueue(task);
+		}
+
+		void JobSystem::Enqueue(Task* task)
+		{
+			int self = GetCurrentWorker();
+			if(self >= 0)
+			{
+				workers[self]->deque.Push(task);
+			}
+			else
+			{
+				std::lock_guard<std::mutex> lock{ sharedMutex };
+				shared.push_back(task);
+			}
+
+			// a worker raises sleeping before checking queued, so one of the two sides sees the other
+			queued.fetch_add(1, std::memory_order_seq_cst);
+			if(sleeping.load(std::memory_order_seq_cst) > 0)
+			{
+				{ std::lock_guard<std::mutex> lock{ sleepMutex }; }
+				wake.notify_one();
+			}
+		}
+
+		Task* JobSystem::FindTask(int self, bool& stolen)
+		{
+			stolen = false;
+			if(self >= 0)
+				if(Task* task = workers[self]->deque.Pop())
+					return task;
+
+			{
+				std::lock_guard<std::mutex> lock{ sharedMutex };
+				if(!shared.empty())
+				{
+					Task* task = shared.front();
+					shared.pop_front();
+					return task;
+				}
+			}
+
+			const uint32_t count = GetWorkerCount();
+			const uint32_t start = (self >= 0) ? (uint32_t)self + 1 : 0;
+			for(uint32_t k = 0; k < count; k++)
+			{
+				uint32_t victim = (start + k) % count;
+				if((int)victim == self)
+					continue;
+				if(Task* task = workers[victim]->deque.Steal())
+				{
+					stolen = true;
+					return task;
+				}
+			}
+			return nullptr;
+		}
+
+		void JobSystem::Execute(Task* task)
+		{
+			queued.fetch_sub(1, std::memory_order_relaxed);
+			task->job();
+
+			// the task holds a reference, the counter can't go away while it is finished
+			Counter::P counter = std::move(task->counter);
+			delete task;
+			if(counter)
+				Finish(*counter);
+		}
+
+		void JobSystem::Finish(Counter& counter)
+		{
+			if(counter.pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+
+			std::vector<Task*> ready;
+			{
+				std::lock_guard<std::mutex> lock{ counter.mutex };
+				ready.swap(counter.continuations);
+			}
+			for(Task* task : ready)
+				Enqueue(task);
+		}
+
+		void JobSystem::Wait(Counter& counter)
+		{
+			const int self = GetCurrentWorker();
+			while(!counter.IsDone())
+			{
+				bool stolen;
+				if(Task* task = FindTask(self, stolen))
+				{
+					Execute(task);
+					if(self >= 0)
+					{
+						workers[self]->executed.fetch_add(1, std::memory_order_relaxed);
+						if(stolen)
+							workers[self]->steals.fetch_add(1, std::memory_order_relaxed);
+					}
+					else
+					{
+						helped.fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+				else
+				{
+					// the remaining jobs are running on other threads
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		int JobSystem::GetCurrentWorker() const
+		{
+			return (currentSystem == this) ? currentWorker : -1;
+		}
+
+		void JobSystem::Run(uint32_t index)
+		{
+			currentSystem = this;
+			currentWorker = (int)index;
+			Worker& self = *workers[index];
+
+			for(;;)
+			{
+				bool stolen;
+				if(Task* task = FindTask((int)index, stolen))
+				{
+					if(stolen)
+						self.steals.fetch_add(1, std::memory_order_relaxed);
+					Execute(task);
+					self.executed.fetch_add(1, std::memory_order_relaxed);
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock{ sleepMutex };
+				if(stopping && queued.load(std::memory_order_seq_cst) == 0)
+					break;
+
+				sleeping.fetch_add(1, std::memory_order_seq_cst);
+				auto idleStart = std::chrono::steady_clock::now();
+				wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_seq_cst) > 0; });
+				auto idleEnd = std::chrono::steady_clock::now();
+				sleeping.fetch_sub(1, std::memory_order_relaxed);
+
+				self.idleNanoseconds.fetch_add(
+					(uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(idleEnd - idleStart).count(),
+					std::memory_order_relaxed);
+			}
+
+			currentSystem = nullptr;
+			currentWorker = -1;
+		}
+
+		JobSystem::Stats JobSystem::GetStats() const
+		{
+			Stats stats;
+			uint64_t idleNanoseconds = 0;
+			for(auto& worker : workers)
+			{
+				stats.executed += worker->executed.load(std::memory_order_relaxed);
+				stats.steals += worker->steals.load(std::memory_order_relaxed);
+				idleNanoseconds += worker->idleNanoseconds.load(std::memory_order_relaxed);
+			}
+			stats.helped = helped.load(std::memory_order_relaxed);
+			stats.executed += stats.helped;
+			stats.idleSeconds = (double)idleNanoseconds * 1e-9;
+			return stats;
+		}
+
+		void JobSystem::ResetStats()
+		{
+			for(auto& worker : workers)
+			{
+				worker->executed.store(0, std::memory_order_relaxed);
+				worker->steals.store(0, std::memory_order_relaxed);
+				worker->idleNanoseconds.store(0, std::memory_order_relaxed);
+			}
+			helped.store(0, std::memory_order_relaxed);
+		}
+
+		uint32_t JobSystem::DefaultWorkerCount()
+		{
+			uint32_t hardware = std::thread::hardware_concurrency();
+			return (hardware > 1) ? hardware - 1 : 1;
+		}
+
+	}
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Engine-wide pool of worker threads with work stealing.
+Every worker owns a lock-free deque: jobs submitted from a worker are pushed to its own deque and taken newest first,
+idle workers steal the oldest job from the others. Jobs submitted from other threads go to a shared queue.
+A thread waiting for a counter runs queued jobs instead of blocking, so the main thread takes part in the work.
+Only uses the standard library, so it can be built and exercised without d3d or physx.
+*/
+namespace Egg {
+	namespace Jobs {
+
+		struct Task;
+
+		/*
+		Number of unfinished jobs of a group. Jobs submitted with a counter raise it and lower it when they finish,
+		jobs submitted after a counter start when it reaches zero.
+		Counters are shared, the queued jobs keep them alive. Don't submit more jobs with a counter
+		that others depend on while it may be reaching zero.
+		*/
+		class Counter
+		{
+			friend class JobSystem;
+
+			std::atomic<uint32_t> pending{ 0 };
+			std::mutex mutex;
+			std::vector<Task*> continuations;
+
+		public:
+			using P = std::shared_ptr<Counter>;
+
+			static P Create() { return std::make_shared<Counter>(); }
+
+			bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+		};
+
+		/*
+		Chase-Lev deque: only the owner pushes and pops at the bottom, any thread may steal from the top.
+		The ring grows when full, replaced rings are kept until the deque is destroyed since a thief may still read them.
+		*/
+		class WorkDeque
+		{
+			struct Ring
+			{
+				int64_t capacity;
+				std::unique_ptr<std::atomic<Task*>[]> items;
+
+				explicit Ring(int64_t capacity) : capacity{ capacity }, items{ new std::atomic<Task*>[(size_t)capacity] } { }
+
+				Task* Get(int64_t i) const { return items[(size_t)(i & (capacity - 1))].load(std::memory_order_relaxed); }
+				void Put(int64_t i, Task* t) { items[(size_t)(i & (capacity - 1))].store(t, std::memory_order_relaxed); }
+			};
+
+			alignas(64) std::atomic<int64_t> top{ 0 };
+			alignas(64) std::atomic<int64_t> bottom{ 0 };
+			std::atomic<Ring*> ring;
+			std::vector<std::unique_ptr<Ring>> rings;
+
+		public:
+			explicit WorkDeque(int64_t capacity = 256);
+
+			void Push(Task* task);
+			Task* Pop();
+			Task* Steal();
+
+			bool Empty() const { return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed); }
+		};
+
+		class JobSystem
+		{
+		public:
+			using Job = std::function<void()>;
+
+			struct Stats
+			{
+				uint64_t executed = 0;
+				uint64_t steals = 0;
+				// jobs run by non-worker threads while waiting for a counter
+				uint64_t helped = 0;
+				// summed over all workers
+				double idleSeconds = 0.0;
+			};
+
+		private:
+			struct Worker
+			{
+				WorkDeque deque;
+				std::thread thread;
+
+				std::atomic<uint64_t> executed{ 0 };
+				std::atomic<uint64_t> steals{ 0 };
+				std::atomic<uint64_t> idleNanoseconds{ 0 };
+			};
+
+			std::vector<std::unique_ptr<Worker>> workers;
+
+			// jobs submitted by threads that are not workers
+			std::mutex sharedMutex;
+			std::deque<Task*> shared;
+
+			// number of jobs submitted but not yet taken, sleeping workers wait for it to become nonzero
+			std::atomic<uint32_t> queued{ 0 };
+			std::atomic<uint32_t> sleeping{ 0 };
+			std::mutex sleepMutex;
+			std::condition_variable wake;
+			bool stopping = false;
+
+			std::atomic<uint64_t> helped{ 0 };
+
+			void Run(uint32_t index);
+			void Enqueue(Task* task);
+			Task* FindTask(int self, bool& stolen);
+			void Execute(Task* task);
+			void Finish(Counter& counter);
+
+		public:
+			/*
+			workerCount == 0 uses DefaultWorkerCount()
+			*/
+			explicit JobSystem(uint32_t workerCount = 0);
+
+			/*
+			Runs the jobs still queued, then joins the workers
+			*/
+			~JobSystem();
+
+			JobSystem(const JobSystem&) = delete;
+			JobSystem& operator=(const JobSystem&) = delete;
+
+			/*
+			counter may be nullptr
+			*/
+			void Submit(Job job, const Counter::P& counter = nullptr);
+
+			/*
+			Queues the job once dependency reaches zero, counter is raised right away
+			*/
+			void SubmitAfter(Counter& dependency, Job job, const Counter::P& counter = nullptr);
+
+			/*
+			Runs queued jobs on the calling thread until the counter reaches zero
+			*/
+			void Wait(Counter& counter);
+
+			/*
+			Calls body(first, last) for consecutive ranges of at most grain indices covering [begin, end) and waits for all of them.
+			The first range runs on the calling thread. grain == 0 picks about four ranges per thread.
+			*/
+			template<typename F>
+			void ParallelFor(uint32_t begin, uint32_t end, uint32_t grain, F&& body)
+			{
+				if(end <= begin)
+					return;
+
+				const uint32_t count = end - begin;
+				if(grain == 0)
+					grain = std::max(1u, count / (4 * (GetWorkerCount() + 1)));
+				if(count <= grain)
+				{
+					body(begin, end);
+					return;
+				}
+
+				Counter::P counter = Counter::Create();
+				for(uint32_t first = begin + grain; first < end; first += std::min(grain, end - first))
+				{
+					uint32_t last = first + std::min(grain, end - first);
+					Submit([&body, first, last] { body(first, last); }, counter);
+				}
+				body(begin, begin + grain);
+				Wait(*counter);
+			}
+
+			uint32_t GetWorkerCount() const { return (uint32_t)workers.size(); }
+
+			/*
+			Index of the worker running the calling thread, or -1 for other threads
+			*/
+			int GetCurrentWorker() const;
+
+			Stats GetStats() const;
+			void ResetStats();
+
+			/*
+			One worker per hardware thread, minus one for the main thread
+			*/
+			static uint32_t DefaultWorkerCount();
+		};
+
+	}
+}
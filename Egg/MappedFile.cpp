@@ -0,0 +1,67 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+Egg::MappedFile::MappedFile(const std::string& path) {
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		Close();
+		return;
+	}
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mapping == nullptr) {
+		Close();
+		return;
+	}
+
+	view = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if(view == nullptr) {
+		Close();
+		return;
+	}
+	size = (size_t)fileSize.QuadPart;
+}
+
+Egg::MappedFile::~MappedFile() {
+	Close();
+}
+
+Egg::MappedFile::MappedFile(MappedFile&& other) noexcept :
+	file{ std::exchange(other.file, INVALID_HANDLE_VALUE) },
+	mapping{ std::exchange(other.mapping, nullptr) },
+	view{ std::exchange(other.view, nullptr) },
+	size{ std::exchange(other.size, 0) } {
+}
+
+Egg::MappedFile& Egg::MappedFile::operator=(MappedFile&& other) noexcept {
+	if(this != &other) {
+		Close();
+		file = std::exchange(other.file, INVALID_HANDLE_VALUE);
+		mapping = std::exchange(other.mapping, nullptr);
+		view = std::exchange(other.view, nullptr);
+		size = std::exchange(other.size, 0);
+	}
+	return *this;
+}
+
+void Egg::MappedFile::Close() {
+	if(view != nullptr) {
+		UnmapViewOfFile(view);
+		view = nullptr;
+	}
+	if(mapping != nullptr) {
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+	if(file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+	size = 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Common.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Egg {
+
+	/*
+	Read only view of a whole file mapped into memory, pages are read from disk (or the file cache) when first touched.
+	A file that does not exist, can not be opened or is empty gives an invalid view.
+	*/
+	class MappedFile {
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+		const uint8_t* view = nullptr;
+		size_t size = 0;
+
+		void Close();
+
+	public:
+		MappedFile() = default;
+		explicit MappedFile(const std::string& path);
+		~MappedFile();
+
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool IsValid() const { return view != nullptr; }
+		const uint8_t* GetData() const { return view; }
+		size_t GetSize() const { return size; }
+	};
+
+}
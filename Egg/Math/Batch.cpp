@@ -0,0 +1,213 @@
+#include "Batch.h"
+#include "Simd.h"
+
+namespace Egg {
+	namespace Math {
+		namespace Batch {
+
+#if EGG_MATH_SIMD
+			namespace {
+
+				// loads xyz without touching the memory after the element, w is undefined
+				inline __m128 LoadFloat3(const Float3& v)
+				{
+					__m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(&v.x)));
+					return _mm_movelh_ps(xy, _mm_load_ss(&v.z));
+				}
+
+				inline void StoreFloat3(Float3& v, __m128 r)
+				{
+					_mm_storel_pi(reinterpret_cast<__m64*>(&v.x), r);
+					_mm_store_ss(&v.z, EGG_SPLAT(r, 2));
+				}
+
+			}
+#endif
+
+			void Transform(const Float4x4& m, const Float4* in, Float4* out, size_t count) noexcept
+			{
+#if EGG_MATH_SIMD
+				const __m128 r0 = _mm_loadu_ps(m.m[0]);
+				const __m128 r1 = _mm_loadu_ps(m.m[1]);
+				const __m128 r2 = _mm_loadu_ps(m.m[2]);
+				const __m128 r3 = _mm_loadu_ps(m.m[3]);
+
+				for(size_t i = 0; i < count; i++)
+					_mm_storeu_ps(&out[i].x, Simd::Transform(_mm_loadu_ps(&in[i].x), r0, r1, r2, r3));
+#else
+				for(size_t i = 0; i < count; i++)
+					out[i] = m.Transform(in[i]);
+#endif
+			}
+
+			void TransformPoints(const Float4x4& m, const Float3* in, Float3* out, size_t count) noexcept
+			{
+#if EGG_MATH_SIMD
+				const __m128 r0 = _mm_loadu_ps(m.m[0]);
+				const __m128 r1 = _mm_loadu_ps(m.m[1]);
+				const __m128 r2 = _mm_loadu_ps(m.m[2]);
+				const __m128 r3 = _mm_loadu_ps(m.m[3]);
+
+				for(size_t i = 0; i < count; i++)
+				{
+					__m128 v = LoadFloat3(in[i]);
+					__m128 s = _mm_mul_ps(EGG_SPLAT(v, 0), r0);
+					s = _mm_add_ps(s, _mm_mul_ps(EGG_SPLAT(v, 1), r1));
+					s = _mm_add_ps(s, _mm_mul_ps(EGG_SPLAT(v, 2), r2));
+					s = _mm_add_ps(s, r3);
+					StoreFloat3(out[i], s);
+				}
+#else
+				for(size_t i = 0; i < count; i++)
+					out[i] = m.Transform(Float4{ in[i], 1.0f }).xyz;
+#endif
+			}
+
+			void TransformDirections(const Float4x4& m, const Float3* in, Float3* out, size_t count) noexcept
+			{
+#if EGG_MATH_SIMD
+				const __m128 r0 = _mm_loadu_ps(m.m[0]);
+				const __m128 r1 = _mm_loadu_ps(m.m[1]);
+				const __m128 r2 = _mm_loadu_ps(m.m[2]);
+
+				for(size_t i = 0; i < count; i++)
+				{
+					__m128 v = LoadFloat3(in[i]);
+					__m128 s = _mm_mul_ps(EGG_SPLAT(v, 0), r0);
+					s = _mm_add_ps(s, _mm_mul_ps(EGG_SPLAT(v, 1), r1));
+					s = _mm_add_ps(s, _mm_mul_ps(EGG_SPLAT(v, 2), r2));
+					StoreFloat3(out[i], s);
+				}
+#else
+				for(size_t i = 0; i < count; i++)
+					out[i] = m.Transform(Float4{ in[i], 0.0f }).xyz;
+#endif
+			}
+
+			void TransformPoints(
+				const Float4x4& m,
+				const float* x, const float* y, const float* z,
+				float* outX, float* outY, float* outZ,
+				size_t count) noexcept
+			{
+				size_t i = 0;
+#if EGG_MATH_SIMD
+				// four points per iteration, every matrix element is a splat
+				const __m128 m00 = _mm_set1_ps(m._00), m01 = _mm_set1_ps(m._01), m02 = _mm_set1_ps(m._02);
+				const __m128 m10 = _mm_set1_ps(m._10), m11 = _mm_set1_ps(m._11), m12 = _mm_set1_ps(m._12);
+				const __m128 m20 = _mm_set1_ps(m._20), m21 = _mm_set1_ps(m._21), m22 = _mm_set1_ps(m._22);
+				const __m128 m30 = _mm_set1_ps(m._30), m31 = _mm_set1_ps(m._31), m32 = _mm_set1_ps(m._32);
+
+				for(; i + 4 <= count; i += 4)
+				{
+					const __m128 vx = _mm_loadu_ps(x + i);
+					const __m128 vy = _mm_loadu_ps(y + i);
+					const __m128 vz = _mm_loadu_ps(z + i);
+
+					_mm_storeu_ps(outX + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m00), _mm_mul_ps(vy, m10)), _mm_mul_ps(vz, m20)), m30));
+					_mm_storeu_ps(outY + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m01), _mm_mul_ps(vy, m11)), _mm_mul_ps(vz, m21)), m31));
+					_mm_storeu_ps(outZ + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m02), _mm_mul_ps(vy, m12)), _mm_mul_ps(vz, m22)), m32));
+				}
+#endif
+				for(; i < count; i++)
+				{
+					const float vx = x[i], vy = y[i], vz = z[i];
+					outX[i] = vx * m._00 + vy * m._10 + vz * m._20 + m._30;
+					outY[i] = vx * m._01 + vy * m._11 + vz * m._21 + m._31;
+					outZ[i] = vx * m._02 + vy * m._12 + vz * m._22 + m._32;
+				}
+			}
+
+			void Mul(const Float4x4* a, const Float4x4* b, Float4x4* out, size_t count) noexcept
+			{
+#if EGG_MATH_SIMD
+				for(size_t i = 0; i < count; i++)
+				{
+					const __m128 b0 = _mm_loadu_ps(b[i].m[0]);
+					const __m128 b1 = _mm_loadu_ps(b[i].m[1]);
+					const __m128 b2 = _mm_loadu_ps(b[i].m[2]);
+					const __m128 b3 = _mm_loadu_ps(b[i].m[3]);
+
+					// all rows of a[i] are loaded before storing, out may alias either input
+					const __m128 p0 = Simd::Transform(_mm_loadu_ps(a[i].m[0]), b0, b1, b2, b3);
+					const __m128 p1 = Simd::Transform(_mm_loadu_ps(a[i].m[1]), b0, b1, b2, b3);
+					const __m128 p2 = Simd::Transform(_mm_loadu_ps(a[i].m[2]), b0, b1, b2, b3);
+					const __m128 p3 = Simd::Transform(_mm_loadu_ps(a[i].m[3]), b0, b1, b2, b3);
+
+					_mm_storeu_ps(out[i].m[0], p0);
+					_mm_storeu_ps(out[i].m[1], p1);
+					_mm_storeu_ps(out[i].m[2], p2);
+					_mm_storeu_ps(out[i].m[3], p3);
+				}
+#else
+				for(size_t i = 0; i < count; i++)
+					out[i] = a[i].Mul(b[i]);
+#endif
+			}
+
+			void Mul(const Float4x4* a, const Float4x4& b, Float4x4* out, size_t count) noexcept
+			{
+#if EGG_MATH_SIMD
+				const __m128 b0 = _mm_loadu_ps(b.m[0]);
+				const __m128 b1 = _mm_loadu_ps(b.m[1]);
+				const __m128 b2 = _mm_loadu_ps(b.m[2]);
+				const __m128 b3 = _mm_loadu_ps(b.m[3]);
+
+				for(size_t i = 0; i < count; i++)
+				{
+					const __m128 p0 = Simd::Transform(_mm_loadu_ps(a[i].m[0]), b0, b1, b2, b3);
+					const __m128 p1 = Simd::Transform(_mm_loadu_ps(a[i].m[1]), b0, b1, b2, b3);
+					const __m128 p2 = Simd::Transform(_mm_loadu_ps(a[i].m[2]), b0, b1, b2, b3);
+					const __m128 p3 = Simd::Transform(_mm_loadu_ps(a[i].m[3]), b0, b1, b2, b3);
+
+					_mm_storeu_ps(out[i].m[0], p0);
+					_mm_storeu_ps(out[i].m[1], p1);
+					_mm_storeu_ps(out[i].m[2], p2);
+					_mm_storeu_ps(out[i].m[3], p3);
+				}
+#else
+				for(size_t i = 0; i < count; i++)
+					out[i] = a[i].Mul(b);
+#endif
+			}
+
+			void RigidTransforms(
+				const Float4* orientations, const Float3* positions,
+				Float4x4* model, Float4x4* modelInverse,
+				size_t count) noexcept
+			{
+				// straight-line code without branches or trigonometry, one body per iteration
+				for(size_t i = 0; i < count; i++)
+				{
+					const float x = orientations[i].x, y = orientations[i].y, z = orientations[i].z, w = orientations[i].w;
+					const float tx = positions[i].x, ty = positions[i].y, tz = positions[i].z;
+
+					const float xx = x * x, yy = y * y, zz = z * z;
+					const float xy = x * y, xz = x * z, yz = y * z;
+					const float wx = w * x, wy = w * y, wz = w * z;
+
+					const float r00 = 1.0f - 2.0f * (yy + zz), r01 = 2.0f * (xy + wz), r02 = 2.0f * (xz - wy);
+					const float r10 = 2.0f * (xy - wz), r11 = 1.0f - 2.0f * (xx + zz), r12 = 2.0f * (yz + wx);
+					const float r20 = 2.0f * (xz + wy), r21 = 2.0f * (yz - wx), r22 = 1.0f - 2.0f * (xx + yy);
+
+					model[i] = Float4x4(
+						r00, r01, r02, 0.0f,
+						r10, r11, r12, 0.0f,
+						r20, r21, r22, 0.0f,
+						tx, ty, tz, 1.0f);
+
+					if(modelInverse)
+						modelInverse[i] = Float4x4(
+							r00, r10, r20, 0.0f,
+							r01, r11, r21, 0.0f,
+							r02, r12, r22, 0.0f,
+							-(tx * r00 + ty * r01 + tz * r02),
+							-(tx * r10 + ty * r11 + tz * r12),
+							-(tx * r20 + ty * r21 + tz * r22),
+							1.0f);
+				}
+			}
+
+		}
+	}
+}
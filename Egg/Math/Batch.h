@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Float3.h"
+#include "Float4.h"
+#include "Float4x4.h"
+#include <cstddef>
+
+/*
+Array versions of the Float4x4 operations, for transforming many elements by the same matrix in one call.
+All functions follow the row-vector convention of Float4x4::Transform (v * m) and allow in == out.
+*/
+namespace Egg {
+	namespace Math {
+		namespace Batch {
+
+			/*
+			out[i] = in[i] * m
+			*/
+			void Transform(const Float4x4& m, const Float4* in, Float4* out, size_t count) noexcept;
+
+			/*
+			out[i] = (in[i], 1) * m, the w component of the result is dropped (no perspective divide)
+			*/
+			void TransformPoints(const Float4x4& m, const Float3* in, Float3* out, size_t count) noexcept;
+
+			/*
+			out[i] = (in[i], 0) * m
+			*/
+			void TransformDirections(const Float4x4& m, const Float3* in, Float3* out, size_t count) noexcept;
+
+			/*
+			Structure-of-arrays version of TransformPoints, the fastest layout for large point clouds
+			*/
+			void TransformPoints(
+				const Float4x4& m,
+				const float* x, const float* y, const float* z,
+				float* outX, float* outY, float* outZ,
+				size_t count) noexcept;
+
+			/*
+			out[i] = a[i] * b[i]
+			*/
+			void Mul(const Float4x4* a, const Float4x4* b, Float4x4* out, size_t count) noexcept;
+
+			/*
+			out[i] = a[i] * b, e.g. model matrices times a shared view-projection matrix
+			*/
+			void Mul(const Float4x4* a, const Float4x4& b, Float4x4* out, size_t count) noexcept;
+
+			/*
+			Rigid body matrices from unit quaternions (x, y, z, w) and positions: rotation followed by translation,
+			the same as Float4x4::Rotation(axis, angle) * Float4x4::Translation(position).
+			The inverses are built directly from the transposed rotation, no general inversion is done.
+			modelInverse may be nullptr.
+			*/
+			void RigidTransforms(
+				const Float4* orientations, const Float3* positions,
+				Float4x4* model, Float4x4* modelInverse,
+				size_t count) noexcept;
+
+		}
+	}
+}
@@ -1,4 +1,5 @@
 #include "Float4x4.h"
+#include "Simd.h"
 
 namespace Egg {
 	namespace Math {
@@ -88,6 +89,15 @@ namespace Egg {
 		{
 			Float4x4 product;
 
+#if EGG_MATH_SIMD
+			const __m128 o0 = _mm_loadu_ps(o.m[0]);
+			const __m128 o1 = _mm_loadu_ps(o.m[1]);
+			const __m128 o2 = _mm_loadu_ps(o.m[2]);
+			const __m128 o3 = _mm_loadu_ps(o.m[3]);
+
+			for(int r = 0; r < 4; r++)
+				_mm_storeu_ps(product.m[r], Simd::Transform(_mm_loadu_ps(m[r]), o0, o1, o2, o3));
+#else
 			for(int r = 0; r < 4; r++)
 				for(int c = 0; c < 4; c++)
 					product.m[r][c] =
@@ -95,6 +105,7 @@ namespace Egg {
 					m[r][1] * o.m[1][c] +
 					m[r][2] * o.m[2][c] +
 					m[r][3] * o.m[3][c];
+#endif
 
 			return product;
 		}
@@ -123,17 +134,38 @@ namespace Egg {
 
 		Float4 Float4x4::Mul(const Float4& v) const noexcept
 		{
+#if EGG_MATH_SIMD
+			// the columns of the transpose are the rows, dot products become a row-vector transform
+			__m128 c0 = _mm_loadu_ps(m[0]);
+			__m128 c1 = _mm_loadu_ps(m[1]);
+			__m128 c2 = _mm_loadu_ps(m[2]);
+			__m128 c3 = _mm_loadu_ps(m[3]);
+			_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+			Float4 r;
+			_mm_storeu_ps(&r.x, Simd::Transform(_mm_loadu_ps(&v.x), c0, c1, c2, c3));
+			return r;
+#else
 			return Float4(v.Dot(*(Float4*)m[0]), v.Dot(*(Float4*)m[1]), v.Dot(*(Float4*)m[2]), v.Dot(*(Float4*)m[3]));
+#endif
 		}
 
 		Float4 Float4x4::Transform(const Float4& v) const noexcept
 		{
+#if EGG_MATH_SIMD
+			Float4 r;
+			_mm_storeu_ps(&r.x, Simd::Transform(
+				_mm_loadu_ps(&v.x),
+				_mm_loadu_ps(m[0]), _mm_loadu_ps(m[1]), _mm_loadu_ps(m[2]), _mm_loadu_ps(m[3])));
+			return r;
+#else
 			return Float4(
 				_00 * v.x + _10 * v.y + _20 * v.z + _30 * v.w,
 				_01 * v.x + _11 * v.y + _21 * v.z + _31 * v.w,
 				_02 * v.x + _12 * v.y + _22 * v.z + _32 * v.w,
 				_03 * v.x + _13 * v.y + _23 * v.z + _33 * v.w
 			);
+#endif
 		}
 
 		Float4 Float4x4::operator*(const Float4& v) const noexcept
@@ -245,8 +277,95 @@ namespace Egg {
 				_03, _13, _23, _33);
 		}
 
+#if EGG_MATH_SIMD
+		namespace {
+
+			// 2x2 blocks are stored row major in one register: (a00, a01, a10, a11)
+
+			// A * B
+			inline __m128 Mat2Mul(__m128 a, __m128 b)
+			{
+				return _mm_add_ps(
+					_mm_mul_ps(a, EGG_SHUFFLE(b, 0, 3, 0, 3)),
+					_mm_mul_ps(EGG_SHUFFLE(a, 1, 0, 3, 2), EGG_SHUFFLE(b, 2, 1, 2, 1)));
+			}
+
+			// adj(A) * B
+			inline __m128 Mat2AdjMul(__m128 a, __m128 b)
+			{
+				return _mm_sub_ps(
+					_mm_mul_ps(EGG_SHUFFLE(a, 3, 3, 0, 0), b),
+					_mm_mul_ps(EGG_SHUFFLE(a, 1, 1, 2, 2), EGG_SHUFFLE(b, 2, 3, 0, 1)));
+			}
+
+			// A * adj(B)
+			inline __m128 Mat2MulAdj(__m128 a, __m128 b)
+			{
+				return _mm_sub_ps(
+					_mm_mul_ps(a, EGG_SHUFFLE(b, 3, 0, 3, 0)),
+					_mm_mul_ps(EGG_SHUFFLE(a, 1, 0, 3, 2), EGG_SHUFFLE(b, 2, 1, 2, 1)));
+			}
+
+		}
+#endif
+
 		Float4x4 Float4x4::_Invert() const noexcept
 		{
+#if EGG_MATH_SIMD
+			/* Block-wise inverse: M = | A B |, with 2x2 blocks A, B, C, D. */
+			/*                         | C D |                              */
+			const __m128 r0 = _mm_loadu_ps(m[0]);
+			const __m128 r1 = _mm_loadu_ps(m[1]);
+			const __m128 r2 = _mm_loadu_ps(m[2]);
+			const __m128 r3 = _mm_loadu_ps(m[3]);
+
+			__m128 A = _mm_movelh_ps(r0, r1);
+			__m128 B = _mm_movehl_ps(r1, r0);
+			__m128 C = _mm_movelh_ps(r2, r3);
+			__m128 D = _mm_movehl_ps(r3, r2);
+
+			/* (|A|, |B|, |C|, |D|) */
+			__m128 detSub = _mm_sub_ps(
+				_mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+				_mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+			__m128 detA = EGG_SPLAT(detSub, 0);
+			__m128 detB = EGG_SPLAT(detSub, 1);
+			__m128 detC = EGG_SPLAT(detSub, 2);
+			__m128 detD = EGG_SPLAT(detSub, 3);
+
+			__m128 D_C = Mat2AdjMul(D, C);
+			__m128 A_B = Mat2AdjMul(A, B);
+
+			/* adjugates of the inverse blocks, scaled by |M| */
+			__m128 X_ = _mm_sub_ps(_mm_mul_ps(detD, A), Mat2Mul(B, D_C));
+			__m128 W_ = _mm_sub_ps(_mm_mul_ps(detA, D), Mat2Mul(C, A_B));
+			__m128 Y_ = _mm_sub_ps(_mm_mul_ps(detB, C), Mat2MulAdj(D, A_B));
+			__m128 Z_ = _mm_sub_ps(_mm_mul_ps(detC, B), Mat2MulAdj(A, D_C));
+
+			/* |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C) */
+			__m128 tr = _mm_mul_ps(A_B, EGG_SHUFFLE(D_C, 0, 2, 1, 3));
+			tr = _mm_add_ps(tr, EGG_SHUFFLE(tr, 2, 3, 0, 1));
+			tr = _mm_add_ps(tr, EGG_SHUFFLE(tr, 1, 0, 3, 2));
+			__m128 detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+
+			/* Run singularity test. */
+			if(_mm_cvtss_f32(detM) == 0.0f)
+				return Identity;
+
+			__m128 rDetM = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM);
+			X_ = _mm_mul_ps(X_, rDetM);
+			Y_ = _mm_mul_ps(Y_, rDetM);
+			Z_ = _mm_mul_ps(Z_, rDetM);
+			W_ = _mm_mul_ps(W_, rDetM);
+
+			/* adjugate shuffle and store shuffle in one go */
+			Float4x4 inv;
+			_mm_storeu_ps(inv.m[0], _mm_shuffle_ps(X_, Y_, _MM_SHUFFLE(1, 3, 1, 3)));
+			_mm_storeu_ps(inv.m[1], _mm_shuffle_ps(X_, Y_, _MM_SHUFFLE(0, 2, 0, 2)));
+			_mm_storeu_ps(inv.m[2], _mm_shuffle_ps(Z_, W_, _MM_SHUFFLE(1, 3, 1, 3)));
+			_mm_storeu_ps(inv.m[3], _mm_shuffle_ps(Z_, W_, _MM_SHUFFLE(0, 2, 0, 2)));
+			return inv;
+#else
 			float det;
 			float d10, d20, d21, d31, d32, d03;
 			Float4x4 inv;
@@ -307,6 +426,7 @@ namespace Egg {
 
 				return inv;
 			}
+#endif
 		}
 
 		Float4x4 Float4x4::Invert() const noexcept
@@ -318,6 +438,45 @@ namespace Egg {
 				return _Invert();
 			}
 
+#if EGG_MATH_SIMD
+			/* Affine: the 3x3 part is inverted by cofactors (cross products of its rows), */
+			/* the translation row is transformed by that inverse and negated. */
+			const __m128 r0 = _mm_loadu_ps(m[0]);
+			const __m128 r1 = _mm_loadu_ps(m[1]);
+			const __m128 r2 = _mm_loadu_ps(m[2]);
+			const __m128 r3 = _mm_loadu_ps(m[3]);
+
+			__m128 c0 = Simd::Cross(r1, r2);
+			__m128 c1 = Simd::Cross(r2, r0);
+			__m128 c2 = Simd::Cross(r0, r1);
+			__m128 c3 = _mm_setzero_ps();
+
+			/* Compute determinant as early as possible using these cofactors. */
+			__m128 d = _mm_mul_ps(r0, c0);
+			det = _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(d, EGG_SPLAT(d, 1)), EGG_SPLAT(d, 2)));
+
+			/* Run singularity test. */
+			if(det == 0.0f)
+				return Identity;
+
+			_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+			const __m128 invDet = _mm_set1_ps(1.0f / det);
+			c0 = _mm_mul_ps(c0, invDet);
+			c1 = _mm_mul_ps(c1, invDet);
+			c2 = _mm_mul_ps(c2, invDet);
+
+			__m128 t = _mm_mul_ps(EGG_SPLAT(r3, 0), c0);
+			t = _mm_add_ps(t, _mm_mul_ps(EGG_SPLAT(r3, 1), c1));
+			t = _mm_add_ps(t, _mm_mul_ps(EGG_SPLAT(r3, 2), c2));
+			t = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), t);
+
+			Float4x4 inv;
+			_mm_storeu_ps(inv.m[0], c0);
+			_mm_storeu_ps(inv.m[1], c1);
+			_mm_storeu_ps(inv.m[2], c2);
+			_mm_storeu_ps(inv.m[3], t);
+			return inv;
+#else
 			Float4x4 inv;
 
 			/* Inverse = adjoint / det. */
@@ -376,6 +535,7 @@ namespace Egg {
 
 				return inv;
 			}
+#endif
 		}
 
 	}
@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+SSE code paths are used for the hot matrix operations on every x64 target (SSE2 is part of the x64 baseline).
+Define EGG_MATH_NO_SIMD to force the portable scalar implementations, e.g. to compare results or timings.
+*/
+#if !defined(EGG_MATH_NO_SIMD) && (defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define EGG_MATH_SIMD 1
+#include <emmintrin.h>
+#else
+#define EGG_MATH_SIMD 0
+#endif
+
+#if EGG_MATH_SIMD
+
+#define EGG_SHUFFLE(v, x, y, z, w) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(w, z, y, x))
+#define EGG_SPLAT(v, i) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(i, i, i, i))
+
+namespace Egg {
+	namespace Math {
+		namespace Simd {
+
+			/*
+			Row-vector times matrix, the matrix given as its four rows: v.x * r0 + v.y * r1 + v.z * r2 + v.w * r3
+			The sums are evaluated in the same order as the scalar code, so results match it exactly.
+			*/
+			inline __m128 Transform(__m128 v, __m128 r0, __m128 r1, __m128 r2, __m128 r3)
+			{
+				__m128 s = _mm_mul_ps(EGG_SPLAT(v, 0), r0);
+				s = _mm_add_ps(s, _mm_mul_ps(EGG_SPLAT(v, 1), r1));
+				s = _mm_add_ps(s, _mm_mul_ps(EGG_SPLAT(v, 2), r2));
+				s = _mm_add_ps(s, _mm_mul_ps(EGG_SPLAT(v, 3), r3));
+				return s;
+			}
+
+			/*
+			Cross product of the xyz parts, w of the result is 0 if both w-s are finite
+			*/
+			inline __m128 Cross(__m128 a, __m128 b)
+			{
+				return _mm_sub_ps(
+					_mm_mul_ps(EGG_SHUFFLE(a, 1, 2, 0, 3), EGG_SHUFFLE(b, 2, 0, 1, 3)),
+					_mm_mul_ps(EGG_SHUFFLE(a, 2, 0, 1, 3), EGG_SHUFFLE(b, 1, 2, 0, 3)));
+			}
+
+		}
+	}
+}
+
+#endif
@@ -1,9 +1,10 @@
 #define basicRootSig "RootFlags( ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT )," \
-					  "CBV(b0), CBV(b1),"\
+					  "CBV(b0), RootConstants(num32BitConstants=1, b1),"\
 					  "DescriptorTable("\
 							"SRV(t0, numDescriptors=1)"\
 					  "), "\
+					  "SRV(t1), SRV(t2), SRV(t3), SRV(t4), SRV(t5),"\
 					  "StaticSampler(s0)"
 
 #define lightRootSig "RootFlags( ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT )," \
-					  "CBV(b0), CBV(b1)"
+					  "CBV(b0), RootConstants(num32BitConstants=1, b1), SRV(t1), SRV(t3)"
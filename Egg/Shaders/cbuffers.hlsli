@@ -1,17 +1,53 @@
+// position.w is 1 / range^2, the light does not reach farther than its range
 struct Light
 {
 	float4 position, color;
 };
 
+struct PerObject
+{
+	float4x4 modelMat;
+	float4x4 modelMatInv;
+};
+
 cbuffer PerFrameCb : register(b0) {
 	float4x4 viewProjMat;
 	float4x4 rayDirTransform;
 	float4 eyePos;
-	Light lights[64];
-	int nrLights;
+	// log2(view depth) * x + y is the depth slice of the light clusters
+	float4 clusterDepth;
+	// tiles across, tiles down and depth slices of the light clusters
+	uint4 clusterCounts;
 }
 
-cbuffer PerObjectCb : register(b1) {
-	float4x4 modelMat;
-	float4x4 modelMatInv;
+// first element of the draw's instances in the instances buffer
+cbuffer PerDrawCb : register(b1) {
+	uint instanceBase;
+}
+
+StructuredBuffer<PerObject> objects : register(t1);
+StructuredBuffer<Light> lights : register(t2);
+// objects buffer index of every instance drawn this frame
+StructuredBuffer<uint> instances : register(t3);
+// offset and count of the lights of every cluster in clusterLights
+StructuredBuffer<uint2> clusterRanges : register(t4);
+// lights buffer indices
+StructuredBuffer<uint> clusterLights : register(t5);
+
+PerObject GetObject(uint instanceID)
+{
+	return objects[instances[instanceBase + instanceID]];
+}
+
+// index of the light cluster (Egg/Cull/LightClusters.h) a point is in
+uint GetCluster(float4 worldPosition)
+{
+	float4 clip = mul(viewProjMat, worldPosition);
+	float2 ndc = clip.xy / clip.w;
+	float3 cell = float3(
+		(ndc.x + 1.0f) * 0.5f * clusterCounts.x,
+		(1.0f - ndc.y) * 0.5f * clusterCounts.y,
+		log2(clip.w) * clusterDepth.x + clusterDepth.y);
+	uint3 c = (uint3)clamp(floor(cell), 0.0f, float3(clusterCounts.xyz - 1));
+	return (c.z * clusterCounts.y + c.y) * clusterCounts.x + c.x;
 }
\ No newline at end of file
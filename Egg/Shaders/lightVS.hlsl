@@ -12,11 +12,12 @@ struct VSOutput {
 };
 
 [RootSignature(lightRootSig)]
-VSOutput main(IAOutput iao) {
+VSOutput main(IAOutput iao, uint instanceID : SV_InstanceID) {
 	VSOutput vso;
+	PerObject object = GetObject(instanceID);
 	vso.position = mul(
 		viewProjMat, mul(
-			modelMat, float4(iao.position, 1.0f)
+			object.modelMat, float4(iao.position, 1.0f)
 		)
 	);
 	return vso;
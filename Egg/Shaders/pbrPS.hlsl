@@ -15,6 +15,14 @@ Texture2D baseTxt : register(t0);
 SamplerState sampl : register(s0);
 
 
+// fades the light to 0 at its range, so it can be left out of the clusters it does not reach
+float SmoothDistanceAtt(float sqrDist, float invSqrRange)
+{
+	float factor = sqrDist * invSqrRange;
+	float smoothFactor = saturate(1.0f - factor * factor);
+	return smoothFactor * smoothFactor;
+}
+
 // sry its pretty messy rn, been experimenting with it a lot
 [RootSignature(basicRootSig)]
 float4 main(VSOutput input) : SV_Target
@@ -38,13 +46,17 @@ float4 main(VSOutput input) : SV_Target
 
 	float NdotV = abs(dot(N, V)) + 1e-5f; // avoid artifact (?)
 
+	// only the lights reaching the cluster of the pixel
+	uint2 range = clusterRanges[GetCluster(input.worldPosition)];
+
 	float3 res = float3(0, 0, 0);
-	for (int i = 0; i < nrLights; i++)
+	for (uint j = 0; j < range.y; j++)
 	{
-		float3 Lunnormalized = lights[i].position - input.worldPosition;
+		Light light = lights[clusterLights[range.x + j]];
+		float3 Lunnormalized = light.position.xyz - input.worldPosition.xyz;
 		float3 L = normalize(Lunnormalized);
 		float sqrDist = dot(Lunnormalized, Lunnormalized);
-		float illuminance = 10.f * (1.f / sqrDist);
+		float illuminance = 10.f * (1.f / sqrDist) * SmoothDistanceAtt(sqrDist, light.position.w);
 
 		float3 H = normalize(V + L);
 		float LdotH = saturate(dot(L, H));
@@ -63,7 +75,7 @@ float4 main(VSOutput input) : SV_Target
 		res += 
 			illuminance * NdotL * 
 			(
-				(Fd + Fr) * baseColorMap * lights[i].color.rgb
+				(Fd + Fr) * baseColorMap * light.color.rgb
 			);
 	}
 
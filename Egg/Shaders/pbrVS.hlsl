@@ -3,11 +3,12 @@
 #include "cbuffers.hlsli"
 
 [RootSignature(basicRootSig)]
-VSOutput main(IAOutput iao) {
+VSOutput main(IAOutput iao, uint instanceID : SV_InstanceID) {
 	VSOutput vso;
-	vso.worldPosition = mul(modelMat, float4(iao.position, 1.0f));
+	PerObject object = GetObject(instanceID);
+	vso.worldPosition = mul(object.modelMat, float4(iao.position, 1.0f));
 	vso.position = mul(viewProjMat, vso.worldPosition);
-	vso.normal = mul(float4(iao.normal, 0.0f), modelMatInv);
+	vso.normal = mul(float4(iao.normal, 0.0f), object.modelMatInv);
 	vso.texCoord = iao.texCoord;
 	return vso;
 }
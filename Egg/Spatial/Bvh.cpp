@@ -0,0 +1,684 @@
+#include "Bvh.h"
+#include "../Math/Simd.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+using Egg::Cull::Aabb;
+using Egg::Math::Float3;
+
+namespace Egg {
+	namespace Spatial {
+
+		namespace {
+
+			constexpr uint32_t BinCount = 12;
+
+			Aabb EmptyBox()
+			{
+				return Aabb{ Float3{ FLT_MAX, FLT_MAX, FLT_MAX }, Float3{ -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+			}
+
+			// component-wise, the Float3 constructors are not inline and these run for every item on every level of the build
+			void Grow(Aabb& a, const Aabb& b)
+			{
+				a.min.x = std::min(a.min.x, b.min.x); a.min.y = std::min(a.min.y, b.min.y); a.min.z = std::min(a.min.z, b.min.z);
+				a.max.x = std::max(a.max.x, b.max.x); a.max.y = std::max(a.max.y, b.max.y); a.max.z = std::max(a.max.z, b.max.z);
+			}
+
+			void Grow(Aabb& a, const Float3& p)
+			{
+				a.min.x = std::min(a.min.x, p.x); a.min.y = std::min(a.min.y, p.y); a.min.z = std::min(a.min.z, p.z);
+				a.max.x = std::max(a.max.x, p.x); a.max.y = std::max(a.max.y, p.y); a.max.z = std::max(a.max.z, p.z);
+			}
+
+			// half the surface area, only ratios of it are used
+			float HalfArea(const Aabb& a)
+			{
+				const float dx = std::max(a.max.x - a.min.x, 0.0f);
+				const float dy = std::max(a.max.y - a.min.y, 0.0f);
+				const float dz = std::max(a.max.z - a.min.z, 0.0f);
+				return dx * dy + dy * dz + dz * dx;
+			}
+
+			float Component(const Float3& v, int axis)
+			{
+				return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+			}
+
+			bool Overlaps(const Aabb& a, const Aabb& b)
+			{
+				return a.min.x <= b.max.x && a.max.x >= b.min.x
+					&& a.min.y <= b.max.y && a.max.y >= b.min.y
+					&& a.min.z <= b.max.z && a.max.z >= b.min.z;
+			}
+
+			bool Overlaps(const Aabb& a, const Egg::Cull::Sphere& s)
+			{
+				const float dx = std::max(std::max(a.min.x - s.center.x, s.center.x - a.max.x), 0.0f);
+				const float dy = std::max(std::max(a.min.y - s.center.y, s.center.y - a.max.y), 0.0f);
+				const float dz = std::max(std::max(a.min.z - s.center.z, s.center.z - a.max.z), 0.0f);
+				return dx * dx + dy * dy + dz * dz <= s.radius * s.radius;
+			}
+
+			// slab test, the entry distance is written to t
+			bool RayBox(const Aabb& a, const Float3& origin, const Float3& invDirection, float maxDistance, float& t)
+			{
+				const float tx1 = (a.min.x - origin.x) * invDirection.x, tx2 = (a.max.x - origin.x) * invDirection.x;
+				const float ty1 = (a.min.y - origin.y) * invDirection.y, ty2 = (a.max.y - origin.y) * invDirection.y;
+				const float tz1 = (a.min.z - origin.z) * invDirection.z, tz2 = (a.max.z - origin.z) * invDirection.z;
+				const float tNear = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+				const float tFar = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), maxDistance));
+				t = tNear;
+				return tNear <= tFar;
+			}
+
+			/*
+			Four lane tests of a node, each returns a mask with bit i set for lane i.
+			Templates, so they can take the private node type.
+			*/
+
+			template<typename Node>
+			int ValidMask(const Node& node)
+			{
+				int mask = 0;
+				for(uint32_t lane = 0; lane < 4; lane++)
+					mask |= (node.child[lane] != 0xffffffffu) << lane;
+				return mask;
+			}
+
+			template<typename Node>
+			int OverlapMask(const Node& node, const Aabb& box)
+			{
+#if EGG_MATH_SIMD
+				__m128 m = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minX), _mm_set1_ps(box.max.x)), _mm_cmpge_ps(_mm_load_ps(node.maxX), _mm_set1_ps(box.min.x)));
+				m = _mm_and_ps(m, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minY), _mm_set1_ps(box.max.y)), _mm_cmpge_ps(_mm_load_ps(node.maxY), _mm_set1_ps(box.min.y))));
+				m = _mm_and_ps(m, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minZ), _mm_set1_ps(box.max.z)), _mm_cmpge_ps(_mm_load_ps(node.maxZ), _mm_set1_ps(box.min.z))));
+				return _mm_movemask_ps(m) & ValidMask(node);
+#else
+				int mask = 0;
+				for(uint32_t lane = 0; lane < 4; lane++)
+				{
+					const Aabb a{ Float3{ node.minX[lane], node.minY[lane], node.minZ[lane] }, Float3{ node.maxX[lane], node.maxY[lane], node.maxZ[lane] } };
+					mask |= Overlaps(a, box) << lane;
+				}
+				return mask & ValidMask(node);
+#endif
+			}
+
+			template<typename Node>
+			int SphereMask(const Node& node, const Egg::Cull::Sphere& sphere)
+			{
+#if EGG_MATH_SIMD
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 cx = _mm_set1_ps(sphere.center.x), cy = _mm_set1_ps(sphere.center.y), cz = _mm_set1_ps(sphere.center.z);
+				const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minX), cx), _mm_sub_ps(cx, _mm_load_ps(node.maxX))), zero);
+				const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minY), cy), _mm_sub_ps(cy, _mm_load_ps(node.maxY))), zero);
+				const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(node.minZ), cz), _mm_sub_ps(cz, _mm_load_ps(node.maxZ))), zero);
+				const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				return _mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_set1_ps(sphere.radius * sphere.radius))) & ValidMask(node);
+#else
+				int mask = 0;
+				for(uint32_t lane = 0; lane < 4; lane++)
+				{
+					const Aabb a{ Float3{ node.minX[lane], node.minY[lane], node.minZ[lane] }, Float3{ node.maxX[lane], node.maxY[lane], node.maxZ[lane] } };
+					mask |= Overlaps(a, sphere) << lane;
+				}
+				return mask & ValidMask(node);
+#endif
+			}
+
+			/*
+			Lanes touching the frustum, insideMask gets the lanes entirely inside it.
+			For each plane, the corner furthest along the normal decides if the box is outside, the nearest one if it is inside.
+			*/
+			template<typename Node>
+			int FrustumMask(const Node& node, const Egg::Cull::Frustum& frustum, int& insideMask)
+			{
+#if EGG_MATH_SIMD
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 minX = _mm_load_ps(node.minX), minY = _mm_load_ps(node.minY), minZ = _mm_load_ps(node.minZ);
+				const __m128 maxX = _mm_load_ps(node.maxX), maxY = _mm_load_ps(node.maxY), maxZ = _mm_load_ps(node.maxZ);
+				__m128 outside = zero, crossing = zero;
+				for(uint32_t p = 0; p < 6; p++)
+				{
+					const Egg::Math::Float4& plane = frustum.GetPlane(p);
+					const __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z), w = _mm_set1_ps(plane.w);
+					const __m128 far = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(nx, plane.x >= 0.0f ? maxX : minX),
+						_mm_mul_ps(ny, plane.y >= 0.0f ? maxY : minY)),
+						_mm_mul_ps(nz, plane.z >= 0.0f ? maxZ : minZ)), w);
+					const __m128 near = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(nx, plane.x >= 0.0f ? minX : maxX),
+						_mm_mul_ps(ny, plane.y >= 0.0f ? minY : maxY)),
+						_mm_mul_ps(nz, plane.z >= 0.0f ? minZ : maxZ)), w);
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(far, zero));
+					crossing = _mm_or_ps(crossing, _mm_cmplt_ps(near, zero));
+				}
+				const int valid = ValidMask(node);
+				const int visible = ~_mm_movemask_ps(outside) & valid;
+				insideMask = visible & ~_mm_movemask_ps(crossing);
+				return visible;
+#else
+				int visible = 0, inside = 0;
+				for(uint32_t lane = 0; lane < 4; lane++)
+				{
+					bool isOutside = false, isCrossing = false;
+					for(uint32_t p = 0; p < 6; p++)
+					{
+						const Egg::Math::Float4& plane = frustum.GetPlane(p);
+						const float far = plane.x * (plane.x >= 0.0f ? node.maxX[lane] : node.minX[lane])
+							+ plane.y * (plane.y >= 0.0f ? node.maxY[lane] : node.minY[lane])
+							+ plane.z * (plane.z >= 0.0f ? node.maxZ[lane] : node.minZ[lane]) + plane.w;
+						const float near = plane.x * (plane.x >= 0.0f ? node.minX[lane] : node.maxX[lane])
+							+ plane.y * (plane.y >= 0.0f ? node.minY[lane] : node.maxY[lane])
+							+ plane.z * (plane.z >= 0.0f ? node.minZ[lane] : node.maxZ[lane]) + plane.w;
+						isOutside |= far < 0.0f;
+						isCrossing |= near < 0.0f;
+					}
+					visible |= !isOutside << lane;
+					inside |= (!isOutside && !isCrossing) << lane;
+				}
+				const int valid = ValidMask(node);
+				insideMask = inside & valid;
+				return visible & valid;
+#endif
+			}
+
+			template<typename Node>
+			int RayMask(const Node& node, const Float3& origin, const Float3& invDirection, float maxDistance, float* tNear)
+			{
+#if EGG_MATH_SIMD
+				const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+				const __m128 ix = _mm_set1_ps(invDirection.x), iy = _mm_set1_ps(invDirection.y), iz = _mm_set1_ps(invDirection.z);
+				const __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix), tx2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+				const __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy), ty2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+				const __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz), tz2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+				const __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_max_ps(_mm_min_ps(tz1, tz2), _mm_setzero_ps()));
+				const __m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_min_ps(_mm_max_ps(tz1, tz2), _mm_set1_ps(maxDistance)));
+				_mm_storeu_ps(tNear, enter);
+				return _mm_movemask_ps(_mm_cmple_ps(enter, exit)) & ValidMask(node);
+#else
+				int mask = 0;
+				for(uint32_t lane = 0; lane < 4; lane++)
+				{
+					const Aabb a{ Float3{ node.minX[lane], node.minY[lane], node.minZ[lane] }, Float3{ node.maxX[lane], node.maxY[lane], node.maxZ[lane] } };
+					mask |= RayBox(a, origin, invDirection, maxDistance, tNear[lane]) << lane;
+				}
+				return mask & ValidMask(node);
+#endif
+			}
+
+		}
+
+		void Bvh::SetLane(Node& node, uint32_t lane, const Aabb& box)
+		{
+			node.minX[lane] = box.min.x; node.minY[lane] = box.min.y; node.minZ[lane] = box.min.z;
+			node.maxX[lane] = box.max.x; node.maxY[lane] = box.max.y; node.maxZ[lane] = box.max.z;
+		}
+
+		Aabb Bvh::GetLaneBox(const Node& node, uint32_t lane) const
+		{
+			return Aabb{
+				Float3{ node.minX[lane], node.minY[lane], node.minZ[lane] },
+				Float3{ node.maxX[lane], node.maxY[lane], node.maxZ[lane] } };
+		}
+
+		Aabb Bvh::GetNodeBox(const Node& node) const
+		{
+			// empty lanes hold an inverted box, which leaves the union as it is
+			Aabb box = EmptyBox();
+			for(uint32_t lane = 0; lane < Width; lane++)
+			{
+				box.min.x = std::min(box.min.x, node.minX[lane]); box.min.y = std::min(box.min.y, node.minY[lane]); box.min.z = std::min(box.min.z, node.minZ[lane]);
+				box.max.x = std::max(box.max.x, node.maxX[lane]); box.max.y = std::max(box.max.y, node.maxY[lane]); box.max.z = std::max(box.max.z, node.maxZ[lane]);
+			}
+			return box;
+		}
+
+		void Bvh::Build(const Aabb* boxes, uint32_t count)
+		{
+			this->boxes.assign(boxes, boxes + count);
+			nodes.clear();
+			leafItems.resize(count);
+			std::iota(leafItems.begin(), leafItems.end(), 0u);
+			nodeOfItem.assign(count, Empty);
+			laneOfItem.assign(count, 0);
+
+			centroids.resize(count);
+			for(uint32_t i = 0; i < count; i++)
+				centroids[i] = boxes[i].GetCenter();
+
+			if(count > 0)
+			{
+				buildNodes.clear();
+				buildNodes.reserve(2 * count);
+				const uint32_t root = BuildRecursive(0, count, 0);
+				nodes.reserve(count / 2 + 1);
+				Collapse(root, Empty, 0);
+				buildNodes.clear();
+			}
+
+			dirty.assign(nodes.size(), 0);
+		}
+
+		uint32_t Bvh::BuildRecursive(uint32_t first, uint32_t count, uint32_t depth)
+		{
+			const uint32_t index = (uint32_t)buildNodes.size();
+			buildNodes.push_back(BuildNode{ EmptyBox(), Empty, Empty, first, count });
+
+			Aabb box = EmptyBox();
+			Aabb centroidBox = EmptyBox();
+			for(uint32_t i = first; i < first + count; i++)
+			{
+				Grow(box, boxes[leafItems[i]]);
+				Grow(centroidBox, centroids[leafItems[i]]);
+			}
+			buildNodes[index].box = box;
+
+			if(count == 1)
+				return index;
+
+			const Float3 extent = centroidBox.max - centroidBox.min;
+			const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+			const float axisMin = Component(centroidBox.min, axis);
+			const float axisExtent = Component(extent, axis);
+
+			uint32_t* items = leafItems.data() + first;
+			uint32_t leftCount = 0;
+
+			if(axisExtent > 0.0f && depth < MaxDepth)
+			{
+				// binned sah: the split between bins that minimizes area * items on both sides
+				Aabb binBoxes[BinCount];
+				uint32_t binCounts[BinCount] = {};
+				std::fill(binBoxes, binBoxes + BinCount, EmptyBox());
+
+				const float scale = (float)BinCount / axisExtent;
+				auto binOf = [&](uint32_t item) {
+					return std::min(BinCount - 1, (uint32_t)((Component(centroids[item], axis) - axisMin) * scale));
+				};
+				for(uint32_t i = 0; i < count; i++)
+				{
+					const uint32_t bin = binOf(items[i]);
+					binCounts[bin]++;
+					Grow(binBoxes[bin], boxes[items[i]]);
+				}
+
+				float rightCosts[BinCount];
+				Aabb rightBox = EmptyBox();
+				uint32_t rightCount = 0;
+				for(uint32_t bin = BinCount - 1; bin > 0; bin--)
+				{
+					Grow(rightBox, binBoxes[bin]);
+					rightCount += binCounts[bin];
+					rightCosts[bin] = HalfArea(rightBox) * (float)rightCount;
+				}
+
+				float bestCost = FLT_MAX;
+				uint32_t bestBin = 0;
+				Aabb leftBox = EmptyBox();
+				uint32_t runningCount = 0;
+				for(uint32_t bin = 0; bin + 1 < BinCount; bin++)
+				{
+					Grow(leftBox, binBoxes[bin]);
+					runningCount += binCounts[bin];
+					const float cost = HalfArea(leftBox) * (float)runningCount + rightCosts[bin + 1];
+					if(runningCount > 0 && runningCount < count && cost < bestCost)
+					{
+						bestCost = cost;
+						bestBin = bin;
+					}
+				}
+
+				// a node costs one traversal step plus the tests of its children, a leaf the tests of its items
+				const float leafCost = HalfArea(box) * (float)count;
+				if(count <= MaxLeafSize && leafCost <= HalfArea(box) + bestCost)
+					return index;
+
+				leftCount = (uint32_t)(std::partition(items, items + count, [&](uint32_t item) { return binOf(item) <= bestBin; }) - items);
+			}
+			else if(count <= MaxLeafSize)
+			{
+				return index;
+			}
+
+			// all centroids in the same place, too deep, or no useful split: halves by the centroids
+			if(leftCount == 0 || leftCount == count)
+			{
+				leftCount = count / 2;
+				std::nth_element(items, items + leftCount, items + count, [&](uint32_t a, uint32_t b) {
+					return Component(centroids[a], axis) < Component(centroids[b], axis);
+				});
+			}
+
+			const uint32_t left = BuildRecursive(first, leftCount, depth + 1);
+			const uint32_t right = BuildRecursive(first + leftCount, count - leftCount, depth + 1);
+			buildNodes[index].left = left;
+			buildNodes[index].right = right;
+			return index;
+		}
+
+		uint32_t Bvh::Collapse(uint32_t buildNode, uint32_t parent, uint32_t parentLane)
+		{
+			const uint32_t index = (uint32_t)nodes.size();
+			nodes.emplace_back();
+			{
+				Node& node = nodes[index];
+				for(uint32_t lane = 0; lane < Width; lane++)
+				{
+					SetLane(node, lane, EmptyBox());
+					node.child[lane] = Empty;
+					node.count[lane] = 0;
+				}
+				node.parent = parent;
+				node.parentLane = parentLane;
+			}
+
+			// the children of the binary node, then the biggest inner child is replaced by its children until there are four
+			uint32_t children[Width];
+			uint32_t childCount = 0;
+			const BuildNode& b = buildNodes[buildNode];
+			if(b.left == Empty)
+			{
+				children[childCount++] = buildNode;
+			}
+			else
+			{
+				children[childCount++] = b.left;
+				children[childCount++] = b.right;
+				while(childCount < Width)
+				{
+					int biggest = -1;
+					float biggestArea = -1.0f;
+					for(uint32_t c = 0; c < childCount; c++)
+					{
+						const BuildNode& child = buildNodes[children[c]];
+						if(child.left != Empty && HalfArea(child.box) > biggestArea)
+						{
+							biggest = (int)c;
+							biggestArea = HalfArea(child.box);
+						}
+					}
+					if(biggest < 0)
+						break;
+					const BuildNode& expanded = buildNodes[children[biggest]];
+					children[biggest] = expanded.left;
+					children[childCount++] = expanded.right;
+				}
+			}
+
+			for(uint32_t lane = 0; lane < childCount; lane++)
+			{
+				const BuildNode& child = buildNodes[children[lane]];
+				SetLane(nodes[index], lane, child.box);
+				if(child.left == Empty)
+				{
+					nodes[index].child[lane] = LeafBit | child.first;
+					nodes[index].count[lane] = child.count;
+					for(uint32_t slot = child.first; slot < child.first + child.count; slot++)
+					{
+						nodeOfItem[leafItems[slot]] = index;
+						laneOfItem[leafItems[slot]] = (uint8_t)lane;
+					}
+				}
+				else
+				{
+					// nodes may reallocate in the call, the result is stored through the index
+					const uint32_t childNode = Collapse(children[lane], index, lane);
+					nodes[index].child[lane] = childNode;
+				}
+			}
+			return index;
+		}
+
+		void Bvh::Refit(const Aabb* boxes, const uint32_t* changed, size_t changedCount)
+		{
+			if(nodes.empty() || changedCount == 0)
+				return;
+
+			// low four bits: leaf lanes whose items moved, bit 4: an inner lane changed, the node's box has to go to its parent
+			constexpr uint8_t ChildChanged = 0x10;
+
+			uint32_t lastDirty = 0;
+			for(size_t k = 0; k < changedCount; k++)
+			{
+				const uint32_t item = changed[k];
+				this->boxes[item] = boxes[item];
+				const uint32_t node = nodeOfItem[item];
+				dirty[node] |= (uint8_t)(1u << laneOfItem[item]);
+				lastDirty = std::max(lastDirty, node);
+			}
+
+			// parents come before their children, one sweep down the indices reaches every ancestor after its children
+			for(uint32_t n = lastDirty + 1; n-- > 0; )
+			{
+				if(!dirty[n])
+					continue;
+
+				Node& node = nodes[n];
+				for(uint32_t lane = 0; lane < Width; lane++)
+				{
+					if(!(dirty[n] & (1u << lane)))
+						continue;
+					Aabb box = EmptyBox();
+					const uint32_t first = node.child[lane] & ~LeafBit;
+					for(uint32_t slot = first; slot < first + node.count[lane]; slot++)
+						Grow(box, this->boxes[leafItems[slot]]);
+					SetLane(node, lane, box);
+				}
+				dirty[n] = 0;
+
+				if(node.parent != Empty)
+				{
+					SetLane(nodes[node.parent], node.parentLane, GetNodeBox(node));
+					dirty[node.parent] |= ChildChanged;
+				}
+			}
+		}
+
+		void Bvh::CollectAll(uint32_t child, uint32_t count, std::vector<uint32_t>& result) const
+		{
+			if(child & LeafBit)
+			{
+				const uint32_t first = child & ~LeafBit;
+				result.insert(result.end(), leafItems.begin() + first, leafItems.begin() + first + count);
+				return;
+			}
+			const Node& node = nodes[child];
+			for(uint32_t lane = 0; lane < Width; lane++)
+				if(node.child[lane] != Empty)
+					CollectAll(node.child[lane], node.count[lane], result);
+		}
+
+		void Bvh::QueryAabb(const Aabb& box, std::vector<uint32_t>& result) const
+		{
+			result.clear();
+			if(nodes.empty())
+				return;
+
+			uint32_t stack[StackSize];
+			uint32_t top = 0;
+			stack[top++] = 0;
+			while(top > 0)
+			{
+				const Node& node = nodes[stack[--top]];
+				int mask = OverlapMask(node, box);
+				for(uint32_t lane = 0; mask; lane++, mask >>= 1)
+				{
+					if(!(mask & 1))
+						continue;
+					const uint32_t child = node.child[lane];
+					if(!(child & LeafBit))
+					{
+						stack[top++] = child;
+						continue;
+					}
+					const uint32_t first = child & ~LeafBit;
+					for(uint32_t slot = first; slot < first + node.count[lane]; slot++)
+						if(Overlaps(boxes[leafItems[slot]], box))
+							result.push_back(leafItems[slot]);
+				}
+			}
+		}
+
+		void Bvh::QuerySphere(const Egg::Cull::Sphere& sphere, std::vector<uint32_t>& result) const
+		{
+			result.clear();
+			if(nodes.empty())
+				return;
+
+			uint32_t stack[StackSize];
+			uint32_t top = 0;
+			stack[top++] = 0;
+			while(top > 0)
+			{
+				const Node& node = nodes[stack[--top]];
+				int mask = SphereMask(node, sphere);
+				for(uint32_t lane = 0; mask; lane++, mask >>= 1)
+				{
+					if(!(mask & 1))
+						continue;
+					const uint32_t child = node.child[lane];
+					if(!(child & LeafBit))
+					{
+						stack[top++] = child;
+						continue;
+					}
+					const uint32_t first = child & ~LeafBit;
+					for(uint32_t slot = first; slot < first + node.count[lane]; slot++)
+						if(Overlaps(boxes[leafItems[slot]], sphere))
+							result.push_back(leafItems[slot]);
+				}
+			}
+		}
+
+		void Bvh::QueryFrustum(const Egg::Cull::Frustum& frustum, std::vector<uint32_t>& result) const
+		{
+			result.clear();
+			if(nodes.empty())
+				return;
+
+			uint32_t stack[StackSize];
+			uint32_t top = 0;
+			stack[top++] = 0;
+			while(top > 0)
+			{
+				const Node& node = nodes[stack[--top]];
+				int inside = 0;
+				int mask = FrustumMask(node, frustum, inside);
+				for(uint32_t lane = 0; mask; lane++, mask >>= 1, inside >>= 1)
+				{
+					if(!(mask & 1))
+						continue;
+					const uint32_t child = node.child[lane];
+					// nothing below a box inside the frustum needs testing
+					if(inside & 1)
+					{
+						CollectAll(child, node.count[lane], result);
+						continue;
+					}
+					if(!(child & LeafBit))
+					{
+						stack[top++] = child;
+						continue;
+					}
+					const uint32_t first = child & ~LeafBit;
+					for(uint32_t slot = first; slot < first + node.count[lane]; slot++)
+						if(frustum.Intersects(boxes[leafItems[slot]]))
+							result.push_back(leafItems[slot]);
+				}
+			}
+		}
+
+		bool Bvh::Raycast(const Float3& origin, const Float3& direction, float maxDistance, RayHit& hit) const
+		{
+			if(nodes.empty())
+				return false;
+
+			// zero components would make 0 * inf in the slab test
+			auto inverse = [](float d) { return 1.0f / (std::fabs(d) > 1e-30f ? d : 1e-30f); };
+			const Float3 invDirection{ inverse(direction.x), inverse(direction.y), inverse(direction.z) };
+
+			hit.item = Empty;
+			hit.distance = maxDistance;
+
+			uint32_t stack[StackSize];
+			float stackDistance[StackSize];
+			uint32_t top = 0;
+			stack[top] = 0;
+			stackDistance[top++] = 0.0f;
+			while(top > 0)
+			{
+				--top;
+				// a closer hit was found since the node was pushed
+				if(stackDistance[top] > hit.distance)
+					continue;
+				const Node& node = nodes[stack[top]];
+
+				alignas(16) float tNear[Width];
+				const int mask = RayMask(node, origin, invDirection, hit.distance, tNear);
+
+				// inner children are pushed furthest first, so the nearest is visited next and the best hit shrinks early
+				uint32_t inner[Width];
+				uint32_t innerCount = 0;
+				for(uint32_t lane = 0; lane < Width; lane++)
+				{
+					if(!(mask & (1 << lane)))
+						continue;
+					const uint32_t child = node.child[lane];
+					if(!(child & LeafBit))
+					{
+						inner[innerCount++] = lane;
+						continue;
+					}
+					const uint32_t first = child & ~LeafBit;
+					for(uint32_t slot = first; slot < first + node.count[lane]; slot++)
+					{
+						float t;
+						if(RayBox(boxes[leafItems[slot]], origin, invDirection, hit.distance, t) && (hit.item == Empty || t < hit.distance))
+						{
+							hit.item = leafItems[slot];
+							hit.distance = t;
+						}
+					}
+				}
+				// at most Width entries, an insertion sort, by decreasing distance
+				for(uint32_t i = 1; i < innerCount; i++)
+				{
+					const uint32_t lane = inner[i];
+					uint32_t j = i;
+					for(; j > 0 && tNear[inner[j - 1]] < tNear[lane]; j--)
+						inner[j] = inner[j - 1];
+					inner[j] = lane;
+				}
+				for(uint32_t i = 0; i < innerCount; i++)
+				{
+					stack[top] = node.child[inner[i]];
+					stackDistance[top++] = tNear[inner[i]];
+				}
+			}
+			return hit.item != Empty;
+		}
+
+		float Bvh::ComputeCost() const
+		{
+			if(nodes.empty())
+				return 0.0f;
+
+			float cost = 0.0f;
+			for(const Node& node : nodes)
+			{
+				cost += HalfArea(GetNodeBox(node));
+				for(uint32_t lane = 0; lane < Width; lane++)
+					if(node.child[lane] & LeafBit && node.child[lane] != Empty)
+						cost += HalfArea(GetLaneBox(node, lane)) * (float)node.count[lane];
+			}
+			const float rootArea = HalfArea(GetNodeBox(nodes[0]));
+			return rootArea > 0.0f ? cost / rootArea : 0.0f;
+		}
+
+	}
+}
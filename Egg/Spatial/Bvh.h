@@ -0,0 +1,122 @@
+#pragma once
+
+#include "../Cull/Bounds.h"
+#include "../Cull/Frustum.h"
+#include "../Math/Float3.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Bounding volume hierarchy over a set of boxes, the items are the indices of the boxes.
+Built top-down with the surface area heuristic into a binary tree, which is then collapsed into nodes of
+four children stored as structure of arrays, so a node's four boxes are tested at once with SSE.
+Items that move are handled by refitting: the tree keeps its topology and only the boxes on the path
+from the moved items to the root grow or shrink. Refitting degrades the tree when items travel far,
+ComputeCost tells when a rebuild pays off.
+Queries are const and can run on any number of threads at the same time.
+*/
+namespace Egg {
+	namespace Spatial {
+
+		class Bvh
+		{
+		public:
+
+			static constexpr uint32_t Width = 4;
+			static constexpr uint32_t MaxLeafSize = 4;
+
+			struct RayHit
+			{
+				uint32_t item;
+				// along the direction, in units of its length, where the ray enters the item's box (0 if it starts inside)
+				float distance;
+			};
+
+		private:
+
+			static constexpr uint32_t Empty = 0xffffffffu;
+			static constexpr uint32_t LeafBit = 0x80000000u;
+			static constexpr uint32_t MaxDepth = 48;
+			// deeper than MaxDepth the splits are median splits that halve the items, so no path is longer than MaxDepth + 32,
+			// and a traversal pops one node and pushes at most four
+			static constexpr uint32_t StackSize = 3 * (MaxDepth + 32) + 4;
+
+			/*
+			Lane i is empty (child Empty, inverted box), a leaf (child LeafBit | first slot in leafItems, count items)
+			or an inner node (child is the node index, count 0). Children always come after their parents.
+			*/
+			struct alignas(16) Node
+			{
+				float minX[Width], minY[Width], minZ[Width];
+				float maxX[Width], maxY[Width], maxZ[Width];
+				uint32_t child[Width];
+				uint32_t count[Width];
+				uint32_t parent;
+				uint32_t parentLane;
+			};
+
+			struct BuildNode
+			{
+				Egg::Cull::Aabb box;
+				uint32_t left, right;
+				uint32_t first, count;
+			};
+
+			std::vector<Node> nodes;
+			std::vector<uint32_t> leafItems;
+			std::vector<Egg::Cull::Aabb> boxes;
+			std::vector<uint32_t> nodeOfItem;
+			std::vector<uint8_t> laneOfItem;
+
+			// build and refit scratch
+			std::vector<BuildNode> buildNodes;
+			std::vector<Egg::Math::Float3> centroids;
+			std::vector<uint8_t> dirty;
+
+			uint32_t BuildRecursive(uint32_t first, uint32_t count, uint32_t depth);
+			uint32_t Collapse(uint32_t buildNode, uint32_t parent, uint32_t parentLane);
+			void SetLane(Node& node, uint32_t lane, const Egg::Cull::Aabb& box);
+			Egg::Cull::Aabb GetLaneBox(const Node& node, uint32_t lane) const;
+			Egg::Cull::Aabb GetNodeBox(const Node& node) const;
+			void CollectAll(uint32_t child, uint32_t count, std::vector<uint32_t>& result) const;
+
+		public:
+
+			/*
+			Builds the tree over count boxes from scratch, the boxes are copied
+			*/
+			void Build(const Egg::Cull::Aabb* boxes, uint32_t count);
+
+			/*
+			Takes the new boxes of the changed items (boxes has all items, only the changed ones are read)
+			and updates the nodes above them. Cost is proportional to the changed items plus the index range of the touched nodes.
+			*/
+			void Refit(const Egg::Cull::Aabb* boxes, const uint32_t* changed, size_t changedCount);
+
+			/*
+			The queries clear result and write the items whose box passes the test to it, in no particular order
+			*/
+			void QueryAabb(const Egg::Cull::Aabb& box, std::vector<uint32_t>& result) const;
+			void QuerySphere(const Egg::Cull::Sphere& sphere, std::vector<uint32_t>& result) const;
+			void QueryFrustum(const Egg::Cull::Frustum& frustum, std::vector<uint32_t>& result) const;
+
+			/*
+			The item whose box the ray origin + t * direction enters first, for 0 <= t <= maxDistance.
+			Returns false if it hits none.
+			*/
+			bool Raycast(const Egg::Math::Float3& origin, const Egg::Math::Float3& direction, float maxDistance, RayHit& hit) const;
+
+			/*
+			Surface area heuristic cost of the tree: the expected number of nodes and items a random ray tests,
+			compare with the cost right after Build to decide when to rebuild
+			*/
+			float ComputeCost() const;
+
+			uint32_t GetItemCount() const { return (uint32_t)boxes.size(); }
+			uint32_t GetNodeCount() const { return (uint32_t)nodes.size(); }
+			const Egg::Cull::Aabb& GetBox(uint32_t item) const { return boxes[item]; }
+		};
+
+	}
+}
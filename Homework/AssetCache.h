@@ -0,0 +1,221 @@
+#pragma once
+
+#include <Egg/Common.h>
+#include <Egg/MappedFile.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace GG
+{
+	// 64 bit fnv-1a over the 8 byte words of the data and then its last bytes, with the size mixed in
+	inline uint64_t HashContent(const uint8_t* data, size_t size)
+	{
+		constexpr uint64_t Prime = 0x100000001b3ull;
+		uint64_t hash = 0xcbf29ce484222325ull ^ (size * Prime);
+
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, data + i, 8);
+			hash = (hash ^ word) * Prime;
+		}
+		for (; i < size; i++)
+			hash = (hash ^ data[i]) * Prime;
+		return hash;
+	}
+
+	/*
+	Loaded assets of one kind, found by path or by the content of their file, so the same file under
+	different paths is loaded once. Every asset sits in a slot, the slot index is what others keep.
+	Acquire and Release count the users of an asset, assets nobody uses stay loaded (a later Acquire revives them)
+	until the cache is over its memory budget, then Trim unloads them, the least recently released first.
+
+	Releasing happens while the gpu may still read the asset, so Release takes the current epoch (a frame counter)
+	and Trim only unloads assets released in epochs the gpu is done with. The slots of unloaded assets are reused.
+	*/
+	template<typename T>
+	class AssetCache
+	{
+	public:
+
+		struct Stats
+		{
+			// found by path
+			uint32_t pathHits = 0;
+			// found by the content of a file with a new path
+			uint32_t contentHits = 0;
+			uint32_t misses = 0;
+			uint32_t evictions = 0;
+			uint32_t residentAssets = 0;
+			uint64_t residentBytes = 0;
+		};
+
+	private:
+
+		struct Entry
+		{
+			std::shared_ptr<T> asset;
+			std::vector<std::string> paths;
+			uint64_t contentHash = 0;
+			bool hasContentHash = false;
+			uint64_t bytes = 0;
+			uint32_t references = 0;
+			uint64_t releaseEpoch = 0;
+		};
+
+		std::string root;
+		uint64_t budgetBytes;
+
+		std::vector<Entry> entries;
+		std::vector<uint32_t> freeSlots;
+		std::unordered_map<std::string, uint32_t> slotOfPath;
+		std::unordered_map<uint64_t, uint32_t> slotOfContent;
+
+		Stats stats;
+
+		void Evict(uint32_t slot)
+		{
+			Entry& entry = entries[slot];
+			for (const std::string& path : entry.paths)
+				slotOfPath.erase(path);
+			if (entry.hasContentHash)
+				slotOfContent.erase(entry.contentHash);
+
+			stats.evictions++;
+			stats.residentAssets--;
+			stats.residentBytes -= entry.bytes;
+
+			entry = Entry{};
+			freeSlots.push_back(slot);
+		}
+
+	public:
+
+		// paths are relative to root, budgetBytes is the size unused assets may push the cache to
+		AssetCache(std::string root, uint64_t budgetBytes) : root{ std::move(root) }, budgetBytes{ budgetBytes } {}
+
+		/*
+		Slot of the asset at path, with one more user. On a miss load(path, slot) is called, it returns
+		the asset (a T::P) and the bytes it takes, the slot is known before loading so the asset may use it (as a descriptor index).
+		*/
+		template<typename Loader>
+		uint32_t Acquire(const std::string& path, Loader&& load)
+		{
+			auto byPath = slotOfPath.find(path);
+			if (byPath != slotOfPath.end())
+			{
+				stats.pathHits++;
+				entries[byPath->second].references++;
+				return byPath->second;
+			}
+
+			// a file that can not be read (not shipped) is only found by path
+			uint64_t contentHash = 0;
+			bool hasContentHash = false;
+			{
+				Egg::MappedFile file{ root + path };
+				if (file.IsValid())
+				{
+					contentHash = HashContent(file.GetData(), file.GetSize());
+					hasContentHash = true;
+				}
+			}
+
+			if (hasContentHash)
+			{
+				auto byContent = slotOfContent.find(contentHash);
+				if (byContent != slotOfContent.end())
+				{
+					stats.contentHits++;
+					Entry& entry = entries[byContent->second];
+					entry.paths.push_back(path);
+					entry.references++;
+					slotOfPath.emplace(path, byContent->second);
+					return byContent->second;
+				}
+			}
+
+			uint32_t slot;
+			if (freeSlots.empty())
+			{
+				slot = (uint32_t)entries.size();
+				entries.emplace_back();
+			}
+			else
+			{
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+			}
+
+			std::pair<std::shared_ptr<T>, uint64_t> loaded = load(path, slot);
+
+			Entry& entry = entries[slot];
+			entry.asset = std::move(loaded.first);
+			entry.paths.push_back(path);
+			entry.contentHash = contentHash;
+			entry.hasContentHash = hasContentHash;
+			entry.bytes = loaded.second;
+			entry.references = 1;
+
+			slotOfPath.emplace(path, slot);
+			if (hasContentHash)
+				slotOfContent.emplace(contentHash, slot);
+
+			stats.misses++;
+			stats.residentAssets++;
+			stats.residentBytes += entry.bytes;
+			return slot;
+		}
+
+		void Release(uint32_t slot, uint64_t epoch)
+		{
+			Entry& entry = entries[slot];
+			ASSERT(entry.references > 0, "Asset released more times than acquired (slot %u)", slot);
+			if (--entry.references == 0)
+				entry.releaseEpoch = epoch;
+		}
+
+		/*
+		Unloads unused assets released in or before completedEpoch, least recently released first, until the cache fits its budget
+		*/
+		void Trim(uint64_t completedEpoch)
+		{
+			while (stats.residentBytes > budgetBytes)
+			{
+				uint32_t victim = UINT32_MAX;
+				for (uint32_t slot = 0; slot < entries.size(); slot++)
+				{
+					const Entry& entry = entries[slot];
+					if (entry.asset && entry.references == 0 && entry.releaseEpoch <= completedEpoch &&
+						(victim == UINT32_MAX || entry.releaseEpoch < entries[victim].releaseEpoch))
+						victim = slot;
+				}
+				if (victim == UINT32_MAX)
+					return;
+				Evict(victim);
+			}
+		}
+
+		// null for slots whose asset was unloaded
+		const std::shared_ptr<T>& operator[](uint32_t slot) const { return entries[slot].asset; }
+
+		// the path the asset of the slot was first acquired with
+		const std::string& GetPath(uint32_t slot) const { return entries[slot].paths.front(); }
+
+		// slots run from 0 to GetSlotCount() - 1
+		uint32_t GetSlotCount() const { return (uint32_t)entries.size(); }
+
+		void SetBudget(uint64_t bytes) { budgetBytes = bytes; }
+		uint64_t GetBudget() const { return budgetBytes; }
+
+		const Stats& GetStats() const { return stats; }
+	};
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "RadixSort.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace GG
+{
+	// passes are drawn in this order, the pass is the most significant field of the sort key
+	enum class DrawPass : uint32_t
+	{
+		Opaque = 0,
+		// drawn back to front, after everything opaque
+		Transparent = 1
+	};
+
+	// one object to draw, pso, texture and geometry are indices into the renderer's tables,
+	// object is the element of the objects buffer, depth is its distance from the camera
+	struct DrawItem
+	{
+		uint32_t pso;
+		uint32_t texture;
+		uint32_t geometry;
+		uint32_t object;
+		float depth = 0.0f;
+		DrawPass pass = DrawPass::Opaque;
+	};
+
+	// 64 bit sort key of a draw item, from the most significant bits:
+	// pass (4) | pso (12) | texture (16) | geometry (16) | depth (16)
+	// sorting the keys puts items with the same state next to each other, and within a batch orders the
+	// instances front to back (opaque, for early z) or back to front (transparent, for blending)
+	namespace SortKey
+	{
+		constexpr uint32_t PassBits = 4, PsoBits = 12, TextureBits = 16, GeometryBits = 16, DepthBits = 16;
+		constexpr uint32_t DepthShift = 0;
+		constexpr uint32_t GeometryShift = DepthShift + DepthBits;
+		constexpr uint32_t TextureShift = GeometryShift + GeometryBits;
+		constexpr uint32_t PsoShift = TextureShift + TextureBits;
+		constexpr uint32_t PassShift = PsoShift + PsoBits;
+
+		// the bits of a non-negative float grow with its value, the top 16 are a monotonic quantization
+		// that needs no near and far range
+		inline uint32_t QuantizeDepth(float depth)
+		{
+			if (!(depth > 0.0f))
+				return 0;
+			uint32_t bits;
+			std::memcpy(&bits, &depth, sizeof(bits));
+			return bits >> (32 - DepthBits);
+		}
+
+		inline uint64_t Make(const DrawItem& item)
+		{
+			uint64_t depth = QuantizeDepth(item.depth);
+			if (item.pass == DrawPass::Transparent)
+				depth = ((1ull << DepthBits) - 1) - depth;
+
+			return ((uint64_t)item.pass << PassShift)
+				| ((uint64_t)item.pso << PsoShift)
+				| ((uint64_t)item.texture << TextureShift)
+				| ((uint64_t)item.geometry << GeometryShift)
+				| (depth << DepthShift);
+		}
+
+		// the state part of the key, items with the same state go into the same batch
+		constexpr uint64_t StateMask = ~((1ull << GeometryShift) - 1);
+
+		constexpr bool Fits(uint32_t pso, uint32_t texture, uint32_t geometry)
+		{
+			return pso < (1u << PsoBits) && texture < (1u << TextureBits) && geometry < (1u << GeometryBits);
+		}
+	}
+
+	// items sharing pass, pso, texture and geometry, drawn with one instanced draw,
+	// their object indices are instances[firstInstance, firstInstance + instanceCount)
+	struct DrawBatch
+	{
+		DrawPass pass;
+		uint32_t pso;
+		uint32_t texture;
+		uint32_t geometry;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	// groups draw items into instanced draws, d3d free: Record calls SetPipeline, SetTexture, SetGeometry
+	// and DrawInstanced on whatever it is given, the renderer passes a command list wrapper, tests a recording stub
+	class DrawBatcher
+	{
+		std::vector<DrawItem> items;
+		std::vector<KeyIndex> keys;
+		std::vector<KeyIndex> scratch;
+		std::vector<uint32_t> instances;
+		std::vector<DrawBatch> batches;
+
+	public:
+
+		struct Stats
+		{
+			uint32_t items = 0;
+			uint32_t draws = 0;
+			uint32_t pipelineChanges = 0;
+			uint32_t textureChanges = 0;
+			uint32_t geometryChanges = 0;
+			// changes saved compared to setting every state for every item
+			uint32_t pipelineChangesElided = 0;
+			uint32_t textureChangesElided = 0;
+			uint32_t geometryChangesElided = 0;
+		};
+
+		void Clear() { items.clear(); }
+
+		void Add(const DrawItem& item) { items.push_back(item); }
+
+		// radix sorts the items by their SortKey, then cuts the sorted list into batches where the state changes,
+		// so state changes between batches are as few as the key order allows
+		void Build()
+		{
+			keys.resize(items.size());
+			for (uint32_t i = 0; i < items.size(); i++)
+				keys[i] = { SortKey::Make(items[i]), i };
+			RadixSort(keys, scratch);
+
+			instances.clear();
+			batches.clear();
+			uint64_t lastState = 0;
+			for (const KeyIndex& k : keys)
+			{
+				const DrawItem& item = items[k.index];
+				const uint64_t state = k.key & SortKey::StateMask;
+				if (batches.empty() || state != lastState)
+				{
+					batches.push_back({ item.pass, item.pso, item.texture, item.geometry, (uint32_t)instances.size(), 0 });
+					lastState = state;
+				}
+				instances.push_back(item.object);
+				batches.back().instanceCount++;
+			}
+		}
+
+		// object indices of all batches, to be copied into the buffer the shaders read the instances from
+		const std::vector<uint32_t>& GetInstances() const { return instances; }
+		const std::vector<DrawBatch>& GetBatches() const { return batches; }
+
+		// state already set on the recorder is not set again, instanceOffset is added to every firstInstance
+		template <typename Recorder>
+		Stats Record(Recorder& recorder, uint32_t instanceOffset = 0) const
+		{
+			Stats stats;
+			stats.items = (uint32_t)items.size();
+
+			const DrawBatch* last = nullptr;
+			for (const DrawBatch& batch : batches)
+			{
+				if (!last || last->pso != batch.pso)
+				{
+					recorder.SetPipeline(batch.pso);
+					stats.pipelineChanges++;
+				}
+				if (!last || last->pso != batch.pso || last->texture != batch.texture)
+				{
+					recorder.SetTexture(batch.texture);
+					stats.textureChanges++;
+				}
+				if (!last || last->geometry != batch.geometry)
+				{
+					recorder.SetGeometry(batch.geometry);
+					stats.geometryChanges++;
+				}
+				recorder.DrawInstanced(batch.geometry, batch.instanceCount, instanceOffset + batch.firstInstance);
+				stats.draws++;
+				last = &batch;
+			}
+
+			stats.pipelineChangesElided = stats.items - stats.pipelineChanges;
+			stats.textureChangesElided = stats.items - stats.textureChanges;
+			stats.geometryChangesElided = stats.items - stats.geometryChanges;
+			return stats;
+		}
+	};
+}
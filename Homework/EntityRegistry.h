@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace GG
+{
+	// handle to an object shared by all systems, the index addresses dense per-system arrays,
+	// the generation tells apart handles of a destroyed entity and the one reusing its slot
+	struct Entity
+	{
+		static constexpr uint32_t InvalidIndex = 0xffffffffu;
+
+		uint32_t index = InvalidIndex;
+		uint32_t generation = 0;
+
+		bool IsValid() const { return index != InvalidIndex; }
+
+		bool operator==(const Entity& rhs) const { return index == rhs.index && generation == rhs.generation; }
+		bool operator!=(const Entity& rhs) const { return !(*this == rhs); }
+	};
+
+	// names are only used at creation and for debugging, per-frame code works with handles
+	class EntityRegistry
+	{
+		std::vector<uint32_t> generations;
+		std::vector<std::string> names;
+		std::vector<uint32_t> freeSlots;
+		std::unordered_map<std::string, Entity> byName;
+
+	public:
+
+		Entity Create(const std::string& name)
+		{
+			Entity e;
+			if (!freeSlots.empty())
+			{
+				e.index = freeSlots.back();
+				freeSlots.pop_back();
+				names[e.index] = name;
+			}
+			else
+			{
+				e.index = (uint32_t)generations.size();
+				generations.push_back(0);
+				names.push_back(name);
+			}
+			e.generation = generations[e.index];
+
+			byName[name] = e;
+			return e;
+		}
+
+		void Destroy(Entity e)
+		{
+			if (!IsAlive(e))
+				return;
+
+			auto it = byName.find(names[e.index]);
+			if (it != byName.end() && it->second == e)
+				byName.erase(it);
+
+			names[e.index].clear();
+			generations[e.index]++;
+			freeSlots.push_back(e.index);
+		}
+
+		bool IsAlive(Entity e) const
+		{
+			return e.index < generations.size() && generations[e.index] == e.generation;
+		}
+
+		// returns an invalid handle if there is no entity with that name
+		Entity Find(const std::string& name) const
+		{
+			auto it = byName.find(name);
+			return it != byName.end() ? it->second : Entity{};
+		}
+
+		const std::string& GetName(Entity e) const { return names[e.index]; }
+
+		// number of slots ever used, the size needed for arrays indexed by Entity::index
+		uint32_t GetCapacity() const { return (uint32_t)generations.size(); }
+	};
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+namespace GG
+{
+	// turns variable frame times into a whole number of fixed simulation steps,
+	// independent of physx and d3d so step counts can be checked with made up frame times
+	class FixedTimestep
+	{
+	public:
+
+		enum class CatchUp
+		{
+			// time beyond maxSubsteps is thrown away, the simulation slows down during a spike
+			Drop,
+			// the backlog is kept (up to maxBacklog seconds) and worked off over the next frames
+			Keep
+		};
+
+	private:
+
+		float stepSize;
+		uint32_t maxSubsteps;
+		CatchUp policy;
+		float maxBacklog;
+
+		float accumulator = 0.0f;
+		uint64_t stepCount = 0;
+		uint64_t droppedSteps = 0;
+
+	public:
+
+		FixedTimestep(float stepSize = 1.0f / 60.0f, uint32_t maxSubsteps = 4, CatchUp policy = CatchUp::Drop, float maxBacklog = 0.25f)
+			: stepSize{ stepSize }, maxSubsteps{ maxSubsteps }, policy{ policy }, maxBacklog{ maxBacklog } { }
+
+		// adds the frame time and returns how many steps to simulate this frame
+		uint32_t Advance(float dt)
+		{
+			accumulator += dt;
+
+			uint32_t steps = 0;
+			while (accumulator >= stepSize && steps < maxSubsteps)
+			{
+				accumulator -= stepSize;
+				steps++;
+			}
+
+			// whole steps left over could not be simulated this frame
+			if (accumulator >= stepSize)
+			{
+				float kept = (policy == CatchUp::Drop) ? std::fmod(accumulator, stepSize) : std::fmin(accumulator, maxBacklog);
+				droppedSteps += (uint64_t)((accumulator - kept) / stepSize);
+				accumulator = kept;
+			}
+
+			stepCount += steps;
+			return steps;
+		}
+
+		// how far the current time is between the last two simulated states, in [0, 1),
+		// a kept backlog of whole steps is not part of it, those are still to be simulated
+		float GetAlpha() const
+		{
+			float alpha = std::fmod(accumulator, stepSize) / stepSize;
+			return alpha < 1.0f ? alpha : std::nextafter(1.0f, 0.0f);
+		}
+
+		void SetStepSize(float s) { stepSize = s; }
+		void SetMaxSubsteps(uint32_t n) { maxSubsteps = n; }
+		void SetCatchUp(CatchUp p, float backlog = 0.25f) { policy = p; maxBacklog = backlog; }
+
+		float GetStepSize() const { return stepSize; }
+		uint32_t GetMaxSubsteps() const { return maxSubsteps; }
+		uint64_t GetStepCount() const { return stepCount; }
+		uint64_t GetDroppedSteps() const { return droppedSteps; }
+	};
+}
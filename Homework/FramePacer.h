@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace GG
+{
+	// number of frames the cpu may record ahead of the gpu, per-frame resources have this many copies
+	constexpr uint32_t FramesInFlight = 2;
+
+	// decides when the resources of a frame slot may be reused, independent of d3d:
+	// Fence is anything with GetCompletedValue(), Signal(value) and Wait(value), a plain counter can stand in for the gpu
+	template <typename Fence>
+	class FramePacer
+	{
+		Fence& fence;
+
+		// fence value signaled after the last submission of each slot, 0 for slots not used yet
+		std::vector<uint64_t> slotValues;
+		uint64_t nextValue = 1;
+		uint32_t frame = 0;
+
+		uint64_t stalls = 0;
+
+	public:
+
+		FramePacer(Fence& fence, uint32_t frameCount = FramesInFlight)
+			: fence{ fence }, slotValues(frameCount, 0) { }
+
+		// waits until the gpu is done with the frame recorded into this slot frameCount frames ago, returns the slot
+		uint32_t BeginFrame()
+		{
+			const uint64_t value = slotValues[frame];
+			if (fence.GetCompletedValue() < value)
+			{
+				stalls++;
+				fence.Wait(value);
+			}
+			return frame;
+		}
+
+		// call after the command lists of the frame are submitted, signals its value and moves to the next slot
+		void EndFrame()
+		{
+			slotValues[frame] = nextValue;
+			fence.Signal(nextValue++);
+			frame = (frame + 1) % GetFrameCount();
+		}
+
+		// blocks until everything submitted so far is done, e.g. before resizing or releasing resources
+		void WaitForIdle()
+		{
+			const uint64_t value = nextValue++;
+			fence.Signal(value);
+			if (fence.GetCompletedValue() < value)
+				fence.Wait(value);
+		}
+
+		// value signaled by the last EndFrame or WaitForIdle
+		uint64_t GetLastSignaledValue() const { return nextValue - 1; }
+
+		uint32_t GetFrame() const { return frame; }
+		uint32_t GetFrameCount() const { return (uint32_t)slotValues.size(); }
+
+		// number of BeginFrame calls that had to wait for the gpu
+		uint64_t GetStallCount() const { return stalls; }
+	};
+}
@@ -2,18 +2,15 @@
 
 #include <Egg/Common.h>
 #include <Egg/Utility.h>
+#include <Egg/MappedFile.h>
 #include <Egg/Math/Math.h>
+#include <Egg/Cull/Bounds.h>
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+#include "MeshCooker.h"
 
-struct PNT_Vertex
-{
-	Egg::Math::Float3 position;
-	Egg::Math::Float3 normal;
-	Egg::Math::Float2 tex;
-};
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 
 
 namespace GG {
@@ -33,6 +30,17 @@ namespace GG {
 		D3D12_INPUT_LAYOUT_DESC inputLayout;
 		D3D12_PRIMITIVE_TOPOLOGY topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
+		// model space bounds of the vertices
+		Egg::Cull::Aabb aabb;
+		Egg::Cull::Sphere boundingSphere;
+
+		// cpu copy of the triangles, for the occlusion culler
+		std::vector<Egg::Math::Float3> positions;
+		std::vector<uint32_t> triangleIndices;
+
+		// buffers and cpu copies
+		uint64_t byteSize = 0;
+
 	public:
 		
 		std::string path;
@@ -40,67 +48,44 @@ namespace GG {
 		Geometry(ID3D12Device* device, std::string filePath)
 			: path{ filePath }
 		{
-			// import geometry from file
-			std::vector<unsigned int> indices;
-			std::vector<PNT_Vertex> vertices;
-
-			uint32_t sizeInBytes;
-			uint32_t indexDataSizeInBytes;
-			uint32_t stride;
-			void* indexData;
-			void* data;
-			DXGI_FORMAT indexFormat;
-			{
-				std::string path = "../Media/" + filePath;
-
-				Assimp::Importer importer;
-
-				const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_GenUVCoords);
+			// the cooked file is mapped, the streams are copied from it straight into the buffers
+			const Egg::MappedFile file = CookedMesh::Load(filePath);
+			const CookedMesh::Header& header = *reinterpret_cast<const CookedMesh::Header*>(file.GetData());
+			const uint8_t* vertexData = file.GetData() + header.vertexOffset;
+			const uint8_t* indexData = file.GetData() + header.indexOffset;
 
-				ASSERT(scene != nullptr, "Failed to load obj file: '%s'. Assimp error message: '%s'", path.c_str(), importer.GetErrorString());
+			const uint32_t sizeInBytes = header.vertexCount * header.vertexStride;
+			const uint32_t indexDataSizeInBytes = header.indexCount * header.indexSize;
+			const uint32_t stride = header.vertexStride;
+			const DXGI_FORMAT indexFormat = header.indexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 
-				ASSERT(scene->HasMeshes(), "Obj file: '%s' does not contain a mesh.", path.c_str());
+			aabb = header.aabb;
+			boundingSphere = header.boundingSphere;
 
-				// for this example we only load the first mesh
-				const aiMesh* mesh = scene->mMeshes[0];
-
-				indices.reserve(mesh->mNumFaces);
-				vertices.reserve(mesh->mNumVertices);
-
-				PNT_Vertex v;
-
-				for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+			// cpu copy of the triangles, for the occlusion culler
+			{
+				positions.resize(header.vertexCount);
+				for (uint32_t i = 0; i < header.vertexCount; i++)
 				{
-					v.position.x = mesh->mVertices[i].x;
-					v.position.y = mesh->mVertices[i].y;
-					v.position.z = mesh->mVertices[i].z;
-
-					v.normal.x = mesh->mNormals[i].x;
-					v.normal.y = mesh->mNormals[i].y;
-					v.normal.z = mesh->mNormals[i].z;
-
-					v.tex.x = mesh->mTextureCoords[0][i].x;
-					v.tex.y = mesh->mTextureCoords[0][i].y;
-
-					vertices.emplace_back(v);
+					const float* p = reinterpret_cast<const float*>(vertexData + (size_t)i * stride + offsetof(PNT_Vertex, position));
+					positions[i].x = p[0];
+					positions[i].y = p[1];
+					positions[i].z = p[2];
 				}
 
-				for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
+				triangleIndices.resize(header.indexCount);
+				if (header.indexSize == 2)
 				{
-					aiFace face = mesh->mFaces[i];
-					indices.emplace_back(face.mIndices[0]);
-					indices.emplace_back(face.mIndices[1]);
-					indices.emplace_back(face.mIndices[2]);
+					const uint16_t* indices16 = reinterpret_cast<const uint16_t*>(indexData);
+					std::copy(indices16, indices16 + header.indexCount, triangleIndices.begin());
 				}
-
-				sizeInBytes = (vertices.size() * sizeof(PNT_Vertex));
-				indexDataSizeInBytes = (indices.size() * 4);
-				stride = sizeof(PNT_Vertex);
-				indexData = &(indices.at(0));
-				data = &(vertices.at(0));
-				indexFormat = DXGI_FORMAT_R32_UINT;
+				else
+					std::memcpy(triangleIndices.data(), indexData, indexDataSizeInBytes);
 			}
 
+			byteSize = (uint64_t)sizeInBytes + indexDataSizeInBytes +
+				positions.size() * sizeof(Egg::Math::Float3) + triangleIndices.size() * sizeof(uint32_t);
+
 			// create d3d resource
 			{
 				static int id = 0;
@@ -135,7 +120,7 @@ namespace GG {
 				DX_API("Failed to map vertex buffer (IndexedGeometry)")
 					vertexBuffer->Map(0, &range, &mappedPtr);
 
-				memcpy(mappedPtr, data, sizeInBytes);
+				memcpy(mappedPtr, vertexData, sizeInBytes);
 				vertexBuffer->Unmap(0, nullptr);
 
 				DX_API("Failed to set name for vertex buffer (IndexedGeometry)")
@@ -202,14 +187,33 @@ namespace GG {
 			}
 		}
 
+		uint64_t GetSizeInBytes() const { return byteSize; }
+
+		const Egg::Cull::Aabb& GetAabb() const { return aabb; }
+		const Egg::Cull::Sphere& GetBoundingSphere() const { return boundingSphere; }
+
+		const std::vector<Egg::Math::Float3>& GetPositions() const { return positions; }
+		const std::vector<uint32_t>& GetTriangleIndices() const { return triangleIndices; }
+
 		void AddInputElement(const D3D12_INPUT_ELEMENT_DESC& ied) { inputElements.push_back(ied); }
 
-		void Draw(ID3D12GraphicsCommandList* commandList)
+		void Bind(ID3D12GraphicsCommandList* commandList)
 		{
 			commandList->IASetPrimitiveTopology(topology);
 			commandList->IASetIndexBuffer(&indexBufferView);
 			commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
-			commandList->DrawIndexedInstanced(indexCount, 1, 0, 0, 0);
+		}
+
+		// the geometry has to be bound already, SV_InstanceID runs from 0 to instanceCount - 1
+		void DrawInstanced(ID3D12GraphicsCommandList* commandList, uint32_t instanceCount)
+		{
+			commandList->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, 0);
+		}
+
+		void Draw(ID3D12GraphicsCommandList* commandList, uint32_t instanceCount = 1)
+		{
+			Bind(commandList);
+			DrawInstanced(commandList, instanceCount);
 		}
 
 		const D3D12_INPUT_LAYOUT_DESC& GetInputLayout() 
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <Egg/Common.h>
+#include <Egg/MappedFile.h>
+#include <Egg/Math/Math.h>
+#include <Egg/Cull/Bounds.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+struct PNT_Vertex
+{
+	Egg::Math::Float3 position;
+	Egg::Math::Float3 normal;
+	Egg::Math::Float2 tex;
+};
+
+namespace GG {
+
+	/*
+	Meshes are imported with assimp once and written to Media/Cooked as a binary file that is mapped
+	and copied straight into the vertex and index buffers, assimp only runs when the cooked file is missing
+	or older than its source. The file is
+		Header
+		vertexCount PNT_Vertex at vertexOffset
+		indexCount indices of indexSize bytes at indexOffset
+	*/
+	namespace CookedMesh {
+
+		constexpr uint32_t Magic = 0x48534d47; // "GMSH"
+		// bump when the layout of the file or the vertex changes, older files are cooked again
+		constexpr uint32_t Version = 1;
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vertexStride;
+			uint32_t vertexCount;
+			uint32_t indexSize;
+			uint32_t indexCount;
+			uint64_t vertexOffset;
+			uint64_t indexOffset;
+			// of the source file the mesh was cooked from
+			uint64_t sourceSize;
+			uint64_t sourceWriteTime;
+			Egg::Cull::Aabb aabb;
+			Egg::Cull::Sphere boundingSphere;
+		};
+
+		// filePath is relative to Media, like the paths Geometry is created with
+		inline std::string GetSourcePath(const std::string& filePath) { return "../Media/" + filePath; }
+		inline std::string GetCookedPath(const std::string& filePath) { return "../Media/Cooked/" + filePath + ".ggmesh"; }
+
+		// size and last write time, false if the file does not exist
+		inline bool GetFileStamp(const std::string& path, uint64_t& size, uint64_t& writeTime)
+		{
+			WIN32_FILE_ATTRIBUTE_DATA attributes;
+			if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+				return false;
+			size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+			writeTime = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+			return true;
+		}
+
+		/*
+		True if file holds a complete mesh of the current version, cooked from the source as it is now.
+		Without the source (shipped cooked files only) any complete mesh of the current version is taken.
+		*/
+		inline bool IsCurrent(const Egg::MappedFile& file, const std::string& sourcePath)
+		{
+			if (!file.IsValid() || file.GetSize() < sizeof(Header))
+				return false;
+
+			const Header& header = *reinterpret_cast<const Header*>(file.GetData());
+			if (header.magic != Magic || header.version != Version || header.vertexStride != sizeof(PNT_Vertex) ||
+				(header.indexSize != 2 && header.indexSize != 4) || header.vertexCount == 0 || header.indexCount == 0)
+				return false;
+			if (header.vertexOffset + (uint64_t)header.vertexCount * header.vertexStride > file.GetSize() ||
+				header.indexOffset + (uint64_t)header.indexCount * header.indexSize > file.GetSize())
+				return false;
+
+			uint64_t sourceSize, sourceWriteTime;
+			if (!GetFileStamp(sourcePath, sourceSize, sourceWriteTime))
+				return true;
+			return header.sourceSize == sourceSize && header.sourceWriteTime == sourceWriteTime;
+		}
+
+		/*
+		Imports the first mesh of the source file and writes it to cookedPath. Indices are 16 bit when the vertices allow it.
+		The file is written next to cookedPath and then moved over it, so a cook that fails halfway leaves no broken file behind.
+		*/
+		inline void Cook(const std::string& sourcePath, const std::string& cookedPath)
+		{
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(sourcePath, aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_GenUVCoords);
+
+			ASSERT(scene != nullptr, "Failed to load obj file: '%s'. Assimp error message: '%s'", sourcePath.c_str(), importer.GetErrorString());
+
+			ASSERT(scene->HasMeshes(), "Obj file: '%s' does not contain a mesh.", sourcePath.c_str());
+
+			// for this example we only load the first mesh
+			const aiMesh* mesh = scene->mMeshes[0];
+
+			Header header = {};
+			header.magic = Magic;
+			header.version = Version;
+			header.vertexStride = sizeof(PNT_Vertex);
+			header.vertexCount = mesh->mNumVertices;
+			header.indexSize = mesh->mNumVertices <= 0xffff ? 2 : 4;
+			header.indexCount = mesh->mNumFaces * 3;
+			header.vertexOffset = (sizeof(Header) + 15) & ~(uint64_t)15;
+			header.indexOffset = header.vertexOffset + (uint64_t)header.vertexCount * header.vertexStride;
+			GetFileStamp(sourcePath, header.sourceSize, header.sourceWriteTime);
+
+			std::vector<PNT_Vertex> vertices(mesh->mNumVertices);
+			Egg::Cull::Aabb& aabb = header.aabb;
+			aabb.min = Egg::Math::Float3{ FLT_MAX, FLT_MAX, FLT_MAX };
+			aabb.max = Egg::Math::Float3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+			{
+				PNT_Vertex& v = vertices[i];
+				v.position.x = mesh->mVertices[i].x;
+				v.position.y = mesh->mVertices[i].y;
+				v.position.z = mesh->mVertices[i].z;
+
+				v.normal.x = mesh->mNormals[i].x;
+				v.normal.y = mesh->mNormals[i].y;
+				v.normal.z = mesh->mNormals[i].z;
+
+				v.tex.x = mesh->mTextureCoords[0][i].x;
+				v.tex.y = mesh->mTextureCoords[0][i].y;
+
+				aabb.min.x = std::min(aabb.min.x, v.position.x);
+				aabb.min.y = std::min(aabb.min.y, v.position.y);
+				aabb.min.z = std::min(aabb.min.z, v.position.z);
+				aabb.max.x = std::max(aabb.max.x, v.position.x);
+				aabb.max.y = std::max(aabb.max.y, v.position.y);
+				aabb.max.z = std::max(aabb.max.z, v.position.z);
+			}
+
+			// centered on the box, with the radius reaching the furthest vertex, tighter than the box's own sphere
+			header.boundingSphere.center = aabb.GetCenter();
+			float radiusSquared = 0.0f;
+			for (const PNT_Vertex& vertex : vertices)
+				radiusSquared = std::max(radiusSquared, (vertex.position - header.boundingSphere.center).LengthSquared());
+			header.boundingSphere.radius = std::sqrt(radiusSquared);
+
+			std::vector<uint8_t> indices((size_t)header.indexCount * header.indexSize);
+			for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
+				for (unsigned int k = 0; k < 3; ++k)
+				{
+					const uint32_t index = mesh->mFaces[i].mIndices[k];
+					if (header.indexSize == 2)
+						reinterpret_cast<uint16_t*>(indices.data())[i * 3 + k] = (uint16_t)index;
+					else
+						reinterpret_cast<uint32_t*>(indices.data())[i * 3 + k] = index;
+				}
+
+			CreateDirectoryA("../Media/Cooked", nullptr);
+			const std::string tempPath = cookedPath + ".tmp";
+			{
+				std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+				ASSERT(out.is_open(), "Failed to create cooked mesh file: '%s'", tempPath.c_str());
+
+				const char padding[16] = {};
+				out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+				out.write(padding, header.vertexOffset - sizeof(Header));
+				out.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(PNT_Vertex));
+				out.write(reinterpret_cast<const char*>(indices.data()), indices.size());
+
+				ASSERT(out.good(), "Failed to write cooked mesh file: '%s'", tempPath.c_str());
+			}
+
+			ASSERT(MoveFileExA(tempPath.c_str(), cookedPath.c_str(), MOVEFILE_REPLACE_EXISTING) != 0,
+				"Failed to replace cooked mesh file: '%s'", cookedPath.c_str());
+		}
+
+		/*
+		The mapped cooked file of the mesh at filePath (relative to Media), cooked first if it is missing or out of date
+		*/
+		inline Egg::MappedFile Load(const std::string& filePath)
+		{
+			const std::string sourcePath = GetSourcePath(filePath);
+			const std::string cookedPath = GetCookedPath(filePath);
+
+			Egg::MappedFile file{ cookedPath };
+			if (IsCurrent(file, sourcePath))
+				return file;
+
+			// the mapping keeps the old file open, it would block replacing it
+			file = Egg::MappedFile{};
+			Cook(sourcePath, cookedPath);
+
+			file = Egg::MappedFile{ cookedPath };
+			ASSERT(IsCurrent(file, sourcePath), "Cooked mesh file is unreadable: '%s'", cookedPath.c_str());
+			return file;
+		}
+
+	}
+}
@@ -8,6 +8,14 @@
 #include <cstdlib>
 
 #include "DescriptorHeap.h"
+#include "FramePacer.h"
+#include "QueueFence.h"
+#include "UploadRing.h"
+#include "EntityRegistry.h"
+GG::EntityRegistry entities;
+
+#include <Egg/Jobs/JobSystem.h>
+Egg::Jobs::JobSystem jobs;
 
 #include "RenderingSystem.h"
 RenderingSystem renderer;
@@ -64,15 +72,21 @@ class MyApp
 	// --- ----
 	// --- COMMAND LISTS
 	// --- ----
-	com_ptr<ID3D12CommandAllocator> commandAllocator;
+	// one allocator per frame in flight, an allocator is only reset after the gpu finished the frame recorded with it
+	com_ptr<ID3D12CommandAllocator> commandAllocators[GG::FramesInFlight];
 	com_ptr<ID3D12GraphicsCommandList> commandList;
 	com_ptr<ID3D12GraphicsCommandList> commandList2;
 
 	// sync objects
-	com_ptr<ID3D12Fence> fence;
-	HANDLE fenceEvent;
-	unsigned long long fenceValue;
-	unsigned int frameIndex;
+	GG::QueueFence fence;
+	GG::FramePacer<GG::QueueFence> pacer{ fence };
+	unsigned int backBufferIndex;
+
+	// transient per-frame data
+	GG::UploadRing uploadRing;
+
+	// physics steps run on the job system while the frame is recorded, P toggles it
+	bool pipelinedPhysics = true;
 	
 	// time objects
 	using clock_type = std::chrono::high_resolution_clock;
@@ -80,21 +94,10 @@ class MyApp
 	std::chrono::time_point<clock_type> timestampEnd;
 	float elapsedTime;
 
-	void WaitForPreviousFrame() 
+	// full flush, only for startup, resizing and shutdown, frames are paced by FramePacer
+	void WaitForGpu() 
 	{
-		const UINT64 fv = fenceValue;
-		DX_API("Failed to signal from command queue")
-			commandQueue->Signal(fence.Get(), fv);
-
-		fenceValue++;
-
-		if (fence->GetCompletedValue() < fv) {
-			DX_API("Failed to sign up for event completion")
-				fence->SetEventOnCompletion(fv, fenceEvent);
-			WaitForSingleObject(fenceEvent, INFINITE);
-		}
-
-		frameIndex = swapChain->GetCurrentBackBufferIndex();
+		pacer.WaitForIdle();
 	}
 
 public:
@@ -111,14 +114,18 @@ public:
 		float deltaTime = std::chrono::duration<float>(timestampEnd - timestampStart).count();
 		elapsedTime += deltaTime;
 		timestampStart = timestampEnd;
-		Update(deltaTime, elapsedTime);
-		Render();
+
+		// waits only if the gpu is still working on the frame that used this slot FramesInFlight frames ago
+		const uint32_t frame = pacer.BeginFrame();
+		uploadRing.BeginFrame(fence.GetCompletedValue());
+		Update(deltaTime, elapsedTime, frame);
+		Render(frame);
 	}
 
-	void Update(float dt, float T) 
+	void Update(float dt, float T, uint32_t frame) 
 	{
-		physics.Update(dt);
-		renderer.Update(&physics, dt);
+		physics.Update(dt, frame);
+		renderer.Update(&physics, uploadRing, dt, frame);
 	}
 
 	/*
@@ -185,15 +192,17 @@ public:
 		- Repeat (next frame)
 	*/
 
-	void PopulateCommandList() 
+	void PopulateCommandList(uint32_t frame) 
 	{
 		// cmdList reset, barrier
 		{
-			commandAllocator->Reset();
-			commandList->Reset(commandAllocator.Get(), nullptr);
+			commandAllocators[frame]->Reset();
+			commandList->Reset(commandAllocators[frame].Get(), nullptr);
+
+			backBufferIndex = swapChain->GetCurrentBackBufferIndex();
 
 			CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-				renderTargets[frameIndex].Get(),
+				renderTargets[backBufferIndex].Get(),
 				D3D12_RESOURCE_STATE_PRESENT,
 				D3D12_RESOURCE_STATE_RENDER_TARGET
 			);
@@ -207,22 +216,22 @@ public:
 			commandList->RSSetViewports(1, &viewPort);
 			commandList->RSSetScissorRects(1, &scissorRect);
 
-			CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle{ rtvHeap->GetCPUHandle(frameIndex) };
+			CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle{ rtvHeap->GetCPUHandle(backBufferIndex) };
 			CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle{ dsvHeap->GetCPUHandle() };
 
 			commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
 
 			const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-			commandList->ClearRenderTargetView(rtvHeap->GetCPUHandle(frameIndex), clearColor, 0, nullptr);
+			commandList->ClearRenderTargetView(rtvHeap->GetCPUHandle(backBufferIndex), clearColor, 0, nullptr);
 			commandList->ClearDepthStencilView(dsvHeap->GetCPUHandle(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 		}
 
-		renderer.Draw(commandList.Get(), &physics);
+		renderer.Draw(commandList.Get(), &physics, frame);
 
 		// close commandlist
 		{
 			CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-				renderTargets[frameIndex].Get(),
+				renderTargets[backBufferIndex].Get(),
 				D3D12_RESOURCE_STATE_RENDER_TARGET,
 				D3D12_RESOURCE_STATE_PRESENT
 			);
@@ -234,9 +243,9 @@ public:
 		}
 	}
 
-	void Render()  
+	void Render(uint32_t frame)  
 	{
-		PopulateCommandList();
+		PopulateCommandList(frame);
 
 		// Execute
 		ID3D12CommandList* cLists[] = { commandList.Get() };
@@ -245,8 +254,9 @@ public:
 		DX_API("Failed to present swap chain")
 			swapChain->Present(0, 0);
 
-		// Sync
-		WaitForPreviousFrame();
+		// Sync, the cpu goes on with the next frame while the gpu works on this one
+		pacer.EndFrame();
+		uploadRing.EndFrame(pacer.GetLastSignaledValue());
 	}
 
 	// sync objects, command allocator, command list
@@ -254,55 +264,53 @@ public:
 	void CreateResources() 
 	{
 		// create sync objects
-		{
-			DX_API("Failed to create fence")
-				device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(fence.GetAddressOf()));
-			fenceValue = 1;
+		fence.CreateResources(device.Get(), commandQueue.Get());
 
-			fenceEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-			if (fenceEvent == NULL) {
-				DX_API("Failed to create windows event") HRESULT_FROM_WIN32(GetLastError());
-			}
-		}
+		uploadRing.CreateResources(device.Get(), 4 * 1024 * 1024);
 
-		// create work submission resources - command list & command allocator
+		// create work submission resources - command list & command allocators
 		{
-			DX_API("Failed to create command allocator")
-				device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(commandAllocator.GetAddressOf()));
+			for (auto& allocator : commandAllocators) {
+				DX_API("Failed to create command allocator")
+					device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(allocator.GetAddressOf()));
+			}
 
 			DX_API("Failed to greate graphics command list")
 				device->CreateCommandList(
 					0, 
 					D3D12_COMMAND_LIST_TYPE_DIRECT, 
-					commandAllocator.Get(), 
+					commandAllocators[0].Get(), 
 					nullptr, 
 					IID_PPV_ARGS(commandList.GetAddressOf())
 				);
 			
 			commandList->Close();
-			//WaitForPreviousFrame();
+			//WaitForGpu();
 
 			DX_API("Failed to greate graphics command list")
 				device->CreateCommandList(
 					0,
 					D3D12_COMMAND_LIST_TYPE_DIRECT,
-					commandAllocator.Get(),
+					commandAllocators[0].Get(),
 					nullptr,
 					IID_PPV_ARGS(commandList2.GetAddressOf())
 				);
 
 			commandList2->Close();
-			WaitForPreviousFrame();
+			WaitForGpu();
 		}
 		
-		renderer.StartUp(device.Get());
-		physics.StartUp(device.Get());
+		renderer.StartUp(device.Get(), jobs);
+		physics.StartUp(device.Get(), jobs);
+		physics.SetPipelined(pipelinedPhysics);
 	}
 
 	void ReleaseResources()  {
 		commandList.Reset();
-		fence.Reset();
-		commandAllocator.Reset();
+		uploadRing.ReleaseResources();
+		fence.ReleaseResources();
+		for (auto& allocator : commandAllocators)
+			allocator.Reset();
 		commandQueue.Reset();
 		swapChain.Reset();
 		device.Reset();
@@ -345,7 +353,7 @@ public:
 				device->CreateRenderTargetView(renderTargets[i].Get(), nullptr, rtvHeap->GetCPUHandle(i));
 			}
 
-			frameIndex = swapChain->GetCurrentBackBufferIndex();
+			backBufferIndex = swapChain->GetCurrentBackBufferIndex();
 		}
 
 		// Depth stencil
@@ -396,21 +404,21 @@ public:
 	{
 		// spere object
 		{
-			const std::string id{ "sphere" };
+			const GG::Entity id = entities.Create("sphere");
 			renderer.AddShadedMesh(device.Get(), id, "sphere.fbx", "checkered.png");
 			physics.AddRigidBody(id, PxTransform{ 0,15,0 }, PxSphereGeometry(2.5f));
 		}
 
 		// another spere object
 		{
-			const std::string id{ "sphere2" };
+			const GG::Entity id = entities.Create("sphere2");
 			renderer.AddShadedMesh(device.Get(), id, "sphere.fbx", "checkered.png");
 			physics.AddRigidBody(id, PxTransform{ 5,25,0 }, PxSphereGeometry(2.5f));
 		}
 
 		// plane object
 		{
-			const std::string id{ "plane" };
+			const GG::Entity id = entities.Create("plane");
 			renderer.AddShadedMesh(device.Get(), id, "plane.obj", "floor.png");
 			physics.AddRigidBody(id, PxTransform{ 0,0,0 }, PxBoxGeometry(PxVec3{ 20, 1, 20 }), true);
 		}
@@ -419,7 +427,7 @@ public:
 		for (int i = -18; i < 18; i += 5) {
 			for (int j = -18; j < 18; j += 5) {
 				for (int k = 5; k < 15; k += 5) {
-					const std::string id{ "cube_" + std::to_string(i) + '-' + std::to_string(j) + '-' + std::to_string(k) };
+					const GG::Entity id = entities.Create("cube_" + std::to_string(i) + '-' + std::to_string(j) + '-' + std::to_string(k));
 					renderer.AddShadedMesh(device.Get(), id, "box.obj", "giraffe.jpg");
 					physics.AddRigidBody(id, PxTransform{ (float)i, (float)k, (float)j }, PxBoxGeometry(PxVec3{ 1, 1, 1 }));
 				}
@@ -428,29 +436,31 @@ public:
 
 		// lights
 		{
-			const std::string id1{ "light1" };
+			const GG::Entity id1 = entities.Create("light1");
 			renderer.AddLight(id1, Float3{ 20,20,20 });
 			physics.AddRigidBody(id1, PxTransform{ 10,10,10 }, PxSphereGeometry(1.f), false);
 
-			const std::string id2{ "light2" };
+			const GG::Entity id2 = entities.Create("light2");
 			renderer.AddLight(id2, Float3{ 20,20,0 });
 			physics.AddRigidBody(id2, PxTransform{ 10,10,-10 }, PxSphereGeometry(1.f), true);
 
-			const std::string id3{ "light3" };
+			const GG::Entity id3 = entities.Create("light3");
 			renderer.AddLight(id3, Float3{ 20,0,0 });
 			physics.AddRigidBody(id3, PxTransform{ -10,10,10 }, PxSphereGeometry(1.f), true);
 
-			const std::string id4{ "light4" };
+			const GG::Entity id4 = entities.Create("light4");
 			renderer.AddLight(id4, Float3{ 0,0,20 });
 			physics.AddRigidBody(id4, PxTransform{ -10,10,-10 }, PxSphereGeometry(1.f), true);
 		}
 
 		// upload textures
 		{
+			// nothing is in flight yet, the allocator of the first frame is free
+			ID3D12CommandAllocator* allocator = commandAllocators[pacer.GetFrame()].Get();
 			DX_API("Failed to reset command allocator (UploadResources)")
-				commandAllocator->Reset();
+				allocator->Reset();
 			DX_API("Failed to reset command list (UploadResources)")
-				commandList->Reset(commandAllocator.Get(), nullptr);
+				commandList->Reset(allocator, nullptr);
 
 			renderer.UploadTextures(commandList.Get());
 
@@ -460,7 +470,7 @@ public:
 			ID3D12CommandList* commandLists[] = { commandList.Get() };
 			commandQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
 
-			WaitForPreviousFrame();
+			WaitForGpu();
 		}
 
 	}
@@ -468,7 +478,7 @@ public:
 	void ReleaseAssets() { }
 
 	void Resize(int width, int height)  {
-		WaitForPreviousFrame();
+		WaitForGpu();
 		ReleaseSwapChainResources();
 		DX_API("Failed to resize swap chain")
 			swapChain->ResizeBuffers(backBufferDepth, 0, 0, DXGI_FORMAT_UNKNOWN, 0);
@@ -481,7 +491,7 @@ public:
 		if (uMsg == WM_KEYDOWN && wParam == VK_SPACE)
 		{
 			int seed = std::chrono::system_clock::now().time_since_epoch().count();
-			const std::string id{ "light" + std::to_string(seed) };
+			const GG::Entity id = entities.Create("light" + std::to_string(seed));
 
 			renderer.AddLight(id, Float3{ 10,10,0 });
 			Float3 pos = renderer.camera->GetEyePosition();
@@ -489,10 +499,16 @@ public:
 			Float3 ahead = renderer.camera->GetAhead() * 1'000.f;
 			physics.AddForce(id, ahead);
 		}
+		if (uMsg == WM_KEYDOWN && wParam == 'P')
+		{
+			pipelinedPhysics = !pipelinedPhysics;
+			physics.SetPipelined(pipelinedPhysics);
+		}
 	}
 
 	void Destroy()  {
-		WaitForPreviousFrame();
+		physics.WaitForSimulation();
+		WaitForGpu();
 		ReleaseSwapChainResources();
 		ReleaseResources();
 		ReleaseAssets();
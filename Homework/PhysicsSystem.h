@@ -1,12 +1,18 @@
 #pragma once
 
 #include <Egg/Common.h>
+#include <Egg/Spatial/Bvh.h>
 
-#include "ConstantBuffer.hpp"
+#include "StructuredBuffer.hpp"
+#include "EntityRegistry.h"
+#include "FixedTimestep.h"
+#include "PxJobDispatcher.h"
 #include "RigidBody.h"
+#include "TransformStore.h"
 
-#include <map>
-#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
 
 #include "physx/PxPhysicsAPI.h"
 #include "physx/foundation/PxSimpleTypes.h"
@@ -14,16 +20,13 @@ using namespace physx;
 
 namespace GG
 {
-	__declspec(align(256)) struct PerObjectCb {
+	// element of the objects structured buffer (t1), shaders find theirs with the object index root constant
+	struct PerObjectData {
 		Float4x4 modelTransform;
 		Float4x4 modelTransformInverse;
 	};
 }
 
-__declspec(align(256)) struct PerObjectCb {
-	GG::PerObjectCb data[1024];
-};
-
 class PxSystem
 {
 
@@ -34,23 +37,82 @@ class PxSystem
 	PxFoundation* gFoundation = nullptr;
 	PxPhysics* gPhysics = nullptr;
 
-	PxDefaultCpuDispatcher* gDispatcher = nullptr;
+	std::unique_ptr<GG::PxJobDispatcher> gDispatcher;
 	PxScene* gScene = nullptr;
 
-	PxReal mAccumulator = 0.0f;
-	PxReal mStepSize = 1.0f / 60.0f;
+	GG::FixedTimestep timestep{ 1.0f / 60.0f };
+	bool interpolate = true;
+
+	// pipelined mode: a step is simulated on the dispatcher threads while the frame is drawn
+	using clock_type = std::chrono::high_resolution_clock;
+	bool pipelined = false;
+	bool simulating = false;
+	uint32_t pendingSteps = 0;
+	std::chrono::time_point<clock_type> simulateStart;
+
+	// physics system resources, one element per body
+	GG::StructuredBuffer<GG::PerObjectData> objects;
+
+	// per-body state in contiguous arrays, indexed by RigidBody::index
+	std::vector<GG::RigidBody::P> rigidBodies;
+	GG::TransformStore transforms;
+	std::vector<PxRigidDynamic*> actors;
+
+	// Entity::index -> RigidBody::index, the generation of the handle is checked against entityOfBody,
+	// so a handle of a destroyed entity does not reach the body of the one reusing its slot
+	std::vector<uint32_t> bodyOfEntity;
+	// RigidBody::index -> Entity
+	std::vector<GG::Entity> entityOfBody;
+
+	// world bounds of the bodies after the last step, in a bvh for scene queries, items are RigidBody::index
+	// moved bodies are refitted every frame, the tree is rebuilt when bodies are added or refitting made it too loose
+	static constexpr float BvhRebuildCostRatio = 1.5f;
+	Egg::Spatial::Bvh bvh;
+	std::vector<Egg::Cull::Aabb> bodyBounds;
+	std::vector<uint32_t> movedBounds;
+	std::vector<uint8_t> isMovedBounds;
+	bool bvhStale = true;
+	float bvhBuiltCost = 0.0f;
+
+	static constexpr uint32_t NoBody = 0xffffffffu;
+
+	// bodies whose matrices changed in each of the last FramesInFlight frames, indexed by frame slot:
+	// the region of a slot is behind by the changes made while the other slots were recorded
+	std::vector<uint32_t> changedInFrame[GG::FramesInFlight];
+	std::vector<uint32_t> uploadList;
+	std::vector<uint8_t> inUploadList;
+
+public:
+
+	struct PipelineStats
+	{
+		uint64_t steps = 0;
+		// frames whose update found the running step unfinished and went on drawing the previous one
+		uint64_t busyPolls = 0;
+		// main thread time between starting a step and collecting it, the time the simulation could overlap with
+		double overlappedSeconds = 0.0;
+		// main thread time spent waiting in fetchResults
+		double blockedSeconds = 0.0;
+	};
+
+	struct UploadStats
+	{
+		uint32_t changedBodies = 0;
+		uint32_t uploadedBodies = 0;
+		uint32_t uploadedRanges = 0;
+		uint64_t uploadedBytes = 0;
+	};
 
-	// physics system resources
-	std::map<std::string, GG::RigidBody::P> rigidBodies;
-	GG::ConstantBuffer<PerObjectCb> perObjectCb;
-	uint32_t objectCount;
+private:
+	PipelineStats pipelineStats;
+	UploadStats uploadStats;
 
 public:
-	PxSystem() : objectCount{ 0 } {  }
+	PxSystem() {  }
 	
-	void StartUp(ID3D12Device* device)
+	void StartUp(ID3D12Device* device, Egg::Jobs::JobSystem& jobs)
 	{
-		perObjectCb.CreateResources(device, sizeof(GG::PerObjectCb));
+		objects.CreateResources(device, 1024, L"Objects");
 
 		gFoundation = PxCreateFoundation(PX_PHYSICS_VERSION, gAllocator, gErrorCallback);
 
@@ -58,44 +120,263 @@ public:
 
 		PxSceneDesc sceneDesc(gPhysics->getTolerancesScale());
 		sceneDesc.gravity = PxVec3(0.0f, -12.f, 0.0f);
-		gDispatcher = PxDefaultCpuDispatcherCreate(2);
-		sceneDesc.cpuDispatcher = gDispatcher;
+		gDispatcher = std::make_unique<GG::PxJobDispatcher>(jobs);
+		sceneDesc.cpuDispatcher = gDispatcher.get();
 		sceneDesc.filterShader = PxDefaultSimulationFilterShader;
+		sceneDesc.flags |= PxSceneFlag::eENABLE_ACTIVE_ACTORS;
 		gScene = gPhysics->createScene(sceneDesc);
 	}
 
-	void Update(float dt)
+	// frame is the slot of the frame being recorded, its region of the constant buffer is written
+	void Update(float dt, uint32_t frame)
+	{
+		const uint32_t steps = timestep.Advance(dt);
+		if (pipelined)
+		{
+			UpdatePipelined(steps);
+		}
+		else
+		{
+			// the writeback only visits the actors the step moved, so every substep is read
+			for (uint32_t s = 0; s < steps; s++)
+			{
+				gScene->simulate(timestep.GetStepSize());
+				gScene->fetchResults(true);
+				ReadPoses();
+			}
+		}
+
+		// the render state of moving bodies is rebuilt every frame, even without a new step
+		transforms.Interpolate(interpolate ? timestep.GetAlpha() : 1.0f);
+		transforms.UpdateMatrices();
+
+		UploadChanged(frame);
+		UpdateBvh();
+	}
+
+	void SetMaxSubsteps(uint32_t n) { timestep.SetMaxSubsteps(n); }
+	void SetCatchUp(GG::FixedTimestep::CatchUp policy, float maxBacklog = 0.25f) { timestep.SetCatchUp(policy, maxBacklog); }
+	void SetInterpolation(bool enabled) { interpolate = enabled; }
+
+	const GG::FixedTimestep& GetTimestep() const { return timestep; }
+
+	void SetPipelined(bool enabled)
 	{
-		mAccumulator += dt;
-		if (mAccumulator > mStepSize)
+		if (!enabled)
+			WaitForSimulation();
+		pipelined = enabled;
+	}
+
+	const PipelineStats& GetPipelineStats() const { return pipelineStats; }
+
+	// the scene can't be read or modified while a step is running, collects it if there is one
+	void WaitForSimulation()
+	{
+		if (simulating)
+			FinishSimulation();
+	}
+
+private:
+
+	// step N+1 is started at the end of the update and runs while the frame is recorded from the snapshot of step N,
+	// results are collected with a non-blocking poll in a later update
+	void UpdatePipelined(uint32_t steps)
+	{
+		pendingSteps += steps;
+
+		if (simulating)
 		{
-			mAccumulator -= mStepSize;
+			if (gScene->checkResults(false))
+				FinishSimulation();
+			else if (pendingSteps > timestep.GetMaxSubsteps())
+				FinishSimulation(); // too far behind, wait for it instead of piling up more steps
+			else
+				pipelineStats.busyPolls++;
+		}
+
+		pendingSteps = std::min(pendingSteps, timestep.GetMaxSubsteps());
 
-			gScene->simulate(mStepSize);
-			gScene->fetchResults(true);
+		if (!simulating && pendingSteps > 0)
+		{
+			pendingSteps--;
+			simulateStart = clock_type::now();
+			gScene->simulate(timestep.GetStepSize());
+			simulating = true;
+		}
+	}
+
+	void FinishSimulation()
+	{
+		auto fetchStart = clock_type::now();
+		gScene->fetchResults(true);
+		auto fetchEnd = clock_type::now();
 
-			for (const auto& [id, rb] : rigidBodies)
+		pipelineStats.steps++;
+		pipelineStats.overlappedSeconds += std::chrono::duration<double>(fetchStart - simulateStart).count();
+		pipelineStats.blockedSeconds += std::chrono::duration<double>(fetchEnd - fetchStart).count();
+
+		simulating = false;
+		ReadPoses();
+	}
+
+public:
+
+	// writeback of the simulated poses of the actors that moved in the last step
+	void ReadPoses()
+	{
+		transforms.BeginStep();
+
+		PxU32 count = 0;
+		PxActor** active = gScene->getActiveActors(count);
+		for (PxU32 i = 0; i < count; i++)
+		{
+			PxRigidDynamic* actor = active[i]->is<PxRigidDynamic>();
+			if (!actor)
+				continue;
+			const PxTransform pose = actor->getGlobalPose();
+			const uint32_t index = (uint32_t)(uintptr_t)actor->userData;
+			transforms.Set(index, ~pose.p, ~pose.q);
+
+			bodyBounds[index] = ToAabb(actor->getWorldBounds());
+			if (!isMovedBounds[index])
 			{
-				rb->Update(dt);
-				perObjectCb->data[rb->index].modelTransform = rb->GetModelMatrix();
-				perObjectCb->data[rb->index].modelTransformInverse = rb->GetModelMatrixInverse();
+				isMovedBounds[index] = 1;
+				movedBounds.push_back(index);
 			}
-			perObjectCb.Upload();
 		}
 	}
 
-	void BindConstantBuffer(ID3D12GraphicsCommandList* commandList, const std::string& id)
+	const Egg::Spatial::Bvh& GetBvh() const { return bvh; }
+
+	GG::Entity GetEntity(uint32_t body) const { return entityOfBody[body]; }
+
+	// the body whose bounds the ray hits first, an invalid entity if there is none
+	GG::Entity Pick(const Float3& origin, const Float3& direction, float maxDistance = 1000.0f) const
 	{
-		commandList->SetGraphicsRootConstantBufferView(
-			1, 
-			perObjectCb.GetGPUVirtualAddress(rigidBodies[id]->index)
-		);
+		Egg::Spatial::Bvh::RayHit hit;
+		return bvh.Raycast(origin, direction, maxDistance, hit) ? entityOfBody[hit.item] : GG::Entity{};
+	}
+
+private:
+
+	static Egg::Cull::Aabb ToAabb(const PxBounds3& bounds) { return Egg::Cull::Aabb{ ~bounds.minimum, ~bounds.maximum }; }
+
+	void UpdateBvh()
+	{
+		if (bvhStale)
+		{
+			bvh.Build(bodyBounds.data(), (uint32_t)bodyBounds.size());
+			bvhBuiltCost = bvh.ComputeCost();
+			bvhStale = false;
+		}
+		else if (!movedBounds.empty())
+		{
+			bvh.Refit(bodyBounds.data(), movedBounds.data(), movedBounds.size());
+			if (bvh.ComputeCost() > BvhRebuildCostRatio * bvhBuiltCost)
+			{
+				bvh.Build(bodyBounds.data(), (uint32_t)bodyBounds.size());
+				bvhBuiltCost = bvh.ComputeCost();
+			}
+		}
+
+		for (uint32_t i : movedBounds)
+			isMovedBounds[i] = 0;
+		movedBounds.clear();
 	}
 
-	GG::RigidBody::P GetRigidBody(const std::string& id) { return rigidBodies[id]; }
+public:
+
+	const UploadStats& GetUploadStats() const { return uploadStats; }
+
+private:
+
+	// copies the matrices of bodies that changed since the region of this frame slot was last written,
+	// neighbouring bodies are copied as one range
+	void UploadChanged(uint32_t frame)
+	{
+		objects.BeginFrame();
+		objects.Resize(transforms.Size());
+
+		const std::vector<uint32_t>& changed = transforms.GetChanged();
+		for (uint32_t i : changed)
+		{
+			objects[i].modelTransform = transforms.GetModelMatrix(i);
+			objects[i].modelTransformInverse = transforms.GetModelMatrixInverse(i);
+		}
+
+		changedInFrame[frame] = changed;
+		transforms.ClearChanged();
+
+		inUploadList.resize(transforms.Size(), 0);
+		uploadList.clear();
+		for (const auto& list : changedInFrame)
+			for (uint32_t i : list)
+				if (!inUploadList[i])
+				{
+					inUploadList[i] = 1;
+					uploadList.push_back(i);
+				}
+		std::sort(uploadList.begin(), uploadList.end());
+
+		uploadStats = UploadStats{};
+		uploadStats.changedBodies = (uint32_t)changedInFrame[frame].size();
+		uploadStats.uploadedBodies = (uint32_t)uploadList.size();
+
+		if (objects.IsStale(frame))
+		{
+			// the buffer grew, this region is filled from scratch
+			uploadStats.uploadedBodies = objects.Size();
+			uploadStats.uploadedRanges = 1;
+			uploadStats.uploadedBytes = objects.Upload(frame);
+		}
+		else
+		{
+			for (size_t first = 0; first < uploadList.size(); )
+			{
+				size_t last = first + 1;
+				while (last < uploadList.size() && uploadList[last] == uploadList[last - 1] + 1)
+					last++;
+
+				uploadStats.uploadedRanges++;
+				uploadStats.uploadedBytes += objects.Upload(frame, uploadList[first], (uint32_t)(last - first));
+				first = last;
+			}
+		}
+
+		for (uint32_t i : uploadList)
+			inUploadList[i] = 0;
+	}
+
+	// body of the entity, asserts that the handle has one and is not stale
+	uint32_t BodyOf(GG::Entity entity) const
+	{
+		ASSERT(HasRigidBody(entity), "Entity #%u (generation %u) has no rigid body", entity.index, entity.generation);
+		return bodyOfEntity[entity.index];
+	}
+
+public:
+
+	// the objects buffer of the frame, bound as a root SRV
+	D3D12_GPU_VIRTUAL_ADDRESS GetObjectsAddress(uint32_t frame) const { return objects.GetGPUVirtualAddress(frame); }
+
+	// index of the entity's element in the objects buffer, passed to the shaders as a root constant
+	uint32_t GetObjectIndex(GG::Entity entity) const { return BodyOf(entity); }
+
+	// false for stale handles too
+	bool HasRigidBody(GG::Entity entity) const
+	{
+		return entity.index < bodyOfEntity.size() && bodyOfEntity[entity.index] != NoBody &&
+			entityOfBody[bodyOfEntity[entity.index]].generation == entity.generation;
+	}
+
+	GG::RigidBody::P GetRigidBody(GG::Entity entity) { return rigidBodies[BodyOf(entity)]; }
+
+	const Float3& GetPosition(GG::Entity entity) const { return transforms.GetPosition(BodyOf(entity)); }
+
+	const Float4x4& GetModelMatrix(GG::Entity entity) const { return transforms.GetModelMatrix(BodyOf(entity)); }
 
 	void AddRigidBody(
-		const std::string& id,
+		GG::Entity entity,
 		const PxTransform& pose,
 		const PxGeometry& geometry = PxSphereGeometry(1.f),
 		bool kinematic = false,
@@ -103,27 +384,39 @@ public:
 		double dFriction = 0.5f,
 		double rest = 0.6f
 	) {
+		ASSERT(!HasRigidBody(entity), "Entity #%u already has a rigid body", entity.index);
+		WaitForSimulation();
 
-		GG::RigidBody::P rb = GG::RigidBody::Create(objectCount, gPhysics, gScene, pose, kinematic);
+		uint32_t index = transforms.Add(~pose.p, ~pose.q);
+		GG::RigidBody::P rb = GG::RigidBody::Create(index, gPhysics, gScene, pose, kinematic);
+		actors.push_back(rb->actor);
 
 		PxMaterial* gMaterial = gPhysics->createMaterial(sFriction, dFriction, rest);
 		PxShape* shape = gPhysics->createShape(geometry, *gMaterial, true);
 		rb->AddShape(shape);
 		shape->release();
 		
-		rigidBodies.insert({ id, rb });
+		rigidBodies.push_back(rb);
+		entityOfBody.push_back(entity);
 
-		objectCount++;
+		bodyBounds.push_back(ToAabb(rb->actor->getWorldBounds()));
+		isMovedBounds.push_back(0);
+		bvhStale = true;
 
+		if (entity.index >= bodyOfEntity.size())
+			bodyOfEntity.resize(entity.index + 1, NoBody);
+		bodyOfEntity[entity.index] = index;
 	}
 
-	void AddForce(const std::string& id, Float3 force) 
+	void AddForce(GG::Entity entity, Float3 force) 
 	{ 
-		rigidBodies[id]->actor->addForce(~force);
+		WaitForSimulation();
+		actors[BodyOf(entity)]->addForce(~force);
 	}
-	void AddTorque(const std::string& id, Float3 torque)
+	void AddTorque(GG::Entity entity, Float3 torque)
 	{
-		rigidBodies[id]->actor->addTorque(~torque);
+		WaitForSimulation();
+		actors[BodyOf(entity)]->addTorque(~torque);
 	}
 
 };
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Egg/Jobs/JobSystem.h>
+
+#include "physx/task/PxCpuDispatcher.h"
+#include "physx/task/PxTask.h"
+
+namespace GG
+{
+	// runs the tasks of a physx scene on the engine's job system, so physics shares the workers with everything else
+	class PxJobDispatcher : public physx::PxCpuDispatcher
+	{
+		Egg::Jobs::JobSystem& jobs;
+
+	public:
+		explicit PxJobDispatcher(Egg::Jobs::JobSystem& jobs) : jobs{ jobs } { }
+
+		void submitTask(physx::PxBaseTask& task) override
+		{
+			// same as PxDefaultCpuDispatcher: the task is released by the thread that ran it
+			jobs.Submit([&task] {
+				task.run();
+				task.release();
+			});
+		}
+
+		uint32_t getWorkerCount() const override { return jobs.GetWorkerCount(); }
+	};
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Egg/Common.h>
+#include <Egg/Utility.h>
+
+namespace GG
+{
+	// an ID3D12Fence signaled from a command queue, the fence FramePacer works with
+	class QueueFence
+	{
+		com_ptr<ID3D12Fence> fence;
+		com_ptr<ID3D12CommandQueue> queue;
+		HANDLE event = NULL;
+
+	public:
+
+		void CreateResources(ID3D12Device* device, ID3D12CommandQueue* commandQueue)
+		{
+			queue = commandQueue;
+
+			DX_API("Failed to create fence")
+				device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(fence.GetAddressOf()));
+
+			event = CreateEvent(NULL, FALSE, FALSE, NULL);
+			if (event == NULL) {
+				DX_API("Failed to create windows event") HRESULT_FROM_WIN32(GetLastError());
+			}
+		}
+
+		void ReleaseResources()
+		{
+			if (event != NULL)
+				CloseHandle(event);
+			event = NULL;
+			fence.Reset();
+			queue.Reset();
+		}
+
+		uint64_t GetCompletedValue() const { return fence->GetCompletedValue(); }
+
+		void Signal(uint64_t value)
+		{
+			DX_API("Failed to signal from command queue")
+				queue->Signal(fence.Get(), value);
+		}
+
+		void Wait(uint64_t value)
+		{
+			DX_API("Failed to sign up for event completion")
+				fence->SetEventOnCompletion(value, event);
+			WaitForSingleObject(event, INFINITE);
+		}
+	};
+}
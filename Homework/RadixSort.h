@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace GG
+{
+	// a 64 bit key and the index of the element it was made for
+	struct KeyIndex
+	{
+		uint64_t key;
+		uint32_t index;
+	};
+
+	// stable lsd radix sort of key/index pairs by key, one pass per byte of the key,
+	// all histograms are built in a single read of the input, and bytes that are the same in every key are skipped,
+	// so keys using few distinct values (a handful of psos and textures) cost only a few passes
+	// scratch is resized to the size of items and can be kept between calls to avoid reallocation
+	inline void RadixSort(std::vector<KeyIndex>& items, std::vector<KeyIndex>& scratch)
+	{
+		const size_t count = items.size();
+		if (count < 2)
+			return;
+		scratch.resize(count);
+
+		uint32_t histograms[8][256] = {};
+		for (const KeyIndex& item : items)
+			for (uint32_t byte = 0; byte < 8; byte++)
+				histograms[byte][(item.key >> (byte * 8)) & 0xff]++;
+
+		KeyIndex* src = items.data();
+		KeyIndex* dst = scratch.data();
+		for (uint32_t byte = 0; byte < 8; byte++)
+		{
+			uint32_t* histogram = histograms[byte];
+			const uint32_t shift = byte * 8;
+
+			// every key has the same value in this byte, the pass would not move anything
+			if (histogram[(src[0].key >> shift) & 0xff] == count)
+				continue;
+
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < 256; digit++)
+			{
+				const uint32_t n = histogram[digit];
+				histogram[digit] = offset;
+				offset += n;
+			}
+
+			for (size_t i = 0; i < count; i++)
+				dst[histogram[(src[i].key >> shift) & 0xff]++] = src[i];
+
+			std::swap(src, dst);
+		}
+
+		// an odd number of passes leaves the result in scratch
+		if (src != items.data())
+			items.swap(scratch);
+	}
+}
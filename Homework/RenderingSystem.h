@@ -5,63 +5,204 @@
 #include <Egg/Math/Math.h>
 using namespace Egg::Math;
 #include <Egg/Cam/FirstPerson.h>
+#include <Egg/Cull/Frustum.h>
+#include <Egg/Cull/LightClusters.h>
+#include <Egg/Cull/OcclusionBuffer.h>
+#include <Egg/Jobs/JobSystem.h>
 
 #include "DescriptorHeap.h"
 #include "GPSO.h"
 #include "Geometry.h"
 #include "Tex2D.h"
-#include "ConstantBuffer.hpp"
-
-#include <map>
+#include "UploadRing.h"
+#include "StructuredBuffer.hpp"
+#include "EntityRegistry.h"
+#include "ShadedMesh.h"
+#include "AssetCache.h"
+#include "FramePacer.h"
+#include "DrawBatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include "PhysicsSystem.h"
 
-// struct for constant buffer uploading
+// element of the lights structured buffer (t2), position.w is 1 / range^2
 struct Light
 {
 	Float4 position, color;
 };
 
+// a light drawn as a small mesh, its position comes from the physics system
+struct LightSource
+{
+	GG::Entity entity;
+	Float3 color; // actually storing just the color (intensity) here
+	float range;
+};
+
 __declspec(align(256)) struct PerFrameCb {
 	Float4x4 viewProjTransform;
 	Float4x4 rayDirTransform;
 	Float4 eyePos;
-	Light lights[64];
-	int nrLights;
+	// depth slice scale and bias, and the grid size of the light clusters
+	Float4 clusterDepth;
+	UInt4 clusterCounts;
 };
 
+// root parameters of the pbr and light root signatures (RootSignatures.hlsli)
+namespace RootParam
+{
+	enum : UINT
+	{
+		PerFrameCb = 0,
+		InstanceBase = 1,
+		Texture = 2,
+		Objects = 3,
+		Lights = 4,
+		Instances = 5,
+		ClusterRanges = 6,
+		ClusterLights = 7,
+
+		LightObjects = 2,
+		LightInstances = 3
+	};
+}
+
 class RenderingSystem
 {
 	// a big heap for everyone :3
 	GG::DescriptorHeap::P heap;
 
-	// camera + lights CBV
-	GG::ConstantBuffer<PerFrameCb> perFrameCb;	
+	// camera + lights CBV, allocated from the upload ring every frame
+	D3D12_GPU_VIRTUAL_ADDRESS perFrameCbAddress = 0;
+	GG::StructuredBuffer<Light> lightBuffer;
 
 	// main rendering resources
 	com_ptr<ID3D12RootSignature> rootSig;
 	GG::GPSO::P gpso;
 
-	std::map<std::string, GG::Geometry::P> geometries;
-	std::map<std::string, GG::Tex2D::P> textures;
-	uint32_t textureCount = 0;
+	// shared resources, meshes refer to them by slot, a texture's slot is also the index of its srv in the heap,
+	// assets no mesh uses any more are unloaded when a cache gets over its budget
+	static constexpr uint64_t GeometryBudget = 256ull << 20;
+	static constexpr uint64_t TextureBudget = 512ull << 20;
+	GG::AssetCache<GG::Geometry> geometries{ "../Media/", GeometryBudget };
+	GG::AssetCache<GG::Tex2D> textures{ "../Media/", TextureBudget };
+	// counts the updates, released assets are unloaded once the frames that could draw them are done
+	uint64_t updateCount = 0;
+	// slots of the textures loaded since the last UploadTextures, their copies are recorded before the next draws
+	std::vector<uint32_t> pendingTextures;
+
+	std::vector<GG::GPSO::P> psos;
+
+	std::vector<GG::ShadedMesh> meshes;
+
+	// frustum culling runs in chunks of CullGrain meshes on the job system, every chunk writes the world space
+	// bounding spheres of its meshes and the indices of the visible ones to its own part of the arrays
+	static constexpr uint32_t CullGrain = 1024;
+	Egg::Jobs::JobSystem* jobs = nullptr;
+	// textures loaded without a cooked file compress their blocks on the same workers
+	std::unique_ptr<GG::JobSystemExecutor> textureExecutor;
+	bool frustumCulling = true;
+	std::vector<float> boundsX, boundsY, boundsZ, boundsRadius;
+	std::vector<uint32_t> visibleMeshes;
+	std::vector<uint32_t> visibleCounts;
+
+	// after frustum culling, the meshes covering most of the screen are rasterized on the cpu
+	// and the other visible meshes are tested against them
+	static constexpr uint32_t MaxOccluders = 8;
+	bool occlusionCulling = true;
+	Egg::Cull::OcclusionBuffer occlusionBuffer;
+	std::vector<std::pair<float, uint32_t>> occluderCandidates;
+	std::vector<uint8_t> occluded;
+
+	// meshes are sorted by pass, pso, texture, geometry and depth, those sharing state are drawn instanced,
+	// the object indices of the instances are written to the upload ring every frame (t3)
+	GG::DrawBatcher batcher;
+	GG::DrawBatcher::Stats batchStats;
+	D3D12_GPU_VIRTUAL_ADDRESS instancesAddress = 0;
+	uint32_t lightInstanceBase = 0;
+
+	// lights are binned into clusters of the view frustum, the pbr shader reads the lights of its pixel's cluster,
+	// the cluster ranges (t4) and light lists (t5) are written to the upload ring every frame
+	Egg::Cull::LightClusters lightClusters;
+	std::vector<Egg::Cull::Sphere> lightSpheres;
+	D3D12_GPU_VIRTUAL_ADDRESS clusterRangesAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS clusterLightsAddress = 0;
 
 	// light (as a mesh) drawing resources
-	std::map<std::string, Float3> lights; // actually storing just the color (intensity) here
+	std::vector<LightSource> lights;
 	com_ptr<ID3D12RootSignature> lightRootSig;
 	GG::GPSO::P lightGpso;
 	GG::Geometry::P lightGeo;
 
+public:
+
+	struct CullStats
+	{
+		uint32_t tested = 0;
+		// in the frustum
+		uint32_t visible = 0;
+		uint32_t occluders = 0;
+		uint32_t occluderTriangles = 0;
+		// in the frustum, but hidden behind the occluders
+		uint32_t occluded = 0;
+		double frustumSeconds = 0.0;
+		double occlusionSeconds = 0.0;
+		double lightClusterSeconds = 0.0;
+	};
+
+private:
+
+	using clock_type = std::chrono::high_resolution_clock;
+	// illuminance (10 * intensity / distance^2 in pbrPS) at which a light's range ends if none is given
+	static constexpr float LightCutoff = 0.02f;
+	CullStats cullStats;
+
 public:
 
 	Egg::Cam::FirstPerson::P camera;
 
 	RenderingSystem() {}
 
+private:
+
+	// issues the batcher's state changes and draws on a d3d command list
+	struct CommandRecorder
+	{
+		RenderingSystem& renderer;
+		ID3D12GraphicsCommandList* commandList;
+
+		void SetPipeline(uint32_t pso) { commandList->SetPipelineState(renderer.psos[pso]->Get()); }
+
+		void SetTexture(uint32_t texture)
+		{
+			commandList->SetGraphicsRootDescriptorTable(
+				RootParam::Texture,
+				renderer.heap->GetGPUHandle(renderer.textures[texture]->index)
+			);
+		}
+
+		void SetGeometry(uint32_t geometry) { renderer.geometries[geometry]->Bind(commandList); }
+
+		void DrawInstanced(uint32_t geometry, uint32_t instanceCount, uint32_t firstInstance)
+		{
+			commandList->SetGraphicsRoot32BitConstant(RootParam::InstanceBase, firstInstance, 0);
+			renderer.geometries[geometry]->DrawInstanced(commandList, instanceCount);
+		}
+	};
+
+public:
+
 	// load/create resources
-	void StartUp(ID3D12Device* device)
+	void StartUp(ID3D12Device* device, Egg::Jobs::JobSystem& jobSystem)
 	{
+		jobs = &jobSystem;
+		textureExecutor = std::make_unique<GG::JobSystemExecutor>(jobSystem);
 
 		heap = GG::DescriptorHeap::Create(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 2048, true);
 
@@ -71,6 +212,7 @@ public:
 			rootSig = Egg::Shader::LoadRootSignature(device, vs.Get());
 
 			gpso = GG::GPSO::Create(device, rootSig.Get(), vs.Get(), ps.Get());
+			psos.push_back(gpso);
 		}
 
 		{
@@ -84,129 +226,333 @@ public:
 		}
 
 		camera = Egg::Cam::FirstPerson::Create()->SetView(Float3(0, 5, -7), Float3(0, 0, 1));
-		perFrameCb.CreateResources(device, sizeof(PerFrameCb));
+		lightBuffer.CreateResources(device, 64, L"Lights");
 
 	}
 
+	// records the copies of the textures loaded since the last call, at startup and from Draw for meshes added later
 	void UploadTextures(ID3D12GraphicsCommandList* commandList)
 	{
-		for (const auto& tex : textures)
-			tex.second->UploadResources(commandList);
+		for (uint32_t slot : pendingTextures)
+			if (textures[slot])
+				textures[slot]->UploadResources(commandList);
+		pendingTextures.clear();
 	}
 
-	void Update(PxSystem* physics, float dt)
+	void Update(PxSystem* physics, GG::UploadRing& uploadRing, float dt, uint32_t frame)
 	{
+		// updates before this one by FramesInFlight or more have been drawn by the gpu
+		updateCount++;
+		if (updateCount > GG::FramesInFlight)
+		{
+			geometries.Trim(updateCount - GG::FramesInFlight);
+			textures.Trim(updateCount - GG::FramesInFlight);
+		}
+
+		camera->Animate(dt);
+		const Float4x4 viewProj = camera->GetViewMatrix() * camera->GetProjMatrix();
+
+		// lights move with their bodies, the whole buffer is written every frame
+		{
+			lightBuffer.BeginFrame();
+			lightBuffer.Resize((uint32_t)lights.size());
+			lightSpheres.resize(lights.size());
+			for (uint32_t i = 0; i < lights.size(); i++)
+			{
+				const Float3 position = physics->GetPosition(lights[i].entity);
+				lightBuffer[i].position = Float4{ position, 1.0f / (lights[i].range * lights[i].range) };
+				lightBuffer[i].color    = Float4{ lights[i].color, 1 };
+				lightSpheres[i] = { position, lights[i].range };
+			}
+			lightBuffer.Upload(frame);
+		}
 
-		// perFrameCb
+		BuildLightClusters(uploadRing);
+
+		// perFrameCb, written straight into the upload heap
 		{
-			camera->Animate(dt);
-			perFrameCb->viewProjTransform = camera->GetViewMatrix() * camera->GetProjMatrix();
+			PerFrameCb* perFrameCb = uploadRing.AllocateConstants<PerFrameCb>(perFrameCbAddress);
+			perFrameCb->viewProjTransform = viewProj;
 			perFrameCb->rayDirTransform = camera->GetRayDirMatrix();
-			perFrameCb->eyePos.xyz = camera->GetEyePosition();
-			perFrameCb->eyePos.w = 1.0f;
-			
-			int i = 0;
-			for (const auto& [id, light] : lights) 
+			perFrameCb->eyePos = Float4{ camera->GetEyePosition(), 1.0f };
+			perFrameCb->clusterDepth = Float4{ lightClusters.GetDepthScale(), lightClusters.GetDepthBias(), 0, 0 };
+			perFrameCb->clusterCounts = UInt4{ lightClusters.GetCountX(), lightClusters.GetCountY(), lightClusters.GetCountZ(), 0 };
+		}
+
+		Cull(physics, viewProj);
+		if (occlusionCulling)
+			CullOccluded(physics, viewProj);
+		else
+			cullStats.occluders = cullStats.occluderTriangles = cullStats.occluded = 0;
+
+		// instance lists: the batched visible meshes, then the lights
+		{
+			// squared distance orders the same as distance
+			const Float3 eye = camera->GetEyePosition();
+			batcher.Clear();
+			for (uint32_t m : visibleMeshes)
 			{
-				perFrameCb->lights[i].position = Float4{ physics->GetRigidBody(id)->GetPosition(), 1 };
-				perFrameCb->lights[i].color    = Float4{ light, 1 };
-				i++;
+				const GG::ShadedMesh& mesh = meshes[m];
+				const float depth = (physics->GetPosition(mesh.entity) - eye).LengthSquared();
+				batcher.Add({ mesh.pso, mesh.texture, mesh.geometry, physics->GetObjectIndex(mesh.entity), depth });
 			}
-			perFrameCb->nrLights = i;
-			
-			perFrameCb.Upload();
+			batcher.Build();
+
+			const std::vector<uint32_t>& instances = batcher.GetInstances();
+			const uint32_t count = (uint32_t)(instances.size() + lights.size());
+			GG::UploadRing::Allocation a = uploadRing.Allocate(std::max(count, 1u) * sizeof(uint32_t));
+			instancesAddress = a.gpuAddress;
+
+			uint32_t* objectIndices = static_cast<uint32_t*>(a.cpuAddress);
+			std::copy(instances.begin(), instances.end(), objectIndices);
+			lightInstanceBase = (uint32_t)instances.size();
+			for (uint32_t i = 0; i < lights.size(); i++)
+				objectIndices[lightInstanceBase + i] = physics->GetObjectIndex(lights[i].entity);
 		}
 
 	}
 
-	void Draw(ID3D12GraphicsCommandList* commandList, PxSystem* physics)
+private:
+
+	// bins the lights into the clusters, a job per depth slice, and copies the cluster tables to the upload ring
+	void BuildLightClusters(GG::UploadRing& uploadRing)
 	{
-		heap->BindHeap(commandList);
+		const clock_type::time_point start = clock_type::now();
+
+		lightClusters.BeginFrame(camera->GetViewMatrix(), camera->GetProjMatrix(), lightSpheres.data(), (uint32_t)lightSpheres.size());
+		jobs->ParallelFor(0, lightClusters.GetCountZ(), 1, [&](uint32_t first, uint32_t last) {
+			for (uint32_t z = first; z < last; z++)
+				lightClusters.BinSlice(z);
+		});
+		lightClusters.Finish();
+
+		const std::vector<Egg::Cull::LightClusters::Range>& ranges = lightClusters.GetRanges();
+		GG::UploadRing::Allocation a = uploadRing.Allocate((uint32_t)(ranges.size() * sizeof(Egg::Cull::LightClusters::Range)));
+		std::copy(ranges.begin(), ranges.end(), static_cast<Egg::Cull::LightClusters::Range*>(a.cpuAddress));
+		clusterRangesAddress = a.gpuAddress;
+
+		const std::vector<uint32_t>& indices = lightClusters.GetIndices();
+		a = uploadRing.Allocate((uint32_t)(std::max<size_t>(indices.size(), 1) * sizeof(uint32_t)));
+		std::copy(indices.begin(), indices.end(), static_cast<uint32_t*>(a.cpuAddress));
+		clusterLightsAddress = a.gpuAddress;
+
+		cullStats.lightClusterSeconds = std::chrono::duration<double>(clock_type::now() - start).count();
+	}
 
-		// sort of render passes ?
-		commandList->SetGraphicsRootSignature(rootSig.Get());
-		commandList->SetPipelineState(gpso->Get());
-		commandList->SetGraphicsRootConstantBufferView(0, perFrameCb.GetGPUVirtualAddress());
+	// finds the meshes whose bounding sphere touches the view frustum, into visibleMeshes, in increasing order
+	void Cull(PxSystem* physics, const Float4x4& viewProj)
+	{
+		const clock_type::time_point start = clock_type::now();
+
+		const Egg::Cull::Frustum frustum = Egg::Cull::Frustum::FromViewProj(viewProj);
+		const uint32_t meshCount = (uint32_t)meshes.size();
+		boundsX.resize(meshCount);
+		boundsY.resize(meshCount);
+		boundsZ.resize(meshCount);
+		boundsRadius.resize(meshCount);
+		visibleMeshes.resize(meshCount);
+		visibleCounts.assign((meshCount + CullGrain - 1) / CullGrain, 0);
+
+		jobs->ParallelFor(0, meshCount, CullGrain, [&](uint32_t first, uint32_t last) {
+			for (uint32_t i = first; i < last; i++)
+			{
+				// bodies are only moved and rotated, the radius stays the same
+				const Egg::Cull::Sphere& sphere = geometries[meshes[i].geometry]->GetBoundingSphere();
+				const Float4 center = physics->GetModelMatrix(meshes[i].entity).Transform(Float4{ sphere.center, 1.0f });
+				boundsX[i] = center.x;
+				boundsY[i] = center.y;
+				boundsZ[i] = center.z;
+				boundsRadius[i] = sphere.radius;
+			}
 
-		for (const auto& [id, geometry] : geometries)
+			uint32_t& visibleCount = visibleCounts[first / CullGrain];
+			if (frustumCulling)
+			{
+				visibleCount = (uint32_t)Egg::Cull::CullSpheres(
+					frustum,
+					&boundsX[first], &boundsY[first], &boundsZ[first], &boundsRadius[first],
+					last - first,
+					&visibleMeshes[first], first);
+			}
+			else
+			{
+				for (uint32_t i = first; i < last; i++)
+					visibleMeshes[i] = i;
+				visibleCount = last - first;
+			}
+		});
+
+		// the chunks' visible lists are moved together, always to the front of their own chunk, which copy allows
+		// as long as the destination does not start inside the source: lists already in place are not copied
+		uint32_t visibleCount = 0;
+		for (uint32_t chunk = 0; chunk < visibleCounts.size(); chunk++)
 		{
+			if (visibleCount != chunk * CullGrain)
+				std::copy_n(&visibleMeshes[chunk * CullGrain], visibleCounts[chunk], &visibleMeshes[visibleCount]);
+			visibleCount += visibleCounts[chunk];
+		}
+		visibleMeshes.resize(visibleCount);
 
-			physics->BindConstantBuffer(commandList, id);
+		cullStats.tested = meshCount;
+		cullStats.visible = visibleCount;
+		cullStats.frustumSeconds = std::chrono::duration<double>(clock_type::now() - start).count();
+	}
 
-			commandList->SetGraphicsRootDescriptorTable(
-				2, 
-				heap->GetGPUHandle(textures[id]->index)
-			);
-			
-			geometry->Draw(commandList);
+	// removes the meshes hidden behind the biggest ones on screen from visibleMeshes
+	void CullOccluded(PxSystem* physics, const Float4x4& viewProj)
+	{
+		const clock_type::time_point start = clock_type::now();
 
+		// bounding sphere radius over distance, squared, ranks the meshes by the size they cover on screen
+		const Float3 eye = camera->GetEyePosition();
+		occluderCandidates.clear();
+		for (uint32_t i = 0; i < visibleMeshes.size(); i++)
+		{
+			const uint32_t m = visibleMeshes[i];
+			const Float3 toMesh = Float3{ boundsX[m], boundsY[m], boundsZ[m] } - eye;
+			const float distanceSquared = std::max(toMesh.LengthSquared(), 1e-4f);
+			occluderCandidates.push_back({ boundsRadius[m] * boundsRadius[m] / distanceSquared, i });
 		}
+		const size_t occluderCount = std::min<size_t>(MaxOccluders, occluderCandidates.size());
+		std::partial_sort(occluderCandidates.begin(), occluderCandidates.begin() + occluderCount, occluderCandidates.end(),
+			[](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.first > b.first; });
 
-		// draw lights
+		occlusionBuffer.BeginFrame(viewProj);
+		for (size_t k = 0; k < occluderCount; k++)
 		{
-			commandList->SetGraphicsRootSignature(lightRootSig.Get());
-			commandList->SetPipelineState(lightGpso->Get());
-			commandList->SetGraphicsRootConstantBufferView(0, perFrameCb.GetGPUVirtualAddress());
+			const GG::ShadedMesh& mesh = meshes[visibleMeshes[occluderCandidates[k].second]];
+			const GG::Geometry::P& geometry = geometries[mesh.geometry];
+			occlusionBuffer.AddOccluder(
+				physics->GetModelMatrix(mesh.entity),
+				geometry->GetPositions().data(), geometry->GetPositions().size(),
+				geometry->GetTriangleIndices().data(), geometry->GetTriangleIndices().size());
+		}
+
+		jobs->ParallelFor(0, occlusionBuffer.GetTileCount(), 4, [&](uint32_t first, uint32_t last) {
+			for (uint32_t tile = first; tile < last; tile++)
+				occlusionBuffer.RasterizeTile(tile);
+		});
+		occlusionBuffer.BuildHierarchy();
 
-			for (const auto& [id, light] : lights)
+		occluded.assign(visibleMeshes.size(), 0);
+		jobs->ParallelFor(0, (uint32_t)visibleMeshes.size(), CullGrain, [&](uint32_t first, uint32_t last) {
+			for (uint32_t i = first; i < last; i++)
 			{
-				physics->BindConstantBuffer(commandList, id);
-				lightGeo->Draw(commandList);
+				const GG::ShadedMesh& mesh = meshes[visibleMeshes[i]];
+				const Egg::Cull::Aabb box = Egg::Cull::Transform(geometries[mesh.geometry]->GetAabb(), physics->GetModelMatrix(mesh.entity));
+				occluded[i] = occlusionBuffer.IsOccluded(box) ? 1 : 0;
 			}
+		});
+
+		// an occluder's front faces lie on its own box, rounding could make it hide itself
+		for (size_t k = 0; k < occluderCount; k++)
+			occluded[occluderCandidates[k].second] = 0;
+
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < visibleMeshes.size(); i++)
+			if (!occluded[i])
+				visibleMeshes[kept++] = visibleMeshes[i];
+
+		cullStats.occluders = (uint32_t)occluderCount;
+		cullStats.occluderTriangles = occlusionBuffer.GetStats().triangles;
+		cullStats.occluded = (uint32_t)visibleMeshes.size() - kept;
+		cullStats.occlusionSeconds = std::chrono::duration<double>(clock_type::now() - start).count();
+		visibleMeshes.resize(kept);
+	}
+
+public:
+
+	void Draw(ID3D12GraphicsCommandList* commandList, PxSystem* physics, uint32_t frame)
+	{
+		UploadTextures(commandList);
 
+		heap->BindHeap(commandList);
+
+		// sort of render passes ?
+		commandList->SetGraphicsRootSignature(rootSig.Get());
+		commandList->SetGraphicsRootConstantBufferView(RootParam::PerFrameCb, perFrameCbAddress);
+		commandList->SetGraphicsRootShaderResourceView(RootParam::Objects, physics->GetObjectsAddress(frame));
+		commandList->SetGraphicsRootShaderResourceView(RootParam::Lights, lightBuffer.GetGPUVirtualAddress(frame));
+		commandList->SetGraphicsRootShaderResourceView(RootParam::Instances, instancesAddress);
+		commandList->SetGraphicsRootShaderResourceView(RootParam::ClusterRanges, clusterRangesAddress);
+		commandList->SetGraphicsRootShaderResourceView(RootParam::ClusterLights, clusterLightsAddress);
+
+		CommandRecorder recorder{ *this, commandList };
+		batchStats = batcher.Record(recorder);
+
+		// draw lights, one instanced draw for all of them
+		if (!lights.empty())
+		{
+			commandList->SetGraphicsRootSignature(lightRootSig.Get());
+			commandList->SetPipelineState(lightGpso->Get());
+			commandList->SetGraphicsRootConstantBufferView(RootParam::PerFrameCb, perFrameCbAddress);
+			commandList->SetGraphicsRootShaderResourceView(RootParam::LightObjects, physics->GetObjectsAddress(frame));
+			commandList->SetGraphicsRootShaderResourceView(RootParam::LightInstances, instancesAddress);
+			commandList->SetGraphicsRoot32BitConstant(RootParam::InstanceBase, lightInstanceBase, 0);
+
+			lightGeo->Draw(commandList, (uint32_t)lights.size());
 		}
 
 	}
 
 	void AddShadedMesh(
 		ID3D12Device* device,
-		const std::string& id,
+		GG::Entity entity,
 		const std::string& meshPath,
 		const std::string& texPath
 	) {
 
-		// check if geo isn't already imported (not pretty)
-		GG::Geometry::P newGeo{ nullptr };
-		{
-			
-			for (const auto& [id, geo] : geometries)
-			{
-				if (geo->path == meshPath)
-					newGeo = geo;
-			}
-		
-			if(!newGeo)
-				newGeo = GG::Geometry::Create(device, meshPath);
-
-		}
-		geometries.insert({ id, newGeo });
+		const uint32_t geometry = geometries.Acquire(meshPath, [&](const std::string& path, uint32_t) {
+			GG::Geometry::P newGeo = GG::Geometry::Create(device, path);
+			const uint64_t size = newGeo->GetSizeInBytes();
+			return std::make_pair(newGeo, size);
+		});
+
+		const uint32_t texture = textures.Acquire(texPath, [&](const std::string& path, uint32_t slot) {
+			GG::Tex2D::P newTex = GG::Tex2D::Create(device, heap, path, GG::TextureCompression::Auto, textureExecutor.get());
+			newTex->CreateSrv(device, heap, slot);
+			pendingTextures.push_back(slot);
+			const uint64_t size = newTex->GetSizeInBytes();
+			return std::make_pair(newTex, size);
+		});
+
+		ASSERT(GG::SortKey::Fits(0, texture, geometry), "Too many geometries or textures for the draw sort key");
+		meshes.push_back({ entity, geometry, texture, 0 });
+	}
 
-		// same for texture
-		GG::Tex2D::P newTex{ nullptr };
-		{
-			
-			for (const auto& [id, tex] : textures)
+	// stops drawing the entity's mesh and releases its geometry and texture
+	void RemoveShadedMesh(GG::Entity entity)
+	{
+		for (size_t i = 0; i < meshes.size(); i++)
+			if (meshes[i].entity == entity)
 			{
-				if (tex->path == texPath)
-					newTex = tex;
+				geometries.Release(meshes[i].geometry, updateCount);
+				textures.Release(meshes[i].texture, updateCount);
+				meshes[i] = meshes.back();
+				meshes.pop_back();
+				return;
 			}
+	}
 
-			if (!newTex)
-			{
-				newTex = GG::Tex2D::Create(device, heap, texPath);
-				newTex->CreateSrv(device, heap, textureCount);
-				textureCount++;
-			}
+	const GG::AssetCache<GG::Geometry>::Stats& GetGeometryCacheStats() const { return geometries.GetStats(); }
+	const GG::AssetCache<GG::Tex2D>::Stats& GetTextureCacheStats() const { return textures.GetStats(); }
 
-		}
-		textures.insert({ id, newTex });
-	}
+	const GG::DrawBatcher::Stats& GetBatchStats() const { return batchStats; }
+
+	void SetFrustumCulling(bool enabled) { frustumCulling = enabled; }
+	void SetOcclusionCulling(bool enabled) { occlusionCulling = enabled; }
+	const CullStats& GetCullStats() const { return cullStats; }
+	const Egg::Cull::LightClusters::Stats& GetLightClusterStats() const { return lightClusters.GetStats(); }
 
+	// range 0 means up to where the light gets dimmer than LightCutoff
 	void AddLight(
-		const std::string& id,
-		Float3 color
+		GG::Entity entity,
+		Float3 color,
+		float range = 0.0f
 	) {
-		lights.insert({ id, color });
+		if (range <= 0.0f)
+			range = std::sqrt(10.0f * std::max(std::max(color.x, std::max(color.y, color.z)), LightCutoff) / LightCutoff);
+		lights.push_back({ entity, color, range });
 	}
 
 	void ProcessMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam) 
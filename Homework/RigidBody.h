@@ -12,11 +12,9 @@ namespace GG
 {
 	GG_CLASS(RigidBody)
 
-		Float4x4 modelMatrix;
-		Float3 position;
-
 	public:
 
+		// slot of the body in the physics system's TransformStore
 		int index;
 		PxRigidDynamic* actor;
 
@@ -24,27 +22,13 @@ namespace GG
 			: index{ index }
 		{
 			actor = gPhysics->createRigidDynamic(pose);
+			// active actor reports are mapped back to the body through this
+			actor->userData = reinterpret_cast<void*>((uintptr_t)index);
 			actor->setRigidBodyFlag(PxRigidBodyFlag::eKINEMATIC, kinematic);
 			gScene->addActor(*actor);
 		}
 
 		void AddShape(PxShape* shape) { actor->attachShape(*shape); }
 
-		void Update(float dt)
-		{
-			PxTransform m = actor->getGlobalPose();
-
-			float angle;
-			Float3 axis;
-			toRadiansAndUnitAxis(m.q, angle, ~axis);
-			
-			position = ~m.p;
-			modelMatrix = Float4x4::Rotation(axis, angle) * Float4x4::Translation(position);
-		}
-
-		Float3   GetPosition()    { return position; }
-		Float4x4 GetModelMatrix() { return modelMatrix; }
-		Float4x4 GetModelMatrixInverse() { return modelMatrix.Invert(); }
-
 	GG_ENDCLASS
 }
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+namespace GG
+{
+	// hands out byte ranges of a ring front to back, the ranges of a frame are reclaimed at once
+	// when the gpu has passed the fence value the frame ended with
+	// only does the bookkeeping, no d3d, so it can be driven with made up sizes and fence values
+	class RingAllocator
+	{
+	public:
+		static constexpr uint64_t InvalidOffset = ~0ull;
+
+		struct Stats
+		{
+			uint64_t allocatedThisFrame = 0;
+			uint64_t allocatedLastFrame = 0;
+			uint64_t peakUsed = 0;
+			uint64_t failedAllocations = 0;
+		};
+
+	private:
+		struct FrameMark
+		{
+			uint64_t fenceValue;
+			uint64_t end;
+		};
+
+		uint64_t capacity;
+
+		// head and tail only grow, the offset in the ring is their value modulo capacity
+		uint64_t head = 0;
+		uint64_t tail = 0;
+		std::deque<FrameMark> frames;
+
+		Stats stats;
+
+	public:
+
+		explicit RingAllocator(uint64_t capacity = 0) : capacity{ capacity } { }
+
+		// returns the offset in the ring or InvalidOffset if the frames still in flight hold too much of it,
+		// alignment has to be a power of two
+		uint64_t Allocate(uint64_t size, uint64_t alignment)
+		{
+			// nothing in flight, start over at the beginning of the ring
+			if (head == tail && frames.empty())
+				head = tail = 0;
+
+			const uint64_t position = head % capacity;
+			uint64_t offset = (position + alignment - 1) & ~(alignment - 1);
+
+			// a range is never split at the end of the ring, the rest of the lap is skipped
+			if (offset + size > capacity)
+				offset = 0;
+
+			const uint64_t skipped = (offset >= position) ? offset - position : capacity - position;
+			const uint64_t newHead = head + skipped + size;
+			if (size > capacity || newHead - tail > capacity)
+			{
+				stats.failedAllocations++;
+				return InvalidOffset;
+			}
+
+			stats.allocatedThisFrame += newHead - head;
+			head = newHead;
+			if (head - tail > stats.peakUsed)
+				stats.peakUsed = head - tail;
+			return offset;
+		}
+
+		// everything allocated since the previous call belongs to the frame signaling fenceValue
+		void EndFrame(uint64_t fenceValue)
+		{
+			frames.push_back({ fenceValue, head });
+			stats.allocatedLastFrame = stats.allocatedThisFrame;
+			stats.allocatedThisFrame = 0;
+		}
+
+		// frees the ranges of the frames with fence values up to completedValue
+		void Reclaim(uint64_t completedValue)
+		{
+			while (!frames.empty() && frames.front().fenceValue <= completedValue)
+			{
+				tail = frames.front().end;
+				frames.pop_front();
+			}
+		}
+
+		uint64_t GetCapacity() const { return capacity; }
+		uint64_t GetUsed() const { return head - tail; }
+		const Stats& GetStats() const { return stats; }
+	};
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "EntityRegistry.h"
+
+#include <cstdint>
+
+namespace GG
+{
+	// a drawable entity, the renderer keeps these in a dense array,
+	// geometry, texture and pso are indices into the renderer's tables
+	struct ShadedMesh
+	{
+		Entity entity;
+		uint32_t geometry;
+		uint32_t texture;
+		uint32_t pso;
+	};
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <Egg/Common.h>
+#include <Egg/Utility.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "FramePacer.h"
+
+namespace GG
+{
+	// array of T in an upload heap, read by shaders through a root SRV, one region per frame in flight
+	// it grows geometrically, a replaced resource is kept until the frames that may still read it are done
+	template <typename T>
+	class StructuredBuffer {
+
+		struct Retired
+		{
+			com_ptr<ID3D12Resource> resource;
+			uint32_t framesLeft;
+		};
+
+		com_ptr<ID3D12Device> device;
+		com_ptr<ID3D12Resource> resource;
+		uint8_t* mappedPtr = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS address = 0;
+		uint32_t capacity = 0;
+		std::wstring name;
+
+		std::vector<T> data;
+		// the region doesn't hold the data yet (after growing), the next upload copies the whole array
+		bool stale[FramesInFlight];
+		std::vector<Retired> retired;
+
+		void Allocate(uint32_t newCapacity)
+		{
+			if (resource)
+			{
+				resource->Unmap(0, nullptr);
+				retired.push_back({ resource, FramesInFlight });
+				resource.Reset();
+			}
+
+			capacity = newCapacity;
+
+			CD3DX12_HEAP_PROPERTIES heapProp{ D3D12_HEAP_TYPE_UPLOAD };
+			CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer((UINT64)capacity * sizeof(T) * FramesInFlight);
+
+			DX_API("Failed to create structured buffer resource")
+				device->CreateCommittedResource(
+					&heapProp,
+					D3D12_HEAP_FLAG_NONE,
+					&resourceDesc,
+					D3D12_RESOURCE_STATE_GENERIC_READ,
+					nullptr,
+					IID_PPV_ARGS(resource.GetAddressOf())
+				);
+
+			CD3DX12_RANGE rr(0, 0);
+			DX_API("Failed to map structured buffer")
+				resource->Map(0, &rr, reinterpret_cast<void**>(&mappedPtr));
+
+			resource->SetName(name.c_str());
+			address = resource->GetGPUVirtualAddress();
+
+			std::fill(std::begin(stale), std::end(stale), true);
+		}
+
+	public:
+
+		StructuredBuffer() { }
+
+		void CreateResources(ID3D12Device* device, uint32_t initialCapacity, const std::wstring& name)
+		{
+			this->device = device;
+			this->name = name;
+			Allocate(std::max(initialCapacity, 1u));
+		}
+
+		void ReleaseResources()
+		{
+			if (resource)
+				resource->Unmap(0, nullptr);
+			resource.Reset();
+			retired.clear();
+			device.Reset();
+			mappedPtr = nullptr;
+		}
+
+		~StructuredBuffer() { ReleaseResources(); }
+
+		// grows the gpu buffer to at least twice its size if count doesn't fit
+		void Resize(uint32_t count)
+		{
+			data.resize(count);
+			if (count > capacity)
+				Allocate(std::max(count, capacity * 2));
+		}
+
+		uint32_t Size() const { return (uint32_t)data.size(); }
+		uint32_t GetCapacity() const { return capacity; }
+
+		T& operator[](uint32_t index) { return data[index]; }
+		const T& operator[](uint32_t index) const { return data[index]; }
+
+		// once per frame, releases the resources replaced at least FramesInFlight frames ago
+		void BeginFrame()
+		{
+			for (auto& r : retired)
+				r.framesLeft--;
+			retired.erase(
+				std::remove_if(retired.begin(), retired.end(), [](const Retired& r) { return r.framesLeft == 0; }),
+				retired.end());
+		}
+
+		// copies elements [first, first + count) into the region of the frame, the whole array if the region is stale
+		// returns the number of bytes copied
+		size_t Upload(uint32_t frame, uint32_t first, uint32_t count)
+		{
+			if (stale[frame])
+			{
+				stale[frame] = false;
+				first = 0;
+				count = Size();
+			}
+			const size_t bytes = (size_t)count * sizeof(T);
+			memcpy(mappedPtr + ((size_t)frame * capacity + first) * sizeof(T), data.data() + first, bytes);
+			return bytes;
+		}
+
+		size_t Upload(uint32_t frame) { return Upload(frame, 0, Size()); }
+
+		bool IsStale(uint32_t frame) const { return stale[frame]; }
+
+		D3D12_GPU_VIRTUAL_ADDRESS GetGPUVirtualAddress(uint32_t frame) const { return address + (UINT64)frame * capacity * sizeof(T); }
+	};
+}
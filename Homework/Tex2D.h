@@ -4,8 +4,10 @@
 #include <DirectXTex/DirectXTex.h>
 
 #include <string>
+#include <vector>
 
 #include "DescriptorHeap.h"
+#include "TextureProcessing.h"
 
 namespace GG
 {
@@ -14,31 +16,50 @@ namespace GG
 		com_ptr<ID3D12Resource> resource;
 		com_ptr<ID3D12Resource> uploadResource;
 		D3D12_RESOURCE_DESC rdsc;
+		// where every mip is in the upload buffer
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints;
+		// the texture and its upload buffer
+		uint64_t byteSize = 0;
+		TextureProcessingStats stats;
 
 	public:
 
 		int index;
 		std::string path;
 
-		Tex2D(ID3D12Device* device, GG::DescriptorHeap::A heap, const std::string &filePath)
+		// executor compresses the blocks of an uncooked texture, on threads started for it when null
+		Tex2D(ID3D12Device* device, GG::DescriptorHeap::A heap, const std::string &filePath,
+			TextureCompression compression = TextureCompression::Auto, DirectX::IParallelExecutor* executor = nullptr)
 			:path{ filePath }
 		{
 			// create resource for texture uploading
 			{
 				std::wstring wstr = Egg::Utility::WFormat(L"../Media/%S", filePath.c_str());
+				std::wstring cookedPath = TextureProcessing::GetCookedPath(filePath);
 
-				DirectX::TexMetadata metaData;
+				// all mips, block compressed unless the size does not allow it,
+				// from the cooker's dds if it is up to date and in the format asked for, processed here otherwise
 				DirectX::ScratchImage sImage;
 
-				DX_API("Failed to load image: %s", filePath.c_str())
-					DirectX::LoadFromWICFile(wstr.c_str(), 0, &metaData, sImage);
+				if (TextureProcessing::IsCookedUsable(wstr, cookedPath, compression))
+				{
+					DX_API("Failed to load cooked image: %s", filePath.c_str())
+						TextureProcessing::LoadCooked(cookedPath, sImage, stats);
+				}
+				else
+				{
+					DX_API("Failed to load image: %s", filePath.c_str())
+						TextureProcessing::LoadAndProcess(wstr, compression, sImage, stats, DirectX::TEX_COMPRESS_PARALLEL, executor);
+				}
+
+				const DirectX::TexMetadata& metaData = sImage.GetMetadata();
 
 				ZeroMemory(&rdsc, sizeof(D3D12_RESOURCE_DESC));
 				rdsc.DepthOrArraySize = 1;
 				rdsc.Height = (unsigned int)metaData.height;
 				rdsc.Width = (unsigned int)metaData.width;
 				rdsc.Format = metaData.format;
-				rdsc.MipLevels = 1;
+				rdsc.MipLevels = (UINT16)metaData.mipLevels;
 				rdsc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
 				rdsc.Alignment = 0;
 				rdsc.SampleDesc.Count = 1;
@@ -59,8 +80,15 @@ namespace GG
 						IID_PPV_ARGS(resource.GetAddressOf())
 					);
 
+				// rows of the upload buffer are aligned, they are copied one by one from the tightly packed image
+				const UINT mipCount = rdsc.MipLevels;
+				std::vector<UINT> numRows(mipCount);
+				std::vector<UINT64> rowSizes(mipCount);
+				footprints.resize(mipCount);
+
 				UINT64 copyableSize;
-				device->GetCopyableFootprints(&rdsc, 0, 1, 0, nullptr, nullptr, nullptr, &copyableSize);
+				device->GetCopyableFootprints(&rdsc, 0, mipCount, 0, footprints.data(), numRows.data(), rowSizes.data(), &copyableSize);
+				byteSize = 2 * copyableSize;
 
 				CD3DX12_RESOURCE_DESC copyableSizeDesc = CD3DX12_RESOURCE_DESC::Buffer(copyableSize);
 
@@ -79,7 +107,13 @@ namespace GG
 				DX_API("Failed to map upload resource")
 					uploadResource->Map(0, &readRange, &texPtr);
 
-				memcpy(texPtr, sImage.GetPixels(), sImage.GetPixelsSize());
+				for (UINT mip = 0; mip < mipCount; mip++)
+				{
+					const DirectX::Image* image = sImage.GetImage(mip, 0, 0);
+					uint8_t* dst = static_cast<uint8_t*>(texPtr) + footprints[mip].Offset;
+					for (UINT row = 0; row < numRows[mip]; row++)
+						memcpy(dst + row * footprints[mip].Footprint.RowPitch, image->pixels + row * image->rowPitch, (size_t)rowSizes[mip]);
+				}
 
 				uploadResource->Unmap(0, nullptr);
 			}
@@ -102,16 +136,12 @@ namespace GG
 
 		void UploadResources(ID3D12GraphicsCommandList* commandList)
 		{
-			CD3DX12_TEXTURE_COPY_LOCATION dst{ resource.Get(), 0 };
-			D3D12_PLACED_SUBRESOURCE_FOOTPRINT psf;
-			psf.Offset = 0;
-			psf.Footprint.Depth = 1;
-			psf.Footprint.Height = rdsc.Height;
-			psf.Footprint.Width = rdsc.Width;
-			psf.Footprint.RowPitch = (DirectX::BitsPerPixel(rdsc.Format) / 8U) * rdsc.Width;
-			psf.Footprint.Format = rdsc.Format;
-			CD3DX12_TEXTURE_COPY_LOCATION src{ uploadResource.Get(), psf };
-			commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+			for (UINT mip = 0; mip < (UINT)footprints.size(); mip++)
+			{
+				CD3DX12_TEXTURE_COPY_LOCATION dst{ resource.Get(), mip };
+				CD3DX12_TEXTURE_COPY_LOCATION src{ uploadResource.Get(), footprints[mip] };
+				commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+			}
 
 			CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(
 				resource.Get(),
@@ -124,5 +154,10 @@ namespace GG
 
 		int GetIndex() { return index; }
 
+		uint64_t GetSizeInBytes() const { return byteSize; }
+
+		// size, format and processing times of the mips
+		const TextureProcessingStats& GetStats() const { return stats; }
+
 	GG_ENDCLASS
 }
\ No newline at end of file
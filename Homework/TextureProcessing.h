@@ -0,0 +1,234 @@
+#pragma once
+
+#include <Egg/Common.h>
+#include <Egg/Jobs/JobSystem.h>
+#include <DirectXTex/DirectXTex.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace GG
+{
+	// block compression of a texture's mips, Auto picks BC1 for opaque images and BC3 for ones with alpha
+	enum class TextureCompression
+	{
+		None,
+		BC1,
+		BC3,
+		// two channels, for normal maps
+		BC5,
+		// best quality, slowest to compress
+		BC7,
+		Auto
+	};
+
+	struct TextureProcessingStats
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 0;
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		// the decoded image
+		uint64_t sourceBytes = 0;
+		// all mips before compression
+		uint64_t uncompressedBytes = 0;
+		// all mips as uploaded
+		uint64_t processedBytes = 0;
+		double decodeSeconds = 0.0;
+		double mipSeconds = 0.0;
+		double compressSeconds = 0.0;
+	};
+
+	// Lets DirectXTex compress blocks on the engine's workers instead of threads of its own, one job per range of block rows
+	class JobSystemExecutor : public DirectX::IParallelExecutor
+	{
+		Egg::Jobs::JobSystem& jobs;
+
+	public:
+		explicit JobSystemExecutor(Egg::Jobs::JobSystem& jobs) : jobs{ jobs } {}
+
+		void __cdecl ParallelFor(size_t count, const std::function<void __cdecl(size_t first, size_t last)>& work) override
+		{
+			jobs.ParallelFor(0, (uint32_t)count, 1, [&](uint32_t first, uint32_t last) { work(first, last); });
+		}
+	};
+
+	namespace TextureProcessing
+	{
+		inline uint64_t GetPixelsSize(const DirectX::ScratchImage& image)
+		{
+			uint64_t size = 0;
+			for (size_t i = 0; i < image.GetImageCount(); i++)
+				size += image.GetImages()[i].slicePitch;
+			return size;
+		}
+
+		inline DXGI_FORMAT GetFormat(TextureCompression compression, const DirectX::ScratchImage& image)
+		{
+			switch (compression)
+			{
+			case TextureCompression::BC1: return DXGI_FORMAT_BC1_UNORM;
+			case TextureCompression::BC3: return DXGI_FORMAT_BC3_UNORM;
+			case TextureCompression::BC5: return DXGI_FORMAT_BC5_UNORM;
+			case TextureCompression::BC7: return DXGI_FORMAT_BC7_UNORM;
+			case TextureCompression::Auto: return image.IsAlphaAllOpaque() ? DXGI_FORMAT_BC1_UNORM : DXGI_FORMAT_BC3_UNORM;
+			default: return DXGI_FORMAT_UNKNOWN;
+			}
+		}
+
+		/*
+		Builds the full mip chain of a decoded 2d image and compresses it, no device needed.
+		Block compressed textures must have a top level that is a whole number of 4x4 blocks,
+		other sizes are left uncompressed. compressFlags are DirectX::TEX_COMPRESS_FLAGS, by default the blocks
+		are compressed on all cores, on threads started for it unless an executor (a JobSystemExecutor) is given.
+		*/
+		inline HRESULT Process(
+			DirectX::ScratchImage&& decoded,
+			TextureCompression compression,
+			DirectX::ScratchImage& result,
+			TextureProcessingStats& stats,
+			DWORD compressFlags = DirectX::TEX_COMPRESS_PARALLEL,
+			DirectX::IParallelExecutor* executor = nullptr)
+		{
+			using clock_type = std::chrono::high_resolution_clock;
+
+			const DirectX::TexMetadata metadata = decoded.GetMetadata();
+			stats.width = (uint32_t)metadata.width;
+			stats.height = (uint32_t)metadata.height;
+			stats.sourceBytes = GetPixelsSize(decoded);
+
+			clock_type::time_point start = clock_type::now();
+			DirectX::ScratchImage mipChain;
+			if (metadata.mipLevels > 1)
+				mipChain = std::move(decoded);
+			else
+			{
+				HRESULT hr = DirectX::GenerateMipMaps(*decoded.GetImage(0, 0, 0), DirectX::TEX_FILTER_DEFAULT, 0, mipChain);
+				if (FAILED(hr))
+					return hr;
+			}
+			stats.mipSeconds = std::chrono::duration<double>(clock_type::now() - start).count();
+			stats.uncompressedBytes = GetPixelsSize(mipChain);
+
+			DXGI_FORMAT format = GetFormat(compression, mipChain);
+			if (metadata.width % 4 != 0 || metadata.height % 4 != 0 || DirectX::IsCompressed(metadata.format))
+				format = DXGI_FORMAT_UNKNOWN;
+
+			start = clock_type::now();
+			if (format == DXGI_FORMAT_UNKNOWN)
+				result = std::move(mipChain);
+			else
+			{
+				HRESULT hr = DirectX::Compress(
+					mipChain.GetImages(), mipChain.GetImageCount(), mipChain.GetMetadata(),
+					format, compressFlags, DirectX::TEX_THRESHOLD_DEFAULT, result, executor);
+				if (FAILED(hr))
+					return hr;
+			}
+			stats.compressSeconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+			stats.mipLevels = (uint32_t)result.GetMetadata().mipLevels;
+			stats.format = result.GetMetadata().format;
+			stats.processedBytes = GetPixelsSize(result);
+			return S_OK;
+		}
+
+		/*
+		Decodes an image file with WIC and processes it
+		*/
+		inline HRESULT LoadAndProcess(
+			const std::wstring& path,
+			TextureCompression compression,
+			DirectX::ScratchImage& result,
+			TextureProcessingStats& stats,
+			DWORD compressFlags = DirectX::TEX_COMPRESS_PARALLEL,
+			DirectX::IParallelExecutor* executor = nullptr)
+		{
+			using clock_type = std::chrono::high_resolution_clock;
+
+			const clock_type::time_point start = clock_type::now();
+			DirectX::ScratchImage decoded;
+			HRESULT hr = DirectX::LoadFromWICFile(path.c_str(), DirectX::WIC_FLAGS_NONE, nullptr, decoded);
+			if (FAILED(hr))
+				return hr;
+			stats.decodeSeconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+			return Process(std::move(decoded), compression, result, stats, compressFlags, executor);
+		}
+
+		/*
+		Textures are cooked offline by Tools/TextureCooker into dds files with all mips, next to the meshes in Media/Cooked.
+		filePath is relative to Media, like the paths Tex2D is created with.
+		*/
+		inline std::wstring GetCookedPath(const std::string& filePath)
+		{
+			return L"../Media/Cooked/" + std::wstring(filePath.begin(), filePath.end()) + L".dds";
+		}
+
+		inline bool GetWriteTime(const std::wstring& path, uint64_t& writeTime)
+		{
+			WIN32_FILE_ATTRIBUTE_DATA attributes;
+			if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attributes))
+				return false;
+			writeTime = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+			return true;
+		}
+
+		// the cooked file exists and was written after its source, or there is no source
+		inline bool IsCookedCurrent(const std::wstring& sourcePath, const std::wstring& cookedPath)
+		{
+			uint64_t sourceTime, cookedTime;
+			if (!GetWriteTime(cookedPath, cookedTime))
+				return false;
+			return !GetWriteTime(sourcePath, sourceTime) || cookedTime >= sourceTime;
+		}
+
+		/*
+		Whether a cooked texture has the format Process would give its source with this compression:
+		uncompressed for sizes that are not whole blocks, BC1 or BC3 for Auto, which depends on the alpha of the pixels
+		*/
+		inline bool MatchesCompression(const DirectX::TexMetadata& metadata, TextureCompression compression)
+		{
+			if (compression == TextureCompression::None || metadata.width % 4 != 0 || metadata.height % 4 != 0)
+				return !DirectX::IsCompressed(metadata.format);
+			if (compression == TextureCompression::Auto)
+				return metadata.format == DXGI_FORMAT_BC1_UNORM || metadata.format == DXGI_FORMAT_BC3_UNORM;
+			// the image is only looked at for Auto
+			return metadata.format == GetFormat(compression, DirectX::ScratchImage{});
+		}
+
+		// the cooked file is current and in the format asked for, it can be loaded instead of processing the source
+		inline bool IsCookedUsable(const std::wstring& sourcePath, const std::wstring& cookedPath, TextureCompression compression)
+		{
+			DirectX::TexMetadata metadata;
+			return IsCookedCurrent(sourcePath, cookedPath) &&
+				SUCCEEDED(DirectX::GetMetadataFromDDSFile(cookedPath.c_str(), DirectX::DDS_FLAGS_NONE, metadata)) &&
+				MatchesCompression(metadata, compression);
+		}
+
+		/*
+		Loads a cooked dds as it is, decodeSeconds is the time it took
+		*/
+		inline HRESULT LoadCooked(const std::wstring& path, DirectX::ScratchImage& result, TextureProcessingStats& stats)
+		{
+			using clock_type = std::chrono::high_resolution_clock;
+
+			const clock_type::time_point start = clock_type::now();
+			HRESULT hr = DirectX::LoadFromDDSFile(path.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, result);
+			if (FAILED(hr))
+				return hr;
+			stats.decodeSeconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+			const DirectX::TexMetadata& metadata = result.GetMetadata();
+			stats.width = (uint32_t)metadata.width;
+			stats.height = (uint32_t)metadata.height;
+			stats.mipLevels = (uint32_t)metadata.mipLevels;
+			stats.format = metadata.format;
+			stats.processedBytes = GetPixelsSize(result);
+			return S_OK;
+		}
+	}
+}
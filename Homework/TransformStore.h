@@ -0,0 +1,168 @@
+#pragma once
+
+#include <Egg/Math/Math.h>
+#include <Egg/Math/Batch.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <cmath>
+
+using namespace Egg::Math;
+
+namespace GG
+{
+	// packed per-body transform state, every array is indexed by RigidBody::index
+	// the physics state of the last two steps is kept, matrices are built from the state
+	// interpolated between them, so rendering does not stutter when the frame rate and step rate differ
+	// only bodies that moved are touched: resting bodies keep their render state and matrices
+	class TransformStore
+	{
+		std::vector<Float3> positions;
+		std::vector<Float4> orientations;
+		std::vector<Float3> previousPositions;
+		std::vector<Float4> previousOrientations;
+
+		std::vector<Float3> renderPositions;
+		std::vector<Float4> renderOrientations;
+		std::vector<Float4x4> modelMatrices;
+		std::vector<Float4x4> modelMatrixInverses;
+
+		// bodies whose previous and current state differ, they are interpolated every frame
+		std::vector<uint32_t> moving;
+		std::vector<uint8_t> isMoving;
+
+		// bodies whose render state and matrices have to be rebuilt, until ClearChanged
+		std::vector<uint32_t> changed;
+		std::vector<uint8_t> isChanged;
+
+		void MarkChanged(uint32_t index)
+		{
+			if (!isChanged[index])
+			{
+				isChanged[index] = 1;
+				changed.push_back(index);
+			}
+		}
+
+	public:
+
+		uint32_t Add(const Float3& position, const Float4& orientation)
+		{
+			uint32_t index = Size();
+			positions.push_back(position);
+			orientations.push_back(orientation);
+			previousPositions.push_back(position);
+			previousOrientations.push_back(orientation);
+			renderPositions.push_back(position);
+			renderOrientations.push_back(orientation);
+			modelMatrices.emplace_back();
+			modelMatrixInverses.emplace_back();
+			isMoving.push_back(0);
+			isChanged.push_back(0);
+			UpdateMatrices(index, 1);
+			MarkChanged(index);
+			return index;
+		}
+
+		// the current state becomes the previous one, call before writing the result of a new step with Set
+		// for the bodies that moved, the others keep previous == current
+		void BeginStep()
+		{
+			for (uint32_t i : moving)
+			{
+				previousPositions[i] = positions[i];
+				previousOrientations[i] = orientations[i];
+				isMoving[i] = 0;
+				// one more rebuild brings the render state to rest
+				MarkChanged(i);
+			}
+			moving.clear();
+		}
+
+		void Set(uint32_t index, const Float3& position, const Float4& orientation)
+		{
+			positions[index] = position;
+			orientations[index] = orientation;
+			if (!isMoving[index])
+			{
+				isMoving[index] = 1;
+				moving.push_back(index);
+			}
+		}
+
+		// render state = previous + alpha * (current - previous), orientations are normalized lerped
+		// bodies at rest have previous == current and are only visited once after they stopped
+		void Interpolate(float alpha)
+		{
+			for (uint32_t i : moving)
+				MarkChanged(i);
+
+			const float beta = 1.0f - alpha;
+			for (uint32_t i : changed)
+			{
+				const Float3& p0 = previousPositions[i];
+				const Float3& p1 = positions[i];
+				renderPositions[i] = Float3{ p0.x * beta + p1.x * alpha, p0.y * beta + p1.y * alpha, p0.z * beta + p1.z * alpha };
+
+				const Float4& q0 = previousOrientations[i];
+				const Float4& q1 = orientations[i];
+				// q and -q are the same rotation, take the shorter arc
+				const float a = (q0.x * q1.x + q0.y * q1.y + q0.z * q1.z + q0.w * q1.w) < 0.0f ? -alpha : alpha;
+				Float4 q{ q0.x * beta + q1.x * a, q0.y * beta + q1.y * a, q0.z * beta + q1.z * a, q0.w * beta + q1.w * a };
+				const float invLength = 1.0f / std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+				renderOrientations[i] = Float4{ q.x * invLength, q.y * invLength, q.z * invLength, q.w * invLength };
+			}
+		}
+
+		// rebuilds the cached matrices of [first, first + count) from the render state
+		void UpdateMatrices(uint32_t first, uint32_t count)
+		{
+			Egg::Math::Batch::RigidTransforms(
+				&renderOrientations[first], &renderPositions[first],
+				&modelMatrices[first], &modelMatrixInverses[first],
+				count
+			);
+		}
+
+		// rebuilds the matrices of the changed bodies, sorts the changed list so runs of neighbours are done in one call
+		void UpdateMatrices()
+		{
+			std::sort(changed.begin(), changed.end());
+			for (size_t first = 0; first < changed.size(); )
+			{
+				size_t last = first + 1;
+				while (last < changed.size() && changed[last] == changed[last - 1] + 1)
+					last++;
+				UpdateMatrices(changed[first], (uint32_t)(last - first));
+				first = last;
+			}
+		}
+
+		// bodies rebuilt since the last ClearChanged, in increasing order after UpdateMatrices
+		const std::vector<uint32_t>& GetChanged() const { return changed; }
+
+		void ClearChanged()
+		{
+			for (uint32_t i : changed)
+				isChanged[i] = 0;
+			changed.clear();
+		}
+
+		uint32_t Size() const { return (uint32_t)positions.size(); }
+		uint32_t GetMovingCount() const { return (uint32_t)moving.size(); }
+
+		// interpolated state, as drawn
+		const Float3&   GetPosition(uint32_t index) const            { return renderPositions[index]; }
+		const Float4&   GetOrientation(uint32_t index) const         { return renderOrientations[index]; }
+		const Float4x4& GetModelMatrix(uint32_t index) const         { return modelMatrices[index]; }
+		const Float4x4& GetModelMatrixInverse(uint32_t index) const  { return modelMatrixInverses[index]; }
+
+		// state after the last simulation step
+		const Float3&   GetSimulatedPosition(uint32_t index) const    { return positions[index]; }
+		const Float4&   GetSimulatedOrientation(uint32_t index) const { return orientations[index]; }
+
+		const Float4x4* GetModelMatrices() const        { return modelMatrices.data(); }
+		const Float4x4* GetModelMatrixInverses() const  { return modelMatrixInverses.data(); }
+	};
+}
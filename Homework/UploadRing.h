@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Egg/Common.h>
+#include <Egg/Utility.h>
+
+#include "RingAllocator.h"
+
+namespace GG
+{
+	// one big persistently mapped upload buffer for data that is written once per frame,
+	// allocations are written directly by the cpu and read by the gpu, there is no shadow copy
+	class UploadRing
+	{
+		com_ptr<ID3D12Resource> resource;
+		uint8_t* mappedPtr = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS address = 0;
+		RingAllocator ring;
+
+	public:
+
+		struct Allocation
+		{
+			void* cpuAddress;
+			D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+		};
+
+		void CreateResources(ID3D12Device* device, uint32_t capacity)
+		{
+			capacity = Egg::Utility::Align256(capacity);
+			ring = RingAllocator{ capacity };
+
+			CD3DX12_HEAP_PROPERTIES heapProp{ D3D12_HEAP_TYPE_UPLOAD };
+			CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(capacity);
+
+			DX_API("Failed to create upload ring resource")
+				device->CreateCommittedResource(
+					&heapProp,
+					D3D12_HEAP_FLAG_NONE,
+					&resourceDesc,
+					D3D12_RESOURCE_STATE_GENERIC_READ,
+					nullptr,
+					IID_PPV_ARGS(resource.GetAddressOf())
+				);
+
+			// never read by the cpu, stays mapped for the lifetime of the resource
+			CD3DX12_RANGE rr(0, 0);
+			DX_API("Failed to map upload ring")
+				resource->Map(0, &rr, reinterpret_cast<void**>(&mappedPtr));
+
+			resource->SetName(L"Upload Ring");
+			address = resource->GetGPUVirtualAddress();
+		}
+
+		void ReleaseResources()
+		{
+			if (resource)
+				resource->Unmap(0, nullptr);
+			resource.Reset();
+			mappedPtr = nullptr;
+		}
+
+		~UploadRing() { ReleaseResources(); }
+
+		Allocation Allocate(uint32_t size, uint32_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT)
+		{
+			uint64_t offset = ring.Allocate(size, alignment);
+			ASSERT(offset != RingAllocator::InvalidOffset, "Upload ring is full (%u bytes requested, %llu of %llu in use)",
+				size, ring.GetUsed(), ring.GetCapacity());
+			return { mappedPtr + offset, address + offset };
+		}
+
+		// room for a constant buffer, the memory is write-combined: fill it, don't read it back
+		template <typename T>
+		T* AllocateConstants(D3D12_GPU_VIRTUAL_ADDRESS& gpuAddress)
+		{
+			Allocation a = Allocate(sizeof(T));
+			gpuAddress = a.gpuAddress;
+			return static_cast<T*>(a.cpuAddress);
+		}
+
+		// call once the gpu may have finished more frames, frees their allocations
+		void BeginFrame(uint64_t completedFenceValue) { ring.Reclaim(completedFenceValue); }
+
+		// call after the fence value of the frame is signaled
+		void EndFrame(uint64_t fenceValue) { ring.EndFrame(fenceValue); }
+
+		const RingAllocator::Stats& GetStats() const { return ring.GetStats(); }
+	};
+}
@@ -0,0 +1,247 @@
+#include "Test.h"
+
+#include <Homework/AssetCache.h>
+#include <Homework/FramePacer.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+Windows only, the cache hashes files through Egg::MappedFile. The files are written to a folder of their own
+next to the working directory and removed at the end.
+*/
+
+namespace {
+
+	const std::string root = "AssetCacheTest/";
+
+	struct Asset
+	{
+		std::string path;
+		uint32_t slot;
+	};
+
+	void WriteFile(const std::string& name, const std::string& content)
+	{
+		std::ofstream out(root + name, std::ios::binary | std::ios::trunc);
+		out << content;
+	}
+
+	// counts the loads, every asset takes the given number of bytes
+	struct Loader
+	{
+		uint32_t loads = 0;
+		uint64_t bytes = 100;
+
+		std::pair<std::shared_ptr<Asset>, uint64_t> operator()(const std::string& path, uint32_t slot)
+		{
+			++loads;
+			return { std::make_shared<Asset>(Asset{ path, slot }), bytes };
+		}
+	};
+
+	struct TestFiles
+	{
+		TestFiles()
+		{
+			CreateDirectoryA(root.c_str(), nullptr);
+			WriteFile("a.bin", "the same bytes");
+			WriteFile("copy of a.bin", "the same bytes");
+			WriteFile("b.bin", "other bytes");
+			WriteFile("c.bin", "more bytes");
+			WriteFile("d.bin", "yet more bytes");
+		}
+
+		~TestFiles()
+		{
+			for (const char* name : { "a.bin", "copy of a.bin", "b.bin", "c.bin", "d.bin" })
+				DeleteFileA((root + name).c_str());
+			RemoveDirectoryA(root.c_str());
+		}
+	};
+
+}
+
+TEST(AssetCacheHitsByPathAndContent)
+{
+	TestFiles files;
+	GG::AssetCache<Asset> cache(root, 1000);
+	Loader loader;
+
+	uint32_t a = cache.Acquire("a.bin", loader);
+	CHECK(loader.loads == 1);
+	CHECK(cache[a]->slot == a && cache[a]->path == "a.bin");
+
+	// the same path, and the same bytes under another path, are the same asset
+	CHECK(cache.Acquire("a.bin", loader) == a);
+	CHECK(cache.Acquire("copy of a.bin", loader) == a);
+	CHECK(loader.loads == 1);
+	CHECK(cache.GetPath(a) == "a.bin");
+
+	uint32_t b = cache.Acquire("b.bin", loader);
+	CHECK(b != a);
+	CHECK(loader.loads == 2);
+
+	// a file that can't be read is only found by its path
+	uint32_t missing = cache.Acquire("not shipped.bin", loader);
+	CHECK(cache.Acquire("not shipped.bin", loader) == missing);
+	CHECK(cache.Acquire("also not shipped.bin", loader) != missing);
+	CHECK(loader.loads == 4);
+
+	const GG::AssetCache<Asset>::Stats& stats = cache.GetStats();
+	CHECK(stats.misses == 4);
+	CHECK(stats.pathHits == 2);
+	CHECK(stats.contentHits == 1);
+	CHECK(stats.residentAssets == 4);
+	CHECK(stats.residentBytes == 400);
+	CHECK(stats.evictions == 0);
+}
+
+TEST(AssetCacheEvictsReleasedAssetsOverBudget)
+{
+	TestFiles files;
+	// room for two assets
+	GG::AssetCache<Asset> cache(root, 250);
+	Loader loader;
+
+	uint32_t a = cache.Acquire("a.bin", loader);
+	uint32_t b = cache.Acquire("b.bin", loader);
+	uint32_t c = cache.Acquire("c.bin", loader);
+
+	// over budget, but everything is in use
+	cache.Trim(100);
+	CHECK(cache.GetStats().evictions == 0);
+	CHECK(cache[a] && cache[b] && cache[c]);
+
+	// released in epochs 5 and 3, the gpu is done with epoch 4: only c may go
+	cache.Release(a, 5);
+	cache.Release(c, 3);
+	cache.Trim(4);
+	CHECK(cache.GetStats().evictions == 1);
+	CHECK(!cache[c]);
+	CHECK(cache[a] && cache[b]);
+	CHECK(cache.GetStats().residentBytes == 200);
+
+	// fits again, a stays loaded unused and comes back without a load
+	cache.Trim(10);
+	CHECK(cache[a]);
+	CHECK(cache.Acquire("a.bin", loader) == a);
+	CHECK(loader.loads == 3);
+
+	// an evicted asset is loaded again, into the free slot, and its paths are forgotten
+	uint32_t again = cache.Acquire("c.bin", loader);
+	CHECK(again == c);
+	CHECK(loader.loads == 4);
+	CHECK(cache[again]->path == "c.bin");
+
+	// the least recently released goes first
+	uint32_t d = cache.Acquire("d.bin", loader);
+	cache.Release(b, 7);
+	cache.Release(again, 6);
+	cache.Release(a, 8);
+	cache.Trim(8);
+	CHECK(!cache[again]);
+	CHECK(!cache[b]);
+	CHECK(cache[a] && cache[d]);
+	CHECK(cache.GetStats().residentAssets == 2);
+
+	// content hits are forgotten with the evicted asset too
+	CHECK(cache.Acquire("copy of a.bin", loader) == a);
+	cache.Release(a, 9);
+	cache.Release(d, 9);
+	cache.SetBudget(0);
+	cache.Trim(9);
+	CHECK(cache.GetStats().residentAssets == 0);
+	CHECK(cache.GetStats().residentBytes == 0);
+	uint32_t loads = loader.loads;
+	cache.Acquire("copy of a.bin", loader);
+	CHECK(loader.loads == loads + 1);
+}
+
+TEST(AssetCacheKeepsRemovedMeshAssetsForFramesInFlight)
+{
+	TestFiles files;
+	// room for two textures
+	GG::AssetCache<Asset> textures(root, 250);
+	Loader loader;
+
+	// what RenderingSystem::Update does before every frame, updates FramesInFlight back have been drawn
+	uint64_t updateCount = 0;
+	auto update = [&] {
+		updateCount++;
+		if (updateCount > GG::FramesInFlight)
+			textures.Trim(updateCount - GG::FramesInFlight);
+	};
+
+	// two meshes added with their textures, drawn for a while
+	update();
+	uint32_t a = textures.Acquire("a.bin", loader);
+	uint32_t b = textures.Acquire("b.bin", loader);
+	for (int i = 0; i < 5; ++i)
+		update();
+
+	// RemoveShadedMesh releases in the current update, and the mesh comes back with another texture, over budget
+	textures.Release(a, updateCount);
+	const uint64_t removedIn = updateCount;
+	uint32_t c = textures.Acquire("c.bin", loader);
+	CHECK(c != a);
+	CHECK(textures.GetStats().residentBytes == 300);
+
+	// the frames in flight may still draw with a
+	for (uint32_t i = 1; i < GG::FramesInFlight; ++i)
+	{
+		update();
+		CHECK(textures[a]);
+	}
+	update();
+	CHECK(updateCount - GG::FramesInFlight == removedIn);
+	CHECK(!textures[a]);
+	CHECK(textures[b] && textures[c]);
+	CHECK(textures.GetStats().evictions == 1);
+	CHECK(textures.GetStats().residentBytes == 200);
+
+	// removed and added again before the frames are done, b stays in its slot without a load
+	textures.Release(b, updateCount);
+	CHECK(textures.Acquire("b.bin", loader) == b);
+	for (uint32_t i = 0; i <= GG::FramesInFlight; ++i)
+		update();
+	CHECK(textures[b]);
+	CHECK(loader.loads == 3);
+
+	// a comes back as a load, into its old slot
+	CHECK(textures.Acquire("a.bin", loader) == a);
+	CHECK(loader.loads == 4);
+}
+
+BENCHMARK(AssetCacheAcquire)
+{
+	TestFiles files;
+	GG::AssetCache<Asset> cache(root, 1ull << 30);
+	Loader loader;
+	cache.Acquire("a.bin", loader);
+
+	// what a mesh costs when its assets are already loaded: a path lookup, against hashing the file for a new path
+	const uint32_t count = 10000;
+	double byPath = Tests::Measure([&] {
+		for (uint32_t i = 0; i < count; ++i)
+			cache.Acquire("a.bin", loader);
+	});
+	std::vector<std::string> paths;
+	for (uint32_t i = 0; i < 100; ++i)
+	{
+		std::string path;
+		for (uint32_t j = 0; j < i; ++j)
+			path += "./";
+		paths.push_back(path + "a.bin");
+	}
+	GG::AssetCache<Asset> fresh(root, 1ull << 30);
+	double byContent = Tests::Measure([&] {
+		for (const std::string& path : paths)
+			fresh.Acquire(path, loader);
+	}, 1) * (count / 100);
+	Tests::Report("10K acquires by path", byPath);
+	Tests::Report("10K acquires by content (from 100)", byContent, byPath);
+}
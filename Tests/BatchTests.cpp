@@ -0,0 +1,255 @@
+#include "Test.h"
+
+#include <Egg/Math/Batch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace Egg::Math;
+
+namespace {
+
+	// not a multiple of four, so the SoA loop runs its remainder too
+	const size_t count = 1027;
+
+	Float4x4 RandomMatrix(Tests::Random& random)
+	{
+		Float4x4 m;
+		for (float& e : m.l)
+			e = random.Float(-10.0f, 10.0f);
+		return m;
+	}
+
+	Float3 RandomPoint(Tests::Random& random)
+	{
+		return Float3(random.Float(-100.0f, 100.0f), random.Float(-100.0f, 100.0f), random.Float(-100.0f, 100.0f));
+	}
+
+	Float3 RandomAxis(Tests::Random& random)
+	{
+		Float3 axis = RandomPoint(random);
+		return axis.LengthSquared() > 1e-4f ? axis.Normalize() : Float3(0.0f, 1.0f, 0.0f);
+	}
+
+	// == rather than a bit compare, the batch direction transform skips the + 0 * row3 that gives -0 or +0
+	bool Equal(const Float3& a, const Float3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	bool Equal(const Float4& a, const Float4& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+	}
+
+	bool Equal(const Float4x4& a, const Float4x4& b)
+	{
+		for (int i = 0; i < 16; ++i)
+			if (a.l[i] != b.l[i])
+				return false;
+		return true;
+	}
+
+	bool Near(const Float4x4& a, const Float4x4& b, float tolerance)
+	{
+		for (int i = 0; i < 16; ++i)
+			if (std::fabs(a.l[i] - b.l[i]) > tolerance * std::max(1.0f, std::fabs(b.l[i])))
+				return false;
+		return true;
+	}
+
+}
+
+TEST(BatchTransformMatchesLoop)
+{
+	Tests::Random random;
+	Float4x4 m = RandomMatrix(random);
+	std::vector<Float4> in(count), out(count);
+	for (Float4& v : in)
+		v = Float4(RandomPoint(random), random.Float(-2.0f, 2.0f));
+
+	Batch::Transform(m, in.data(), out.data(), count);
+	for (size_t i = 0; i < count; ++i)
+		CHECK(Equal(out[i], m.Transform(in[i])));
+
+	// in place
+	std::vector<Float4> inPlace = in;
+	Batch::Transform(m, inPlace.data(), inPlace.data(), count);
+	for (size_t i = 0; i < count; ++i)
+		CHECK(Equal(inPlace[i], out[i]));
+}
+
+TEST(BatchTransformPointsAndDirectionsMatchLoop)
+{
+	Tests::Random random;
+	Float4x4 m = RandomMatrix(random);
+	std::vector<Float3> in(count), points(count), directions(count);
+	for (Float3& v : in)
+		v = RandomPoint(random);
+
+	Batch::TransformPoints(m, in.data(), points.data(), count);
+	Batch::TransformDirections(m, in.data(), directions.data(), count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		CHECK(Equal(points[i], m.Transform(Float4(in[i], 1.0f)).xyz));
+		CHECK(Equal(directions[i], m.Transform(Float4(in[i], 0.0f)).xyz));
+	}
+
+	std::vector<Float3> inPlace = in;
+	Batch::TransformPoints(m, inPlace.data(), inPlace.data(), count);
+	for (size_t i = 0; i < count; ++i)
+		CHECK(Equal(inPlace[i], points[i]));
+
+	// structure of arrays
+	std::vector<float> x(count), y(count), z(count), outX(count), outY(count), outZ(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		x[i] = in[i].x;
+		y[i] = in[i].y;
+		z[i] = in[i].z;
+	}
+	Batch::TransformPoints(m, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), count);
+	for (size_t i = 0; i < count; ++i)
+		CHECK(Equal(Float3(outX[i], outY[i], outZ[i]), points[i]));
+}
+
+TEST(BatchMulMatchesLoop)
+{
+	Tests::Random random;
+	std::vector<Float4x4> a(count), b(count), out(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		a[i] = RandomMatrix(random);
+		b[i] = RandomMatrix(random);
+	}
+	Float4x4 shared = RandomMatrix(random);
+
+	Batch::Mul(a.data(), b.data(), out.data(), count);
+	for (size_t i = 0; i < count; ++i)
+		CHECK(Equal(out[i], a[i] * b[i]));
+
+	Batch::Mul(a.data(), shared, out.data(), count);
+	for (size_t i = 0; i < count; ++i)
+		CHECK(Equal(out[i], a[i] * shared));
+
+	// out aliasing either input
+	std::vector<Float4x4> aliased = a;
+	Batch::Mul(aliased.data(), b.data(), aliased.data(), count);
+	for (size_t i = 0; i < count; ++i)
+		CHECK(Equal(aliased[i], a[i] * b[i]));
+	aliased = b;
+	Batch::Mul(a.data(), aliased.data(), aliased.data(), count);
+	for (size_t i = 0; i < count; ++i)
+		CHECK(Equal(aliased[i], a[i] * b[i]));
+}
+
+TEST(BatchRigidTransformsMatchRotationTranslation)
+{
+	Tests::Random random;
+	std::vector<Float4> orientations(count);
+	std::vector<Float3> positions(count), axes(count);
+	std::vector<float> angles(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		axes[i] = RandomAxis(random);
+		angles[i] = random.Float(-3.14f, 3.14f);
+		orientations[i] = Float4(axes[i] * std::sin(angles[i] * 0.5f), std::cos(angles[i] * 0.5f));
+		positions[i] = RandomPoint(random);
+	}
+
+	std::vector<Float4x4> model(count), modelInverse(count), modelOnly(count);
+	Batch::RigidTransforms(orientations.data(), positions.data(), model.data(), modelInverse.data(), count);
+	Batch::RigidTransforms(orientations.data(), positions.data(), modelOnly.data(), nullptr, count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		CHECK(Near(model[i], Float4x4::Rotation(axes[i], angles[i]) * Float4x4::Translation(positions[i]), 1e-5f));
+		CHECK(Near(modelInverse[i], model[i].Invert(), 1e-4f));
+		CHECK(Equal(modelOnly[i], model[i]));
+	}
+}
+
+BENCHMARK(BatchTransforms)
+{
+	const size_t n = 1 << 16;
+	Tests::Random random;
+	Float4x4 m = RandomMatrix(random);
+	std::vector<Float4> in4(n), out4(n);
+	std::vector<Float3> in3(n), out3(n);
+	std::vector<float> x(n), y(n), z(n), outX(n), outY(n), outZ(n);
+	std::vector<Float4x4> matrices(n), products(n);
+	std::vector<Float4> orientations(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		in3[i] = RandomPoint(random);
+		in4[i] = Float4(in3[i], 1.0f);
+		x[i] = in3[i].x;
+		y[i] = in3[i].y;
+		z[i] = in3[i].z;
+		matrices[i] = RandomMatrix(random);
+		Float3 axis = RandomAxis(random);
+		float angle = random.Float(-3.14f, 3.14f);
+		orientations[i] = Float4(axis * std::sin(angle * 0.5f), std::cos(angle * 0.5f));
+	}
+
+	double loop = Tests::Measure([&] {
+		for (size_t i = 0; i < n; ++i)
+			out4[i] = m.Transform(in4[i]);
+		Tests::Consume(out4.data());
+	});
+	double batch = Tests::Measure([&] {
+		Batch::Transform(m, in4.data(), out4.data(), n);
+		Tests::Consume(out4.data());
+	});
+	Tests::Report("Transform, 64K Float4, loop", loop);
+	Tests::Report("Transform, 64K Float4, batch", batch, loop);
+
+	loop = Tests::Measure([&] {
+		for (size_t i = 0; i < n; ++i)
+			out3[i] = m.Transform(Float4(in3[i], 1.0f)).xyz;
+		Tests::Consume(out3.data());
+	});
+	batch = Tests::Measure([&] {
+		Batch::TransformPoints(m, in3.data(), out3.data(), n);
+		Tests::Consume(out3.data());
+	});
+	double soa = Tests::Measure([&] {
+		Batch::TransformPoints(m, x.data(), y.data(), z.data(), outX.data(), outY.data(), outZ.data(), n);
+		Tests::Consume(outX.data());
+	});
+	Tests::Report("TransformPoints, 64K Float3, loop", loop);
+	Tests::Report("TransformPoints, 64K Float3, batch", batch, loop);
+	Tests::Report("TransformPoints, 64K points, batch SoA", soa, loop);
+
+	loop = Tests::Measure([&] {
+		for (size_t i = 0; i < n; ++i)
+			products[i] = matrices[i] * m;
+		Tests::Consume(products.data());
+	});
+	batch = Tests::Measure([&] {
+		Batch::Mul(matrices.data(), m, products.data(), n);
+		Tests::Consume(products.data());
+	});
+	Tests::Report("Mul by shared matrix, 64K, loop", loop);
+	Tests::Report("Mul by shared matrix, 64K, batch", batch, loop);
+
+	loop = Tests::Measure([&] {
+		for (size_t i = 0; i < n; ++i)
+		{
+			float angle = 2.0f * std::acos(orientations[i].w);
+			float s = std::sqrt(std::max(1.0f - orientations[i].w * orientations[i].w, 1e-12f));
+			Float4x4 model = Float4x4::Rotation(orientations[i].xyz / s, angle) * Float4x4::Translation(in3[i]);
+			products[i] = model;
+			matrices[i] = model.Invert();
+		}
+		Tests::Consume(products.data());
+		Tests::Consume(matrices.data());
+	});
+	batch = Tests::Measure([&] {
+		Batch::RigidTransforms(orientations.data(), in3.data(), products.data(), matrices.data(), n);
+		Tests::Consume(products.data());
+		Tests::Consume(matrices.data());
+	});
+	Tests::Report("Model and inverse, 64K bodies, Rotation/Invert", loop);
+	Tests::Report("Model and inverse, 64K bodies, batch", batch, loop);
+}
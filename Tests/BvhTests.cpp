@@ -0,0 +1,316 @@
+#include "Test.h"
+
+#include <Egg/Spatial/Bvh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace Egg::Math;
+using namespace Egg::Cull;
+using namespace Egg::Spatial;
+
+namespace {
+
+	// a flat scene like the app's: spread out in x and z, a tenth of that in y
+	std::vector<Aabb> RandomBoxes(Tests::Random& random, uint32_t count)
+	{
+		std::vector<Aabb> boxes(count);
+		for (Aabb& box : boxes)
+		{
+			Float3 center(random.Float(-500.0f, 500.0f), random.Float(-50.0f, 50.0f), random.Float(-500.0f, 500.0f));
+			Float3 extent(random.Float(0.2f, 3.0f), random.Float(0.2f, 3.0f), random.Float(0.2f, 3.0f));
+			box = Aabb{ center - extent, center + extent };
+		}
+		return boxes;
+	}
+
+	Float3 RandomPoint(Tests::Random& random)
+	{
+		return Float3(random.Float(-500.0f, 500.0f), random.Float(-50.0f, 50.0f), random.Float(-500.0f, 500.0f));
+	}
+
+	bool Overlaps(const Aabb& a, const Aabb& b)
+	{
+		return a.min.x <= b.max.x && a.max.x >= b.min.x
+			&& a.min.y <= b.max.y && a.max.y >= b.min.y
+			&& a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	bool Overlaps(const Aabb& a, const Sphere& s)
+	{
+		const float dx = std::max(std::max(a.min.x - s.center.x, s.center.x - a.max.x), 0.0f);
+		const float dy = std::max(std::max(a.min.y - s.center.y, s.center.y - a.max.y), 0.0f);
+		const float dz = std::max(std::max(a.min.z - s.center.z, s.center.z - a.max.z), 0.0f);
+		return dx * dx + dy * dy + dz * dz <= s.radius * s.radius;
+	}
+
+	// entry distance of the ray into the box in double precision, negative if it misses
+	double RayEntry(const Aabb& a, const Float3& origin, const Float3& direction, float maxDistance)
+	{
+		const double o[3] = { origin.x, origin.y, origin.z }, d[3] = { direction.x, direction.y, direction.z };
+		const double lo[3] = { a.min.x, a.min.y, a.min.z }, hi[3] = { a.max.x, a.max.y, a.max.z };
+		double tNear = 0.0, tFar = maxDistance;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (d[axis] == 0.0)
+			{
+				if (o[axis] < lo[axis] || o[axis] > hi[axis])
+					return -1.0;
+				continue;
+			}
+			double t1 = (lo[axis] - o[axis]) / d[axis], t2 = (hi[axis] - o[axis]) / d[axis];
+			tNear = std::max(tNear, std::min(t1, t2));
+			tFar = std::min(tFar, std::max(t1, t2));
+		}
+		return tNear <= tFar ? tNear : -1.0;
+	}
+
+	template <typename Test>
+	std::vector<uint32_t> BruteForce(const std::vector<Aabb>& boxes, Test test)
+	{
+		std::vector<uint32_t> result;
+		for (uint32_t i = 0; i < boxes.size(); ++i)
+			if (test(boxes[i]))
+				result.push_back(i);
+		return result;
+	}
+
+	bool SameItems(std::vector<uint32_t> a, const std::vector<uint32_t>& sortedExpected)
+	{
+		std::sort(a.begin(), a.end());
+		return a == sortedExpected;
+	}
+
+	Frustum RandomFrustum(Tests::Random& random)
+	{
+		Float3 ahead(random.Float(-1.0f, 1.0f), random.Float(-0.3f, 0.3f), random.Float(-1.0f, 1.0f));
+		if (ahead.LengthSquared() < 1e-2f)
+			ahead = Float3(0.0f, 0.0f, 1.0f);
+		return Frustum::FromViewProj(Float4x4::View(RandomPoint(random), ahead.Normalize(), Float3(0.0f, 1.0f, 0.0f)) *
+			Float4x4::Proj(random.Float(0.6f, 1.6f), 1.5f, 0.1f, random.Float(50.0f, 400.0f)));
+	}
+
+	// every query of the tree against the same test on every box
+	uint32_t CountMismatches(const Bvh& bvh, const std::vector<Aabb>& boxes, Tests::Random& random, uint32_t queries)
+	{
+		uint32_t mismatches = 0;
+		std::vector<uint32_t> result;
+		for (uint32_t q = 0; q < queries; ++q)
+		{
+			Float3 c = RandomPoint(random);
+			Float3 e(random.Float(0.0f, 40.0f), random.Float(0.0f, 40.0f), random.Float(0.0f, 40.0f));
+			Aabb box{ c - e, c + e };
+			bvh.QueryAabb(box, result);
+			mismatches += SameItems(result, BruteForce(boxes, [&](const Aabb& a) { return Overlaps(a, box); })) ? 0 : 1;
+
+			Sphere sphere{ RandomPoint(random), random.Float(0.0f, 40.0f) };
+			bvh.QuerySphere(sphere, result);
+			mismatches += SameItems(result, BruteForce(boxes, [&](const Aabb& a) { return Overlaps(a, sphere); })) ? 0 : 1;
+
+			Frustum frustum = RandomFrustum(random);
+			bvh.QueryFrustum(frustum, result);
+			mismatches += SameItems(result, BruteForce(boxes, [&](const Aabb& a) { return frustum.Intersects(a); })) ? 0 : 1;
+
+			// every fourth ray is axis aligned, zero direction components take the guarded inverse
+			Float3 origin = RandomPoint(random);
+			Float3 direction(random.Float(-1.0f, 1.0f), random.Float(-0.2f, 0.2f), random.Float(-1.0f, 1.0f));
+			if (q % 4 == 0)
+				direction = (q % 8 == 0) ? Float3(1.0f, 0.0f, 0.0f) : Float3(0.0f, 0.0f, -1.0f);
+			const float maxDistance = 500.0f;
+			double best = -1.0;
+			for (const Aabb& a : boxes)
+			{
+				double t = RayEntry(a, origin, direction, maxDistance);
+				if (t >= 0.0 && (best < 0.0 || t < best))
+					best = t;
+			}
+			Bvh::RayHit hit;
+			bool hitSomething = bvh.Raycast(origin, direction, maxDistance, hit);
+			if (hitSomething != (best >= 0.0))
+				++mismatches;
+			else if (hitSomething)
+			{
+				// ties may give another item at the same distance, the item has to be hit where it says
+				double itemEntry = RayEntry(boxes[hit.item], origin, direction, maxDistance);
+				if (std::fabs(hit.distance - best) > 1e-3 || std::fabs(itemEntry - best) > 1e-3)
+					++mismatches;
+			}
+		}
+		return mismatches;
+	}
+
+}
+
+TEST(BvhQueriesMatchBruteForce)
+{
+	Tests::Random random;
+	std::vector<Aabb> boxes = RandomBoxes(random, 5000);
+	Bvh bvh;
+	bvh.Build(boxes.data(), (uint32_t)boxes.size());
+	CHECK(bvh.GetItemCount() == boxes.size());
+	CHECK(bvh.ComputeCost() > 0.0f);
+	CHECK(CountMismatches(bvh, boxes, random, 200) == 0);
+}
+
+TEST(BvhRefitMatchesBruteForce)
+{
+	Tests::Random random;
+	std::vector<Aabb> boxes = RandomBoxes(random, 5000);
+	Bvh bvh;
+	bvh.Build(boxes.data(), (uint32_t)boxes.size());
+	const float builtCost = bvh.ComputeCost();
+
+	// a tenth of the items move a little, then some travel across the scene
+	for (uint32_t round = 0; round < 3; ++round)
+	{
+		std::vector<uint32_t> changed;
+		for (uint32_t i = round; i < boxes.size(); i += 10)
+		{
+			Float3 offset = (round < 2) ? Float3(random.Float(-5.0f, 5.0f), random.Float(-5.0f, 5.0f), random.Float(-5.0f, 5.0f))
+				: RandomPoint(random) - boxes[i].GetCenter();
+			boxes[i] = Aabb{ boxes[i].min + offset, boxes[i].max + offset };
+			changed.push_back(i);
+		}
+		bvh.Refit(boxes.data(), changed.data(), changed.size());
+		for (uint32_t i : changed)
+			CHECK(bvh.GetBox(i).min.x == boxes[i].min.x && bvh.GetBox(i).max.z == boxes[i].max.z);
+		CHECK(CountMismatches(bvh, boxes, random, 50) == 0);
+	}
+	// items that travelled far make the boxes above them grow
+	CHECK(bvh.ComputeCost() > builtCost);
+
+	bvh.Refit(boxes.data(), nullptr, 0);
+	CHECK(CountMismatches(bvh, boxes, random, 20) == 0);
+}
+
+TEST(BvhSmallAndDegenerateTrees)
+{
+	Tests::Random random;
+	std::vector<uint32_t> result;
+
+	Bvh empty;
+	empty.Build(nullptr, 0);
+	Bvh::RayHit hit;
+	CHECK(!empty.Raycast(Float3(0.0f, 0.0f, 0.0f), Float3(1.0f, 0.0f, 0.0f), 100.0f, hit));
+	empty.QueryAabb(Aabb{ Float3(-1e6f, -1e6f, -1e6f), Float3(1e6f, 1e6f, 1e6f) }, result);
+	CHECK(result.empty());
+	CHECK(empty.ComputeCost() == 0.0f);
+
+	// sizes around the leaf size and the node width
+	for (uint32_t count = 1; count <= 20; ++count)
+	{
+		std::vector<Aabb> boxes = RandomBoxes(random, count);
+		Bvh bvh;
+		bvh.Build(boxes.data(), count);
+		CHECK(CountMismatches(bvh, boxes, random, 20) == 0);
+	}
+
+	// all boxes the same: no split separates them, the build falls back to halving
+	std::vector<Aabb> same(3000, Aabb{ Float3(1.0f, 2.0f, 3.0f), Float3(2.0f, 3.0f, 4.0f) });
+	Bvh stacked;
+	stacked.Build(same.data(), (uint32_t)same.size());
+	stacked.QueryAabb(same[0], result);
+	CHECK(result.size() == same.size());
+	CHECK(stacked.Raycast(Float3(0.0f, 2.5f, 3.5f), Float3(1.0f, 0.0f, 0.0f), 10.0f, hit));
+	CHECK_NEAR(hit.distance, 1.0f, 1e-6f);
+
+	// a ray starting inside a box hits it at 0, a ray shorter than the way to the box misses
+	std::vector<Aabb> one{ Aabb{ Float3(-1.0f, -1.0f, -1.0f), Float3(1.0f, 1.0f, 1.0f) } };
+	Bvh single;
+	single.Build(one.data(), 1);
+	CHECK(single.Raycast(Float3(0.0f, 0.0f, 0.0f), Float3(0.0f, 1.0f, 0.0f), 1.0f, hit));
+	CHECK(hit.item == 0 && hit.distance == 0.0f);
+	CHECK(!single.Raycast(Float3(-5.0f, 0.0f, 0.0f), Float3(1.0f, 0.0f, 0.0f), 3.9f, hit));
+	CHECK(single.Raycast(Float3(-5.0f, 0.0f, 0.0f), Float3(1.0f, 0.0f, 0.0f), 4.1f, hit));
+	CHECK_NEAR(hit.distance, 4.0f, 1e-6f);
+}
+
+BENCHMARK(BvhQueries)
+{
+	const uint32_t count = 100000;
+	Tests::Random random;
+	std::vector<Aabb> boxes = RandomBoxes(random, count);
+	Bvh bvh;
+	double build = Tests::Measure([&] { bvh.Build(boxes.data(), count); }, 3);
+	char what[96];
+	std::snprintf(what, sizeof(what), "Build, 100K boxes, %u nodes", bvh.GetNodeCount());
+	Tests::Report(what, build);
+
+	std::vector<uint32_t> changed;
+	for (uint32_t i = 0; i < count; i += 10)
+		changed.push_back(i);
+	double refit = Tests::Measure([&] { bvh.Refit(boxes.data(), changed.data(), changed.size()); });
+	Tests::Report("Refit, 10% of 100K boxes", refit, build);
+
+	std::vector<Aabb> queries(100);
+	for (Aabb& q : queries)
+	{
+		Float3 c = RandomPoint(random);
+		q = Aabb{ c - Float3(20.0f, 20.0f, 20.0f), c + Float3(20.0f, 20.0f, 20.0f) };
+	}
+	std::vector<uint32_t> result;
+	double brute = Tests::Measure([&] {
+		for (const Aabb& q : queries)
+		{
+			result.clear();
+			for (uint32_t i = 0; i < count; ++i)
+				if (Overlaps(boxes[i], q))
+					result.push_back(i);
+		}
+		Tests::Consume(result.data());
+	}, 3);
+	double tree = Tests::Measure([&] {
+		for (const Aabb& q : queries)
+			bvh.QueryAabb(q, result);
+		Tests::Consume(result.data());
+	});
+	Tests::Report("100 box queries, brute force", brute);
+	Tests::Report("100 box queries, bvh", tree, brute);
+
+	Frustum frustum = Frustum::FromViewProj(Float4x4::View(Float3(0.0f, 5.0f, -7.0f), Float3(0.0f, 0.0f, 1.0f), Float3(0.0f, 1.0f, 0.0f)) *
+		Float4x4::Proj(1.2f, 1.5f, 0.1f, 300.0f));
+	brute = Tests::Measure([&] {
+		result.clear();
+		for (uint32_t i = 0; i < count; ++i)
+			if (frustum.Intersects(boxes[i]))
+				result.push_back(i);
+		Tests::Consume(result.data());
+	});
+	tree = Tests::Measure([&] { bvh.QueryFrustum(frustum, result); Tests::Consume(result.data()); });
+	std::snprintf(what, sizeof(what), "Frustum query, %zu of 100K visible, brute force", result.size());
+	Tests::Report(what, brute);
+	Tests::Report("Frustum query, bvh", tree, brute);
+
+	std::vector<Float3> origins(1000), directions(1000);
+	for (uint32_t i = 0; i < 1000; ++i)
+	{
+		origins[i] = RandomPoint(random);
+		directions[i] = Float3(random.Float(-1.0f, 1.0f), random.Float(-0.1f, 0.1f), random.Float(-1.0f, 1.0f));
+	}
+	Bvh::RayHit hit;
+	uint32_t hits = 0;
+	tree = Tests::Measure([&] {
+		hits = 0;
+		for (uint32_t i = 0; i < 1000; ++i)
+			hits += bvh.Raycast(origins[i], directions[i], 200.0f, hit) ? 1 : 0;
+		Tests::Consume(&hits);
+	});
+	std::vector<double> best(10);
+	brute = Tests::Measure([&] {
+		for (uint32_t i = 0; i < 10; ++i)
+		{
+			best[i] = -1.0;
+			for (const Aabb& a : boxes)
+			{
+				double t = RayEntry(a, origins[i], directions[i], 200.0f);
+				if (t >= 0.0 && (best[i] < 0.0 || t < best[i]))
+					best[i] = t;
+			}
+		}
+		Tests::Consume(best.data());
+	}, 3) * 100.0;
+	std::snprintf(what, sizeof(what), "1000 raycasts, %u hit, brute force (from 10)", hits);
+	Tests::Report(what, brute);
+	Tests::Report("1000 raycasts, bvh", tree, brute);
+}
@@ -0,0 +1,254 @@
+#include "Test.h"
+
+#include <Homework/DrawBatcher.h>
+#include <Homework/RadixSort.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+	bool ByKey(const GG::KeyIndex& a, const GG::KeyIndex& b)
+	{
+		return a.key < b.key;
+	}
+
+	// the radix sort is stable, so it has to give exactly what std::stable_sort gives, indices included
+	bool SortsLikeStableSort(const std::vector<GG::KeyIndex>& input)
+	{
+		std::vector<GG::KeyIndex> expected = input;
+		std::stable_sort(expected.begin(), expected.end(), ByKey);
+		std::vector<GG::KeyIndex> sorted = input, scratch;
+		GG::RadixSort(sorted, scratch);
+		if (sorted.size() != expected.size())
+			return false;
+		for (size_t i = 0; i < sorted.size(); ++i)
+			if (sorted[i].key != expected[i].key || sorted[i].index != expected[i].index)
+				return false;
+		return true;
+	}
+
+	std::vector<GG::KeyIndex> Keys(uint32_t count, Tests::Random& random, uint64_t (*make)(Tests::Random&))
+	{
+		std::vector<GG::KeyIndex> keys(count);
+		for (uint32_t i = 0; i < count; ++i)
+			keys[i] = { make(random), i };
+		return keys;
+	}
+
+	GG::DrawItem RandomItem(Tests::Random& random, uint32_t object)
+	{
+		GG::DrawItem item;
+		item.pso = random.Next() % 3;
+		item.texture = random.Next() % 5;
+		item.geometry = random.Next() % 4;
+		item.object = object;
+		item.depth = random.Float(0.1f, 500.0f);
+		item.pass = (random.Next() % 4 == 0) ? GG::DrawPass::Transparent : GG::DrawPass::Opaque;
+		return item;
+	}
+
+	// records what the batcher sets, checking that it never sets what is already set
+	struct Recorder
+	{
+		uint32_t pso = ~0u, texture = ~0u, geometry = ~0u;
+		uint32_t redundant = 0;
+		uint32_t setPipeline = 0, setTexture = 0, setGeometry = 0;
+		std::vector<GG::DrawBatch> draws;
+
+		void SetPipeline(uint32_t p) { redundant += (p == pso) ? 1 : 0; pso = p; ++setPipeline; }
+		// the batcher sets the texture again after every pipeline change, that is not counted as redundant
+		void SetTexture(uint32_t t) { texture = t; ++setTexture; }
+		void SetGeometry(uint32_t g) { redundant += (g == geometry) ? 1 : 0; geometry = g; ++setGeometry; }
+		void DrawInstanced(uint32_t g, uint32_t instanceCount, uint32_t firstInstance)
+		{
+			draws.push_back({ GG::DrawPass::Opaque, pso, texture, g, firstInstance, instanceCount });
+		}
+	};
+
+}
+
+TEST(RadixSortMatchesStableSort)
+{
+	Tests::Random random;
+	std::vector<GG::KeyIndex> empty, scratch;
+	GG::RadixSort(empty, scratch);
+	CHECK(empty.empty());
+
+	for (uint32_t count : { 1u, 2u, 3u, 100u, 4097u })
+	{
+		// every byte different
+		CHECK(SortsLikeStableSort(Keys(count, random, [](Tests::Random& r) { return r.Next64(); })));
+		// few distinct values, lots of equal keys whose order has to stay
+		CHECK(SortsLikeStableSort(Keys(count, random, [](Tests::Random& r) { return uint64_t(r.Next() % 7) << 40; })));
+		// all keys equal, every pass is skipped
+		CHECK(SortsLikeStableSort(Keys(count, random, [](Tests::Random&) { return uint64_t(0x0123456789abcdef); })));
+		// one byte differs, a single pass leaves the result in scratch
+		CHECK(SortsLikeStableSort(Keys(count, random, [](Tests::Random& r) { return uint64_t(r.Next() & 0xff) << 56; })));
+		// three bytes differ
+		CHECK(SortsLikeStableSort(Keys(count, random, [](Tests::Random& r) { return uint64_t(r.Next() & 0xff00ff) | (uint64_t(r.Next() & 0xff) << 48); })));
+		// draw keys
+		CHECK(SortsLikeStableSort(Keys(count, random, [](Tests::Random& r) { return GG::SortKey::Make(RandomItem(r, 0)); })));
+	}
+
+	// scratch kept from a larger sort is fine
+	std::vector<GG::KeyIndex> keys = Keys(10, random, [](Tests::Random& r) { return r.Next64(); });
+	scratch.resize(1000);
+	GG::RadixSort(keys, scratch);
+	CHECK(std::is_sorted(keys.begin(), keys.end(), ByKey));
+}
+
+TEST(SortKeyOrdersPassStateAndDepth)
+{
+	// depth quantization is monotonic and puts everything at or behind the camera at 0
+	Tests::Random random;
+	for (uint32_t i = 0; i < 10000; ++i)
+	{
+		float a = random.Float(0.0f, 1000.0f), b = random.Float(0.0f, 1000.0f);
+		if (a < b)
+			CHECK(GG::SortKey::QuantizeDepth(a) <= GG::SortKey::QuantizeDepth(b));
+	}
+	CHECK(GG::SortKey::QuantizeDepth(0.0f) == 0);
+	CHECK(GG::SortKey::QuantizeDepth(-5.0f) == 0);
+	CHECK(GG::SortKey::QuantizeDepth(1.0f) < GG::SortKey::QuantizeDepth(2.0f));
+
+	GG::DrawItem near{ 1, 2, 3, 0, 1.0f, GG::DrawPass::Opaque };
+	GG::DrawItem far = near;
+	far.depth = 100.0f;
+	// opaque front to back, transparent back to front, every transparent item after every opaque one
+	CHECK(GG::SortKey::Make(near) < GG::SortKey::Make(far));
+	near.pass = far.pass = GG::DrawPass::Transparent;
+	CHECK(GG::SortKey::Make(far) < GG::SortKey::Make(near));
+	GG::DrawItem opaque{ 4095, 65535, 65535, 0, 1e30f, GG::DrawPass::Opaque };
+	CHECK(GG::SortKey::Make(opaque) < GG::SortKey::Make(near));
+
+	// state outranks depth
+	GG::DrawItem a{ 1, 1, 1, 0, 1000.0f, GG::DrawPass::Opaque };
+	GG::DrawItem b{ 1, 1, 2, 0, 1.0f, GG::DrawPass::Opaque };
+	CHECK(GG::SortKey::Make(a) < GG::SortKey::Make(b));
+	CHECK((GG::SortKey::Make(a) & GG::SortKey::StateMask) != (GG::SortKey::Make(b) & GG::SortKey::StateMask));
+	b.geometry = 1;
+	CHECK((GG::SortKey::Make(a) & GG::SortKey::StateMask) == (GG::SortKey::Make(b) & GG::SortKey::StateMask));
+
+	CHECK(GG::SortKey::Fits(4095, 65535, 65535));
+	CHECK(!GG::SortKey::Fits(4096, 0, 0));
+	CHECK(!GG::SortKey::Fits(0, 65536, 0));
+}
+
+TEST(DrawBatcherGroupsItemsAndSkipsRedundantState)
+{
+	const uint32_t count = 2000;
+	Tests::Random random;
+	std::vector<GG::DrawItem> items;
+	GG::DrawBatcher batcher;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		items.push_back(RandomItem(random, i));
+		batcher.Add(items.back());
+	}
+	batcher.Build();
+
+	const std::vector<GG::DrawBatch>& batches = batcher.GetBatches();
+	const std::vector<uint32_t>& instances = batcher.GetInstances();
+	CHECK(instances.size() == count);
+
+	// every object is drawn once, with the state of its batch, in key order
+	std::vector<uint32_t> drawn(count, 0);
+	uint32_t next = 0;
+	uint64_t previousKey = 0;
+	for (size_t b = 0; b < batches.size(); ++b)
+	{
+		const GG::DrawBatch& batch = batches[b];
+		CHECK(batch.firstInstance == next);
+		CHECK(batch.instanceCount > 0);
+		for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; ++i)
+		{
+			const GG::DrawItem& item = items[instances[i]];
+			++drawn[instances[i]];
+			CHECK(item.pass == batch.pass && item.pso == batch.pso && item.texture == batch.texture && item.geometry == batch.geometry);
+			uint64_t key = GG::SortKey::Make(item);
+			CHECK(key >= previousKey);
+			previousKey = key;
+		}
+		next += batch.instanceCount;
+
+		// neighbours never share all of their state, or they would be one batch
+		if (b > 0)
+		{
+			const GG::DrawBatch& prev = batches[b - 1];
+			CHECK(!(prev.pass == batch.pass && prev.pso == batch.pso && prev.texture == batch.texture && prev.geometry == batch.geometry));
+		}
+	}
+	CHECK(std::all_of(drawn.begin(), drawn.end(), [](uint32_t n) { return n == 1; }));
+	// 2 passes * 3 psos * 5 textures * 4 geometries
+	CHECK(batches.size() <= 120);
+
+	Recorder recorder;
+	GG::DrawBatcher::Stats stats = batcher.Record(recorder, 100);
+	CHECK(recorder.redundant == 0);
+	CHECK(recorder.draws.size() == batches.size());
+	CHECK(stats.items == count);
+	CHECK(stats.draws == batches.size());
+	CHECK(stats.pipelineChanges == recorder.setPipeline);
+	CHECK(stats.textureChanges == recorder.setTexture);
+	CHECK(stats.geometryChanges == recorder.setGeometry);
+	CHECK(stats.pipelineChangesElided == count - stats.pipelineChanges);
+	// opaque and transparent: each pso is set at most once per pass
+	CHECK(stats.pipelineChanges <= 2 * 3);
+	for (size_t b = 0; b < batches.size(); ++b)
+	{
+		CHECK(recorder.draws[b].pso == batches[b].pso);
+		CHECK(recorder.draws[b].texture == batches[b].texture);
+		CHECK(recorder.draws[b].geometry == batches[b].geometry);
+		CHECK(recorder.draws[b].firstInstance == batches[b].firstInstance + 100);
+		CHECK(recorder.draws[b].instanceCount == batches[b].instanceCount);
+	}
+
+	// a cleared batcher records nothing
+	batcher.Clear();
+	batcher.Build();
+	Recorder empty;
+	stats = batcher.Record(empty);
+	CHECK(stats.draws == 0 && empty.draws.empty());
+}
+
+BENCHMARK(RadixSortDrawKeys)
+{
+	Tests::Random random;
+	std::vector<GG::KeyIndex> scratch;
+	for (uint32_t count : { 1000u, 10000u, 100000u })
+	{
+		std::vector<GG::KeyIndex> keys = Keys(count, random, [](Tests::Random& r) { return GG::SortKey::Make(RandomItem(r, 0)); });
+		std::vector<GG::KeyIndex> work;
+
+		double standard = Tests::Measure([&] {
+			work = keys;
+			std::sort(work.begin(), work.end(), ByKey);
+			Tests::Consume(work.data());
+		});
+		double radix = Tests::Measure([&] {
+			work = keys;
+			GG::RadixSort(work, scratch);
+			Tests::Consume(work.data());
+		});
+
+		char what[64];
+		std::snprintf(what, sizeof(what), "%u draw keys, std::sort", count);
+		Tests::Report(what, standard);
+		std::snprintf(what, sizeof(what), "%u draw keys, radix sort", count);
+		Tests::Report(what, radix, standard);
+	}
+
+	std::vector<GG::KeyIndex> keys = Keys(100000, random, [](Tests::Random& r) { return r.Next64(); });
+	std::vector<GG::KeyIndex> work;
+	double standard = Tests::Measure([&] { work = keys; std::sort(work.begin(), work.end(), ByKey); Tests::Consume(work.data()); });
+	double radix = Tests::Measure([&] { work = keys; GG::RadixSort(work, scratch); Tests::Consume(work.data()); });
+	Tests::Report("100000 random 64 bit keys, std::sort", standard);
+	Tests::Report("100000 random 64 bit keys, radix sort", radix, standard);
+
+	GG::DrawBatcher batcher;
+	for (uint32_t i = 0; i < 10000; ++i)
+		batcher.Add(RandomItem(random, i));
+	double build = Tests::Measure([&] { batcher.Build(); Tests::Consume(batcher.GetInstances().data()); });
+	Tests::Report("DrawBatcher::Build, 10000 items", build);
+}
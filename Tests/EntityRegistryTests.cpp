@@ -0,0 +1,126 @@
+#include "Test.h"
+
+#include <Homework/EntityRegistry.h>
+
+#include <string>
+#include <vector>
+
+TEST(EntityRegistryReusesSlotsWithNewGeneration)
+{
+	GG::EntityRegistry registry;
+	CHECK(!registry.IsAlive(GG::Entity{}));
+	CHECK(!GG::Entity{}.IsValid());
+
+	GG::Entity a = registry.Create("a");
+	GG::Entity b = registry.Create("b");
+	CHECK(a.IsValid() && b.IsValid());
+	CHECK(a.index != b.index);
+	CHECK(registry.IsAlive(a) && registry.IsAlive(b));
+	CHECK(registry.Find("a") == a);
+	CHECK(registry.GetName(b) == "b");
+
+	registry.Destroy(a);
+	CHECK(!registry.IsAlive(a));
+	CHECK(!registry.Find("a").IsValid());
+	CHECK(registry.IsAlive(b));
+
+	// the slot comes back with the next generation, the old handle stays dead
+	GG::Entity c = registry.Create("c");
+	CHECK(c.index == a.index);
+	CHECK(c.generation == a.generation + 1);
+	CHECK(c != a);
+	CHECK(registry.IsAlive(c));
+	CHECK(!registry.IsAlive(a));
+	CHECK(registry.GetCapacity() == 2);
+
+	// destroying through a stale handle or twice does nothing
+	registry.Destroy(a);
+	CHECK(registry.IsAlive(c));
+	CHECK(registry.Find("c") == c);
+	registry.Destroy(c);
+	registry.Destroy(c);
+	GG::Entity d = registry.Create("d");
+	GG::Entity e = registry.Create("e");
+	CHECK(d.index == a.index && d.generation == a.generation + 2);
+	CHECK(e.index == 2);
+	CHECK(registry.GetCapacity() == 3);
+}
+
+TEST(EntityRegistryNameLookupFollowsTheLatestEntity)
+{
+	GG::EntityRegistry registry;
+	GG::Entity first = registry.Create("box");
+	GG::Entity second = registry.Create("box");
+	CHECK(registry.Find("box") == second);
+
+	// the older entity does not take the name with it
+	registry.Destroy(first);
+	CHECK(registry.Find("box") == second);
+	registry.Destroy(second);
+	CHECK(!registry.Find("box").IsValid());
+}
+
+TEST(EntityRegistryChurnKeepsCapacity)
+{
+	const uint32_t live = 256;
+	GG::EntityRegistry registry;
+	Tests::Random random;
+	std::vector<GG::Entity> entities;
+	std::vector<GG::Entity> dead;
+	for (uint32_t i = 0; i < live; ++i)
+		entities.push_back(registry.Create("e" + std::to_string(i)));
+
+	for (uint32_t round = 0; round < 10000; ++round)
+	{
+		uint32_t victim = random.Next() % live;
+		registry.Destroy(entities[victim]);
+		dead.push_back(entities[victim]);
+		entities[victim] = registry.Create("r" + std::to_string(round));
+	}
+
+	CHECK(registry.GetCapacity() == live);
+	for (const GG::Entity& e : entities)
+		CHECK(registry.IsAlive(e));
+	for (const GG::Entity& e : dead)
+		CHECK(!registry.IsAlive(e));
+}
+
+BENCHMARK(EntityRegistryLookup)
+{
+	const uint32_t count = 10000;
+	GG::EntityRegistry registry;
+	std::vector<std::string> names;
+	std::vector<GG::Entity> handles;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		names.push_back("Media/entity" + std::to_string(i));
+		handles.push_back(registry.Create(names.back()));
+	}
+	std::vector<float> perEntity(registry.GetCapacity(), 1.0f);
+	// what PxSystem keeps to check handles: the dense index of every entity, and the entity of every dense element
+	std::vector<uint32_t> denseOfEntity(registry.GetCapacity());
+	std::vector<GG::Entity> entityOfDense(registry.GetCapacity());
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		denseOfEntity[handles[i].index] = i;
+		entityOfDense[i] = handles[i];
+	}
+
+	float sum = 0.0f;
+	double byName = Tests::Measure([&] {
+		for (const std::string& name : names)
+			sum += perEntity[registry.Find(name).index];
+		Tests::Consume(&sum);
+	});
+	double byHandle = Tests::Measure([&] {
+		for (const GG::Entity& e : handles)
+		{
+			const uint32_t dense = denseOfEntity[e.index];
+			if (entityOfDense[dense].generation == e.generation)
+				sum += perEntity[dense];
+		}
+		Tests::Consume(&sum);
+	});
+	Tests::Report("10K per-frame lookups by name", byName);
+	Tests::Report("10K per-frame lookups by generation checked handle", byHandle, byName);
+}
@@ -0,0 +1,100 @@
+#include "Test.h"
+
+#include <Homework/FixedTimestep.h>
+
+#include <vector>
+
+/*
+Step sizes and frame times are multiples of 1/16, so the accumulator is exact and the step counts are too.
+*/
+
+namespace {
+
+	std::vector<uint32_t> Run(GG::FixedTimestep& timestep, const std::vector<float>& frameTimes)
+	{
+		std::vector<uint32_t> steps;
+		for (float dt : frameTimes)
+			steps.push_back(timestep.Advance(dt));
+		return steps;
+	}
+
+}
+
+TEST(FixedTimestepStepsScriptedFrames)
+{
+	GG::FixedTimestep timestep(0.25f, 4);
+	// short frames step nothing until a whole step has built up, the remainder carries over
+	CHECK(Run(timestep, { 0.125f, 0.125f, 0.3125f, 0.5f, 0.0625f, 0.25f }) == (std::vector<uint32_t>{ 0, 1, 1, 2, 0, 1 }));
+	CHECK(timestep.GetStepCount() == 5);
+	CHECK(timestep.GetDroppedSteps() == 0);
+	// 0.125 left over, half a step
+	CHECK(timestep.GetAlpha() == 0.5f);
+
+	// a zero frame time steps nothing and changes nothing
+	CHECK(timestep.Advance(0.0f) == 0);
+	CHECK(timestep.GetAlpha() == 0.5f);
+	CHECK(timestep.Advance(0.125f) == 1);
+	CHECK(timestep.GetAlpha() == 0.0f);
+}
+
+TEST(FixedTimestepDropClampsAtMaxSubsteps)
+{
+	GG::FixedTimestep timestep(0.25f, 4, GG::FixedTimestep::CatchUp::Drop);
+	// a spike of 8.25 steps: 4 are simulated, the 4 whole ones left are dropped, the quarter step is kept
+	CHECK(timestep.Advance(2.0625f) == 4);
+	CHECK(timestep.GetDroppedSteps() == 4);
+	CHECK(timestep.GetAlpha() == 0.25f);
+	// the next frames do not catch up
+	CHECK(timestep.Advance(0.1875f) == 1);
+	CHECK(Run(timestep, { 0.25f, 0.25f }) == (std::vector<uint32_t>{ 1, 1 }));
+	CHECK(timestep.GetStepCount() == 7);
+	CHECK(timestep.GetDroppedSteps() == 4);
+
+	// never more than maxSubsteps, whatever the frame time
+	timestep.SetMaxSubsteps(2);
+	CHECK(Run(timestep, { 10.0f, 0.75f, 0.5f }) == (std::vector<uint32_t>{ 2, 2, 2 }));
+	CHECK(timestep.GetDroppedSteps() == 4 + 38 + 1);
+}
+
+TEST(FixedTimestepKeepWorksOffBacklog)
+{
+	GG::FixedTimestep timestep(0.25f, 2, GG::FixedTimestep::CatchUp::Keep, 1.0f);
+	// 6 steps: 2 now, the 4 left are the whole allowed backlog and are simulated over the next frames
+	CHECK(timestep.Advance(1.5f) == 2);
+	CHECK(timestep.GetDroppedSteps() == 0);
+	CHECK(Run(timestep, { 0.0f, 0.0f, 0.0f }) == (std::vector<uint32_t>{ 2, 2, 0 }));
+	CHECK(timestep.GetStepCount() == 6);
+
+	// 12 steps: 2 now, 4 kept, the 6 over the backlog are dropped
+	CHECK(timestep.Advance(3.0f) == 2);
+	CHECK(timestep.GetDroppedSteps() == 6);
+	CHECK(Run(timestep, { 0.0f, 0.0f, 0.0f }) == (std::vector<uint32_t>{ 2, 2, 0 }));
+	CHECK(timestep.GetStepCount() == 12);
+
+	// frames at the step rate work the backlog off one extra step per frame, then keep up
+	CHECK(timestep.Advance(1.75f) == 2);
+	CHECK(timestep.GetDroppedSteps() == 7);
+	CHECK(Run(timestep, { 0.25f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f }) == (std::vector<uint32_t>{ 2, 2, 2, 2, 1, 1 }));
+	CHECK(timestep.GetAlpha() == 0.0f);
+}
+
+TEST(FixedTimestepAlphaStaysBelowOne)
+{
+	Tests::Random random;
+	for (GG::FixedTimestep::CatchUp policy : { GG::FixedTimestep::CatchUp::Drop, GG::FixedTimestep::CatchUp::Keep })
+	{
+		GG::FixedTimestep timestep(1.0f / 60.0f, 4, policy, 0.25f);
+		uint64_t steps = 0;
+		for (int frame = 0; frame < 100000; ++frame)
+		{
+			// mostly around the step size, with the odd spike
+			const float dt = (frame % 97 == 0) ? random.Float(0.1f, 0.5f) : random.Float(0.0f, 0.04f);
+			const uint32_t n = timestep.Advance(dt);
+			CHECK(n <= 4);
+			steps += n;
+			const float alpha = timestep.GetAlpha();
+			CHECK(alpha >= 0.0f && alpha < 1.0f);
+		}
+		CHECK(timestep.GetStepCount() == steps);
+	}
+}
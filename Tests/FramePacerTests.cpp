@@ -0,0 +1,206 @@
+#include "Test.h"
+
+#include <Homework/FramePacer.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+	// the gpu only moves when the test says so, Wait completes up to the value it was asked for and counts the call
+	struct ManualFence
+	{
+		uint64_t completed = 0;
+		uint64_t signaled = 0;
+		uint32_t waits = 0;
+		uint64_t lastWaitedFor = 0;
+
+		uint64_t GetCompletedValue() const { return completed; }
+		void Signal(uint64_t value) { signaled = value; }
+		void Wait(uint64_t value)
+		{
+			++waits;
+			lastWaitedFor = value;
+			if (completed < value)
+				completed = value;
+		}
+	};
+
+	// a gpu thread that completes the signaled values in order, each after a delay, Wait really blocks
+	class ThreadFence
+	{
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::deque<uint64_t> queued;
+		uint64_t completed = 0;
+		bool quit = false;
+		std::chrono::microseconds frameTime;
+		std::thread gpu;
+
+	public:
+		explicit ThreadFence(std::chrono::microseconds frameTime) : frameTime{ frameTime }
+		{
+			gpu = std::thread([this] {
+				std::unique_lock<std::mutex> lock(mutex);
+				while (true)
+				{
+					changed.wait(lock, [this] { return quit || !queued.empty(); });
+					if (queued.empty())
+						return;
+					uint64_t value = queued.front();
+					lock.unlock();
+					std::this_thread::sleep_for(this->frameTime);
+					lock.lock();
+					queued.pop_front();
+					completed = value;
+					changed.notify_all();
+				}
+			});
+		}
+
+		~ThreadFence()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				quit = true;
+			}
+			changed.notify_all();
+			gpu.join();
+		}
+
+		uint64_t GetCompletedValue()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return completed;
+		}
+
+		void Signal(uint64_t value)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queued.push_back(value);
+			changed.notify_all();
+		}
+
+		void Wait(uint64_t value)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this, value] { return completed >= value; });
+		}
+
+		// values signaled but not completed yet
+		uint64_t GetQueued()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return queued.size();
+		}
+	};
+
+}
+
+TEST(FramePacerReusesSlotAfterFramesInFlight)
+{
+	ManualFence fence;
+	GG::FramePacer<ManualFence> pacer(fence);
+	CHECK(pacer.GetFrameCount() == GG::FramesInFlight);
+
+	// the first FramesInFlight frames start without waiting, each signals the next value
+	for (uint32_t i = 0; i < GG::FramesInFlight; ++i)
+	{
+		CHECK(pacer.BeginFrame() == i);
+		pacer.EndFrame();
+		CHECK(fence.signaled == i + 1);
+		CHECK(pacer.GetLastSignaledValue() == i + 1);
+	}
+	CHECK(fence.waits == 0);
+	CHECK(pacer.GetStallCount() == 0);
+
+	// the slots wrap around, a slot is reused only when the frame recorded into it FramesInFlight frames ago is done
+	for (uint64_t frame = GG::FramesInFlight; frame < 100; ++frame)
+	{
+		uint32_t waits = fence.waits;
+		CHECK(pacer.BeginFrame() == frame % GG::FramesInFlight);
+		CHECK(fence.waits == waits + 1);
+		CHECK(fence.lastWaitedFor == frame - GG::FramesInFlight + 1);
+		pacer.EndFrame();
+	}
+	CHECK(pacer.GetStallCount() == 100 - GG::FramesInFlight);
+	CHECK(pacer.GetFrame() == 100 % GG::FramesInFlight);
+
+	// a gpu that keeps up never makes BeginFrame wait
+	uint64_t stalls = pacer.GetStallCount();
+	for (uint32_t i = 0; i < 10; ++i)
+	{
+		fence.completed = fence.signaled;
+		pacer.BeginFrame();
+		pacer.EndFrame();
+	}
+	CHECK(pacer.GetStallCount() == stalls);
+
+	// the gpu one frame behind is still within FramesInFlight
+	for (uint32_t i = 0; i < 10; ++i)
+	{
+		fence.completed = fence.signaled - 1;
+		pacer.BeginFrame();
+		pacer.EndFrame();
+	}
+	CHECK(pacer.GetStallCount() == stalls);
+}
+
+TEST(FramePacerWaitForIdle)
+{
+	ManualFence fence;
+	GG::FramePacer<ManualFence> pacer(fence, 3);
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		pacer.BeginFrame();
+		pacer.EndFrame();
+	}
+	CHECK(fence.completed == 0);
+
+	// signals a value of its own after the frames and waits for it, the next frames find every slot free
+	pacer.WaitForIdle();
+	CHECK(fence.signaled == 4);
+	CHECK(fence.completed == 4);
+	CHECK(pacer.GetLastSignaledValue() == 4);
+	uint32_t waits = fence.waits;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		pacer.BeginFrame();
+		pacer.EndFrame();
+	}
+	CHECK(fence.waits == waits);
+	CHECK(fence.signaled == 7);
+
+	// nothing to wait for if the gpu is already there
+	fence.completed = 100;
+	waits = fence.waits;
+	pacer.WaitForIdle();
+	CHECK(fence.waits == waits);
+}
+
+TEST(FramePacerBlocksOnSlowGpu)
+{
+	// a gpu five times slower than the cpu: when a frame starts recording at most FramesInFlight - 1 earlier frames are unfinished,
+	// BeginFrame blocks in the fence until then
+	ThreadFence fence(std::chrono::milliseconds(2));
+	GG::FramePacer<ThreadFence> pacer(fence);
+	uint64_t maxAhead = 0;
+	for (uint32_t i = 0; i < 20; ++i)
+	{
+		pacer.BeginFrame();
+		uint64_t ahead = pacer.GetLastSignaledValue() - fence.GetCompletedValue();
+		maxAhead = std::max(maxAhead, ahead);
+		std::this_thread::sleep_for(std::chrono::microseconds(400));
+		pacer.EndFrame();
+	}
+	CHECK(maxAhead <= GG::FramesInFlight - 1);
+	CHECK(pacer.GetStallCount() > 0);
+	CHECK(fence.GetQueued() <= GG::FramesInFlight);
+
+	pacer.WaitForIdle();
+	CHECK(fence.GetCompletedValue() == pacer.GetLastSignaledValue());
+	CHECK(fence.GetQueued() == 0);
+}
@@ -0,0 +1,247 @@
+#include "Test.h"
+
+#include <Egg/Cull/Frustum.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace Egg::Math;
+using namespace Egg::Cull;
+
+namespace {
+
+	Float3 RandomPoint(Tests::Random& random, float extent)
+	{
+		return Float3(random.Float(-extent, extent), random.Float(-extent, extent), random.Float(-extent, extent));
+	}
+
+	Float3 RandomAxis(Tests::Random& random)
+	{
+		Float3 axis = RandomPoint(random, 1.0f);
+		return axis.LengthSquared() > 1e-4f ? axis.Normalize() : Float3(0.0f, 0.0f, 1.0f);
+	}
+
+	Float4x4 RandomViewProj(Tests::Random& random)
+	{
+		Float3 ahead = RandomAxis(random);
+		// keep away from looking straight up or down, View needs ahead and up not to be parallel
+		if (std::fabs(ahead.y) > 0.9f)
+			ahead = Float3(ahead.x, 0.5f, ahead.z).Normalize();
+		return Float4x4::View(RandomPoint(random, 50.0f), ahead, Float3(0.0f, 1.0f, 0.0f)) *
+			Float4x4::Proj(random.Float(0.6f, 1.6f), random.Float(0.75f, 2.0f), random.Float(0.1f, 2.0f), random.Float(100.0f, 400.0f));
+	}
+
+	enum class Clip { Inside, Outside, Boundary };
+
+	// the brute force reference: the point in clip space against -w <= x <= w, -w <= y <= w, 0 <= z <= w,
+	// points too close to a plane to tell with float precision are Boundary
+	Clip Classify(const Float4x4& viewProj, const Float3& p)
+	{
+		Float4 c = viewProj.Transform(Float4(p, 1.0f));
+		const float margin = 1e-4f * std::fabs(c.w) + 1e-5f;
+		const float distances[6] = { c.w + c.x, c.w - c.x, c.w + c.y, c.w - c.y, c.z, c.w - c.z };
+		bool boundary = false;
+		for (float d : distances)
+		{
+			if (d < -margin)
+				return Clip::Outside;
+			boundary = boundary || d <= margin;
+		}
+		return boundary ? Clip::Boundary : Clip::Inside;
+	}
+
+	// whether any of the center, the surface points along the axes and random points of the sphere is inside the frustum
+	bool AnySampleInside(const Float4x4& viewProj, const Sphere& s, Tests::Random& random)
+	{
+		const Float3 axes[6] = { Float3(1.0f, 0.0f, 0.0f), Float3(-1.0f, 0.0f, 0.0f), Float3(0.0f, 1.0f, 0.0f), Float3(0.0f, -1.0f, 0.0f), Float3(0.0f, 0.0f, 1.0f), Float3(0.0f, 0.0f, -1.0f) };
+		if (Classify(viewProj, s.center) == Clip::Inside)
+			return true;
+		for (const Float3& a : axes)
+			if (Classify(viewProj, s.center + a * s.radius) == Clip::Inside)
+				return true;
+		for (int i = 0; i < 64; ++i)
+			if (Classify(viewProj, s.center + RandomAxis(random) * (s.radius * random.Float(0.0f, 1.0f))) == Clip::Inside)
+				return true;
+		return false;
+	}
+
+	bool AnySampleInside(const Float4x4& viewProj, const Aabb& box, Tests::Random& random)
+	{
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			Float3 p((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+			if (Classify(viewProj, p) == Clip::Inside)
+				return true;
+		}
+		for (int i = 0; i < 64; ++i)
+		{
+			Float3 p(random.Float(box.min.x, box.max.x), random.Float(box.min.y, box.max.y), random.Float(box.min.z, box.max.z));
+			if (Classify(viewProj, p) == Clip::Inside)
+				return true;
+		}
+		return false;
+	}
+
+}
+
+TEST(FrustumPlanesMatchClipSpace)
+{
+	Tests::Random random;
+	for (int camera = 0; camera < 50; ++camera)
+	{
+		Float4x4 viewProj = RandomViewProj(random);
+		Frustum frustum = Frustum::FromViewProj(viewProj);
+		for (uint32_t p = 0; p < 6; ++p)
+		{
+			const Float4& plane = frustum.GetPlane(p);
+			CHECK_NEAR(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z, 1.0f, 1e-5f);
+		}
+
+		// a point is visible exactly when it is in the clip volume
+		for (int i = 0; i < 2000; ++i)
+		{
+			Float3 p = RandomPoint(random, 400.0f);
+			Clip clip = Classify(viewProj, p);
+			if (clip != Clip::Boundary)
+				CHECK(frustum.Intersects(Sphere{ p, 0.0f }) == (clip == Clip::Inside));
+		}
+	}
+}
+
+TEST(FrustumCullsConservatively)
+{
+	// never culls a volume that has a point in the frustum, and rarely keeps one that has none
+	Tests::Random random;
+	uint32_t spheres = 0, spheresKeptOutside = 0, boxes = 0, boxesKeptOutside = 0;
+	for (int camera = 0; camera < 20; ++camera)
+	{
+		Float4x4 viewProj = RandomViewProj(random);
+		Frustum frustum = Frustum::FromViewProj(viewProj);
+		for (int i = 0; i < 500; ++i)
+		{
+			Sphere s{ RandomPoint(random, 300.0f), random.Float(0.1f, 20.0f) };
+			bool inside = AnySampleInside(viewProj, s, random);
+			bool visible = frustum.Intersects(s);
+			if (inside)
+				CHECK(visible);
+			spheres += visible ? 1 : 0;
+			spheresKeptOutside += (visible && !inside) ? 1 : 0;
+
+			Float3 center = RandomPoint(random, 300.0f);
+			Float3 extent(random.Float(0.1f, 20.0f), random.Float(0.1f, 20.0f), random.Float(0.1f, 20.0f));
+			Aabb box{ center - extent, center + extent };
+			inside = AnySampleInside(viewProj, box, random);
+			visible = frustum.Intersects(box);
+			if (inside)
+				CHECK(visible);
+			boxes += visible ? 1 : 0;
+			boxesKeptOutside += (visible && !inside) ? 1 : 0;
+		}
+	}
+	// the kept ones are near the frustum edges and corners, or sampled too sparsely to find their inside point
+	CHECK(spheres > 500 && boxes > 500);
+	CHECK(spheresKeptOutside * 5 < spheres);
+	CHECK(boxesKeptOutside * 5 < boxes);
+}
+
+TEST(CullSpheresMatchesPerSphereTest)
+{
+	Tests::Random random;
+	// not a multiple of four, the last ones go through the scalar loop
+	const size_t count = 4099;
+	std::vector<float> x(count), y(count), z(count), radius(count);
+	std::vector<uint32_t> visible(count);
+	for (int camera = 0; camera < 20; ++camera)
+	{
+		Frustum frustum = Frustum::FromViewProj(RandomViewProj(random));
+		for (size_t i = 0; i < count; ++i)
+		{
+			Float3 p = RandomPoint(random, 300.0f);
+			x[i] = p.x;
+			y[i] = p.y;
+			z[i] = p.z;
+			radius[i] = random.Float(0.0f, 20.0f);
+		}
+
+		const uint32_t firstIndex = 1000;
+		size_t visibleCount = CullSpheres(frustum, x.data(), y.data(), z.data(), radius.data(), count, visible.data(), firstIndex);
+		std::vector<uint32_t> expected;
+		for (size_t i = 0; i < count; ++i)
+			if (frustum.Intersects(Sphere{ Float3(x[i], y[i], z[i]), radius[i] }))
+				expected.push_back(firstIndex + (uint32_t)i);
+		CHECK(visibleCount == expected.size());
+		CHECK(std::equal(expected.begin(), expected.end(), visible.begin()));
+	}
+}
+
+TEST(AabbTransformContainsTransformedCorners)
+{
+	Tests::Random random;
+	for (int i = 0; i < 1000; ++i)
+	{
+		Float3 center = RandomPoint(random, 50.0f);
+		Float3 extent(random.Float(0.1f, 10.0f), random.Float(0.1f, 10.0f), random.Float(0.1f, 10.0f));
+		Aabb box{ center - extent, center + extent };
+		Float4x4 m = Float4x4::Scaling(Float3(random.Float(0.2f, 4.0f), random.Float(0.2f, 4.0f), random.Float(0.2f, 4.0f))) *
+			Float4x4::Rotation(RandomAxis(random), random.Float(-3.14f, 3.14f)) * Float4x4::Translation(RandomPoint(random, 100.0f));
+		Aabb transformed = Transform(box, m);
+
+		// contains every corner, and is touched by at least one corner on each side
+		const float tolerance = 1e-3f;
+		float touch[6] = { 1e30f, 1e30f, 1e30f, 1e30f, 1e30f, 1e30f };
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			Float3 p((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+			Float3 q = m.Transform(Float4(p, 1.0f)).xyz;
+			CHECK(q.x >= transformed.min.x - tolerance && q.x <= transformed.max.x + tolerance);
+			CHECK(q.y >= transformed.min.y - tolerance && q.y <= transformed.max.y + tolerance);
+			CHECK(q.z >= transformed.min.z - tolerance && q.z <= transformed.max.z + tolerance);
+			touch[0] = std::min(touch[0], q.x - transformed.min.x);
+			touch[1] = std::min(touch[1], transformed.max.x - q.x);
+			touch[2] = std::min(touch[2], q.y - transformed.min.y);
+			touch[3] = std::min(touch[3], transformed.max.y - q.y);
+			touch[4] = std::min(touch[4], q.z - transformed.min.z);
+			touch[5] = std::min(touch[5], transformed.max.z - q.z);
+		}
+		for (float t : touch)
+			CHECK(std::fabs(t) < tolerance);
+	}
+}
+
+BENCHMARK(FrustumCullSpheres)
+{
+	const size_t count = 1 << 16;
+	Tests::Random random;
+	// a 90 degree camera in the middle of the scene, about a sixth of it is in view
+	Frustum frustum = Frustum::FromViewProj(Float4x4::View(Float3(0.0f, 0.0f, 0.0f), Float3(0.0f, 0.0f, 1.0f), Float3(0.0f, 1.0f, 0.0f)) *
+		Float4x4::Proj(1.57f, 1.0f, 0.5f, 1000.0f));
+	std::vector<float> x(count), y(count), z(count), radius(count);
+	std::vector<uint32_t> visible(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Float3 p = RandomPoint(random, 300.0f);
+		x[i] = p.x;
+		y[i] = p.y;
+		z[i] = p.z;
+		radius[i] = random.Float(0.5f, 5.0f);
+	}
+
+	size_t visibleCount = 0;
+	double loop = Tests::Measure([&] {
+		visibleCount = 0;
+		for (size_t i = 0; i < count; ++i)
+			if (frustum.Intersects(Sphere{ Float3(x[i], y[i], z[i]), radius[i] }))
+				visible[visibleCount++] = (uint32_t)i;
+		Tests::Consume(visible.data());
+	});
+	double batch = Tests::Measure([&] {
+		visibleCount = CullSpheres(frustum, x.data(), y.data(), z.data(), radius.data(), count, visible.data());
+		Tests::Consume(visible.data());
+	});
+
+	char what[80];
+	std::snprintf(what, sizeof(what), "64K spheres, %u%% visible, Intersects loop", (uint32_t)(visibleCount * 100 / count));
+	Tests::Report(what, loop);
+	Tests::Report("64K spheres, CullSpheres", batch, loop);
+}
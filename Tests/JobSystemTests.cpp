@@ -0,0 +1,271 @@
+#include "Test.h"
+
+#include <Egg/Jobs/JobSystem.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/*
+Stress tests of Egg::Jobs, meant to be run under ThreadSanitizer too ("make tsan" in this folder).
+The worker count is fixed, so the races happen the same way on every machine, even on a single core.
+*/
+
+using namespace Egg::Jobs;
+
+namespace {
+
+	const uint32_t workerCount = 4;
+
+	// every slot must be hit exactly once
+	bool AllOnce(const std::vector<std::atomic<uint32_t>>& hits)
+	{
+		for (const std::atomic<uint32_t>& h : hits)
+			if (h.load() != 1)
+				return false;
+		return true;
+	}
+
+}
+
+TEST(JobSystemRunsJobsFromManyThreadsOnce)
+{
+	const uint32_t submitters = 4;
+	const uint32_t jobsPerSubmitter = 5000;
+	JobSystem jobs(workerCount);
+	std::vector<std::atomic<uint32_t>> hits(submitters * jobsPerSubmitter);
+
+	// threads that are not workers go through the shared queue and help while they wait
+	std::vector<std::thread> threads;
+	for (uint32_t s = 0; s < submitters; ++s)
+		threads.emplace_back([&jobs, &hits, s] {
+			Counter::P counter = Counter::Create();
+			for (uint32_t i = 0; i < jobsPerSubmitter; ++i)
+				jobs.Submit([&hits, s, i] { hits[s * jobsPerSubmitter + i].fetch_add(1); }, counter);
+			jobs.Wait(*counter);
+		});
+	for (std::thread& t : threads)
+		t.join();
+
+	CHECK(AllOnce(hits));
+	CHECK(jobs.GetStats().executed == submitters * jobsPerSubmitter);
+}
+
+TEST(JobSystemJobsSubmittedFromJobs)
+{
+	// a binary tree of jobs, every job but the leaves submits two more to its worker's deque,
+	// which the other workers have to steal from
+	const uint32_t depth = 14;
+	JobSystem jobs(workerCount);
+	Counter::P counter = Counter::Create();
+	std::atomic<uint32_t> nodes{ 0 };
+
+	std::function<void(uint32_t)> node = [&](uint32_t level) {
+		nodes.fetch_add(1);
+		if (level + 1 < depth)
+		{
+			jobs.Submit([&node, level] { node(level + 1); }, counter);
+			jobs.Submit([&node, level] { node(level + 1); }, counter);
+		}
+	};
+	jobs.Submit([&node] { node(0); }, counter);
+	jobs.Wait(*counter);
+
+	CHECK(nodes.load() == (1u << depth) - 1);
+	CHECK(counter->IsDone());
+}
+
+TEST(JobSystemWaitRunsJobsOnTheCallingThread)
+{
+	// one worker blocked by a job that only finishes after another queued job ran, the waiting main thread has to run it
+	JobSystem jobs(1);
+	Counter::P counter = Counter::Create();
+	std::atomic<bool> released{ false };
+	jobs.Submit([&released] { while (!released.load()) std::this_thread::yield(); }, counter);
+	jobs.Submit([&released] { released.store(true); }, counter);
+	jobs.Wait(*counter);
+
+	CHECK(released.load());
+	CHECK(jobs.GetStats().helped >= 1);
+	CHECK(jobs.GetCurrentWorker() == -1);
+}
+
+TEST(JobSystemDestructorRunsQueuedJobs)
+{
+	std::atomic<uint32_t> executed{ 0 };
+	{
+		JobSystem jobs(workerCount);
+		for (uint32_t i = 0; i < 10000; ++i)
+			jobs.Submit([&executed] { executed.fetch_add(1); });
+	}
+	CHECK(executed.load() == 10000);
+}
+
+TEST(WorkDequeStealRace)
+{
+	// the owner pushes and pops at the bottom while three thieves steal from the top, starting from a tiny ring
+	// so it grows under them; every item has to come out exactly once
+	const uint32_t items = 200000;
+	const uint32_t thieves = 3;
+	WorkDeque deque(4);
+	std::vector<std::atomic<uint32_t>> taken(items + 1);
+	std::atomic<bool> done{ false };
+
+	// items are fake task pointers, the deque never dereferences them
+	auto take = [&taken](Task* task) { taken[(size_t)(uintptr_t)task].fetch_add(1); };
+
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < thieves; ++t)
+		threads.emplace_back([&] {
+			while (!done.load())
+				if (Task* task = deque.Steal())
+					take(task);
+			while (Task* task = deque.Steal())
+				take(task);
+		});
+
+	Tests::Random random;
+	for (uint32_t i = 1; i <= items; ++i)
+	{
+		deque.Push(reinterpret_cast<Task*>((uintptr_t)i));
+		// pop about a third of the time, so the last-element race between Pop and Steal happens often
+		if (random.Next() % 3 == 0)
+			if (Task* task = deque.Pop())
+				take(task);
+	}
+	while (Task* task = deque.Pop())
+		take(task);
+	done.store(true);
+	for (std::thread& t : threads)
+		t.join();
+
+	CHECK(deque.Empty());
+	CHECK(taken[0].load() == 0);
+	bool once = true;
+	for (uint32_t i = 1; i <= items; ++i)
+		once = once && taken[i].load() == 1;
+	CHECK(once);
+}
+
+TEST(JobSystemNestedParallelFor)
+{
+	// three levels of ParallelFor, the inner loops are waited for inside jobs of the outer ones
+	const uint32_t outer = 16, middle = 16, inner = 256;
+	JobSystem jobs(workerCount);
+	std::vector<std::atomic<uint32_t>> hits(outer * middle * inner);
+
+	for (uint32_t round = 0; round < 4; ++round)
+	{
+		for (std::atomic<uint32_t>& h : hits)
+			h.store(0);
+
+		jobs.ParallelFor(0, outer, 1, [&](uint32_t firstO, uint32_t lastO) {
+			for (uint32_t o = firstO; o < lastO; ++o)
+				jobs.ParallelFor(0, middle, 2, [&, o](uint32_t firstM, uint32_t lastM) {
+					for (uint32_t m = firstM; m < lastM; ++m)
+						jobs.ParallelFor(0, inner, round * 16, [&, o, m](uint32_t first, uint32_t last) {
+							for (uint32_t i = first; i < last; ++i)
+								hits[(o * middle + m) * inner + i].fetch_add(1);
+						});
+				});
+		});
+
+		CHECK(AllOnce(hits));
+	}
+
+	// empty and single-range loops run inline
+	uint32_t calls = 0;
+	jobs.ParallelFor(5, 5, 1, [&calls](uint32_t, uint32_t) { ++calls; });
+	jobs.ParallelFor(0, 3, 8, [&calls](uint32_t first, uint32_t last) { calls += (first == 0 && last == 3) ? 1 : 100; });
+	CHECK(calls == 1);
+}
+
+TEST(JobSystemSubmitAfterOrdersDependencies)
+{
+	JobSystem jobs(workerCount);
+
+	for (uint32_t round = 0; round < 50; ++round)
+	{
+		// diamond: a -> (b, c) -> d, every job checks the stage its dependencies reached
+		Counter::P a = Counter::Create(), bc = Counter::Create(), d = Counter::Create();
+		std::atomic<uint32_t> aDone{ 0 }, bcDone{ 0 }, errors{ 0 };
+		const uint32_t width = 32;
+
+		// SubmitAfter raises bc right away, so d is attached to a counter that can't have reached zero yet,
+		// while a may already be done when b and c are attached
+		for (uint32_t i = 0; i < width; ++i)
+			jobs.Submit([&] { aDone.fetch_add(1); }, a);
+		for (uint32_t i = 0; i < 2 * width; ++i)
+			jobs.SubmitAfter(*a, [&] { if (aDone.load() != width) errors.fetch_add(1); bcDone.fetch_add(1); }, bc);
+		jobs.SubmitAfter(*bc, [&] { if (bcDone.load() != 2 * width) errors.fetch_add(1); }, d);
+		jobs.Wait(*d);
+
+		CHECK(errors.load() == 0);
+		CHECK(bcDone.load() == 2 * width);
+		CHECK(a->IsDone() && bc->IsDone());
+	}
+
+	// a chain of 1000 jobs, each after the previous one's counter
+	{
+		std::atomic<uint32_t> next{ 0 }, errors{ 0 };
+		Counter::P previous = Counter::Create();
+		jobs.Submit([&next] { next.fetch_add(1); }, previous);
+		for (uint32_t i = 1; i < 1000; ++i)
+		{
+			Counter::P counter = Counter::Create();
+			jobs.SubmitAfter(*previous, [&next, &errors, i] { if (next.fetch_add(1) != i) errors.fetch_add(1); }, counter);
+			previous = counter;
+		}
+		jobs.Wait(*previous);
+		CHECK(next.load() == 1000);
+		CHECK(errors.load() == 0);
+	}
+
+	// a dependency that is already done queues the job right away
+	{
+		Counter::P done = Counter::Create();
+		Counter::P counter = Counter::Create();
+		std::atomic<bool> ran{ false };
+		jobs.SubmitAfter(*done, [&ran] { ran.store(true); }, counter);
+		jobs.Wait(*counter);
+		CHECK(ran.load());
+	}
+}
+
+BENCHMARK(JobSystemParallelFor)
+{
+	const uint32_t count = 1 << 20;
+	std::vector<float> data(count);
+	auto work = [&data](uint32_t first, uint32_t last) {
+		for (uint32_t i = first; i < last; ++i)
+		{
+			float x = (float)i * 1e-6f;
+			for (int k = 0; k < 16; ++k)
+				x = x * 0.999f + 0.5f / (1.0f + x * x);
+			data[i] = x;
+		}
+	};
+
+	// the same ranges one after the other, so the loop is compiled the same way as in the jobs
+	double serial = Tests::Measure([&] {
+		for (uint32_t first = 0; first < count; first += 4096)
+			work(first, first + 4096);
+		Tests::Consume(data.data());
+	}, 3);
+	Tests::Report("1M elements, serial", serial);
+
+	JobSystem jobs;
+	for (uint32_t grain : { 256u, 4096u, 0u })
+	{
+		jobs.ResetStats();
+		double parallel = Tests::Measure([&] { jobs.ParallelFor(0, count, grain, work); Tests::Consume(data.data()); }, 3);
+		JobSystem::Stats stats = jobs.GetStats();
+		char what[96];
+		std::snprintf(what, sizeof(what), "1M elements, %u+1 threads, grain %u, %llu steals", jobs.GetWorkerCount(), grain,
+			(unsigned long long)stats.steals);
+		Tests::Report(what, parallel, serial);
+	}
+}
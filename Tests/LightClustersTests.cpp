@@ -0,0 +1,426 @@
+#include "Test.h"
+
+#include <Egg/Cull/LightClusters.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace Egg::Math;
+using namespace Egg::Cull;
+
+namespace {
+
+	const float Fov = 1.2f, Aspect = 16.0f / 9.0f, Near = 0.5f, Far = 500.0f;
+
+	// looking down and to the side from off the origin, so the lights go through a rotation and a translation
+	Float4x4 CameraView()
+	{
+		return Float4x4::View(Float3(3.0f, 4.0f, -2.0f), Float3(0.3f, -0.2f, 1.0f), Float3(0.0f, 1.0f, 0.0f));
+	}
+
+	Float4x4 CameraProj()
+	{
+		return Float4x4::Proj(Fov, Aspect, Near, Far);
+	}
+
+	void Build(LightClusters& clusters, const Float4x4& view, const std::vector<Sphere>& lights)
+	{
+		clusters.BeginFrame(view, CameraProj(), lights.data(), (uint32_t)lights.size());
+		for (uint32_t z = 0; z < clusters.GetCountZ(); ++z)
+			clusters.BinSlice(z);
+		clusters.Finish();
+	}
+
+	// the brute force: the frustum slice of every cluster and the box around it from the camera parameters, in double precision
+	struct Reference
+	{
+		uint32_t countX, countY, countZ;
+		double xScale, yScale;
+
+		explicit Reference(const LightClusters& clusters) :
+			countX{ clusters.GetCountX() }, countY{ clusters.GetCountY() }, countZ{ clusters.GetCountZ() },
+			xScale{ 1.0 / std::tan(Fov * 0.5) / Aspect }, yScale{ 1.0 / std::tan(Fov * 0.5) }
+		{
+		}
+
+		double SliceDepth(uint32_t z) const
+		{
+			return Near * std::pow((double)Far / Near, (double)z / countZ);
+		}
+
+		void Box(uint32_t x, uint32_t y, uint32_t z, double min[3], double max[3]) const
+		{
+			const double d0 = SliceDepth(z), d1 = SliceDepth(z + 1);
+			const double left = -1.0 + 2.0 * x / countX, right = -1.0 + 2.0 * (x + 1) / countX;
+			const double top = 1.0 - 2.0 * y / countY, bottom = 1.0 - 2.0 * (y + 1) / countY;
+			min[0] = std::min(left * d0, left * d1) / xScale;
+			max[0] = std::max(right * d0, right * d1) / xScale;
+			min[1] = std::min(bottom * d0, bottom * d1) / yScale;
+			max[1] = std::max(top * d0, top * d1) / yScale;
+			min[2] = d0;
+			max[2] = d1;
+		}
+
+		// the corners of the frustum slice, near ones first, each counterclockwise from the bottom left seen from the camera
+		void Corners(uint32_t x, uint32_t y, uint32_t z, double corners[8][3]) const
+		{
+			const double left = -1.0 + 2.0 * x / countX, right = -1.0 + 2.0 * (x + 1) / countX;
+			const double top = 1.0 - 2.0 * y / countY, bottom = 1.0 - 2.0 * (y + 1) / countY;
+			const double ndc[4][2] = { { left, bottom }, { right, bottom }, { right, top }, { left, top } };
+			for (int i = 0; i < 8; ++i)
+			{
+				const double d = SliceDepth(z + i / 4);
+				corners[i][0] = ndc[i % 4][0] * d / xScale;
+				corners[i][1] = ndc[i % 4][1] * d / yScale;
+				corners[i][2] = d;
+			}
+		}
+
+		// a view space point at the center of a tile, at view depth d
+		Float3 TileCenter(uint32_t x, uint32_t y, double d) const
+		{
+			const double ndcX = -1.0 + (2.0 * x + 1.0) / countX, ndcY = 1.0 - (2.0 * y + 1.0) / countY;
+			return Float3((float)(ndcX * d / xScale), (float)(ndcY * d / yScale), (float)d);
+		}
+	};
+
+	double Dot(const double a[3], const double b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// distance of p from the segment ab
+	double SegmentDistance(const double p[3], const double a[3], const double b[3])
+	{
+		const double ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		const double ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+		const double t = std::min(std::max(Dot(ap, ab) / Dot(ab, ab), 0.0), 1.0);
+		const double d[3] = { ap[0] - t * ab[0], ap[1] - t * ab[1], ap[2] - t * ab[2] };
+		return std::sqrt(Dot(d, d));
+	}
+
+	// distance of p from the planar convex quad, given in order
+	double QuadDistance(const double p[3], const double* quad[4])
+	{
+		const double u[3] = { quad[1][0] - quad[0][0], quad[1][1] - quad[0][1], quad[1][2] - quad[0][2] };
+		const double v[3] = { quad[3][0] - quad[0][0], quad[3][1] - quad[0][1], quad[3][2] - quad[0][2] };
+		double n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+		const double length = std::sqrt(Dot(n, n));
+		for (double& c : n)
+			c /= length;
+		const double ap[3] = { p[0] - quad[0][0], p[1] - quad[0][1], p[2] - quad[0][2] };
+		const double height = Dot(ap, n);
+
+		// the foot of p is inside if it is on the same side of every edge
+		bool inside = true;
+		for (int i = 0; i < 4; ++i)
+		{
+			const double* a = quad[i];
+			const double* b = quad[(i + 1) % 4];
+			const double edge[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			const double toP[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+			const double cross[3] = { edge[1] * toP[2] - edge[2] * toP[1], edge[2] * toP[0] - edge[0] * toP[2], edge[0] * toP[1] - edge[1] * toP[0] };
+			inside = inside && Dot(cross, n) >= 0.0;
+		}
+		if (inside)
+			return std::fabs(height);
+		double distance = SegmentDistance(p, quad[0], quad[1]);
+		for (int i = 1; i < 4; ++i)
+			distance = std::min(distance, SegmentDistance(p, quad[i], quad[(i + 1) % 4]));
+		return distance;
+	}
+
+	// distance of the view space sphere from the frustum slice minus its radius, negative if it reaches into the slice
+	double SliceGap(const double center[3], double radius, const double corners[8][3])
+	{
+		// the faces counterclockwise seen from outside
+		const int faces[6][4] = { { 0, 3, 2, 1 }, { 4, 5, 6, 7 }, { 0, 4, 7, 3 }, { 1, 2, 6, 5 }, { 0, 1, 5, 4 }, { 3, 7, 6, 2 } };
+		bool inside = true;
+		double distance = 1e30;
+		for (const auto& face : faces)
+		{
+			const double* quad[4] = { corners[face[0]], corners[face[1]], corners[face[2]], corners[face[3]] };
+			distance = std::min(distance, QuadDistance(center, quad));
+			const double u[3] = { quad[1][0] - quad[0][0], quad[1][1] - quad[0][1], quad[1][2] - quad[0][2] };
+			const double v[3] = { quad[3][0] - quad[0][0], quad[3][1] - quad[0][1], quad[3][2] - quad[0][2] };
+			const double n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+			const double ap[3] = { center[0] - quad[0][0], center[1] - quad[0][1], center[2] - quad[0][2] };
+			inside = inside && Dot(ap, n) <= 0.0;
+		}
+		return (inside ? 0.0 : distance) - radius;
+	}
+
+	// distance of the view space sphere from the box minus its radius, negative if it reaches into the box
+	double Gap(const double center[3], double radius, const double min[3], const double max[3])
+	{
+		double squared = 0.0;
+		for (int j = 0; j < 3; ++j)
+		{
+			const double d = std::max(std::max(min[j] - center[j], center[j] - max[j]), 0.0);
+			squared += d * d;
+		}
+		return std::sqrt(squared) - radius;
+	}
+
+	// the lights of every cluster by the reference, in light order. The ones reaching into the frustum slice must
+	// be listed, the ones that only reach into the box around it may be, as may pairs too close to touching to
+	// tell with float precision; anything else must not
+	struct Expected
+	{
+		std::vector<std::vector<uint32_t>> touching;
+		std::vector<std::vector<uint32_t>> possible;
+	};
+
+	Expected BruteForce(const Reference& reference, const Float4x4& view, const std::vector<Sphere>& lights)
+	{
+		std::vector<double> centers(lights.size() * 3);
+		for (size_t i = 0; i < lights.size(); ++i)
+			for (int j = 0; j < 3; ++j)
+				centers[i * 3 + j] = (double)lights[i].center.x * view.m[0][j] + (double)lights[i].center.y * view.m[1][j] +
+					(double)lights[i].center.z * view.m[2][j] + view.m[3][j];
+
+		Expected expected;
+		const uint32_t clusterCount = reference.countX * reference.countY * reference.countZ;
+		expected.touching.resize(clusterCount);
+		expected.possible.resize(clusterCount);
+		for (uint32_t z = 0; z < reference.countZ; ++z)
+			for (uint32_t y = 0; y < reference.countY; ++y)
+				for (uint32_t x = 0; x < reference.countX; ++x)
+				{
+					const uint32_t cluster = (z * reference.countY + y) * reference.countX + x;
+					double min[3], max[3], corners[8][3];
+					reference.Box(x, y, z, min, max);
+					reference.Corners(x, y, z, corners);
+					const double margin = 1e-4 * max[2];
+					for (uint32_t i = 0; i < (uint32_t)lights.size(); ++i)
+					{
+						if (Gap(&centers[i * 3], lights[i].radius, min, max) > margin)
+							continue;
+						if (SliceGap(&centers[i * 3], lights[i].radius, corners) < -margin)
+							expected.touching[cluster].push_back(i);
+						else
+							expected.possible[cluster].push_back(i);
+					}
+				}
+		return expected;
+	}
+
+	std::vector<uint32_t> LightsOf(const LightClusters& clusters, uint32_t cluster)
+	{
+		const LightClusters::Range& range = clusters.GetRanges()[cluster];
+		return std::vector<uint32_t>(clusters.GetIndices().begin() + range.offset, clusters.GetIndices().begin() + range.offset + range.count);
+	}
+
+	bool Contains(const std::vector<uint32_t>& list, uint32_t light)
+	{
+		return std::find(list.begin(), list.end(), light) != list.end();
+	}
+
+	// a world space light from a view space center
+	Sphere WorldLight(const Float4x4& inverseView, const Float3& viewCenter, float radius)
+	{
+		const Float4 p = inverseView.Transform(Float4(viewCenter, 1.0f));
+		return Sphere{ Float3(p.x, p.y, p.z), radius };
+	}
+
+	// lights all over the frustum, more of them near the camera where the slices are thin, some of them
+	// reaching past the near and far planes, the sides, or behind the camera
+	std::vector<Sphere> RandomLights(Tests::Random& random, const Reference& reference, const Float4x4& inverseView, uint32_t count)
+	{
+		std::vector<Sphere> lights;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const double d = i % 16 == 0 ? random.Float(-5.0f, 1.0f) : Near * std::pow(1.1 * Far / Near, (double)random.Float(-0.05f, 1.0f));
+			const float ndcX = random.Float(-1.2f, 1.2f), ndcY = random.Float(-1.2f, 1.2f);
+			const Float3 center((float)(ndcX * std::fabs(d) / reference.xScale), (float)(ndcY * std::fabs(d) / reference.yScale), (float)d);
+			lights.push_back(WorldLight(inverseView, center, (float)(random.Float(0.02f, 0.3f) * std::max(std::fabs(d), 1.0))));
+		}
+		return lights;
+	}
+
+}
+
+TEST(LightClustersMatchBruteForce)
+{
+	Tests::Random random;
+	// room for every light, the cap has a test of its own
+	LightClusters clusters(16, 9, 24, 1024);
+	const Reference reference(clusters);
+	const Float4x4 view = CameraView();
+	const Float4x4 inverseView = view.Invert();
+
+	// random lights, then pairs on both sides of the slice boundaries in the middle of a tile: one centered on
+	// the boundary that reaches into both slices, and one just past it that stays in the farther slice
+	std::vector<Sphere> lights = RandomLights(random, reference, inverseView, 400);
+	struct Straddling { uint32_t light, x, y, z; };
+	std::vector<Straddling> straddling;
+	for (uint32_t z = 1; z < reference.countZ; ++z)
+	{
+		const uint32_t x = z % reference.countX, y = z % reference.countY;
+		const double d = reference.SliceDepth(z);
+		straddling.push_back({ (uint32_t)lights.size(), x, y, z });
+		lights.push_back(WorldLight(inverseView, reference.TileCenter(x, y, d), (float)(0.01 * d)));
+		lights.push_back(WorldLight(inverseView, reference.TileCenter(x, y, d * 1.03), (float)(0.01 * d)));
+	}
+	Build(clusters, view, lights);
+	const Expected expected = BruteForce(reference, view, lights);
+
+	// the slice of a depth by GetDepthScale and GetDepthBias changes at the boundaries
+	for (uint32_t z = 1; z < reference.countZ; ++z)
+	{
+		const double d = reference.SliceDepth(z);
+		CHECK(std::floor(std::log2(d * 1.001) * clusters.GetDepthScale() + clusters.GetDepthBias()) == z);
+		CHECK(std::floor(std::log2(d * 0.999) * clusters.GetDepthScale() + clusters.GetDepthBias()) == z - 1);
+	}
+
+	uint32_t total = 0, occupied = 0, maxCount = 0;
+	for (uint32_t z = 0; z < reference.countZ; ++z)
+		for (uint32_t y = 0; y < reference.countY; ++y)
+			for (uint32_t x = 0; x < reference.countX; ++x)
+			{
+				const uint32_t cluster = clusters.GetClusterIndex(x, y, z);
+				double min[3], max[3];
+				reference.Box(x, y, z, min, max);
+				const Aabb& box = clusters.GetClusterBox(cluster);
+				const double tolerance = 1e-5 * max[2];
+				CHECK_NEAR(box.min.x, min[0], tolerance);
+				CHECK_NEAR(box.max.x, max[0], tolerance);
+				CHECK_NEAR(box.min.y, min[1], tolerance);
+				CHECK_NEAR(box.max.y, max[1], tolerance);
+				CHECK_NEAR(box.min.z, min[2], tolerance);
+				CHECK_NEAR(box.max.z, max[2], tolerance);
+
+				// every light that touches is in the list, in order, and nothing that misses the box
+				const std::vector<uint32_t> actual = LightsOf(clusters, cluster);
+				CHECK(std::is_sorted(actual.begin(), actual.end()));
+				for (uint32_t light : expected.touching[cluster])
+					CHECK(Contains(actual, light));
+				for (uint32_t light : actual)
+					CHECK(Contains(expected.touching[cluster], light) || Contains(expected.possible[cluster], light));
+
+				total += (uint32_t)actual.size();
+				occupied += actual.empty() ? 0 : 1;
+				maxCount = std::max(maxCount, (uint32_t)actual.size());
+			}
+
+	for (const Straddling& s : straddling)
+	{
+		CHECK(Contains(LightsOf(clusters, clusters.GetClusterIndex(s.x, s.y, s.z - 1)), s.light));
+		CHECK(Contains(LightsOf(clusters, clusters.GetClusterIndex(s.x, s.y, s.z)), s.light));
+		CHECK(!Contains(LightsOf(clusters, clusters.GetClusterIndex(s.x, s.y, s.z - 1)), s.light + 1));
+		CHECK(Contains(LightsOf(clusters, clusters.GetClusterIndex(s.x, s.y, s.z)), s.light + 1));
+	}
+
+	// the lists are packed one after the other, and the stats count them
+	const LightClusters::Stats& stats = clusters.GetStats();
+	uint32_t offset = 0;
+	for (const LightClusters::Range& range : clusters.GetRanges())
+	{
+		CHECK(range.offset == offset);
+		offset += range.count;
+	}
+	CHECK(clusters.GetIndices().size() == total);
+	CHECK(stats.lights == lights.size());
+	CHECK(stats.clusters == 16 * 9 * 24);
+	CHECK(stats.indices == total);
+	CHECK(stats.occupiedClusters == occupied);
+	CHECK(stats.maxLightsPerCluster == maxCount);
+	CHECK(stats.overflowedClusters == 0);
+	CHECK_NEAR(stats.averageLightsPerCluster, (double)total / stats.clusters, 1e-5);
+	CHECK_NEAR(stats.averageLightsPerOccupiedCluster, (double)total / occupied, 1e-4);
+	CHECK(total > stats.clusters);
+}
+
+TEST(LightClustersCapOverflowingClusters)
+{
+	Tests::Random random;
+	const uint32_t cap = 8;
+	LightClusters clusters(16, 9, 24, cap);
+	const Reference reference(clusters);
+	const Float4x4 view = CameraView();
+	const Float4x4 inverseView = view.Invert();
+
+	// a crowd of big lights in the middle of the view, over the cap for many clusters, and the random ones
+	std::vector<Sphere> lights;
+	for (uint32_t i = 0; i < 24; ++i)
+		lights.push_back(WorldLight(inverseView, Float3(random.Float(-2.0f, 2.0f), random.Float(-1.0f, 1.0f), random.Float(15.0f, 25.0f)), random.Float(4.0f, 8.0f)));
+	const std::vector<Sphere> scattered = RandomLights(random, reference, inverseView, 200);
+	lights.insert(lights.end(), scattered.begin(), scattered.end());
+	Build(clusters, view, lights);
+	const Expected expected = BruteForce(reference, view, lights);
+
+	uint32_t total = 0, overflowedAtLeast = 0, overflowedAtMost = 0, exact = 0;
+	for (uint32_t cluster = 0; cluster < clusters.GetClusterCount(); ++cluster)
+	{
+		const std::vector<uint32_t>& touching = expected.touching[cluster];
+		const std::vector<uint32_t>& possible = expected.possible[cluster];
+		const std::vector<uint32_t> actual = LightsOf(clusters, cluster);
+		CHECK(actual.size() <= cap);
+		total += (uint32_t)actual.size();
+		overflowedAtLeast += touching.size() > cap ? 1 : 0;
+		overflowedAtMost += touching.size() + possible.size() > cap ? 1 : 0;
+
+		// the first lights that touch are kept, in light order
+		if (possible.empty())
+		{
+			const size_t kept = std::min<size_t>(touching.size(), cap);
+			CHECK(actual.size() == kept);
+			CHECK(std::equal(actual.begin(), actual.end(), touching.begin()));
+			exact += touching.size() > cap ? 1 : 0;
+		}
+	}
+	// the crowd went over the cap, and the test above saw it
+	CHECK(exact > 20);
+
+	const LightClusters::Stats& stats = clusters.GetStats();
+	CHECK(stats.overflowedClusters >= overflowedAtLeast && stats.overflowedClusters <= overflowedAtMost);
+	CHECK(stats.maxLightsPerCluster == cap);
+	CHECK(stats.indices == total);
+	CHECK(clusters.GetIndices().size() == total);
+	CHECK_NEAR(stats.averageLightsPerCluster, (double)total / clusters.GetClusterCount(), 1e-5);
+	CHECK(stats.averageLightsPerCluster <= (float)cap);
+}
+
+BENCHMARK(LightClustersBin)
+{
+	// what BuildLightClusters does on one thread each frame, against testing every cluster box with every light
+	Tests::Random random;
+	LightClusters clusters;
+	const Reference reference(clusters);
+	const Float4x4 view = CameraView();
+	const std::vector<Sphere> lights = RandomLights(random, reference, view.Invert(), 1024);
+
+	double binned = Tests::Measure([&] { Build(clusters, view, lights); Tests::Consume(clusters.GetIndices().data()); });
+
+	std::vector<Sphere> viewLights;
+	for (const Sphere& light : lights)
+	{
+		const Float4 c = view.Transform(Float4(light.center, 1.0f));
+		viewLights.push_back(Sphere{ Float3(c.x, c.y, c.z), light.radius });
+	}
+	std::vector<uint32_t> counts(clusters.GetClusterCount());
+	double bruteForce = Tests::Measure([&] {
+		for (uint32_t cluster = 0; cluster < clusters.GetClusterCount(); ++cluster)
+		{
+			const Aabb& box = clusters.GetClusterBox(cluster);
+			uint32_t count = 0;
+			for (const Sphere& s : viewLights)
+			{
+				const float dx = std::max(std::max(box.min.x - s.center.x, s.center.x - box.max.x), 0.0f);
+				const float dy = std::max(std::max(box.min.y - s.center.y, s.center.y - box.max.y), 0.0f);
+				const float dz = std::max(std::max(box.min.z - s.center.z, s.center.z - box.max.z), 0.0f);
+				count += dx * dx + dy * dy + dz * dz <= s.radius * s.radius ? 1 : 0;
+			}
+			counts[cluster] = count;
+		}
+		Tests::Consume(counts.data());
+	}, 3);
+
+	char what[80];
+	std::snprintf(what, sizeof(what), "1K lights, 16x9x24, %.1f per cluster, %u overflowed",
+		clusters.GetStats().averageLightsPerCluster, clusters.GetStats().overflowedClusters);
+	Tests::Report("1K lights, every cluster against every light", bruteForce);
+	Tests::Report(what, binned, bruteForce);
+}
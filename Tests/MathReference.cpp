@@ -0,0 +1,104 @@
+/*
+Compiles the math sources a second time with EGG_MATH_NO_SIMD, in the namespace EggScalar instead of Egg,
+so the SIMD and the scalar paths can be compared in one binary. Only Float4x4.cpp, OcclusionBuffer.cpp and what
+they call are pulled in.
+*/
+
+#define EGG_MATH_NO_SIMD
+#define Egg EggScalar
+#include <Egg/Math/Float4x4.cpp>
+#include <Egg/Math/Float3.cpp>
+#include <Egg/Math/Float4.cpp>
+#include <Egg/Math/Int3.cpp>
+#include <Egg/Math/Int4.cpp>
+#include <Egg/Math/Bool3.cpp>
+#include <Egg/Math/Bool4.cpp>
+#include <Egg/Cull/OcclusionBuffer.cpp>
+#undef Egg
+
+#if EGG_MATH_SIMD
+#error "the reference must be the scalar build"
+#endif
+
+#include "MathReference.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+	using EggScalar::Math::Float3;
+	using EggScalar::Math::Float4;
+	using EggScalar::Math::Float4x4;
+
+	Float4x4 LoadMatrix(const float* m)
+	{
+		Float4x4 matrix;
+		std::memcpy(matrix.l, m, sizeof(matrix.l));
+		return matrix;
+	}
+
+	Float4 LoadVector(const float* v)
+	{
+		return Float4(v[0], v[1], v[2], v[3]);
+	}
+
+	void Store(const Float4x4& matrix, float* out)
+	{
+		std::memcpy(out, matrix.l, sizeof(matrix.l));
+	}
+
+	void Store(const Float4& vector, float* out)
+	{
+		out[0] = vector.x;
+		out[1] = vector.y;
+		out[2] = vector.z;
+		out[3] = vector.w;
+	}
+
+}
+
+namespace Tests {
+	namespace Scalar {
+
+		void Mul(const float* a, const float* b, float* out)
+		{
+			Store(LoadMatrix(a).Mul(LoadMatrix(b)), out);
+		}
+
+		void MulVector(const float* m, const float* v, float* out)
+		{
+			Store(LoadMatrix(m).Mul(LoadVector(v)), out);
+		}
+
+		void Transform(const float* m, const float* v, float* out)
+		{
+			Store(LoadMatrix(m).Transform(LoadVector(v)), out);
+		}
+
+		void Invert(const float* m, float* out)
+		{
+			Store(LoadMatrix(m).Invert(), out);
+		}
+
+		void InvertGeneral(const float* m, float* out)
+		{
+			Store(LoadMatrix(m)._Invert(), out);
+		}
+
+		void RasterizeDepth(const float* viewProj, const float* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+			uint32_t width, uint32_t height, float* depth)
+		{
+			std::vector<Float3> points;
+			for (size_t i = 0; i < vertexCount; ++i)
+				points.push_back(Float3(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]));
+			EggScalar::Cull::OcclusionBuffer buffer(width, height);
+			buffer.BeginFrame(LoadMatrix(viewProj));
+			buffer.AddOccluder(Float4x4::Identity, points.data(), points.size(), indices, indexCount);
+			for (uint32_t tile = 0; tile < buffer.GetTileCount(); ++tile)
+				buffer.RasterizeTile(tile);
+			std::memcpy(depth, buffer.GetDepth(), sizeof(float) * buffer.GetWidth() * buffer.GetHeight());
+		}
+
+	}
+}
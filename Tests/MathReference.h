@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+The scalar (EGG_MATH_NO_SIMD) build of the Float4x4 operations and the occlusion rasterizer, next to the SIMD
+build that the rest of the tests link against. Matrices are 16 floats in Float4x4 layout, vectors 4.
+*/
+namespace Tests {
+	namespace Scalar {
+
+		// Float4x4::Mul(Float4x4)
+		void Mul(const float* a, const float* b, float* out);
+
+		// Float4x4::Mul(Float4)
+		void MulVector(const float* m, const float* v, float* out);
+
+		// Float4x4::Transform
+		void Transform(const float* m, const float* v, float* out);
+
+		// Float4x4::Invert
+		void Invert(const float* m, float* out);
+
+		// Float4x4::_Invert, the general path that Invert takes for non-affine matrices
+		void InvertGeneral(const float* m, float* out);
+
+		// OcclusionBuffer depth of a triangle list with an identity model, positions are 3 floats each;
+		// width and height must be multiples of the tile size, depth takes width * height floats
+		void RasterizeDepth(const float* viewProj, const float* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+			uint32_t width, uint32_t height, float* depth);
+
+	}
+}
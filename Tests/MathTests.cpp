@@ -0,0 +1,212 @@
+#include "Test.h"
+#include "MathReference.h"
+
+#include <Egg/Math/Float3.h>
+#include <Egg/Math/Float4.h>
+#include <Egg/Math/Float4x4.h>
+#include <Egg/Math/Simd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace Egg::Math;
+
+namespace {
+
+	/*
+	The SIMD inverses take other routes than the cofactor expansion of the scalar code (block-wise for general
+	matrices, cross products for affine ones), so they are compared relative to the largest element of the
+	scalar inverse. For the body matrices and well conditioned general matrices below the largest difference
+	is about 4e-6, view-projection matrices with a far/near ratio up to 1e4 lose more and differ up to 1.1e-4.
+	*/
+	const float inverseTolerance = 1e-5f;
+	const float viewProjInverseTolerance = 5e-4f;
+
+	Float4x4 RandomMatrix(Tests::Random& random)
+	{
+		Float4x4 m;
+		for (float& e : m.l)
+			e = random.Float(-10.0f, 10.0f);
+		return m;
+	}
+
+	Float4 RandomVector(Tests::Random& random)
+	{
+		return Float4(random.Float(-100.0f, 100.0f), random.Float(-100.0f, 100.0f), random.Float(-100.0f, 100.0f), random.Float(-2.0f, 2.0f));
+	}
+
+	Float3 RandomAxis(Tests::Random& random)
+	{
+		Float3 axis(random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f));
+		return axis.LengthSquared() > 1e-4f ? axis.Normalize() : Float3(0.0f, 1.0f, 0.0f);
+	}
+
+	// scale * rotation * translation, the kind of matrix the bodies have
+	Float4x4 RandomAffine(Tests::Random& random)
+	{
+		Float3 scale(random.Float(0.1f, 10.0f), random.Float(0.1f, 10.0f), random.Float(0.1f, 10.0f));
+		Float3 offset(random.Float(-500.0f, 500.0f), random.Float(-500.0f, 500.0f), random.Float(-500.0f, 500.0f));
+		return Float4x4::Scaling(scale) * Float4x4::Rotation(RandomAxis(random), random.Float(-3.14f, 3.14f)) * Float4x4::Translation(offset);
+	}
+
+	// view * projection, the non-affine matrix the camera has
+	Float4x4 RandomViewProj(Tests::Random& random)
+	{
+		Float3 eye(random.Float(-50.0f, 50.0f), random.Float(-50.0f, 50.0f), random.Float(-50.0f, 50.0f));
+		return Float4x4::View(eye, RandomAxis(random), Float3(0.0f, 1.0f, 0.0f)) *
+			Float4x4::Proj(random.Float(0.5f, 1.5f), random.Float(0.5f, 2.0f), random.Float(0.1f, 1.0f), random.Float(100.0f, 1000.0f));
+	}
+
+	bool BitEqual(const float* a, const float* b, size_t count)
+	{
+		return std::memcmp(a, b, count * sizeof(float)) == 0;
+	}
+
+	float MaxAbs(const float* a, size_t count)
+	{
+		float m = 0.0f;
+		for (size_t i = 0; i < count; ++i)
+			m = std::max(m, std::fabs(a[i]));
+		return m;
+	}
+
+	bool InverseMatches(const Float4x4& simd, const float* scalar, float tolerance = inverseTolerance)
+	{
+		float scale = std::max(1.0f, MaxAbs(scalar, 16));
+		for (int i = 0; i < 16; ++i)
+			if (std::fabs(simd.l[i] - scalar[i]) > tolerance * scale)
+				return false;
+		return true;
+	}
+
+}
+
+TEST(Float4x4MulMatchesScalar)
+{
+	Tests::Random random;
+	for (int i = 0; i < 10000; ++i)
+	{
+		Float4x4 a = RandomMatrix(random);
+		Float4x4 b = RandomMatrix(random);
+		float expected[16];
+		Tests::Scalar::Mul(a.l, b.l, expected);
+		Float4x4 product = a * b;
+		CHECK(BitEqual(product.l, expected, 16));
+	}
+}
+
+TEST(Float4x4TransformMatchesScalar)
+{
+	Tests::Random random;
+	for (int i = 0; i < 10000; ++i)
+	{
+		Float4x4 m = RandomMatrix(random);
+		Float4 v = RandomVector(random);
+
+		float expected[4];
+		Tests::Scalar::Transform(m.l, &v.x, expected);
+		Float4 transformed = m.Transform(v);
+		CHECK(BitEqual(&transformed.x, expected, 4));
+
+		Tests::Scalar::MulVector(m.l, &v.x, expected);
+		Float4 product = m.Mul(v);
+		CHECK(BitEqual(&product.x, expected, 4));
+	}
+}
+
+TEST(Float4x4InvertMatchesScalar)
+{
+	Tests::Random random;
+	for (int i = 0; i < 10000; ++i)
+	{
+		Float4x4 affine = RandomAffine(random);
+		float expected[16];
+		Tests::Scalar::Invert(affine.l, expected);
+		CHECK(InverseMatches(affine.Invert(), expected));
+
+		Float4x4 viewProj = RandomViewProj(random);
+		Tests::Scalar::Invert(viewProj.l, expected);
+		CHECK(InverseMatches(viewProj.Invert(), expected, viewProjInverseTolerance));
+
+		// diagonally dominant, so well conditioned, but with no structure at all
+		Float4x4 general = RandomMatrix(random);
+		for (int d = 0; d < 4; ++d)
+			general.m[d][d] += (general.m[d][d] < 0.0f) ? -40.0f : 40.0f;
+		Tests::Scalar::InvertGeneral(general.l, expected);
+		CHECK(InverseMatches(general._Invert(), expected));
+	}
+}
+
+TEST(Float4x4InvertSingularIsIdentity)
+{
+	Float4x4 singularAffine = Float4x4::Scaling(Float3(1.0f, 0.0f, 1.0f)) * Float4x4::Translation(Float3(1.0f, 2.0f, 3.0f));
+	Float4x4 singularGeneral(
+		1.0f, 2.0f, 3.0f, 4.0f,
+		2.0f, 4.0f, 6.0f, 8.0f,
+		0.0f, 1.0f, 0.0f, 1.0f,
+		1.0f, 0.0f, 1.0f, 0.0f);
+
+	float expected[16];
+	Tests::Scalar::Invert(singularAffine.l, expected);
+	CHECK(BitEqual(singularAffine.Invert().l, expected, 16));
+	CHECK(BitEqual(singularAffine.Invert().l, Float4x4::Identity.l, 16));
+
+	Tests::Scalar::Invert(singularGeneral.l, expected);
+	CHECK(BitEqual(singularGeneral.Invert().l, expected, 16));
+	CHECK(BitEqual(singularGeneral.Invert().l, Float4x4::Identity.l, 16));
+}
+
+BENCHMARK(Float4x4Operations)
+{
+	const size_t count = 1 << 16;
+	Tests::Random random;
+	std::vector<Float4x4> matrices(count);
+	std::vector<Float4> vectors(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		matrices[i] = (i & 1) ? RandomAffine(random) : RandomViewProj(random);
+		vectors[i] = RandomVector(random);
+	}
+	std::vector<Float4x4> outMatrices(count);
+	std::vector<Float4> outVectors(count);
+
+	double scalar = Tests::Measure([&] {
+		for (size_t i = 0; i + 1 < count; ++i)
+			Tests::Scalar::Mul(matrices[i].l, matrices[i + 1].l, outMatrices[i].l);
+		Tests::Consume(outMatrices.data());
+	});
+	double simd = Tests::Measure([&] {
+		for (size_t i = 0; i + 1 < count; ++i)
+			outMatrices[i] = matrices[i] * matrices[i + 1];
+		Tests::Consume(outMatrices.data());
+	});
+	Tests::Report("Mul, 64K matrices, scalar", scalar);
+	Tests::Report("Mul, 64K matrices, simd", simd, scalar);
+
+	scalar = Tests::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			Tests::Scalar::Transform(matrices[i].l, &vectors[i].x, &outVectors[i].x);
+		Tests::Consume(outVectors.data());
+	});
+	simd = Tests::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			outVectors[i] = matrices[i].Transform(vectors[i]);
+		Tests::Consume(outVectors.data());
+	});
+	Tests::Report("Transform, 64K vectors, scalar", scalar);
+	Tests::Report("Transform, 64K vectors, simd", simd, scalar);
+
+	scalar = Tests::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			Tests::Scalar::Invert(matrices[i].l, outMatrices[i].l);
+		Tests::Consume(outMatrices.data());
+	});
+	simd = Tests::Measure([&] {
+		for (size_t i = 0; i < count; ++i)
+			outMatrices[i] = matrices[i].Invert();
+		Tests::Consume(outMatrices.data());
+	});
+	Tests::Report("Invert, 64K matrices, half affine, scalar", scalar);
+	Tests::Report("Invert, 64K matrices, half affine, simd", simd, scalar);
+}
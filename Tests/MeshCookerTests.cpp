@@ -0,0 +1,248 @@
+#include "Test.h"
+
+#include <Homework/MeshCooker.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+Cooks the meshes of Media into files of their own next to the app's cooked files, so the app's are not touched.
+Windows only, like the cooker, run from Bin so Media is at ../Media.
+*/
+
+namespace {
+
+	std::string TestCookedPath(const std::string& filePath)
+	{
+		return GG::CookedMesh::GetCookedPath(filePath) + ".test";
+	}
+
+	std::vector<uint8_t> ReadAll(const std::string& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	void WriteAll(const std::string& path, const std::vector<uint8_t>& bytes, size_t size)
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(bytes.data()), size);
+	}
+
+	// the header and streams of a cooked file against what assimp imports from the source
+	bool MatchesImport(const Egg::MappedFile& file, const std::string& sourcePath)
+	{
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(sourcePath, aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_GenUVCoords);
+		if (!scene || !scene->HasMeshes())
+			return false;
+		const aiMesh* mesh = scene->mMeshes[0];
+
+		const GG::CookedMesh::Header& header = *reinterpret_cast<const GG::CookedMesh::Header*>(file.GetData());
+		if (header.vertexCount != mesh->mNumVertices || header.indexCount != mesh->mNumFaces * 3)
+			return false;
+		if (header.vertexOffset % 16 != 0 || header.indexSize != (mesh->mNumVertices <= 0xffff ? 2u : 4u))
+			return false;
+
+		const PNT_Vertex* vertices = reinterpret_cast<const PNT_Vertex*>(file.GetData() + header.vertexOffset);
+		const Egg::Cull::Aabb& aabb = header.aabb;
+		const Egg::Cull::Sphere& sphere = header.boundingSphere;
+		for (uint32_t i = 0; i < header.vertexCount; ++i)
+		{
+			const PNT_Vertex& v = vertices[i];
+			if (v.position.x != mesh->mVertices[i].x || v.position.y != mesh->mVertices[i].y || v.position.z != mesh->mVertices[i].z ||
+				v.normal.x != mesh->mNormals[i].x || v.tex.y != mesh->mTextureCoords[0][i].y)
+				return false;
+			if (v.position.x < aabb.min.x || v.position.y < aabb.min.y || v.position.z < aabb.min.z ||
+				v.position.x > aabb.max.x || v.position.y > aabb.max.y || v.position.z > aabb.max.z)
+				return false;
+			if ((v.position - sphere.center).Length() > sphere.radius * 1.0001f + 1e-6f)
+				return false;
+		}
+
+		const uint8_t* indices = file.GetData() + header.indexOffset;
+		for (uint32_t i = 0; i < header.indexCount; ++i)
+		{
+			const uint32_t index = header.indexSize == 2 ? reinterpret_cast<const uint16_t*>(indices)[i] : reinterpret_cast<const uint32_t*>(indices)[i];
+			if (index != mesh->mFaces[i / 3].mIndices[i % 3])
+				return false;
+		}
+		return true;
+	}
+
+	// the copies Geometry makes out of the mapped cooked file: the streams into the upload buffers, here vectors
+	// standing in for them, and the positions and widened indices for the occlusion culler
+	struct Streams
+	{
+		std::vector<uint8_t> vertexBuffer;
+		std::vector<uint8_t> indexBuffer;
+		std::vector<Egg::Math::Float3> positions;
+		std::vector<uint32_t> triangleIndices;
+	};
+
+	void CopyStreams(const Egg::MappedFile& file, Streams& streams)
+	{
+		const GG::CookedMesh::Header& header = *reinterpret_cast<const GG::CookedMesh::Header*>(file.GetData());
+		const uint8_t* vertexData = file.GetData() + header.vertexOffset;
+		const uint8_t* indexData = file.GetData() + header.indexOffset;
+		const uint32_t sizeInBytes = header.vertexCount * header.vertexStride;
+		const uint32_t indexDataSizeInBytes = header.indexCount * header.indexSize;
+
+		streams.positions.resize(header.vertexCount);
+		for (uint32_t i = 0; i < header.vertexCount; ++i)
+		{
+			const float* p = reinterpret_cast<const float*>(vertexData + (size_t)i * header.vertexStride + offsetof(PNT_Vertex, position));
+			streams.positions[i] = Egg::Math::Float3{ p[0], p[1], p[2] };
+		}
+		streams.triangleIndices.resize(header.indexCount);
+		if (header.indexSize == 2)
+		{
+			const uint16_t* indices16 = reinterpret_cast<const uint16_t*>(indexData);
+			std::copy(indices16, indices16 + header.indexCount, streams.triangleIndices.begin());
+		}
+		else
+			std::memcpy(streams.triangleIndices.data(), indexData, indexDataSizeInBytes);
+
+		streams.vertexBuffer.resize(sizeInBytes);
+		std::memcpy(streams.vertexBuffer.data(), vertexData, sizeInBytes);
+		streams.indexBuffer.resize(indexDataSizeInBytes);
+		std::memcpy(streams.indexBuffer.data(), indexData, indexDataSizeInBytes);
+	}
+
+	// opening a file without buffering makes the system write back and drop its cached pages, as long as
+	// no mapping of it is open, so the next read comes from the disk
+	void EvictFromFileCache(const std::string& path)
+	{
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+	}
+
+	// best of some runs of body in milliseconds, each right after evicting path from the file cache
+	template<typename Body>
+	double MeasureCold(const std::string& path, Body&& body, int runs = 3)
+	{
+		double best = 1e30;
+		for (int i = 0; i < runs; ++i)
+		{
+			EvictFromFileCache(path);
+			auto start = std::chrono::steady_clock::now();
+			body();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+
+}
+
+TEST(MeshCookerRoundTripsMediaMeshes)
+{
+	for (const char* name : { "box.obj", "plane.obj", "ball_low.obj", "sphere.fbx" })
+	{
+		const std::string sourcePath = GG::CookedMesh::GetSourcePath(name);
+		const std::string cookedPath = TestCookedPath(name);
+		GG::CookedMesh::Cook(sourcePath, cookedPath);
+
+		Egg::MappedFile file{ cookedPath };
+		CHECK(GG::CookedMesh::IsCurrent(file, sourcePath));
+		CHECK(MatchesImport(file, sourcePath));
+		file = Egg::MappedFile{};
+		DeleteFileA(cookedPath.c_str());
+	}
+}
+
+TEST(MeshCookerRejectsStaleAndBrokenFiles)
+{
+	const std::string sourcePath = GG::CookedMesh::GetSourcePath("box.obj");
+	const std::string cookedPath = TestCookedPath("box.obj");
+	const std::string brokenPath = cookedPath + ".broken";
+	GG::CookedMesh::Cook(sourcePath, cookedPath);
+	const std::vector<uint8_t> bytes = ReadAll(cookedPath);
+	CHECK(bytes.size() > sizeof(GG::CookedMesh::Header));
+
+	// one changed header field at a time, the source stamp, the version or the vertex layout
+	auto isCurrentWith = [&](size_t offset, uint64_t value, size_t size) {
+		std::vector<uint8_t> changed = bytes;
+		std::memcpy(changed.data() + offset, &value, size);
+		WriteAll(brokenPath, changed, changed.size());
+		Egg::MappedFile file{ brokenPath };
+		return GG::CookedMesh::IsCurrent(file, sourcePath);
+	};
+	const GG::CookedMesh::Header& header = *reinterpret_cast<const GG::CookedMesh::Header*>(bytes.data());
+	// the unchanged copy is current
+	CHECK(isCurrentWith(0, 0, 0));
+	CHECK(!isCurrentWith(offsetof(GG::CookedMesh::Header, sourceWriteTime), header.sourceWriteTime + 1, sizeof(uint64_t)));
+	CHECK(!isCurrentWith(offsetof(GG::CookedMesh::Header, sourceSize), header.sourceSize + 1, sizeof(uint64_t)));
+	CHECK(!isCurrentWith(offsetof(GG::CookedMesh::Header, version), GG::CookedMesh::Version + 1, sizeof(uint32_t)));
+	CHECK(!isCurrentWith(offsetof(GG::CookedMesh::Header, magic), 0, sizeof(uint32_t)));
+	CHECK(!isCurrentWith(offsetof(GG::CookedMesh::Header, vertexStride), sizeof(PNT_Vertex) + 4, sizeof(uint32_t)));
+	CHECK(!isCurrentWith(offsetof(GG::CookedMesh::Header, indexSize), 3, sizeof(uint32_t)));
+
+	// cut off anywhere, in the header or the index stream
+	for (size_t size : { size_t(0), sizeof(GG::CookedMesh::Header) - 1, bytes.size() - 1 })
+	{
+		WriteAll(brokenPath, bytes, size);
+		Egg::MappedFile file{ brokenPath };
+		CHECK(!GG::CookedMesh::IsCurrent(file, sourcePath));
+	}
+
+	// without the source, any complete file of the current version is taken
+	{
+		Egg::MappedFile file{ cookedPath };
+		CHECK(GG::CookedMesh::IsCurrent(file, "../Media/no such mesh.obj"));
+	}
+	CHECK(!GG::CookedMesh::IsCurrent(Egg::MappedFile{ "../Media/Cooked/no such mesh.ggmesh" }, sourcePath));
+
+	DeleteFileA(brokenPath.c_str());
+	DeleteFileA(cookedPath.c_str());
+}
+
+BENCHMARK(MeshCookerLoad)
+{
+	for (const char* name : { "ball_low.obj", "sphere.fbx" })
+	{
+		const std::string sourcePath = GG::CookedMesh::GetSourcePath(name);
+		const std::string cookedPath = TestCookedPath(name);
+		GG::CookedMesh::Cook(sourcePath, cookedPath);
+
+		// what Geometry did before, import and copy out the vertices, against mapping the cooked file and copying its
+		// streams the way Geometry does, from the disk right after the cook and from the file cache
+		std::vector<PNT_Vertex> vertices;
+		Streams streams;
+		double import = Tests::Measure([&] {
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(sourcePath, aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_GenUVCoords);
+			const aiMesh* mesh = scene->mMeshes[0];
+			vertices.resize(mesh->mNumVertices);
+			for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+			{
+				vertices[i].position = Egg::Math::Float3{ mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z };
+				vertices[i].normal = Egg::Math::Float3{ mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z };
+				vertices[i].tex = Egg::Math::Float2{ mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y };
+			}
+			Tests::Consume(vertices.data());
+		}, 3);
+		auto load = [&] {
+			Egg::MappedFile file{ cookedPath };
+			GG::CookedMesh::IsCurrent(file, sourcePath);
+			CopyStreams(file, streams);
+			Tests::Consume(streams.vertexBuffer.data());
+		};
+		double cold = MeasureCold(cookedPath, load);
+		double warm = Tests::Measure(load);
+		DeleteFileA(cookedPath.c_str());
+
+		char what[64];
+		std::snprintf(what, sizeof(what), "%s, assimp import", name);
+		Tests::Report(what, import);
+		std::snprintf(what, sizeof(what), "%s, cooked file, cold", name);
+		Tests::Report(what, cold, import);
+		std::snprintf(what, sizeof(what), "%s, cooked file, warm", name);
+		Tests::Report(what, warm, import);
+	}
+}
@@ -0,0 +1,273 @@
+#include "Test.h"
+#include "MathReference.h"
+
+#include <Egg/Cull/OcclusionBuffer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace Egg::Math;
+using namespace Egg::Cull;
+
+namespace {
+
+	const uint32_t Width = 256, Height = 128;
+
+	// at the origin looking down +z, 90 degrees across
+	Float4x4 CameraViewProj()
+	{
+		return Float4x4::View(Float3(0.0f, 0.0f, 0.0f), Float3(0.0f, 0.0f, 1.0f), Float3(0.0f, 1.0f, 0.0f)) *
+			Float4x4::Proj(1.57f, 2.0f, 0.1f, 1000.0f);
+	}
+
+	struct Mesh
+	{
+		std::vector<Float3> positions;
+		std::vector<uint32_t> indices;
+
+		// a quad facing the camera at depth z, both windings show up over the tests
+		void AddQuad(float minX, float minY, float maxX, float maxY, float z)
+		{
+			const uint32_t first = (uint32_t)positions.size();
+			positions.push_back(Float3(minX, minY, z));
+			positions.push_back(Float3(maxX, minY, z));
+			positions.push_back(Float3(maxX, maxY, z));
+			positions.push_back(Float3(minX, maxY, z));
+			for (uint32_t i : { 0u, 1u, 2u, 0u, 2u, 3u })
+				indices.push_back(first + i);
+		}
+	};
+
+	void Render(OcclusionBuffer& buffer, const Float4x4& viewProj, const Mesh& mesh)
+	{
+		buffer.BeginFrame(viewProj);
+		buffer.AddOccluder(Float4x4::Identity, mesh.positions.data(), mesh.positions.size(), mesh.indices.data(), mesh.indices.size());
+		for (uint32_t tile = 0; tile < buffer.GetTileCount(); ++tile)
+			buffer.RasterizeTile(tile);
+		buffer.BuildHierarchy();
+	}
+
+	// x, y in pixels and d3d depth, w is 0 behind the camera
+	struct ScreenPoint { double x, y, z, w; };
+
+	ScreenPoint Project(const Float4x4& viewProj, const Float3& p)
+	{
+		const Float4 clip = viewProj.Transform(Float4(p, 1.0f));
+		if (clip.w <= 0.0f)
+			return { 0.0, 0.0, 0.0, 0.0 };
+		return { (clip.x / clip.w + 1.0) * 0.5 * Width, (1.0 - clip.y / clip.w) * 0.5 * Height, clip.z / (double)clip.w, clip.w };
+	}
+
+	Aabb Box(const Float3& center, const Float3& extent)
+	{
+		return Aabb{ center - extent, center + extent };
+	}
+
+}
+
+TEST(OcclusionWallHidesOnlyWhatIsBehindIt)
+{
+	OcclusionBuffer buffer(Width, Height);
+	const Float4x4 viewProj = CameraViewProj();
+	Mesh wall;
+	wall.AddQuad(-5.0f, -3.0f, 5.0f, 3.0f, 10.0f);
+	Render(buffer, viewProj, wall);
+	CHECK(buffer.GetStats().triangles == 2 && buffer.GetStats().rejectedTriangles == 0);
+
+	// behind the middle of the wall, far behind it, and a long one whose texels of the pyramid are all inside it
+	CHECK(buffer.IsOccluded(Box(Float3(0.0f, 0.0f, 20.0f), Float3(1.0f, 1.0f, 1.0f))));
+	CHECK(buffer.IsOccluded(Box(Float3(2.0f, -1.0f, 200.0f), Float3(3.0f, 3.0f, 3.0f))));
+	CHECK(buffer.IsOccluded(Box(Float3(0.0f, 0.0f, 30.0f), Float3(3.0f, 0.5f, 0.5f))));
+
+	// beside the wall, sticking out past its edge, in front of it and through it
+	CHECK(!buffer.IsOccluded(Box(Float3(15.0f, 0.0f, 20.0f), Float3(1.0f, 1.0f, 1.0f))));
+	CHECK(!buffer.IsOccluded(Box(Float3(0.0f, 9.0f, 20.0f), Float3(1.0f, 1.0f, 1.0f))));
+	CHECK(!buffer.IsOccluded(Box(Float3(10.0f, 0.0f, 20.0f), Float3(1.0f, 1.0f, 1.0f))));
+	CHECK(!buffer.IsOccluded(Box(Float3(0.0f, 0.0f, 5.0f), Float3(1.0f, 1.0f, 1.0f))));
+	CHECK(!buffer.IsOccluded(Box(Float3(0.0f, 0.0f, 10.0f), Float3(1.0f, 1.0f, 1.0f))));
+
+	// off screen and behind the camera, those are for the frustum test
+	CHECK(!buffer.IsOccluded(Box(Float3(500.0f, 0.0f, 20.0f), Float3(1.0f, 1.0f, 1.0f))));
+	CHECK(!buffer.IsOccluded(Box(Float3(0.0f, 0.0f, -20.0f), Float3(1.0f, 1.0f, 1.0f))));
+
+	// a new frame without occluders hides nothing
+	Render(buffer, viewProj, Mesh{});
+	CHECK(!buffer.IsOccluded(Box(Float3(0.0f, 0.0f, 20.0f), Float3(1.0f, 1.0f, 1.0f))));
+}
+
+TEST(OcclusionDepthMatchesScalarReference)
+{
+	// random triangles in front of the camera, overlapping each other and the tile edges. The SIMD rasterizer
+	// must give the depth of the EGG_MATH_NO_SIMD build, and both the coverage of a brute force that tests every
+	// pixel center against every triangle in double precision; pixels with a center too close to an edge to
+	// tell are skipped, and its depth is only as close as the float plane equations get
+	Tests::Random random;
+	OcclusionBuffer buffer(Width, Height);
+	const Float4x4 viewProj = CameraViewProj();
+	std::vector<float> scalarDepth(Width * Height);
+	for (int scene = 0; scene < 10; ++scene)
+	{
+		Mesh mesh;
+		for (int t = 0; t < 60; ++t)
+		{
+			const Float3 center(random.Float(-20.0f, 20.0f), random.Float(-10.0f, 10.0f), random.Float(8.0f, 30.0f));
+			for (int v = 0; v < 3; ++v)
+			{
+				mesh.indices.push_back((uint32_t)mesh.positions.size());
+				mesh.positions.push_back(center + Float3(random.Float(-10.0f, 10.0f), random.Float(-10.0f, 10.0f), random.Float(-6.0f, 6.0f)));
+			}
+		}
+		Render(buffer, viewProj, mesh);
+		const float* depth = buffer.GetDepth();
+
+		Tests::Scalar::RasterizeDepth(viewProj.l, &mesh.positions[0].x, mesh.positions.size(), mesh.indices.data(), mesh.indices.size(),
+			Width, Height, scalarDepth.data());
+		for (uint32_t i = 0; i < Width * Height; ++i)
+			CHECK_NEAR(depth[i], scalarDepth[i], 1e-6);
+
+		std::vector<ScreenPoint> screen;
+		for (const Float3& p : mesh.positions)
+			screen.push_back(Project(viewProj, p));
+
+		uint32_t compared = 0, covered = 0;
+		for (uint32_t y = 0; y < Height; ++y)
+			for (uint32_t x = 0; x < Width; ++x)
+			{
+				const double px = x + 0.5, py = y + 0.5;
+				double nearest = 1.0;
+				bool ambiguous = false;
+				for (size_t t = 0; t < mesh.indices.size(); t += 3)
+				{
+					const ScreenPoint& a = screen[mesh.indices[t]];
+					const ScreenPoint& b = screen[mesh.indices[t + 1]];
+					const ScreenPoint& c = screen[mesh.indices[t + 2]];
+					const double area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+					if (std::fabs(area) < 1.0)
+						continue;
+					// barycentrics of the pixel center
+					const double wa = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) / area;
+					const double wb = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) / area;
+					const double wc = 1.0 - wa - wb;
+					const double margin = 1e-3;
+					if (wa < -margin || wb < -margin || wc < -margin)
+						continue;
+					if (wa < margin || wb < margin || wc < margin)
+					{
+						ambiguous = true;
+						break;
+					}
+					nearest = std::min(nearest, std::max(0.0, wa * a.z + wb * b.z + wc * c.z));
+				}
+				if (ambiguous)
+					continue;
+				++compared;
+				covered += nearest < 1.0 ? 1 : 0;
+				CHECK((depth[y * Width + x] < 1.0f) == (nearest < 1.0));
+				CHECK_NEAR(depth[y * Width + x], nearest, 2.5e-4);
+			}
+		// most pixels are decided, and there is something on them
+		CHECK(compared > Width * Height * 9 / 10);
+		CHECK(covered > compared / 4);
+	}
+}
+
+TEST(OcclusionHierarchyIsConservative)
+{
+	// never reports a box occluded that has a point nearer than the rasterized depth at its pixel: boxes on
+	// tile and texel edges of every level, thin ones and ones crossing the near plane or the camera plane
+	Tests::Random random;
+	OcclusionBuffer buffer(Width, Height);
+	const Float4x4 viewProj = CameraViewProj();
+	uint32_t occluded = 0;
+	for (int scene = 0; scene < 20; ++scene)
+	{
+		Mesh mesh;
+		for (int q = 0; q < 6; ++q)
+		{
+			const float x = random.Float(-40.0f, 30.0f), y = random.Float(-20.0f, 15.0f);
+			mesh.AddQuad(x, y, x + random.Float(2.0f, 20.0f), y + random.Float(2.0f, 10.0f), random.Float(5.0f, 40.0f));
+		}
+		Render(buffer, viewProj, mesh);
+		const float* depth = buffer.GetDepth();
+
+		for (int i = 0; i < 2000; ++i)
+		{
+			const float z = random.Float(4.0f, 80.0f);
+			// centered on a tile edge in x or y half of the time: TileWidth columns are z * (2 / Width) * TileWidth apart at depth z
+			Float3 center(random.Float(-z, z), random.Float(-z * 0.5f, z * 0.5f), z);
+			if (i % 2 == 0)
+			{
+				const float column = std::round((center.x / z + 1.0f) * 0.5f * Width / OcclusionBuffer::TileWidth) * OcclusionBuffer::TileWidth;
+				center.x = (column * 2.0f / Width - 1.0f) * z;
+			}
+			if (i % 4 == 1)
+			{
+				const float row = std::round((1.0f - center.y / (0.5f * z)) * 0.5f * Height / OcclusionBuffer::TileHeight) * OcclusionBuffer::TileHeight;
+				center.y = (1.0f - row * 2.0f / Height) * 0.5f * z;
+			}
+			const Float3 extent(random.Float(0.01f, 4.0f), random.Float(0.01f, 4.0f), random.Float(0.01f, 4.0f));
+			const Aabb box = Box(center, extent);
+			if (!buffer.IsOccluded(box))
+				continue;
+			++occluded;
+
+			// every sampled point of an occluded box is on screen behind the depth at its pixel
+			for (int s = 0; s < 64; ++s)
+			{
+				Float3 p(random.Float(box.min.x, box.max.x), random.Float(box.min.y, box.max.y), random.Float(box.min.z, box.max.z));
+				if (s < 8)
+					p = Float3((s & 1) ? box.max.x : box.min.x, (s & 2) ? box.max.y : box.min.y, (s & 4) ? box.max.z : box.min.z);
+				const ScreenPoint sp = Project(viewProj, p);
+				if (sp.x < 0.0 || sp.y < 0.0 || sp.x >= Width || sp.y >= Height)
+					continue;
+				CHECK(sp.w > 0.0);
+				CHECK(depth[(uint32_t)sp.y * Width + (uint32_t)sp.x] < sp.z + 1e-6);
+			}
+		}
+
+		// boxes reaching in front of the near plane, or behind the camera, are never occluded, even behind occluders
+		for (const Aabb& box : {
+			Aabb{ Float3(-1.0f, -1.0f, 0.05f), Float3(1.0f, 1.0f, 60.0f) },
+			Aabb{ Float3(-1.0f, -1.0f, -2.0f), Float3(1.0f, 1.0f, 60.0f) },
+			Aabb{ Float3(-30.0f, -10.0f, 0.099f), Float3(30.0f, 10.0f, 90.0f) } })
+			CHECK(!buffer.IsOccluded(box));
+	}
+	// the check above looked at something
+	CHECK(occluded > 1000);
+}
+
+BENCHMARK(OcclusionCulling)
+{
+	// a few walls and many small boxes, what CullOccluded does each frame with its biggest meshes
+	Tests::Random random;
+	OcclusionBuffer buffer(Width, Height);
+	const Float4x4 viewProj = CameraViewProj();
+	Mesh mesh;
+	for (int q = 0; q < 16; ++q)
+	{
+		const float x = random.Float(-40.0f, 30.0f), y = random.Float(-20.0f, 15.0f);
+		mesh.AddQuad(x, y, x + random.Float(5.0f, 20.0f), y + random.Float(5.0f, 10.0f), random.Float(10.0f, 40.0f));
+	}
+	std::vector<Aabb> boxes;
+	for (int i = 0; i < 10000; ++i)
+	{
+		const float z = random.Float(10.0f, 100.0f);
+		boxes.push_back(Box(Float3(random.Float(-z, z), random.Float(-z * 0.5f, z * 0.5f), z), Float3(1.0f, 1.0f, 1.0f)));
+	}
+
+	double render = Tests::Measure([&] { Render(buffer, viewProj, mesh); Tests::Consume(buffer.GetDepth()); });
+	std::vector<uint8_t> hidden(boxes.size());
+	double test = Tests::Measure([&] {
+		for (size_t i = 0; i < boxes.size(); ++i)
+			hidden[i] = buffer.IsOccluded(boxes[i]) ? 1 : 0;
+		Tests::Consume(hidden.data());
+	});
+
+	char what[64];
+	std::snprintf(what, sizeof(what), "16 occluders rasterized, %ux%u", Width, Height);
+	Tests::Report(what, render);
+	std::snprintf(what, sizeof(what), "10K boxes tested, %u%% occluded", (uint32_t)(std::count(hidden.begin(), hidden.end(), 1) * 100 / hidden.size()));
+	Tests::Report(what, test);
+}
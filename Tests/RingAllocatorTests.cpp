@@ -0,0 +1,173 @@
+#include "Test.h"
+
+#include <Homework/FramePacer.h>
+#include <Homework/RingAllocator.h>
+
+#include <deque>
+#include <vector>
+
+namespace {
+
+	const uint64_t Invalid = GG::RingAllocator::InvalidOffset;
+
+	// the gpu finishes frames only when the test completes them, Wait catches it up to the value asked for
+	struct ManualFence
+	{
+		uint64_t completed = 0;
+		uint64_t signaled = 0;
+
+		uint64_t GetCompletedValue() const { return completed; }
+		void Signal(uint64_t value) { signaled = value; }
+		void Wait(uint64_t value)
+		{
+			if (completed < value)
+				completed = value;
+		}
+	};
+
+	struct Range
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint64_t fenceValue;
+	};
+
+	bool Overlap(const Range& a, const Range& b)
+	{
+		return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+	}
+
+}
+
+TEST(RingAllocatorWrapsAroundAndReclaims)
+{
+	GG::RingAllocator ring(1024);
+	CHECK(ring.Allocate(100, 256) == 0);
+	CHECK(ring.Allocate(100, 256) == 256);
+	ring.EndFrame(1);
+	CHECK(ring.Allocate(300, 256) == 512);
+	ring.EndFrame(2);
+	CHECK(ring.GetUsed() == 812);
+
+	// 200 bytes don't fit before the end, the range would start over at 0 where frame 1 still is
+	CHECK(ring.Allocate(200, 256) == Invalid);
+	CHECK(ring.GetStats().failedAllocations == 1);
+	CHECK(ring.GetUsed() == 812);
+
+	// once frame 1 is done it wraps around, the skipped end of the lap counts as used until frame 3 is done
+	ring.Reclaim(1);
+	CHECK(ring.GetUsed() == 812 - 356);
+	CHECK(ring.Allocate(200, 256) == 0);
+	CHECK(ring.GetUsed() == 1024 - 356 + 200);
+	ring.EndFrame(3);
+	CHECK(ring.Allocate(100, 256) == 256);
+	CHECK(ring.Allocate(1, 256) == Invalid);
+	ring.EndFrame(4);
+
+	// reclaiming a value some frames ahead frees all of them, an empty ring starts over at 0
+	ring.Reclaim(4);
+	CHECK(ring.GetUsed() == 0);
+	CHECK(ring.Allocate(1024, 256) == 0);
+	CHECK(ring.Allocate(1, 1) == Invalid);
+	CHECK(ring.Allocate(2048, 1) == Invalid);
+	CHECK(ring.GetStats().peakUsed == 1024);
+}
+
+TEST(RingAllocatorAlignsAndCountsFrames)
+{
+	GG::RingAllocator ring(4096);
+	CHECK(ring.Allocate(1, 1) == 0);
+	CHECK(ring.Allocate(1, 16) == 16);
+	CHECK(ring.Allocate(1, 256) == 256);
+	CHECK(ring.Allocate(3, 1) == 257);
+	CHECK(ring.Allocate(8, 8) == 264);
+	CHECK(ring.GetStats().allocatedThisFrame == 272);
+	ring.EndFrame(1);
+	CHECK(ring.GetStats().allocatedThisFrame == 0);
+	CHECK(ring.GetStats().allocatedLastFrame == 272);
+
+	// a frame with no allocations still has a mark, reclaiming it frees nothing
+	ring.EndFrame(2);
+	CHECK(ring.GetStats().allocatedLastFrame == 0);
+	ring.Reclaim(0);
+	CHECK(ring.GetUsed() == 272);
+	ring.Reclaim(1);
+	CHECK(ring.GetUsed() == 0);
+	ring.Reclaim(2);
+	CHECK(ring.GetUsed() == 0);
+}
+
+// frames as the app runs them: the pacer lets the cpu get FramesInFlight frames ahead of a gpu that finishes
+// frames at random, every allocation must stay clear of the ranges of the frames the gpu may still be reading
+TEST(RingAllocatorRetiresAfterFramesInFlight)
+{
+	const uint64_t capacity = 64 * 1024;
+	ManualFence fence;
+	GG::FramePacer<ManualFence> pacer(fence);
+	GG::RingAllocator ring(capacity);
+	Tests::Random random;
+	std::deque<Range> inFlight;
+	uint32_t overlaps = 0, failures = 0;
+	uint64_t wrapped = 0, previousOffset = 0;
+
+	for (uint32_t frame = 0; frame < 5000; ++frame)
+	{
+		// the gpu finishes some of the submitted frames, or none
+		if (fence.completed < fence.signaled && random.Next() % 2 == 0)
+			fence.completed += 1 + random.Next() % (fence.signaled - fence.completed);
+		pacer.BeginFrame();
+		ring.Reclaim(fence.GetCompletedValue());
+		while (!inFlight.empty() && inFlight.front().fenceValue <= fence.GetCompletedValue())
+			inFlight.pop_front();
+
+		// at most FramesInFlight - 1 frames are still running, their ranges are all that's left in the ring
+		uint64_t used = 0;
+		for (const Range& r : inFlight)
+		{
+			CHECK(fence.GetCompletedValue() + GG::FramesInFlight - 1 >= r.fenceValue);
+			used += r.size;
+		}
+		CHECK(ring.GetUsed() >= used);
+
+		std::vector<Range> thisFrame;
+		uint32_t allocations = 1 + random.Next() % 24;
+		for (uint32_t a = 0; a < allocations; ++a)
+		{
+			uint64_t size = 1 + random.Next() % 1024;
+			uint64_t alignment = uint64_t(1) << (random.Next() % 9);
+			uint64_t offset = ring.Allocate(size, alignment);
+			if (offset == Invalid)
+			{
+				++failures;
+				continue;
+			}
+			CHECK(offset % alignment == 0);
+			CHECK(offset + size <= capacity);
+			if (offset < previousOffset)
+				++wrapped;
+			previousOffset = offset;
+
+			Range range{ offset, size, pacer.GetLastSignaledValue() + 1 };
+			for (const Range& r : inFlight)
+				overlaps += Overlap(range, r) ? 1 : 0;
+			for (const Range& r : thisFrame)
+				overlaps += Overlap(range, r) ? 1 : 0;
+			thisFrame.push_back(range);
+		}
+
+		pacer.EndFrame();
+		ring.EndFrame(pacer.GetLastSignaledValue());
+		inFlight.insert(inFlight.end(), thisFrame.begin(), thisFrame.end());
+	}
+
+	CHECK(overlaps == 0);
+	// 24 allocations of up to 1 KB, with alignment, never fill a 64 KB ring in FramesInFlight frames
+	CHECK(failures == 0);
+	CHECK(ring.GetStats().failedAllocations == 0);
+	CHECK(ring.GetStats().peakUsed <= capacity);
+	CHECK(wrapped > 100);
+
+	pacer.WaitForIdle();
+	ring.Reclaim(fence.GetCompletedValue());
+	CHECK(ring.GetUsed() == 0);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/*
+A minimal test and benchmark registry, so the tests need nothing beyond the standard library.
+
+	TEST(Name) { CHECK(a == b); CHECK_NEAR(x, y, 1e-5f); }
+	BENCHMARK(Name) { Tests::Report("what", Tests::Measure([&] { ... })); }
+
+A failed CHECK reports itself and the test goes on, the test fails if any of its checks failed.
+*/
+namespace Tests {
+
+	struct Case
+	{
+		const char* name;
+		void (*run)();
+		bool benchmark;
+	};
+
+	inline std::vector<Case>& Registry()
+	{
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	struct Registrar
+	{
+		Registrar(const char* name, void (*run)(), bool benchmark)
+		{
+			Registry().push_back(Case{ name, run, benchmark });
+		}
+	};
+
+	inline uint32_t& FailureCount()
+	{
+		static uint32_t failures = 0;
+		return failures;
+	}
+
+	inline void Fail(const char* file, int line, const char* expression)
+	{
+		std::printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+		++FailureCount();
+	}
+
+	// fixed seed xorshift, so failures reproduce
+	class Random
+	{
+		uint32_t state;
+
+	public:
+		explicit Random(uint32_t seed = 0x9E3779B9u) : state(seed ? seed : 1u) { }
+
+		uint32_t Next()
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		uint64_t Next64()
+		{
+			return (uint64_t(Next()) << 32) | Next();
+		}
+
+		// uniform in [lo, hi)
+		float Float(float lo, float hi)
+		{
+			return lo + (hi - lo) * float(Next() >> 8) * (1.0f / 16777216.0f);
+		}
+	};
+
+	// where Consume writes, a volatile the compiler has to store to
+	inline const void* volatile sink = nullptr;
+
+	// keeps the optimizer from dropping the results of benchmarked code
+	inline void Consume(const void* p)
+	{
+		sink = p;
+	}
+
+	/*
+	Best of some runs of body in milliseconds, the first run is a warm-up
+	*/
+	template<typename Body>
+	double Measure(Body&& body, int runs = 7)
+	{
+		double best = 1e30;
+		for (int i = 0; i <= runs; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			body();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (i > 0 && ms < best)
+				best = ms;
+		}
+		return best;
+	}
+
+	inline void Report(const char* what, double ms)
+	{
+		std::printf("  %-48s %10.3f ms\n", what, ms);
+	}
+
+	inline void Report(const char* what, double ms, double baselineMs)
+	{
+		std::printf("  %-48s %10.3f ms  %6.2fx\n", what, ms, baselineMs / ms);
+	}
+
+}
+
+#define TESTS_CASE(name, benchmark) \
+	static void name(); \
+	static const Tests::Registrar name##Registrar(#name, &name, benchmark); \
+	static void name()
+
+#define TEST(name) TESTS_CASE(name, false)
+#define BENCHMARK(name) TESTS_CASE(name, true)
+
+#define CHECK(expression) \
+	((expression) ? (void)0 : Tests::Fail(__FILE__, __LINE__, #expression))
+
+#define CHECK_NEAR(a, b, tolerance) \
+	((std::fabs(double(a) - double(b)) <= double(tolerance)) ? (void)0 : Tests::Fail(__FILE__, __LINE__, #a " ~= " #b))
@@ -0,0 +1,228 @@
+#include "Test.h"
+
+#include <Homework/TextureProcessing.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/*
+The texture path of Tex2D without a device: mips and block compression of generated images, and of the Media
+images for the benchmark. Windows only, DirectXTex decodes through WIC, run from Bin so Media is at ../Media.
+*/
+
+namespace {
+
+	// smooth color ramps, with alpha falling off to the right unless opaque
+	DirectX::ScratchImage MakeImage(size_t width, size_t height, bool opaque)
+	{
+		DirectX::ScratchImage image;
+		image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, 1);
+		const DirectX::Image& top = *image.GetImage(0, 0, 0);
+		for (size_t y = 0; y < height; ++y)
+		{
+			uint8_t* row = top.pixels + y * top.rowPitch;
+			for (size_t x = 0; x < width; ++x)
+			{
+				row[x * 4 + 0] = (uint8_t)(x * 255 / width);
+				row[x * 4 + 1] = (uint8_t)(y * 255 / height);
+				row[x * 4 + 2] = (uint8_t)(128 + 64 * std::sin(float(x + y) * 0.05f));
+				row[x * 4 + 3] = opaque ? 255 : (uint8_t)(255 - x * 255 / width);
+			}
+		}
+		return image;
+	}
+
+	// the bytes of a full mip chain, in 4x4 blocks of blockBytes, or in pixels of 4 bytes when blockBytes is 0
+	uint64_t MipChainBytes(uint32_t width, uint32_t height, uint32_t blockBytes)
+	{
+		uint64_t bytes = 0;
+		while (true)
+		{
+			bytes += blockBytes ? uint64_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes : uint64_t(width) * height * 4;
+			if (width == 1 && height == 1)
+				return bytes;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+	}
+
+	// of the processed top level against the uncompressed one, -1 if they can't be compared
+	double Mse(const DirectX::ScratchImage& processed, const DirectX::ScratchImage& reference)
+	{
+		float mse;
+		if (FAILED(DirectX::ComputeMSE(*processed.GetImage(0, 0, 0), *reference.GetImage(0, 0, 0), mse, nullptr)))
+			return -1.0;
+		return mse;
+	}
+
+	double Psnr(const DirectX::ScratchImage& processed, const DirectX::ScratchImage& reference)
+	{
+		const double mse = Mse(processed, reference);
+		if (mse < 0.0)
+			return -1.0;
+		return mse > 0.0 ? 10.0 * std::log10(1.0 / mse) : 99.0;
+	}
+
+	// in 8 bit steps
+	double Rmse(const DirectX::ScratchImage& processed, const DirectX::ScratchImage& reference)
+	{
+		const double mse = Mse(processed, reference);
+		return mse < 0.0 ? -1.0 : std::sqrt(mse) * 255.0;
+	}
+
+	bool SameBytes(const DirectX::ScratchImage& a, const DirectX::ScratchImage& b)
+	{
+		return a.GetPixelsSize() == b.GetPixelsSize() && std::memcmp(a.GetPixels(), b.GetPixels(), a.GetPixelsSize()) == 0;
+	}
+
+}
+
+TEST(TextureProcessingBuildsFullMipChains)
+{
+	DirectX::ScratchImage result;
+	GG::TextureProcessingStats stats;
+	CHECK(SUCCEEDED(GG::TextureProcessing::Process(MakeImage(256, 64, true), GG::TextureCompression::None, result, stats)));
+	CHECK(stats.width == 256 && stats.height == 64);
+	// 256 down to 1
+	CHECK(stats.mipLevels == 9);
+	CHECK(result.GetMetadata().mipLevels == 9);
+	CHECK(stats.format == DXGI_FORMAT_R8G8B8A8_UNORM);
+	CHECK(stats.sourceBytes == 256 * 64 * 4);
+	CHECK(stats.uncompressedBytes == MipChainBytes(256, 64, 0));
+	CHECK(stats.processedBytes == stats.uncompressedBytes);
+
+	// down to a single pixel
+	const DirectX::Image& last = *result.GetImage(8, 0, 0);
+	CHECK(last.width == 1 && last.height == 1);
+}
+
+TEST(TextureProcessingCompressesWholeBlocks)
+{
+	struct Case { GG::TextureCompression compression; bool opaque; DXGI_FORMAT format; uint32_t blockBytes; };
+	const Case cases[] = {
+		{ GG::TextureCompression::BC1, true, DXGI_FORMAT_BC1_UNORM, 8 },
+		{ GG::TextureCompression::BC3, false, DXGI_FORMAT_BC3_UNORM, 16 },
+		{ GG::TextureCompression::BC5, true, DXGI_FORMAT_BC5_UNORM, 16 },
+		{ GG::TextureCompression::BC7, false, DXGI_FORMAT_BC7_UNORM, 16 },
+		{ GG::TextureCompression::Auto, true, DXGI_FORMAT_BC1_UNORM, 8 },
+		{ GG::TextureCompression::Auto, false, DXGI_FORMAT_BC3_UNORM, 16 },
+	};
+	for (const Case& c : cases)
+	{
+		DirectX::ScratchImage result;
+		GG::TextureProcessingStats stats;
+		CHECK(SUCCEEDED(GG::TextureProcessing::Process(MakeImage(128, 128, c.opaque), c.compression, result, stats)));
+		CHECK(stats.format == c.format);
+		CHECK(result.GetMetadata().format == c.format);
+		CHECK(stats.mipLevels == 8);
+		// the mips under 4x4 take a whole block each
+		CHECK(stats.processedBytes == MipChainBytes(128, 128, c.blockBytes));
+		CHECK(stats.uncompressedBytes == MipChainBytes(128, 128, 0));
+	}
+
+	// not a whole number of blocks, left uncompressed but with its mips
+	DirectX::ScratchImage result;
+	GG::TextureProcessingStats stats;
+	CHECK(SUCCEEDED(GG::TextureProcessing::Process(MakeImage(250, 100, true), GG::TextureCompression::BC1, result, stats)));
+	CHECK(stats.format == DXGI_FORMAT_R8G8B8A8_UNORM);
+	CHECK(stats.mipLevels == 8);
+	CHECK(stats.processedBytes == stats.uncompressedBytes);
+}
+
+TEST(TextureProcessingKeepsQualityAndIsDeterministic)
+{
+	DirectX::ScratchImage reference;
+	GG::TextureProcessingStats stats;
+	CHECK(SUCCEEDED(GG::TextureProcessing::Process(MakeImage(128, 128, true), GG::TextureCompression::None, reference, stats)));
+
+	// the float encoder, the integer fast path, and both on the job system, which must give the same blocks
+	Egg::Jobs::JobSystem jobs;
+	GG::JobSystemExecutor executor{ jobs };
+	DirectX::ScratchImage accurate, fast, accurateOnJobs, fastOnJobs;
+	CHECK(SUCCEEDED(GG::TextureProcessing::Process(MakeImage(128, 128, true), GG::TextureCompression::BC1, accurate, stats)));
+	CHECK(SUCCEEDED(GG::TextureProcessing::Process(MakeImage(128, 128, true), GG::TextureCompression::BC1, fast, stats,
+		DirectX::TEX_COMPRESS_PARALLEL | DirectX::TEX_COMPRESS_BC_FAST)));
+	CHECK(SUCCEEDED(GG::TextureProcessing::Process(MakeImage(128, 128, true), GG::TextureCompression::BC1, accurateOnJobs, stats,
+		DirectX::TEX_COMPRESS_PARALLEL, &executor)));
+	CHECK(SUCCEEDED(GG::TextureProcessing::Process(MakeImage(128, 128, true), GG::TextureCompression::BC1, fastOnJobs, stats,
+		DirectX::TEX_COMPRESS_PARALLEL | DirectX::TEX_COMPRESS_BC_FAST, &executor)));
+	CHECK(SameBytes(accurate, accurateOnJobs));
+	CHECK(SameBytes(fast, fastOnJobs));
+
+	// smooth ramps compress well, and the fast path is not far behind
+	const double accuratePsnr = Psnr(accurate, reference);
+	const double fastPsnr = Psnr(fast, reference);
+	CHECK(accuratePsnr > 35.0);
+	CHECK(fastPsnr > 32.0);
+	CHECK(fastPsnr > accuratePsnr - 3.0);
+}
+
+TEST(TextureProcessingMatchesCookedFormats)
+{
+	auto matches = [](size_t width, size_t height, DXGI_FORMAT format, GG::TextureCompression compression) {
+		DirectX::TexMetadata metadata = {};
+		metadata.width = width;
+		metadata.height = height;
+		metadata.format = format;
+		return GG::TextureProcessing::MatchesCompression(metadata, compression);
+	};
+	// a bc7 cook is not what the app gets when it asks for bc1 or auto, and the other way around
+	CHECK(matches(256, 256, DXGI_FORMAT_BC7_UNORM, GG::TextureCompression::BC7));
+	CHECK(!matches(256, 256, DXGI_FORMAT_BC7_UNORM, GG::TextureCompression::BC1));
+	CHECK(!matches(256, 256, DXGI_FORMAT_BC7_UNORM, GG::TextureCompression::Auto));
+	CHECK(!matches(256, 256, DXGI_FORMAT_BC1_UNORM, GG::TextureCompression::BC7));
+	CHECK(matches(256, 256, DXGI_FORMAT_BC1_UNORM, GG::TextureCompression::Auto));
+	CHECK(matches(256, 256, DXGI_FORMAT_BC3_UNORM, GG::TextureCompression::Auto));
+	CHECK(matches(256, 256, DXGI_FORMAT_R8G8B8A8_UNORM, GG::TextureCompression::None));
+	CHECK(!matches(256, 256, DXGI_FORMAT_BC1_UNORM, GG::TextureCompression::None));
+	CHECK(!matches(256, 256, DXGI_FORMAT_R8G8B8A8_UNORM, GG::TextureCompression::Auto));
+	// sizes that are not whole blocks are never compressed
+	CHECK(matches(250, 100, DXGI_FORMAT_R8G8B8A8_UNORM, GG::TextureCompression::BC7));
+	CHECK(!matches(250, 100, DXGI_FORMAT_BC7_UNORM, GG::TextureCompression::BC7));
+}
+
+BENCHMARK(TextureProcessingMediaImages)
+{
+	// what Tex2D does on a cache miss without a cooked file, per image and compression, with the four bc7 presets;
+	// the throughput is of the uncompressed mip chain through the compressor
+	Egg::Jobs::JobSystem jobs;
+	GG::JobSystemExecutor executor{ jobs };
+	CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	for (const char* name : { "checkered.png", "floor.png", "giraffe.jpg" })
+	{
+		const std::wstring path = L"../Media/" + std::wstring(name, name + std::strlen(name));
+		DirectX::ScratchImage reference;
+		GG::TextureProcessingStats referenceStats;
+		if (FAILED(GG::TextureProcessing::LoadAndProcess(path, GG::TextureCompression::None, reference, referenceStats)))
+		{
+			std::printf("  %s could not be loaded\n", name);
+			continue;
+		}
+
+		struct Setting { const char* what; GG::TextureCompression compression; DWORD flags; };
+		const Setting settings[] = {
+			{ "BC1", GG::TextureCompression::BC1, DirectX::TEX_COMPRESS_PARALLEL },
+			{ "BC1 fast", GG::TextureCompression::BC1, DirectX::TEX_COMPRESS_PARALLEL | DirectX::TEX_COMPRESS_BC_FAST },
+			{ "BC7 ultrafast", GG::TextureCompression::BC7, DirectX::TEX_COMPRESS_PARALLEL | DirectX::TEX_COMPRESS_BC7_ULTRAFAST },
+			{ "BC7 fast", GG::TextureCompression::BC7, DirectX::TEX_COMPRESS_PARALLEL | DirectX::TEX_COMPRESS_BC7_FAST },
+			{ "BC7 normal", GG::TextureCompression::BC7, DirectX::TEX_COMPRESS_PARALLEL },
+			{ "BC7 slow", GG::TextureCompression::BC7, DirectX::TEX_COMPRESS_PARALLEL | DirectX::TEX_COMPRESS_BC7_SLOW },
+		};
+		for (const Setting& setting : settings)
+		{
+			DirectX::ScratchImage result;
+			GG::TextureProcessingStats stats;
+			if (FAILED(GG::TextureProcessing::LoadAndProcess(path, setting.compression, result, stats, setting.flags, &executor)))
+				continue;
+			const double megabytesPerSecond = stats.compressSeconds > 0.0 ? stats.uncompressedBytes / stats.compressSeconds / 1e6 : 0.0;
+			std::printf("  %s %ux%u %s: decode %.1f ms, mips %.1f ms, compress %.1f ms (%.1f MB/s), %llu KB -> %llu KB, psnr %.2f dB, rmse %.3f\n",
+				name, stats.width, stats.height, setting.what,
+				stats.decodeSeconds * 1000.0, stats.mipSeconds * 1000.0, stats.compressSeconds * 1000.0, megabytesPerSecond,
+				(unsigned long long)(stats.uncompressedBytes / 1024), (unsigned long long)(stats.processedBytes / 1024),
+				Psnr(result, reference), Rmse(result, reference));
+		}
+	}
+	CoUninitialize();
+}
@@ -0,0 +1,212 @@
+#include "Test.h"
+
+#include <Homework/TransformStore.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+	Float3 RandomPoint(Tests::Random& random)
+	{
+		return Float3(random.Float(-100.0f, 100.0f), random.Float(-100.0f, 100.0f), random.Float(-100.0f, 100.0f));
+	}
+
+	Float4 RandomOrientation(Tests::Random& random)
+	{
+		Float4 q(random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f));
+		float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+		return length > 1e-3f ? Float4(q.x / length, q.y / length, q.z / length, q.w / length) : Float4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	// the per-body path the store replaced: axis-angle, Rotation * Translation and a general Invert
+	Float4x4 ModelMatrix(const Float4& q, const Float3& p)
+	{
+		float w = std::min(1.0f, std::max(-1.0f, q.w));
+		float s = std::sqrt(std::max(1.0f - w * w, 0.0f));
+		if (s < 1e-6f)
+			return Float4x4::Translation(p);
+		return Float4x4::Rotation(Float3(q.x / s, q.y / s, q.z / s), 2.0f * std::acos(w)) * Float4x4::Translation(p);
+	}
+
+	bool Near(const Float4x4& a, const Float4x4& b, float tolerance)
+	{
+		for (int i = 0; i < 16; ++i)
+			if (std::fabs(a.l[i] - b.l[i]) > tolerance * std::max(1.0f, std::fabs(b.l[i])))
+				return false;
+		return true;
+	}
+
+	bool Equal(const Float4x4& a, const Float4x4& b)
+	{
+		for (int i = 0; i < 16; ++i)
+			if (a.l[i] != b.l[i])
+				return false;
+		return true;
+	}
+
+}
+
+TEST(TransformStoreMatricesMatchPerBodyPath)
+{
+	const uint32_t count = 1000;
+	Tests::Random random;
+	GG::TransformStore store;
+	for (uint32_t i = 0; i < count; ++i)
+		store.Add(RandomPoint(random), RandomOrientation(random));
+
+	store.Interpolate(0.0f);
+	store.UpdateMatrices();
+	CHECK(store.GetChanged().size() == count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Float4x4 expected = ModelMatrix(store.GetOrientation(i), store.GetPosition(i));
+		CHECK(Near(store.GetModelMatrix(i), expected, 1e-4f));
+		CHECK(Near(store.GetModelMatrixInverse(i), expected.Invert(), 1e-3f));
+		CHECK(Equal(store.GetModelMatrices()[i], store.GetModelMatrix(i)));
+	}
+	store.ClearChanged();
+
+	// a step moves every third body, the render state is halfway
+	std::vector<Float3> before(count);
+	for (uint32_t i = 0; i < count; ++i)
+		before[i] = store.GetSimulatedPosition(i);
+	std::vector<Float4x4> restingMatrices(store.GetModelMatrices(), store.GetModelMatrices() + count);
+
+	store.BeginStep();
+	for (uint32_t i = 0; i < count; i += 3)
+		store.Set(i, before[i] + Float3(1.0f, 2.0f, 3.0f), RandomOrientation(random));
+	CHECK(store.GetMovingCount() == (count + 2) / 3);
+
+	store.Interpolate(0.5f);
+	store.UpdateMatrices();
+	const std::vector<uint32_t>& changed = store.GetChanged();
+	CHECK(changed.size() == (count + 2) / 3);
+	CHECK(std::is_sorted(changed.begin(), changed.end()));
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (i % 3 == 0)
+		{
+			Float3 halfway = before[i] + Float3(0.5f, 1.0f, 1.5f);
+			CHECK_NEAR(store.GetPosition(i).x, halfway.x, 1e-4f);
+			CHECK_NEAR(store.GetPosition(i).y, halfway.y, 1e-4f);
+			CHECK_NEAR(store.GetPosition(i).z, halfway.z, 1e-4f);
+
+			const Float4& q = store.GetOrientation(i);
+			CHECK_NEAR(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w, 1.0f, 1e-5f);
+
+			Float4x4 expected = ModelMatrix(q, store.GetPosition(i));
+			CHECK(Near(store.GetModelMatrix(i), expected, 1e-4f));
+			CHECK(Near(store.GetModelMatrixInverse(i), expected.Invert(), 1e-3f));
+		}
+		else
+		{
+			// untouched
+			CHECK(Equal(store.GetModelMatrix(i), restingMatrices[i]));
+			CHECK(store.GetPosition(i).x == before[i].x);
+		}
+	}
+	store.ClearChanged();
+
+	// no step: the moving bodies are interpolated again, the resting ones are not visited
+	store.Interpolate(1.0f);
+	CHECK(store.GetChanged().size() == (count + 2) / 3);
+	store.UpdateMatrices();
+	for (uint32_t i = 0; i < count; i += 3)
+		CHECK_NEAR(store.GetPosition(i).x, before[i].x + 1.0f, 1e-4f);
+	store.ClearChanged();
+
+	// a step without Set: the moved bodies come to rest with one last rebuild, then nothing changes
+	store.BeginStep();
+	CHECK(store.GetMovingCount() == 0);
+	store.Interpolate(0.5f);
+	CHECK(store.GetChanged().size() == (count + 2) / 3);
+	store.UpdateMatrices();
+	for (uint32_t i = 0; i < count; i += 3)
+		CHECK(store.GetPosition(i).x == store.GetSimulatedPosition(i).x);
+	store.ClearChanged();
+	store.BeginStep();
+	store.Interpolate(0.5f);
+	CHECK(store.GetChanged().empty());
+}
+
+// the previous/current pair is the snapshot pipelined physics draws from while the next step runs:
+// writing a step's results must not change what interpolation at 0 gives
+TEST(TransformStoreStepKeepsPreviousSnapshot)
+{
+	GG::TransformStore store;
+	const Float4 identity(0.0f, 0.0f, 0.0f, 1.0f);
+	const Float4 turned(0.0f, 0.70710678f, 0.0f, 0.70710678f);
+	uint32_t a = store.Add(Float3(0.0f, 0.0f, 0.0f), identity);
+	uint32_t b = store.Add(Float3(5.0f, 0.0f, 0.0f), identity);
+
+	store.BeginStep();
+	store.Set(a, Float3(1.0f, 0.0f, 0.0f), turned);
+	store.BeginStep();
+	store.Set(a, Float3(2.0f, 0.0f, 0.0f), turned);
+
+	// previous is the result of the first step, current of the second
+	store.Interpolate(0.0f);
+	CHECK(store.GetPosition(a).x == 1.0f);
+	CHECK(store.GetSimulatedPosition(a).x == 2.0f);
+	CHECK_NEAR(store.GetOrientation(a).y, turned.y, 1e-6f);
+	store.Interpolate(1.0f);
+	CHECK(store.GetPosition(a).x == 2.0f);
+
+	// a body that was not written keeps previous == current
+	CHECK(store.GetPosition(b).x == 5.0f);
+	CHECK(store.GetSimulatedPosition(b).x == 5.0f);
+
+	// q and -q: interpolation takes the short arc and stays at the same rotation
+	store.BeginStep();
+	store.Set(a, Float3(2.0f, 0.0f, 0.0f), Float4(-turned.x, -turned.y, -turned.z, -turned.w));
+	store.Interpolate(0.5f);
+	const Float4& q = store.GetOrientation(a);
+	CHECK_NEAR(std::fabs(q.y), turned.y, 1e-6f);
+	CHECK_NEAR(std::fabs(q.w), turned.w, 1e-6f);
+}
+
+BENCHMARK(TransformStoreUpdate)
+{
+	const uint32_t count = 1 << 14;
+	Tests::Random random;
+	GG::TransformStore store;
+	std::vector<Float3> positions(count);
+	std::vector<Float4> orientations(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		positions[i] = RandomPoint(random);
+		orientations[i] = RandomOrientation(random);
+		store.Add(positions[i], orientations[i]);
+	}
+	std::vector<Float4x4> model(count), modelInverse(count);
+
+	double perBody = Tests::Measure([&] {
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			model[i] = ModelMatrix(orientations[i], positions[i]);
+			modelInverse[i] = model[i].Invert();
+		}
+		Tests::Consume(model.data());
+		Tests::Consume(modelInverse.data());
+	});
+	Tests::Report("16K bodies, per-body Rotation and Invert", perBody);
+
+	for (uint32_t stride : { 1u, 10u, 100u })
+	{
+		double stored = Tests::Measure([&] {
+			store.BeginStep();
+			for (uint32_t i = 0; i < count; i += stride)
+				store.Set(i, positions[i], orientations[i]);
+			store.Interpolate(0.5f);
+			store.UpdateMatrices();
+			store.ClearChanged();
+			Tests::Consume(store.GetModelMatrices());
+		});
+		char what[64];
+		std::snprintf(what, sizeof(what), "16K bodies, 1/%u moving, store", stride);
+		Tests::Report(what, stored, perBody);
+	}
+}
@@ -0,0 +1,49 @@
+/*
+Runs the tests of the cpu side of Egg and Homework, or with --bench their benchmarks.
+
+	Tests [--bench] [filter]
+
+Only the cases whose name contains filter are run. The exit code is the number of failed tests.
+Everything but the Windows-only cases also builds with the Makefile next to this file, "make tsan" builds
+the same binary with ThreadSanitizer.
+*/
+
+#include "Test.h"
+
+#include <cstdio>
+#include <cstring>
+
+int main(int argc, char* argv[])
+{
+	bool benchmarks = false;
+	const char* filter = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--bench") == 0)
+			benchmarks = true;
+		else
+			filter = argv[i];
+	}
+
+	uint32_t run = 0;
+	uint32_t failed = 0;
+	for (const Tests::Case& testCase : Tests::Registry())
+	{
+		if (testCase.benchmark != benchmarks || (filter && !std::strstr(testCase.name, filter)))
+			continue;
+
+		std::printf("%s\n", testCase.name);
+		std::fflush(stdout);
+		uint32_t failuresBefore = Tests::FailureCount();
+		testCase.run();
+		++run;
+		if (Tests::FailureCount() != failuresBefore)
+		{
+			++failed;
+			std::printf("  FAILED\n");
+		}
+	}
+
+	std::printf("%u %s run, %u failed\n", run, benchmarks ? "benchmarks" : "tests", failed);
+	return (int)failed;
+}
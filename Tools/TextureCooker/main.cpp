@@ -0,0 +1,358 @@
+/*
+Cooks the images of Media into dds files with all mips, block compressed, for Tex2D to load as they are.
+
+	TextureCooker [--in <dir>] [--out <dir>] [--format bc7|bc1|bc3|bc5|auto|none] [--quick] [--bc7 ultrafast|fast|normal|slow] [--fast] [--psnr] [--force] [--threads <n>]
+
+Defaults: --in ../Media --out ../Media/Cooked --format auto. Every image.ext is written to out/image.ext.dds,
+with the hash of the image's content, the format and the compress flags it was cooked with in out/image.ext.dds.hash.
+An output cooked with other settings is cooked again. Otherwise an output newer than its image is up to date,
+an older one whose recorded hash still matches (a checkout touched the image) is only touched.
+Tex2D only loads cooked files in the format it asks for, auto by default, so cook with the format the app uses.
+Images are cooked in parallel on the job system, one image per job, with the blocks of each image compressed
+by jobs of the same workers.
+--bc7 picks how far the bc7 encoder searches, --fast takes bc1 and bc3 through the integer encoder,
+--psnr reports the error of each cooked top level, so presets and encoders can be compared on the same images.
+*/
+
+#include <Egg/Common.h>
+#include <Egg/MappedFile.h>
+#include <Egg/Jobs/JobSystem.h>
+#include <Homework/AssetCache.h>
+#include <Homework/TextureProcessing.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+	enum class Outcome { Cooked, UpToDate, Touched, Failed };
+
+	struct Job
+	{
+		fs::path source;
+		fs::path output;
+		Outcome outcome = Outcome::Failed;
+		HRESULT error = S_OK;
+		uint64_t sourceFileBytes = 0;
+		uint64_t outputFileBytes = 0;
+		double seconds = 0.0;
+		// mean squared error of the top level against the decoded image, in 0..1 units, negative if not measured
+		double mse = -1.0;
+		GG::TextureProcessingStats stats;
+	};
+
+	struct Options
+	{
+		fs::path input = "../Media";
+		fs::path output = "../Media/Cooked";
+		GG::TextureCompression compression = GG::TextureCompression::Auto;
+		DWORD compressFlags = DirectX::TEX_COMPRESS_DEFAULT;
+		bool force = false;
+		bool psnr = false;
+		uint32_t threads = 0;
+	};
+
+	bool IsImage(const fs::path& path)
+	{
+		std::string ext = path.extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower(c); });
+		return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp" || ext == ".tif" || ext == ".tiff" || ext == ".gif";
+	}
+
+	const char* FormatName(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM: return "BC1";
+		case DXGI_FORMAT_BC3_UNORM: return "BC3";
+		case DXGI_FORMAT_BC5_UNORM: return "BC5";
+		case DXGI_FORMAT_BC7_UNORM: return "BC7";
+		case DXGI_FORMAT_UNKNOWN: return "-";
+		default: return "uncompressed";
+		}
+	}
+
+	bool ParseCompression(const char* name, GG::TextureCompression& compression)
+	{
+		const struct { const char* name; GG::TextureCompression compression; } names[] = {
+			{ "bc1", GG::TextureCompression::BC1 },
+			{ "bc3", GG::TextureCompression::BC3 },
+			{ "bc5", GG::TextureCompression::BC5 },
+			{ "bc7", GG::TextureCompression::BC7 },
+			{ "auto", GG::TextureCompression::Auto },
+			{ "none", GG::TextureCompression::None },
+		};
+		for (const auto& n : names)
+			if (_stricmp(name, n.name) == 0)
+			{
+				compression = n.compression;
+				return true;
+			}
+		return false;
+	}
+
+	bool ParseBC7Preset(const char* name, DWORD& compressFlags)
+	{
+		const struct { const char* name; DWORD flags; } names[] = {
+			{ "ultrafast", DirectX::TEX_COMPRESS_BC7_ULTRAFAST },
+			{ "fast", DirectX::TEX_COMPRESS_BC7_FAST },
+			{ "normal", 0 },
+			{ "slow", DirectX::TEX_COMPRESS_BC7_SLOW },
+		};
+		for (const auto& n : names)
+			if (_stricmp(name, n.name) == 0)
+			{
+				compressFlags = (compressFlags & ~(DWORD)DirectX::TEX_COMPRESS_BC7_QUALITY_MASK) | n.flags;
+				return true;
+			}
+		return false;
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const bool hasValue = i + 1 < argc;
+			if (strcmp(argv[i], "--in") == 0 && hasValue)
+				options.input = argv[++i];
+			else if (strcmp(argv[i], "--out") == 0 && hasValue)
+				options.output = argv[++i];
+			else if (strcmp(argv[i], "--format") == 0 && hasValue)
+			{
+				if (!ParseCompression(argv[++i], options.compression))
+					return false;
+			}
+			else if (strcmp(argv[i], "--bc7") == 0 && hasValue)
+			{
+				if (!ParseBC7Preset(argv[++i], options.compressFlags))
+					return false;
+			}
+			else if (strcmp(argv[i], "--threads") == 0 && hasValue)
+				options.threads = (uint32_t)atoi(argv[++i]);
+			else if (strcmp(argv[i], "--quick") == 0)
+				options.compressFlags |= DirectX::TEX_COMPRESS_BC7_QUICK;
+			else if (strcmp(argv[i], "--fast") == 0)
+				options.compressFlags |= DirectX::TEX_COMPRESS_BC_FAST;
+			else if (strcmp(argv[i], "--psnr") == 0)
+				options.psnr = true;
+			else if (strcmp(argv[i], "--force") == 0)
+				options.force = true;
+			else
+				return false;
+		}
+		return true;
+	}
+
+	bool HashFile(const fs::path& path, uint64_t& hash)
+	{
+		Egg::MappedFile file{ path.string() };
+		if (!file.IsValid())
+			return false;
+		hash = GG::HashContent(file.GetData(), file.GetSize());
+		return true;
+	}
+
+	// what an output was cooked from and how, kept next to it so a change of either cooks it again
+	struct Record
+	{
+		uint64_t hash = 0;
+		uint32_t compression = 0;
+		// the flags that change the blocks, not how they are scheduled
+		uint32_t compressFlags = 0;
+
+		bool SameSettings(const Record& other) const { return compression == other.compression && compressFlags == other.compressFlags; }
+	};
+
+	Record MakeRecord(uint64_t hash, const Options& options)
+	{
+		return Record{ hash, (uint32_t)options.compression, (uint32_t)(options.compressFlags & ~(DWORD)DirectX::TEX_COMPRESS_PARALLEL) };
+	}
+
+	// false for a missing file, and for one written before the settings were recorded
+	bool ReadRecord(const fs::path& path, Record& record)
+	{
+		std::ifstream in(path);
+		return (bool)(in >> std::hex >> record.hash >> record.compression >> record.compressFlags);
+	}
+
+	void WriteRecord(const fs::path& path, const Record& record)
+	{
+		std::ofstream out(path, std::ios::trunc);
+		out << std::hex << record.hash << ' ' << record.compression << ' ' << record.compressFlags << '\n';
+	}
+
+	// mean squared error of the cooked top level against the source, decoded again, negative if it can not be measured
+	double MeasureMSE(const fs::path& source, const DirectX::ScratchImage& cooked)
+	{
+		DirectX::ScratchImage decoded;
+		if (FAILED(DirectX::LoadFromWICFile(source.wstring().c_str(), DirectX::WIC_FLAGS_NONE, nullptr, decoded)))
+			return -1.0;
+
+		float mse;
+		if (FAILED(DirectX::ComputeMSE(*decoded.GetImage(0, 0, 0), *cooked.GetImage(0, 0, 0), mse, nullptr)))
+			return -1.0;
+		return mse;
+	}
+
+	void Cook(Job& job, const Options& options, DirectX::IParallelExecutor* executor)
+	{
+		using clock_type = std::chrono::high_resolution_clock;
+		const clock_type::time_point start = clock_type::now();
+
+		std::error_code ec;
+		job.sourceFileBytes = fs::file_size(job.source, ec);
+
+		const fs::path recordPath = job.output.string() + ".hash";
+		Record recorded;
+		const bool reusable = !options.force && fs::exists(job.output, ec) &&
+			ReadRecord(recordPath, recorded) && recorded.SameSettings(MakeRecord(0, options));
+
+		if (reusable && fs::last_write_time(job.output, ec) >= fs::last_write_time(job.source, ec))
+		{
+			job.outcome = Outcome::UpToDate;
+			return;
+		}
+
+		uint64_t hash = 0;
+		const bool hashed = HashFile(job.source, hash);
+
+		if (reusable)
+		{
+			if (hashed && recorded.hash == hash)
+			{
+				fs::last_write_time(job.output, fs::file_time_type::clock::now(), ec);
+				job.outcome = Outcome::Touched;
+				return;
+			}
+		}
+
+		// wic needs com on the thread that decodes, the workers are not initialized yet
+		const HRESULT coInit = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+		DirectX::ScratchImage image;
+		job.error = GG::TextureProcessing::LoadAndProcess(job.source.wstring(), options.compression, image, job.stats, options.compressFlags, executor);
+		if (SUCCEEDED(job.error) && options.psnr)
+			job.mse = MeasureMSE(job.source, image);
+		if (SUCCEEDED(job.error))
+			job.error = DirectX::SaveToDDSFile(image.GetImages(), image.GetImageCount(), image.GetMetadata(), DirectX::DDS_FLAGS_NONE, job.output.wstring().c_str());
+
+		if (SUCCEEDED(coInit))
+			CoUninitialize();
+
+		if (FAILED(job.error))
+			return;
+
+		if (hashed)
+			WriteRecord(recordPath, MakeRecord(hash, options));
+
+		job.outputFileBytes = fs::file_size(job.output, ec);
+		job.outcome = Outcome::Cooked;
+		job.seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		printf("usage: TextureCooker [--in <dir>] [--out <dir>] [--format bc7|bc1|bc3|bc5|auto|none] [--quick] [--bc7 ultrafast|fast|normal|slow] [--fast] [--psnr] [--force] [--threads <n>]\n");
+		return 1;
+	}
+
+	std::error_code ec;
+	if (!fs::is_directory(options.input, ec))
+	{
+		printf("input directory '%s' does not exist\n", options.input.string().c_str());
+		return 1;
+	}
+	fs::create_directories(options.output, ec);
+
+	std::vector<Job> jobs;
+	for (const fs::directory_entry& entry : fs::directory_iterator(options.input, ec))
+		if (entry.is_regular_file() && IsImage(entry.path()))
+		{
+			Job job;
+			job.source = entry.path();
+			job.output = options.output / (entry.path().filename().string() + ".dds");
+			jobs.push_back(job);
+		}
+
+	CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	using clock_type = std::chrono::high_resolution_clock;
+	const clock_type::time_point start = clock_type::now();
+	if (options.threads == 1)
+	{
+		for (Job& job : jobs)
+			Cook(job, options, nullptr);
+	}
+	else
+	{
+		// the images are cooked in parallel, and the blocks of each one too, a worker waiting for its blocks helps with the others
+		Egg::Jobs::JobSystem jobSystem{ options.threads > 1 ? options.threads - 1 : Egg::Jobs::JobSystem::DefaultWorkerCount() };
+		GG::JobSystemExecutor executor{ jobSystem };
+		jobSystem.ParallelFor(0, (uint32_t)jobs.size(), 1, [&](uint32_t first, uint32_t last) {
+			for (uint32_t i = first; i < last; i++)
+				Cook(jobs[i], options, &executor);
+		});
+	}
+	const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+	uint32_t cooked = 0, skipped = 0, failed = 0;
+	uint64_t sourceBytes = 0, outputBytes = 0, pixelBytes = 0;
+	for (const Job& job : jobs)
+	{
+		const std::string name = job.source.filename().string();
+		switch (job.outcome)
+		{
+		case Outcome::Cooked:
+			cooked++;
+			sourceBytes += job.sourceFileBytes;
+			outputBytes += job.outputFileBytes;
+			pixelBytes += job.stats.sourceBytes;
+			printf("cooked   %-24s %5ux%-5u %2u mips %-12s %9llu -> %9llu bytes  decode %.3fs  mips %.3fs  compress %.3fs  total %.3fs",
+				name.c_str(), job.stats.width, job.stats.height, job.stats.mipLevels, FormatName(job.stats.format),
+				(unsigned long long)job.sourceFileBytes, (unsigned long long)job.outputFileBytes,
+				job.stats.decodeSeconds, job.stats.mipSeconds, job.stats.compressSeconds, job.seconds);
+			if (job.mse >= 0.0)
+				printf("  rmse %.3f  psnr %.2fdB", std::sqrt(job.mse) * 255.0, job.mse > 0.0 ? 10.0 * std::log10(1.0 / job.mse) : 99.0);
+			printf("\n");
+			break;
+		case Outcome::UpToDate:
+			skipped++;
+			printf("current  %s\n", name.c_str());
+			break;
+		case Outcome::Touched:
+			skipped++;
+			printf("same     %s (content unchanged)\n", name.c_str());
+			break;
+		case Outcome::Failed:
+			failed++;
+			printf("FAILED   %s (hr 0x%08lx)\n", name.c_str(), (unsigned long)job.error);
+			break;
+		}
+	}
+
+	printf("\n%u cooked, %u up to date, %u failed in %.3fs", cooked, skipped, failed, seconds);
+	if (cooked > 0 && seconds > 0.0)
+		printf(", %.2f textures/s, %.2f MB/s of decoded pixels, %.2f MB of files -> %.2f MB",
+			cooked / seconds, pixelBytes / seconds / (1024.0 * 1024.0),
+			sourceBytes / (1024.0 * 1024.0), outputBytes / (1024.0 * 1024.0));
+	printf("\n");
+
+	CoUninitialize();
+	return failed > 0 ? 1 : 0;
+}